@@ -8,26 +8,22 @@
  * @since   Oct, 2021
  */
 
-//#define CF_USE_DISPLAY 0x3C                                                     // Uncomment to use display. Use the display address.
-
 // Libraries.
 
 #include <Logger.h>                                                             // Logger.
 #include <CFWiFiManagerHelper.h>                                                // CF WiFiManager Helper.
 #include <CFThingsBoardHelper.h>                                                // CF ThingsBoard Helper.
-
-// Optional libraries.
-
-#ifdef CF_USE_DISPLAY
-    #include <CFIconSet.h>                                                      // CF Icon Set for display.
-    #include <CFIoTDisplayHelper.h>                                             // Display.
-    CFIoTDisplayHelper _display(128, 64, CF_USE_DISPLAY);
-#endif
+#include <CFIconSet.h>                                                          // CF Icon Set for display.
+#include <CFIoTDisplayHelper.h>                                                 // Display.
+#include <CFDevice.h>                                                           // CF Device.
 
 // Software info.
 #define APP_CODE                        "cf-iot-app-code"                       // App code.
 #define APP_VERSION                     "1.0.0"                                 // App version.
 
+// Pin setup.
+#define DISPLAY_ADDRESS                 0x3C                                    // Display I2C address.
+
 // WiFiManager parameters.
 #define CF_WM_MAX_PARAMS_QTY            3
 WiFiManagerParameter _params[] = {
@@ -39,16 +35,17 @@ WiFiManagerParameter _params[] = {
 // CF Helpers.
 CFWiFiManagerHelper _cfWiFiManager;                                             // CF WiFiManager Helper.
 CFThingsBoardHelper _cfThingsBoard(APP_CODE, APP_VERSION);                      // CF WiFiManager Helper.
+CFIoTDisplayHelper _display(128, 64, DISPLAY_ADDRESS);                          // Display.
+
+// Device components, started and looped in this order. Add the sensors' helpers (and a
+// CFTelemetryValues for values set here), so the telemetry buffers are sized for them. Drop
+// _display for a device without one.
+CFDevice<_cfWiFiManager, _cfThingsBoard, _display> _device;
 
 void setup() {
     // Setup Serial.
     Serial.begin(115200);
 
-    // Start display.
-    #ifdef CF_USE_DISPLAY
-        _display.begin();
-    #endif
-
     // Setup logger.
     Logger::setLogLevel(Logger::NOTICE); // VERBOSE, NOTICE, WARNING, ERROR, FATAL, SILENT.
 
@@ -56,19 +53,19 @@ void setup() {
     _cfWiFiManager.setCustomParameters(_params, CF_WM_MAX_PARAMS_QTY);
     _cfWiFiManager.setOnSaveParametersCallback(onSaveParametersCallback);
     _cfWiFiManager.setOnConfigModeCallback(onConfigModeCallback);
-    _cfWiFiManager.begin();
+    _cfWiFiManager.setOnConnectCallback(onWiFiConnectCallback);
+    _device.begin();                                                            // Sizes MQTT buffer. Doesn't block while config portal is running.
 
     // Config ThingsBoard.
     onSaveParametersCallback();                                                 // Call the callback once to update the first time.
 
     // Config ThingsBoard.
-    _cfThingsBoard.setLocalIP(_cfWiFiManager.getLocalIP());
-    _cfThingsBoard.setOnThingsBoardConnectCallback(onThingsBoardConnectCallback);
+    _cfThingsBoard.onAttribute("attr_device_name", onDeviceNameCallback);
+    _cfThingsBoard.onRPC("default", RPCDefaultCallback);
 }
 
 void loop() {
-    _cfWiFiManager.loop();                                                      // Do WiFiManager loop.
-    _cfThingsBoard.loop();                                                      // Do ThingsBoard loop.
+    _device.loop();                                                             // Do WiFiManager, ThingsBoard (once Wi-Fi is up) and display loops.
 
     // Call render method.
     render();
@@ -84,13 +81,10 @@ void onSaveParametersCallback() {
 }
 
 /**
- * Callback to be called when receive any attribute update from ThingsBoard.
+ * Callback to be called when device name is updated on ThingsBoard.
  */
-void ATTRCallback(const RPC_Data &data) {
-    Logger::notice("Attr received.");
-
-    // Update attributes.
-    _cfWiFiManager.setParameter("p_device_name", data["attr_device_name"]);
+void onDeviceNameCallback(const char *value) {
+    _cfWiFiManager.setParameter("p_device_name", value);
 }
 
 /**
@@ -99,11 +93,8 @@ void ATTRCallback(const RPC_Data &data) {
 void RPCDefaultCallback(const RPC_Data &data, RPC_Response &resp) {
     Logger::notice("RPC default received.");
     
-    // Process data.
-    StaticJsonDocument<200> doc;
-    deserializeJson(doc, data);
-    
-    int value = doc["value"];
+    // Params are already parsed.
+    int value = data["value"];
     
     // Return value.
     JsonObject r  = resp.to<JsonObject>();
@@ -111,48 +102,39 @@ void RPCDefaultCallback(const RPC_Data &data, RPC_Response &resp) {
 }
 
 /**
- * Callbacks list to be called when receive a RPC from ThingsBoard.
+ * Callback to be called when Wi-Fi is connected.
  */
-int RPCCallbackListSize = 1;
-RPC_Callback RPCCallbackList[] = {
-    { "default",              RPCDefaultCallback }
-};
-
-/**
- * Callback to subscribe to ThingsBoard RPC/Attr.
- */
-void onThingsBoardConnectCallback() {
-    _cfThingsBoard.ATTRSubscribe(ATTRCallback);
-    _cfThingsBoard.RPCSubscribe(RPCCallbackList, RPCCallbackListSize);
+void onWiFiConnectCallback() {
+    _cfThingsBoard.setLocalIP(_cfWiFiManager.getLocalIP());
 }
 
 /**
  * Callback to be called when Wi-Fi config mode is called.
  */
 void onConfigModeCallback() {
-    // Render if display is defined.
-    #ifdef CF_USE_DISPLAY
-        _display.clearDisplay();
+    Logger::notice("Config portal started.");
+}
 
-        // Draw bitmaps.
-        _display.drawBitmap(0, 0, CFIconSet::NETWORK_HIGH_BARS_8X8, 8, 7, 1);   // Network.
-        _display.drawBitmap(96, 0, CFIconSet::PHONE_8X8, 8, 7, 1);              // Things Board.
-        
-        // Draw lines.
-        _display.setCursor(0, 0);                                               // Line 1 Size 1
-        _display.print("  AP STARTED      OFF");
+/**
+ * Render config mode screen.
+ */
+void renderConfigMode() {
+    // Draw bitmaps.
+    _display.drawBitmap(0, 0, CFIconSet::NETWORK_HIGH_BARS_8X8, 8, 7, 1);       // Network.
+    _display.drawBitmap(96, 0, CFIconSet::PHONE_8X8, 8, 7, 1);                  // Things Board.
     
-        _display.setCursor(0, 24);                                              // Line 3 Size 1
-        _display.print(" SSID: " + _cfWiFiManager.getDefaultSSID());
+    // Draw lines.
+    _display.setCursor(0, 0);                                                   // Line 1 Size 1
+    _display.print("  AP STARTED      OFF");
+
+    _display.setCursor(0, 24);                                                  // Line 3 Size 1
+    _display.print(" SSID: " + _cfWiFiManager.getDefaultSSID());
+
+    _display.setCursor(0, 32);                                                  // Line 4 Size 1
+    _display.print(" PASS: " + _cfWiFiManager.getDefaultPassword());
     
-        _display.setCursor(0, 32);                                              // Line 4 Size 1
-        _display.print(" PASS: " + _cfWiFiManager.getDefaultPassword());
-        
-        _display.setCursor(0, 40);                                              // Line 5 Size 1
-        _display.print(" IP: " + _cfWiFiManager.getLocalIP());
-        
-        _display.display();
-    #endif
+    _display.setCursor(0, 40);                                                  // Line 5 Size 1
+    _display.print(" IP: " + _cfWiFiManager.getLocalIP());
 }
 
 void renderHeader() {
@@ -184,15 +166,23 @@ void renderHeader() {
 }
 
 /**
- * Render if display is defined.
+ * Render if the device has a display.
  */
 void render() {
-    #ifdef CF_USE_DISPLAY
+    if (_device.has<CFIoTDisplayHelper>()) {
         _display.clearDisplay();
+
+        // Config portal is running in background, keep showing how to reach it.
+        if (_cfWiFiManager.isConfigMode()) {
+            renderConfigMode();
+            _display.display();
+            return;
+        }
+
         renderHeader();
 
         // Render body.
         
         _display.display();
-    #endif
+    }
 }
\ No newline at end of file
@@ -1,9 +1,8 @@
-#include <ESP8266HTTPClient.h>
 #include <Logger.h>
 #include <CFWiFiManagerHelper.h>
-
-WiFiClientSecure wifiClient;
-HTTPClient https;
+#include <CFIntercomHelper.h>
+#include <CFNotificationHelper.h>
+#include <CFRateLimiter.h>
 
 CFWiFiManagerHelper _cfWiFiManager(3000);
 #define CF_WM_MAX_PARAMS_QTY 4
@@ -15,17 +14,17 @@ WiFiManagerParameter _params[] = {{"p_device_name", "Device Name", _cfWiFiManage
 
 #define PIN_INTERCOM A0
 
-const char *WEBHOOK_BASE = "https://api.telegram.org/bot";
-const char *ACTION = "/sendMessage";
-const char *CHAT_ID = "?chat_id=";
-const char *MESSAGE = "&text=";
-const int READ_DELAY = 100;
-const int NOTIFICATION_DELAY = 5000;
+CFIntercomHelper _intercom(PIN_INTERCOM);
+CFNotificationHelper _notifier;
+CFTelegramTarget _telegram;
+
+const unsigned long NOTIFICATION_WINDOW = 5000;     // Rings within the window are merged into one notification.
+const uint8_t NOTIFICATION_BURST = 3;               // Notifications that can be sent back to back.
+const unsigned long NOTIFICATION_REFILL = 60000;    // Time to earn one more notification.
+
+CFRateLimiter _rateLimiter(NOTIFICATION_WINDOW, NOTIFICATION_BURST, NOTIFICATION_REFILL);
 
-char webhookURL[200];
-unsigned long lastRead = 0;
-unsigned long lastNotificationSent = 0;
-int voltage;
+char message[CF_NOTIFICATION_MESSAGE_SIZE];
 
 void setup() {
   Serial.begin(115200);
@@ -37,47 +36,47 @@ void setup() {
   _cfWiFiManager.begin();
   onSaveParametersCallback();
 
-  refreshWebhookURL();
+  // Config intercom.
+  _intercom.setOnRingCallback(onRingCallback);
+  _intercom.setOnRingEndCallback(onRingEndCallback);
+  _intercom.begin();
+
+  // Config notifications.
+  _rateLimiter.setOnAlertCallback(onAlertCallback);
 }
 
 void loop() {
   _cfWiFiManager.loop();
-  if (millis() < lastRead || millis() - lastRead > READ_DELAY) {
-    lastRead = millis();
-    voltage = analogRead(PIN_INTERCOM) / 1024.0 * 12;
-    if (voltage > 6) {
-      if (millis() < lastNotificationSent || millis() - lastNotificationSent > NOTIFICATION_DELAY) {
-        lastNotificationSent = millis();
-        Logger::notice("Voltage change indentified. Sending notification.");
-        wifiClient.setInsecure();
-        https.begin(wifiClient, webhookURL);
-        int httpCode = https.GET();
-        if (httpCode == HTTP_CODE_OK) {
-          String payload = https.getString();
-          Logger::notice("A notification has been sent.");
-          Logger::notice("[HTTPS] Received payload telegram: " + payload);
-        } else {
-          Logger::notice("Sending notification has failed. Error: " + String(httpCode) + " (" + webhookURL + ")");
-        }
-        https.end();
-      }
-    }
+  _intercom.loop();
+  _rateLimiter.loop();
+  _notifier.loop();
+}
+
+void onRingCallback() {
+  _rateLimiter.trigger(&_telegram);
+}
+
+void onAlertCallback(const void *destination, unsigned long count) {
+  char text[CF_NOTIFICATION_MESSAGE_SIZE];
+  if (count > 1) {
+    snprintf(text, sizeof(text), "%s (x%lu)", message, count);
+  } else {
+    strlcpy(text, message, sizeof(text));
   }
+  Logger::notice("Ring identified. Sending notification.");
+  _notifier.notify((CFNotificationTarget *) destination, text);
 }
 
-void refreshWebhookURL() {
-  String message = _cfWiFiManager.getParameter("p_message");
-  message.replace(" ", "+");
-  strcpy(webhookURL, WEBHOOK_BASE);
-  strcat(webhookURL, _cfWiFiManager.getParameter("p_bot_token").c_str());
-  strcat(webhookURL, ACTION);
-  strcat(webhookURL, CHAT_ID);
-  strcat(webhookURL, _cfWiFiManager.getParameter("p_chat_id").c_str());
-  strcat(webhookURL, MESSAGE);
-  strcat(webhookURL, message.c_str());
+void onRingEndCallback(unsigned long duration) {
+  Logger::notice("Ring #" + String(_intercom.getRingCount()) + " lasted " + String(duration) + " ms.");
+}
+
+void refreshTarget() {
+  _telegram.set(_cfWiFiManager.getParameter("p_bot_token"), _cfWiFiManager.getParameter("p_chat_id"));
+  strlcpy(message, _cfWiFiManager.getParameter("p_message"), sizeof(message));
 }
 
 void onSaveParametersCallback() {
   Logger::notice("On save parameters callback called.");
-  refreshWebhookURL();
-}
+  refreshTarget();
+}
\ No newline at end of file
@@ -8,22 +8,20 @@
  * @since   Sep, 2021
  */
 
-#define CF_USE_DISPLAY 0x3C                                                     // Uncomment to use display. Use the display address.
-
 // Libraries.
 
 #include <Logger.h>                                                             // Logger.
 #include <CFWiFiManagerHelper.h>                                                // CF WiFiManager Helper.
 #include <CFThingsBoardHelper.h>                                                // CF ThingsBoard Helper.
 #include <CFSoilMoistureHelper.h>                                               // CF soil moisture sensor.
-
-// Optional libraries.
-
-#ifdef CF_USE_DISPLAY
-    #include <CFIconSet.h>                                                      // CF Icon Set for display.
-    #include <CFIoTDisplayHelper.h>                                             // Display.
-    CFIoTDisplayHelper _display(128, 64, CF_USE_DISPLAY);
-#endif
+#include <CFLoopSupervisor.h>                                                   // CF Loop Supervisor.
+#include <CFHeap.h>                                                             // CF Heap.
+#include <CFTrend.h>                                                            // CF Trend.
+#include <CFLocalEndpoint.h>                                                    // CF Local Endpoint.
+#include <CFTimeSeries.h>                                                       // CF Time Series.
+#include <CFIconSet.h>                                                          // CF Icon Set for display.
+#include <CFIoTDisplayHelper.h>                                                 // Display.
+#include <CFDevice.h>                                                           // CF Device.
 
 // Software info.
 #define APP_CODE                        "cf-iot-soilmoisture-monitor"           // App code.
@@ -31,6 +29,11 @@
 
 // Pin setup.
 #define PIN_SOILMOISTURE                A0                                      // Soil moisture pin.
+#define DISPLAY_ADDRESS                 0x3C                                    // Display I2C address.
+
+// Dry out prediction.
+#define SOIL_DRY_PERCENT                30                                      // Pot needs water below this percent.
+#define SOIL_DRY_WARNING                7200000                                 // Send right away when dry within 2 hours.
 
 // WiFiManager parameters.
 #define CF_WM_MAX_PARAMS_QTY            5
@@ -45,48 +48,119 @@ WiFiManagerParameter _params[] = {
 // CF Helpers.
 CFWiFiManagerHelper _cfWiFiManager;                                             // CF WiFiManager Helper.
 CFThingsBoardHelper _cfThingsBoard(APP_CODE, APP_VERSION);                      // CF WiFiManager Helper.
+CFLocalEndpoint _localEndpoint;                                                 // Readings and metrics on http://<ip>:8080/metrics.
+CFIoTDisplayHelper _display(128, 64, DISPLAY_ADDRESS);                          // Display.
 
 // Create a sensor object.
 CFSoilMoistureHelper _soilMoisture(PIN_SOILMOISTURE);                           // CF soil moisture sensor.
+CFAggregator _soilAggregate;                                                    // Soil moisture percent between sends.
+CFAdaptiveSampler _soilSampler(1000, 60000);                                    // Read every 1 s while watering, up to 60 s when stable.
+CFTrend _soilTrend(1800000);                                                    // Drying trend over the last ~30 minutes.
+CFTimeSeries _history;                                                          // Soil moisture history in SPIFFS.
+int _soilSeries;                                                                // Soil moisture percent series.
+CFTelemetryValues<2> _soilTrendValues;                                          // Drying rate and time to dry, set from the trend.
+
+// Device components, started and looped in this order. Drop _display for a device without one.
+CFDevice<_soilMoisture, _history, _cfWiFiManager, _cfThingsBoard, _display, _soilTrendValues> _device;
+
+// Loop supervisor and its sections.
+CFLoopSupervisor _supervisor;                                                   // CF Loop Supervisor.
+int _sectionSoil;                                                               // Soil moisture section.
+int _sectionWiFi;                                                               // WiFiManager section.
+int _sectionThingsBoard;                                                        // ThingsBoard section.
+int _sectionRender;                                                             // Render section.
+int _sectionDisplay;                                                            // Display flush section.
 
 void setup() {
     // Start Serial.
     Serial.begin(115200);
 
-    // Start display.
-    #ifdef CF_USE_DISPLAY
-        _display.begin();
-    #endif
-    
     // Setup Logger.
     Logger::setLogLevel(Logger::NOTICE); // VERBOSE, NOTICE, WARNING, ERROR, FATAL, SILENT.
+
+    // Read faster when raw value moves over 20 per minute (changes within 3 are noise).
+    _soilSampler.setRateThreshold(20, 3);
+    _soilMoisture.setAdaptiveSampler(_soilSampler);
+    _soilTrend.setThreshold(SOIL_DRY_PERCENT, SOIL_DRY_WARNING);
+
+    // Keep history (needs the clock), sent to ThingsBoard after outages and served on /history.
+    configTime(0, 0, "pool.ntp.org");
+    _soilSeries = _history.addSeries("soi_perct");
+
+    // Config loop supervisor. Budgets in microseconds. Render may wait when loop is late.
+    _supervisor.begin();                                                        // Report offenders from before reboot.
+    _sectionSoil = _supervisor.addSection("soil", 2000);
+    _sectionWiFi = _supervisor.addSection("wifi", 20000);
+    _sectionThingsBoard = _supervisor.addSection("tb", 50000);
+    _sectionRender = _supervisor.addSection("render", 30000, true);
+    _sectionDisplay = _supervisor.addSection("display", 5000);
+    _supervisor.setLoopBudget(50000);
     
     // Config WiFiManager.
     _cfWiFiManager.setCustomParameters(_params, CF_WM_MAX_PARAMS_QTY);
     _cfWiFiManager.setOnSaveParametersCallback(onSaveParametersCallback);
     _cfWiFiManager.setOnConfigModeCallback(onConfigModeCallback);
-    _cfWiFiManager.begin();
+    _cfWiFiManager.setOnConnectCallback(onWiFiConnectCallback);
+    _cfWiFiManager.setLocalEndpoint(_localEndpoint);                            // LAN monitoring without ThingsBoard.
+
+    // Start components: MQTT buffer and telemetry document are sized from them, WiFiManager
+    // doesn't block while config portal is running.
+    _device.begin();
+    if (_device.has<CFIoTDisplayHelper>()) {
+        _display.setDoubleBuffered(true);                                       // Render doesn't wait for I2C.
+    }
 
     // Config ThingsBoard.
     onSaveParametersCallback();                                                 // Call the callback once to update the first time.
 
     // Config ThingsBoard.
-    _cfThingsBoard.setLocalIP(_cfWiFiManager.getLocalIP());
-    _cfThingsBoard.setOnThingsBoardConnectCallback(onThingsBoardConnectCallback);
+    _cfThingsBoard.onAttribute("attr_device_name", onDeviceNameCallback);
+    _cfThingsBoard.onAttribute("attr_soilm_dryval", onDryValueCallback);
+    _cfThingsBoard.onAttribute("attr_soilm_wetval", onWetValueCallback);
+    _cfThingsBoard.onRPC("default", RPCDefaultCallback);
+    _cfThingsBoard.setTelemetryAggregate("soi_perct", _soilAggregate);          // Every reading between sends.
+    _cfThingsBoard.setBackfill(_history);
+    _localEndpoint.setTimeSeries(_history);
 }
 
 void loop() {
-    _soilMoisture.loop();                                                       // Soil moisture loop.
+    _supervisor.loop();                                                         // Mark loop start.
+
+    // Loop components, each in its section, in the order they're listed. ThingsBoard waits for Wi-Fi.
+    const int sections[] = {_sectionSoil, _sectionSoil, _sectionWiFi, _sectionThingsBoard, _sectionDisplay, -1};
+    if (_device.loop(_supervisor, sections) & _device.bit<_soilMoisture>()) {
+        _soilAggregate.add(_soilMoisture.getSersorPercent());
+        _history.add(_soilSeries, _soilMoisture.getSersorPercent());
+
+        // Drying rate and when the pot dries out. Don't wait for the next send if it's soon.
+        if (_soilTrend.add(_soilMoisture.getSersorPercent())) {
+            _cfThingsBoard.sendNow();
+        }
+        if (_soilTrend.isFitted()) {
+            _cfThingsBoard.setTelemetryValue("soi_rate", _soilTrend.getRate());  // % per hour.
+            _cfThingsBoard.setTelemetryValue("soi_dry_min", (int) _soilTrend.getTimeToThreshold());
+        }
+    }
 
     // Set telemetry data.
     _cfThingsBoard.setTelemetryValue("soi_value", _soilMoisture.getRawSensorValue());
     _cfThingsBoard.setTelemetryValue("soi_perct", _soilMoisture.getSersorPercent());
+    _localEndpoint.setReading("soi_value", _soilMoisture.getRawSensorValue());
+    _localEndpoint.setReading("soi_perct", _soilMoisture.getSersorPercent());
+
+    // Setup is over once ThingsBoard is first connected. From then on nothing allocates but the
+    // core's connections and the portal (counted as heap_allowed), so any other allocation traps.
+    // Notices are only for reconnections and the like, but Logger builds a String for each.
+    if (!CFHeap::isSealed() && _cfThingsBoard.isConnected()) {
+        CFHeap::seal(true);
+        Logger::setLogLevel(Logger::WARNING);
+    }
 
-    _cfWiFiManager.loop();                                                      // Do WiFiManager loop.
-    _cfThingsBoard.loop();                                                      // Do ThingsBoard loop.
-
-    // Call render method.
-    render();
+    // Call render method. The display streams the frame over the next loops.
+    if (_supervisor.start(_sectionRender)) {
+        render();
+        _supervisor.stop(_sectionRender);
+    }
 }
 
 /**
@@ -99,33 +173,39 @@ void onSaveParametersCallback() {
     _cfThingsBoard.setAttributeValue("attr_soilm_dryval", _cfWiFiManager.getParameter("p_soilm_dryval"));
     _cfThingsBoard.setAttributeValue("attr_soilm_wetval", _cfWiFiManager.getParameter("p_soilm_wetval"));
     
-    _soilMoisture.setRawDryValue(_cfWiFiManager.getParameter("p_soilm_dryval").toInt());
-    _soilMoisture.setRawWetValue(_cfWiFiManager.getParameter("p_soilm_wetval").toInt());
+    _soilMoisture.setRawDryValue(atoi(_cfWiFiManager.getParameter("p_soilm_dryval")));
+    _soilMoisture.setRawWetValue(atoi(_cfWiFiManager.getParameter("p_soilm_wetval")));
 }
 
 /**
- * Callback to be called when receive any attribute update from ThingsBoard.
+ * Callback to be called when device name is updated on ThingsBoard.
  */
-void ATTRCallback(const RPC_Data &data) {
-    Logger::notice("Attr received.");
+void onDeviceNameCallback(const char *value) {
+    _cfWiFiManager.setParameter("p_device_name", value);
+}
 
-    // Update attributes.
-    _cfWiFiManager.setParameter("p_device_name", data["attr_device_name"]);
-    _cfWiFiManager.setParameter("p_soilm_dryval", data["attr_soilm_dryval"]);
-    _cfWiFiManager.setParameter("p_soilm_wetval", data["attr_soilm_wetval"]);
+/**
+ * Callback to be called when dry value is updated on ThingsBoard.
+ */
+void onDryValueCallback(const char *value) {
+    _cfWiFiManager.setParameter("p_soilm_dryval", value);
+}
+
+/**
+ * Callback to be called when wet value is updated on ThingsBoard.
+ */
+void onWetValueCallback(const char *value) {
+    _cfWiFiManager.setParameter("p_soilm_wetval", value);
 }
 
 /**
  * Callback to be called when receive default RPC from ThingsBoard.
  */
 void RPCDefaultCallback(const RPC_Data &data, RPC_Response &resp) {
-    Logger::notice("RPC default received.");
-    
-    // Process data.
-    StaticJsonDocument<200> doc;
-    deserializeJson(doc, data);
+    CF_LOG_NOTICE("RPC default received.");
     
-    int value = doc["value"];
+    // Params are already parsed.
+    int value = data["value"];
     
     // Return value.
     JsonObject r  = resp.to<JsonObject>();
@@ -133,51 +213,49 @@ void RPCDefaultCallback(const RPC_Data &data, RPC_Response &resp) {
 }
 
 /**
- * Callbacks list to be called when receive a RPC from ThingsBoard.
+ * Callback to be called when Wi-Fi is connected.
  */
-int RPCCallbackListSize = 1;
-RPC_Callback RPCCallbackList[] = {
-    { "default",              RPCDefaultCallback }
-};
+void onWiFiConnectCallback() {
+    _cfThingsBoard.setLocalIP(_cfWiFiManager.getLocalIP());
+}
 
 /**
- * Callback to subscribe to ThingsBoard RPC/Attr.
+ * Callback to be called when Wi-Fi config mode is called.
  */
-void onThingsBoardConnectCallback() {
-    _cfThingsBoard.ATTRSubscribe(ATTRCallback);
-    _cfThingsBoard.RPCSubscribe(RPCCallbackList, RPCCallbackListSize);
+void onConfigModeCallback() {
+    CF_LOG_NOTICE("Config portal started.");
 }
 
 /**
- * Callback to be called when Wi-Fi config mode is called.
+ * Render config mode screen.
  */
-void onConfigModeCallback() {
-    // Render if display is defined.
-    #ifdef CF_USE_DISPLAY
-        _display.clearDisplay();
+void renderConfigMode() {
+    char line[22];                                                              // One line of text.
 
-        // Draw bitmaps.
-        _display.drawBitmap(0, 0, CFIconSet::NETWORK_HIGH_BARS_8X8, 8, 7, 1);   // Network.
-        _display.drawBitmap(96, 0, CFIconSet::PHONE_8X8, 8, 7, 1);              // Things Board.
-        
-        // Draw lines.
-        _display.setCursor(0, 0);                                               // Line 1 Size 1
-        _display.print("  AP STARTED      OFF");
+    // Draw bitmaps.
+    _display.drawBitmap(0, 0, CFIconSet::NETWORK_HIGH_BARS_8X8, 8, 7, 1);       // Network.
+    _display.drawBitmap(96, 0, CFIconSet::PHONE_8X8, 8, 7, 1);                  // Things Board.
     
-        _display.setCursor(0, 24);                                              // Line 3 Size 1
-        _display.print(" SSID: " + _cfWiFiManager.getDefaultSSID());
+    // Draw lines.
+    _display.setCursor(0, 0);                                                   // Line 1 Size 1
+    _display.print("  AP STARTED      OFF");
+
+    _display.setCursor(0, 24);                                                  // Line 3 Size 1
+    snprintf(line, sizeof(line), " SSID: %s", _cfWiFiManager.getDefaultSSID().c_str());
+    _display.print(line);
+
+    _display.setCursor(0, 32);                                                  // Line 4 Size 1
+    snprintf(line, sizeof(line), " PASS: %s", _cfWiFiManager.getDefaultPassword().c_str());
+    _display.print(line);
     
-        _display.setCursor(0, 32);                                              // Line 4 Size 1
-        _display.print(" PASS: " + _cfWiFiManager.getDefaultPassword());
-        
-        _display.setCursor(0, 40);                                              // Line 5 Size 1
-        _display.print(" IP: " + _cfWiFiManager.getLocalIP());
-        
-        _display.display();
-    #endif
+    _display.setCursor(0, 40);                                                  // Line 5 Size 1
+    snprintf(line, sizeof(line), " IP: %s", _cfWiFiManager.getLocalIP().c_str());
+    _display.print(line);
 }
 
 void renderHeader() {
+    char line[22];                                                              // One line of text.
+
     _display.drawBitmap(0, 0, CFIconSet::NETWORK_HIGH_BARS_8X8, 8, 7, 1);       // Network.
     _display.drawBitmap(96, 0, CFIconSet::PHONE_8X8, 8, 7, 1);                  // Things Board.
     
@@ -185,32 +263,32 @@ void renderHeader() {
     if (!_cfWiFiManager.isConnected()) {
         _display.print("  OFFLINE         OFF");
     } else {
-        // Print SSID.
-        String ssid = _cfWiFiManager.getSSID().substring(0, 13);
-        for (int i = ssid.length(); i < 13; i++) {
-            ssid += " ";
-        }
-        _display.print("  " + ssid + "   ");
-
-        // Print if ThingsBoard is connected.
-        if (_cfThingsBoard.isConnected()) {
-            _display.print("ON");
-        } else {
-            _display.print("OFF");
-        }
+        // Print SSID and if ThingsBoard is connected.
+        snprintf(line, sizeof(line), "  %-13.13s   %s", _cfWiFiManager.getSSID().c_str(),
+                _cfThingsBoard.isConnected() ? "ON" : "OFF");
+        _display.print(line);
 
         // Print IP address.
         _display.setCursor(0, 8);                                               // Line 2 Size 1.
-        _display.print("IP: " + _cfWiFiManager.getLocalIP());
+        snprintf(line, sizeof(line), "IP: %s", _cfWiFiManager.getLocalIP().c_str());
+        _display.print(line);
     }
 }
 
 /**
- * Render if display is defined.
+ * Render if the device has a display.
  */
 void render() {
-    #ifdef CF_USE_DISPLAY
+    if (_device.has<CFIoTDisplayHelper>()) {
         _display.clearDisplay();
+
+        // Config portal is running in background, keep showing how to reach it.
+        if (_cfWiFiManager.isConfigMode()) {
+            renderConfigMode();
+            _display.display();
+            return;
+        }
+
         renderHeader();
 
         // Render body.
@@ -220,38 +298,20 @@ void render() {
         _display.drawBitmap(8, 40, CFIconSet::WATERDROP_8X8, 8, 7, 1);      // Wet value.
         _display.drawBitmap(64, 40, CFIconSet::NO_WATER_8X8, 8, 7, 1);      // Dry value.
 
-        String moisturePercent = String(_soilMoisture.getSersorPercent());  // Moisture percent.
-        String moistureRawValue = String(_soilMoisture.getRawSensorValue());// Moisture raw value.
-        String rawWaterValue = String(_soilMoisture.getRawWetValue());      // Raw water value.
-        String rawDryValue = String(_soilMoisture.getRawDryValue());        // Raw dry value.
+        char line[22];                                                      // One line of text.
 
         // Display moisture percent and raw value.
         _display.setCursor(0, 24);                                          // Line 4 Size 1.
-        _display.print("    ");
-        for (int i = moisturePercent.length(); i < 4; i++) {
-            moisturePercent += " ";
-        }
-        _display.print(moisturePercent);
-        _display.print("%    ");
-        for (int i = moistureRawValue.length(); i < 4; i++) {
-            moistureRawValue += " ";
-        }
-        _display.print(moistureRawValue);
-        _display.print("RAW");
+        snprintf(line, sizeof(line), "    %-4d%%    %-4dRAW", _soilMoisture.getSersorPercent(),
+                _soilMoisture.getRawSensorValue());
+        _display.print(line);
 
         // Display dry and wet value.
         _display.setCursor(0, 40);                                          // Line 6 Size 1.
-        _display.print("    ");
-        for (int i = rawWaterValue.length(); i < 4; i++) {
-            rawWaterValue += " ";
-        }
-        _display.print(rawWaterValue);
-        _display.print("     ");
-        for (int i = rawDryValue.length(); i < 4; i++) {
-            rawDryValue += " ";
-        }
-        _display.print(rawDryValue);
+        snprintf(line, sizeof(line), "    %-4d     %-4d", _soilMoisture.getRawWetValue(),
+                _soilMoisture.getRawDryValue());
+        _display.print(line);
         
         _display.display();
-    #endif
+    }
 }
\ No newline at end of file
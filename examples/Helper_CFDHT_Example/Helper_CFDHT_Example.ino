@@ -40,7 +40,12 @@ void loop() {
         Serial.print("Heat Index C:  ");
         Serial.println(dht.getHeatIndexC());
         Serial.print("Heat Index F:  ");
-        Serial.println(dht.getHeatIndexC());
+        Serial.println(dht.getHeatIndexF());
+        Serial.print("Dew Point C:   ");
+        Serial.println(dht.getDewPointC());
+        Serial.print("Abs. Humidity: ");
+        Serial.print(dht.getAbsoluteHumidity());
+        Serial.println(" g/m3");
         Serial.print("Humidity %:    ");
         Serial.print(dht.getHumidity());
         Serial.println("%\n");
@@ -0,0 +1,613 @@
+/**
+ * Arduino.cpp
+ *
+ * Host HAL: virtual clock, pins, math, String and new of the ESP8266 Arduino core.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <Arduino.h>                                                            // Host Arduino.
+#include <stdarg.h>                                                             // Variable arguments.
+#include <unistd.h>                                                             // Process id.
+#include <chrono>                                                               // Clock.
+#include <thread>                                                               // Sleep.
+#include <new>                                                                  // Allocation failure.
+#if defined(__GLIBC__)
+    #include <malloc.h>                                                         // Heap statistics.
+#elif defined(__APPLE__)
+    #include <malloc/malloc.h>                                                  // Heap statistics.
+#endif
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const std::chrono::steady_clock::time_point _tStart = std::chrono::steady_clock::now();
+static const time_t _timeStart = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+static double _speed = 1;                                                       // Virtual clock speed.
+static bool _fastForward = false;                                               // Only delay() runs faster.
+static double _skipped = 0;                                                     // Virtual us delay() skipped.
+static bool _expectingReply = false;                                            // Written, nothing read since.
+static std::chrono::steady_clock::time_point _tWritten;                         // When it was written.
+static int _pins[CF_HOST_PINS];                                                 // Pin values.
+
+/**
+ * Get the heap in use by the process.
+ *
+ * @return Bytes, or 0 where the C library doesn't tell.
+ */
+static size_t _heapInUse() {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return (unsigned int) mallinfo().uordblks;
+#elif defined(__APPLE__)
+    return mstats().bytes_used;
+#else
+    return 0;
+#endif
+}
+
+// Heap in use before any global of the program is built.
+static struct HeapStart {
+    size_t used = _heapInUse();
+} _heapStart __attribute__((init_priority(101)));
+
+/**
+ * Get virtual us since start, not wrapped.
+ *
+ * @return Virtual us.
+ */
+static double _virtualMicros() {
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - _tStart;
+    return _fastForward ? elapsed.count() + _skipped : elapsed.count() * _speed;
+}
+
+/**
+ * Sleep virtual us.
+ *
+ * @param us Virtual us.
+ */
+static void _sleep(double us) {
+    bool waiting = _expectingReply
+            && std::chrono::steady_clock::now() - _tWritten < std::chrono::milliseconds(CF_HOST_REPLY_WAIT);
+    if (_fastForward && !waiting) {
+        _skipped += us - us / _speed;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(us / _speed));
+}
+
+/**
+ * Get virtual us since start.
+ *
+ * @return Virtual us.
+ */
+unsigned long micros() {
+    return (unsigned long) (uint32_t) _virtualMicros();
+}
+
+/**
+ * Get virtual ms since start.
+ *
+ * @return Virtual ms.
+ */
+unsigned long millis() {
+    return (unsigned long) (uint32_t) (_virtualMicros() / 1000);
+}
+
+/**
+ * Sleep virtual ms.
+ *
+ * @param ms Virtual ms.
+ */
+void delay(unsigned long ms) {
+    _sleep(ms * 1000.0);
+}
+
+/**
+ * Sleep virtual us.
+ *
+ * @param us Virtual us.
+ */
+void delayMicroseconds(unsigned int us) {
+    _sleep(us);
+}
+
+/**
+ * Give the CPU away for a moment (1 ms real time).
+ */
+void yield() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+/**
+ * Nothing to set, time() follows the virtual clock already.
+ *
+ * @param timezone Time zone (s).
+ * @param daylightOffset Daylight saving offset (s).
+ * @param server1 NTP server.
+ * @param server2 NTP server.
+ * @param server3 NTP server.
+ */
+void configTime(int, int, const char *, const char *, const char *) {
+}
+
+#ifndef __THROW
+    #define __THROW
+#endif
+
+/**
+ * Get Unix time on the virtual clock, from the host's time at start. It takes the place of the C
+ * library's, as the ESP8266 core's follows SNTP.
+ *
+ * @param timer Receives the time, if not null.
+ * @return Unix time (s).
+ */
+extern "C" time_t time(time_t *timer) __THROW {
+    time_t now = _timeStart + (time_t) (_virtualMicros() / 1000000);
+    if (timer) {
+        *timer = now;
+    }
+    return now;
+}
+
+/**
+ * Define virtual clock speed.
+ *
+ * @param speed Virtual time per real time, e.g. 4 runs an hour in 15 minutes.
+ */
+void hostSetSpeed(double speed) {
+    _speed = speed > 0 ? speed : 1;
+    _fastForward = false;
+}
+
+/**
+ * Define delay() speed only. Waits on the network and yield() keep real time, so replies take
+ * as long as they do on the LAN.
+ *
+ * @param speed Virtual time per real time of delay(), e.g. 10000 runs a week in a minute
+ *          when the loop mostly sleeps.
+ */
+void hostSetFastForward(double speed) {
+    _speed = speed > 0 ? speed : 1;
+    _fastForward = true;
+}
+
+/**
+ * Something was written to a connection, a reply may follow. Called by WiFiClient.
+ */
+void hostExpectReply() {
+    if (!_expectingReply) {
+        _expectingReply = true;
+        _tWritten = std::chrono::steady_clock::now();
+    }
+}
+
+/**
+ * Something was read from a connection, or it was closed. Called by WiFiClient.
+ */
+void hostReplied() {
+    _expectingReply = false;
+}
+
+/**
+ * Define what a pin reads.
+ *
+ * @param pin Pin.
+ * @param value Value.
+ */
+void hostWrite(uint8_t pin, int value) {
+    if (pin < CF_HOST_PINS) {
+        _pins[pin] = value;
+    }
+}
+
+/**
+ * Get the heap in use since start.
+ *
+ * @return Bytes the program's globals and code took, e.g. the helpers' JSON documents.
+ */
+size_t hostHeapUsed() {
+    size_t used = _heapInUse();
+    return used > _heapStart.used ? used - _heapStart.used : 0;
+}
+
+/**
+ * Nothing to configure on the host.
+ *
+ * @param pin Pin.
+ * @param mode Mode.
+ */
+void pinMode(uint8_t, uint8_t) {
+}
+
+/**
+ * Read a digital pin.
+ *
+ * @param pin Pin.
+ * @return Value set by hostWrite() or digitalWrite().
+ */
+int digitalRead(uint8_t pin) {
+    return pin < CF_HOST_PINS ? _pins[pin] : LOW;
+}
+
+/**
+ * Write a digital pin, read back by digitalRead().
+ *
+ * @param pin Pin.
+ * @param value Value.
+ */
+void digitalWrite(uint8_t pin, uint8_t value) {
+    hostWrite(pin, value);
+}
+
+/**
+ * Read an analog pin.
+ *
+ * @param pin Pin.
+ * @return Value set by hostWrite().
+ */
+int analogRead(uint8_t pin) {
+    return pin < CF_HOST_PINS ? _pins[pin] : 0;
+}
+
+/**
+ * Pins don't change by themselves on the host, so the callback is never called.
+ *
+ * @param pin Pin.
+ * @param callback Callback.
+ * @param arg Callback argument.
+ * @param mode Mode.
+ */
+void attachInterruptArg(uint8_t, void (*)(void *), void *, int) {
+}
+
+/**
+ * Nothing to detach.
+ *
+ * @param pin Pin.
+ */
+void detachInterrupt(uint8_t) {
+}
+
+/**
+ * Get a random number.
+ *
+ * @param max Upper bound, excluded.
+ * @return Number in [0, max).
+ */
+long random(long max) {
+    return max > 0 ? ::random() % max : 0;
+}
+
+/**
+ * Get a random number.
+ *
+ * @param min Lower bound.
+ * @param max Upper bound, excluded.
+ * @return Number in [min, max).
+ */
+long random(long min, long max) {
+    return max > min ? min + random(max - min) : min;
+}
+
+/**
+ * Seed random().
+ *
+ * @param seed Seed.
+ */
+void randomSeed(unsigned long seed) {
+    srandom(seed);
+}
+
+/**
+ * Map a value of a range onto another.
+ *
+ * @param value Value.
+ * @param fromLow Low end of the value range.
+ * @param fromHigh High end of the value range.
+ * @param toLow Low end of the target range.
+ * @param toHigh High end of the target range.
+ * @return Mapped value.
+ */
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh) {
+    return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+/**
+ * Copy text, always terminated.
+ *
+ * @param destination Buffer.
+ * @param source Text.
+ * @param size Buffer size.
+ * @return Source length.
+ */
+size_t strlcpy(char *destination, const char *source, size_t size) {
+    size_t length = strlen(source);
+    if (size > 0) {
+        size_t copied = min(length, size - 1);
+        memcpy(destination, source, copied);
+        destination[copied] = '\0';
+    }
+    return length;
+}
+
+/**
+ * Append text, always terminated.
+ *
+ * @param destination Buffer holding text.
+ * @param source Text to append.
+ * @param size Buffer size.
+ * @return Length it would have without the buffer limit.
+ */
+size_t strlcat(char *destination, const char *source, size_t size) {
+    size_t length = strnlen(destination, size);
+    return length == size ? size + strlen(source) : length + strlcpy(destination + length, source, size - length);
+}
+#endif
+
+/**
+ * Process id, so each simulated device has its own.
+ *
+ * @return Chip id (24 bits).
+ */
+uint32_t EspClass::getChipId() {
+    return (uint32_t) getpid() & 0xFFFFFF;
+}
+
+// String.
+
+/**
+ * Constructor from a number.
+ *
+ * @param value Value.
+ * @param base DEC or HEX.
+ */
+String::String(long value, unsigned char base) {
+    char text[34];
+    if (base == DEC) {
+        snprintf(text, sizeof(text), "%ld", value);
+    } else {
+        snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lo", (unsigned long) value);
+    }
+    assign(text);
+}
+
+/**
+ * Constructor from a number.
+ *
+ * @param value Value.
+ * @param base DEC or HEX.
+ */
+String::String(unsigned long value, unsigned char base) {
+    char text[34];
+    snprintf(text, sizeof(text), base == HEX ? "%lX" : (base == DEC ? "%lu" : "%lo"), value);
+    assign(text);
+}
+
+/**
+ * Constructor from a decimal number.
+ *
+ * @param value Value.
+ * @param decimals Decimal places.
+ */
+String::String(double value, unsigned char decimals) {
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    assign(text);
+}
+
+/**
+ * Get part of the text.
+ *
+ * @param from First index.
+ * @param to Index after the last.
+ * @return Text.
+ */
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+        std::swap(from, to);
+    }
+    if (from >= length()) {
+        return String();
+    }
+    return String(substr(from, min((size_t) to, length()) - from));
+}
+
+/**
+ * Find a character.
+ *
+ * @param c Character.
+ * @param from Index to start from.
+ * @return Index or -1.
+ */
+int String::indexOf(char c, unsigned int from) const {
+    size_t index = find(c, from);
+    return index == npos ? -1 : (int) index;
+}
+
+/**
+ * Find a text.
+ *
+ * @param text Text.
+ * @param from Index to start from.
+ * @return Index or -1.
+ */
+int String::indexOf(const char *text, unsigned int from) const {
+    size_t index = find(text, from);
+    return index == npos ? -1 : (int) index;
+}
+
+/**
+ * Remove white space around the text.
+ */
+void String::trim() {
+    size_t start = find_first_not_of(" \t\r\n");
+    size_t end = find_last_not_of(" \t\r\n");
+    assign(start == npos ? "" : substr(start, end - start + 1));
+}
+
+/**
+ * Make the text upper case.
+ */
+void String::toUpperCase() {
+    std::transform(begin(), end(), begin(), ::toupper);
+}
+
+/**
+ * Make the text lower case.
+ */
+void String::toLowerCase() {
+    std::transform(begin(), end(), begin(), ::tolower);
+}
+
+// Print and Stream.
+
+/**
+ * Write bytes one by one.
+ *
+ * @param buffer Bytes.
+ * @param size Size.
+ * @return Bytes written.
+ */
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size-- > 0 && write(*buffer++) == 1) {
+        written++;
+    }
+    return written;
+}
+
+/**
+ * Print formatted text, up to 255 characters.
+ *
+ * @param format Format.
+ * @return Bytes written.
+ */
+size_t Print::printf(const char *format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return length > 0 ? write((const uint8_t *) text, min((size_t) length, sizeof(text) - 1)) : 0;
+}
+
+/**
+ * Read bytes, waiting up to the timeout.
+ *
+ * @param buffer Buffer.
+ * @param length Bytes wanted.
+ * @return Bytes read.
+ */
+size_t Stream::readBytes(char *buffer, size_t length) {
+    size_t count = 0;
+    unsigned long tStart = millis();
+    while (count < length && millis() - tStart < _timeout) {
+        int c = read();
+        if (c < 0) {
+            yield();
+            continue;
+        }
+        buffer[count++] = (char) c;
+    }
+    return count;
+}
+
+// IPAddress.
+
+/**
+ * Parse a dotted address.
+ *
+ * @param text Text, e.g. "192.168.0.10".
+ * @return False if it isn't an address.
+ */
+bool IPAddress::fromString(const char *text) {
+    unsigned int parts[4];
+    char end;
+    if (sscanf(text, "%u.%u.%u.%u%c", &parts[0], &parts[1], &parts[2], &parts[3], &end) != 4) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (parts[i] > 255) {
+            return false;
+        }
+        _bytes[i] = parts[i];
+    }
+    return true;
+}
+
+/**
+ * Get the dotted address.
+ *
+ * @return Text.
+ */
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+    return String(text);
+}
+
+// new and delete.
+
+/**
+ * Allocate through malloc, as the ESP8266 core does, so the malloc wrappers see it.
+ *
+ * @param size Bytes.
+ * @return Memory.
+ */
+void *operator new(size_t size) {
+    void *memory = malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/**
+ * Allocate an array through malloc.
+ *
+ * @param size Bytes.
+ * @return Memory.
+ */
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+/**
+ * Free memory of new.
+ *
+ * @param memory Memory.
+ */
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+/**
+ * Free memory of new[].
+ *
+ * @param memory Memory.
+ */
+void operator delete[](void *memory) noexcept {
+    free(memory);
+}
+
+/**
+ * Free memory of new, size given.
+ *
+ * @param memory Memory.
+ */
+void operator delete(void *memory, size_t) noexcept {
+    free(memory);
+}
+
+/**
+ * Free memory of new[], size given.
+ *
+ * @param memory Memory.
+ */
+void operator delete[](void *memory, size_t) noexcept {
+    free(memory);
+}
@@ -0,0 +1,236 @@
+/**
+ * Arduino.h
+ *
+ * Host HAL: the part of the ESP8266 Arduino core the CF helpers use, so the real helpers build
+ * and run on a PC (Linux or macOS). extras/tools/cffleet.py builds extras/host/cfdevice.cpp
+ * with it and runs one process per simulated device.
+ *
+ * Time runs on a virtual clock: millis() and micros() count from the process start, faster
+ * than real time by hostSetSpeed(), and delay() sleeps accordingly. yield() gives the CPU
+ * away for a moment, so busy loops (e.g. waiting for CONNACK) don't spin. With
+ * hostSetFastForward() only delay() is faster: from a write until something is read (up to
+ * CF_HOST_REPLY_WAIT real ms) it sleeps in real time, so a simulated week doesn't turn a
+ * round trip on the LAN into minutes. time() follows the virtual clock from the host's time
+ * at start, as if configTime() had set it.
+ *
+ * new and delete go through malloc and free, as in the ESP8266 core, so CFHeap counts them when
+ * built with CF_HEAP_WRAP and the malloc wrappers (GNU ld only).
+ *
+ * Pins are plain values: hostWrite() sets what analogRead() and digitalRead() return.
+ *
+ * hostHeapUsed() tells the heap in use, not counting what the C++ runtime took before the
+ * program started. It's the PC's malloc with 8 byte pointers, so it's an upper bound of what
+ * the same code takes on the ESP8266.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PGM_P                               const char *
+#define PSTR(text)                          (text)
+#define F(text)                             (text)
+#define pgm_read_byte(address)              (*(const uint8_t *) (address))
+#define pgm_read_word(address)              (*(const uint16_t *) (address))
+#define pgm_read_dword(address)             (*(const uint32_t *) (address))
+#define memcpy_P                            memcpy
+#define strlen_P                            strlen
+
+#define HIGH                                1
+#define LOW                                 0
+#define INPUT                               0
+#define OUTPUT                              1
+#define INPUT_PULLUP                        2
+#define CHANGE                              3
+#define A0                                  17
+#define CF_HOST_PINS                        32                                  // Pins hostWrite() can set.
+#define CF_HOST_REPLY_WAIT                  100                                 // Real ms fast forward waits for a reply.
+#define digitalPinToInterrupt(pin)          (pin)
+
+#define DEC                                 10
+#define HEX                                 16
+
+using std::min;
+using std::max;
+
+#ifndef constrain
+    #define constrain(value, low, high)     ((value) < (low) ? (low) : ((value) > (high) ? (high) : (value)))
+#endif
+
+// Time.
+unsigned long millis();                                                         // Virtual ms since start.
+unsigned long micros();                                                         // Virtual us since start.
+void delay(unsigned long ms);                                                   // Sleep virtual ms.
+void delayMicroseconds(unsigned int us);                                        // Sleep virtual us.
+void yield();                                                                   // Give the CPU away for a moment.
+void configTime(int timezone, int daylightOffset,                               // Nothing to set, time() runs already.
+        const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+
+// Pins.
+void pinMode(uint8_t pin, uint8_t mode);                                        // Nothing to configure.
+int digitalRead(uint8_t pin);                                                   // Value set by hostWrite().
+void digitalWrite(uint8_t pin, uint8_t value);                                  // Keep a value.
+int analogRead(uint8_t pin);                                                    // Value set by hostWrite().
+void attachInterruptArg(uint8_t pin, void (*callback)(void *), void *arg,       // Never called back.
+        int mode);
+void detachInterrupt(uint8_t pin);                                              // Nothing to detach.
+
+// Math.
+long random(long max);                                                          // Random number in [0, max).
+long random(long min, long max);                                                // Random number in [min, max).
+void randomSeed(unsigned long seed);                                            // Seed random().
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh);     // Map a range onto another.
+
+// Text.
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)                              // Newer C libraries have them.
+    size_t strlcpy(char *destination, const char *source, size_t size);         // Copy with terminator.
+    size_t strlcat(char *destination, const char *source, size_t size);         // Append with terminator.
+#endif
+
+// Host only.
+void hostSetSpeed(double speed);                                                // Define virtual clock speed.
+void hostSetFastForward(double speed);                                          // Define delay() speed only.
+void hostExpectReply();                                                         // Something was written (WiFiClient).
+void hostReplied();                                                             // Something was read (WiFiClient).
+void hostWrite(uint8_t pin, int value);                                         // Define what a pin reads.
+size_t hostHeapUsed();                                                          // Heap in use since start (bytes).
+
+/**
+ * Arduino String over std::string.
+ */
+class String : public std::string {
+    public:
+        String() {}
+        String(const char *text) : std::string(text ? text : "") {}
+        String(const std::string &text) : std::string(text) {}
+        String(char c) : std::string(1, c) {}
+        String(int value, unsigned char base = DEC) : String((long) value, base) {}
+        String(unsigned int value, unsigned char base = DEC) : String((unsigned long) value, base) {}
+        String(long value, unsigned char base = DEC);
+        String(unsigned long value, unsigned char base = DEC);
+        String(double value, unsigned char decimals = 2);
+
+        bool reserve(unsigned int size) { std::string::reserve(size); return true; }
+        bool equals(const String &text) const { return *this == text; }
+        bool concat(const String &text) { append(text); return true; }
+        String substring(unsigned int from) const { return substring(from, length()); }
+        String substring(unsigned int from, unsigned int to) const;
+        int indexOf(char c, unsigned int from = 0) const;
+        int indexOf(const char *text, unsigned int from = 0) const;
+        bool startsWith(const String &prefix) const { return compare(0, prefix.length(), prefix) == 0; }
+        void trim();
+        void toUpperCase();
+        void toLowerCase();
+        long toInt() const { return atol(c_str()); }
+        float toFloat() const { return atof(c_str()); }
+};
+
+/**
+ * Output.
+ */
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size);
+        size_t write(const char *text) { return write((const uint8_t *) text, strlen(text)); }
+        size_t print(const char *text) { return write(text); }
+        size_t print(const String &text) { return write(text.c_str()); }
+        size_t print(char c) { return write((uint8_t) c); }
+        size_t print(long value, int base = DEC) { return print(String(value, base)); }
+        size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+        size_t print(int value, int base = DEC) { return print((long) value, base); }
+        size_t print(unsigned int value, int base = DEC) { return print((unsigned long) value, base); }
+        size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+        template <typename T> size_t println(const T &value) { return print(value) + print("\n"); }
+        template <typename T> size_t println(const T &value, int format) { return print(value, format) + print("\n"); }
+        size_t println() { return print("\n"); }
+        size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+        virtual void flush() {}
+};
+
+/**
+ * Input and output.
+ */
+class Stream : public Print {
+    protected:
+        unsigned long _timeout = 1000;                                          // Time waiting for data (virtual ms).
+
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+        void setTimeout(unsigned long timeout) { _timeout = timeout; }
+        size_t readBytes(char *buffer, size_t length);
+};
+
+/**
+ * Standard output as Serial.
+ */
+class HardwareSerial : public Stream {
+    public:
+        void begin(unsigned long) {}
+        size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+        size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+        using Print::write;
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+        void flush() override { fflush(stdout); }
+        operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * IPv4 address.
+ */
+class IPAddress {
+    private:
+        uint8_t _bytes[4];                                                      // Address, network order.
+
+    public:
+        IPAddress() : _bytes{0, 0, 0, 0} {}
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _bytes{a, b, c, d} {}
+        IPAddress(uint32_t address) { memcpy(_bytes, &address, 4); }
+        operator uint32_t() const { uint32_t address; memcpy(&address, _bytes, 4); return address; }
+        uint8_t operator[](int index) const { return _bytes[index]; }
+        uint8_t &operator[](int index) { return _bytes[index]; }
+        bool isSet() const { return (uint32_t) *this != 0; }
+        bool fromString(const char *text);
+        String toString() const;
+};
+
+/**
+ * Chip.
+ */
+class EspClass {
+    public:
+        uint32_t getChipId();                                                   // Process id, so each device differs.
+        uint32_t getFreeHeap() { return 32768; }                                // Fixed: the host heap tells nothing.
+        uint8_t getHeapFragmentation() { return 0; }
+        uint32_t getMaxFreeBlockSize() { return 32768; }
+        uint32_t getCycleCount() { return micros() * 80; }
+        void wdtFeed() {}
+        void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * Client.h
+ *
+ * Host HAL: network client interface of the Arduino core.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef Client_h
+#define Client_h
+
+#include <Arduino.h>                                                            // Host Arduino.
+
+class Client : public Stream {
+    public:
+        virtual int connect(IPAddress ip, uint16_t port) = 0;                   // Connect to an address.
+        virtual int connect(const char *host, uint16_t port) = 0;               // Connect to a host.
+        virtual size_t write(uint8_t c) = 0;                                    // Write a byte.
+        virtual size_t write(const uint8_t *buffer, size_t size) = 0;           // Write bytes.
+        virtual int available() = 0;                                            // Bytes ready to read.
+        virtual int read() = 0;                                                 // Read a byte (-1 if none).
+        virtual int read(uint8_t *buffer, size_t size) = 0;                     // Read bytes ready.
+        virtual int peek() = 0;                                                 // Next byte (-1 if none).
+        virtual void flush() = 0;                                               // Wait until written.
+        virtual void stop() = 0;                                                // Close.
+        virtual uint8_t connected() = 0;                                        // True if open or data is left.
+        virtual operator bool() = 0;                                            // True if open.
+        using Print::write;
+};
+
+#endif
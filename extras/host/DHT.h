@@ -0,0 +1,67 @@
+/**
+ * DHT.h
+ *
+ * Host HAL: the Adafruit DHT library API. Every sensor reads what DHT::hostSetReading() set, NaN
+ * until then.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef DHT_h
+#define DHT_h
+
+#include <Arduino.h>                                                            // Host Arduino.
+
+#define DHT11                               11
+#define DHT12                               12
+#define DHT21                               21
+#define DHT22                               22
+#define AM2301                              21
+
+class DHT {
+    private:
+        // Attributes.
+        static inline float _temperature = NAN;                                 // Temperature (C).
+        static inline float _humidity = NAN;                                    // Humidity (%).
+
+    public:
+        // Methods.
+        DHT(uint8_t /* pin */, uint8_t /* type */, uint8_t /* count */ = 6) {}
+        void begin(uint8_t /* usecs */ = 55) {}
+        float readTemperature(bool fahrenheit = false, bool /* force */ = false) {
+            return fahrenheit ? convertCtoF(_temperature) : _temperature;
+        }
+        float readHumidity(bool /* force */ = false) { return _humidity; }
+        float convertCtoF(float c) { return c * 1.8f + 32; }
+        float convertFtoC(float f) { return (f - 32) * 0.55555f; }
+
+        /**
+         * Heat index, same formula as the Adafruit library (Rothfusz with adjustments).
+         */
+        float computeHeatIndex(float temperature, float humidity, bool fahrenheit = true) {
+            float t = fahrenheit ? temperature : convertCtoF(temperature);
+            float hi = 0.5f * (t + 61.0f + ((t - 68.0f) * 1.2f) + (humidity * 0.094f));
+            if (hi > 79) {
+                hi = -42.379f + 2.04901523f * t + 10.14333127f * humidity - 0.22475541f * t * humidity
+                        - 0.00683783f * t * t - 0.05481717f * humidity * humidity
+                        + 0.00122874f * t * t * humidity + 0.00085282f * t * humidity * humidity
+                        - 0.00000199f * t * t * humidity * humidity;
+                if (humidity < 13 && t >= 80.0f && t <= 112.0f) {
+                    hi -= ((13.0f - humidity) * 0.25f) * sqrtf((17.0f - fabsf(t - 95.0f)) * 0.05882f);
+                } else if (humidity > 85.0f && t >= 80.0f && t <= 87.0f) {
+                    hi += ((humidity - 85.0f) * 0.1f) * ((87.0f - t) * 0.2f);
+                }
+            }
+            return fahrenheit ? hi : convertFtoC(hi);
+        }
+
+        // Host only.
+        static void hostSetReading(float temperature, float humidity) {
+            _temperature = temperature;
+            _humidity = humidity;
+        }
+};
+
+#endif
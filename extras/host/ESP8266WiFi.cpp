@@ -0,0 +1,95 @@
+/**
+ * ESP8266WiFi.cpp
+ *
+ * Host HAL: Wi-Fi of the ESP8266 core.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <ESP8266WiFi.h>                                                        // Host Wi-Fi.
+#include <netdb.h>                                                              // Resolver.
+#include <netinet/in.h>                                                         // Addresses.
+
+ESP8266WiFiClass WiFi;
+
+/**
+ * Resolve a host name (or IP text) with the host resolver.
+ *
+ * @param host Host name or IP.
+ * @param ip Receives the address.
+ * @return 1 if resolved, 0 if not.
+ */
+int ESP8266WiFiClass::hostByName(const char *host, IPAddress &ip) {
+    if (ip.fromString(host)) {
+        return 1;
+    }
+    addrinfo hints = {};
+    addrinfo *result = nullptr;
+    hints.ai_family = AF_INET;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+        return 0;
+    }
+    ip = IPAddress((uint32_t) ((sockaddr_in *) result->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(result);
+    return 1;
+}
+
+/**
+ * Resolve a host name. The host resolver keeps its own timeout.
+ *
+ * @param host Host name or IP.
+ * @param ip Receives the address.
+ * @param timeout Ignored.
+ * @return 1 if resolved, 0 if not.
+ */
+int ESP8266WiFiClass::hostByName(const char *host, IPAddress &ip, uint32_t) {
+    return hostByName(host, ip);
+}
+
+/**
+ * Nothing to switch.
+ *
+ * @param mode Ignored.
+ * @return True.
+ */
+bool ESP8266WiFiClass::mode(WiFiMode_t) {
+    return true;
+}
+
+/**
+ * Always connected.
+ *
+ * @return WL_CONNECTED.
+ */
+wl_status_t ESP8266WiFiClass::status() {
+    return WL_CONNECTED;
+}
+
+/**
+ * Loopback.
+ *
+ * @return 127.0.0.1.
+ */
+IPAddress ESP8266WiFiClass::localIP() {
+    return IPAddress(127, 0, 0, 1);
+}
+
+/**
+ * Host network name.
+ *
+ * @return "host".
+ */
+String ESP8266WiFiClass::SSID() {
+    return String("host");
+}
+
+/**
+ * Fixed signal.
+ *
+ * @return -50 dBm.
+ */
+int32_t ESP8266WiFiClass::RSSI() {
+    return -50;
+}
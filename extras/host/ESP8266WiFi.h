@@ -0,0 +1,35 @@
+/**
+ * ESP8266WiFi.h
+ *
+ * Host HAL: Wi-Fi of the ESP8266 core. The station is always connected, on the host network;
+ * DNS goes through the host resolver.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include <Arduino.h>                                                            // Host Arduino.
+#include <WiFiClient.h>                                                         // Host WiFiClient.
+
+enum wl_status_t {WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL = 1, WL_CONNECTED = 3, WL_DISCONNECTED = 6};
+enum WiFiMode_t {WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3};
+
+class ESP8266WiFiClass {
+    public:
+        // Methods.
+        int hostByName(const char *host, IPAddress &ip);                        // Resolve a host name.
+        int hostByName(const char *host, IPAddress &ip, uint32_t timeout);      // Resolve a host name.
+        bool mode(WiFiMode_t mode);                                             // Nothing to switch.
+        wl_status_t status();                                                   // Always connected.
+        IPAddress localIP();                                                    // Loopback.
+        String SSID();                                                          // Host network name.
+        int32_t RSSI();                                                         // Fixed signal.
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * FS.cpp
+ *
+ * Host HAL: SPIFFS in a host directory.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <FS.h>                                                                 // Host FS.
+#include <sys/stat.h>                                                           // Stat and mkdir.
+#include <unistd.h>                                                             // Unlink.
+
+FS SPIFFS;
+
+/**
+ * Constructor.
+ *
+ * @param file Host file, closed with the last copy.
+ */
+File::File(FILE *file):
+        _file(file, fclose) {
+
+}
+
+/**
+ * Write a byte.
+ *
+ * @param c Byte.
+ * @return Bytes written.
+ */
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+/**
+ * Write bytes.
+ *
+ * @param buffer Bytes.
+ * @param size Size.
+ * @return Bytes written.
+ */
+size_t File::write(const uint8_t *buffer, size_t size) {
+    return _file ? fwrite(buffer, 1, size, _file.get()) : 0;
+}
+
+/**
+ * Bytes left to read.
+ *
+ * @return Bytes.
+ */
+int File::available() {
+    return _file ? (int) (size() - position()) : 0;
+}
+
+/**
+ * Read a byte.
+ *
+ * @return Byte or -1 at the end.
+ */
+int File::read() {
+    return _file ? fgetc(_file.get()) : -1;
+}
+
+/**
+ * Read bytes.
+ *
+ * @param buffer Buffer.
+ * @param size Buffer size.
+ * @return Bytes read.
+ */
+size_t File::read(uint8_t *buffer, size_t size) {
+    return _file ? fread(buffer, 1, size, _file.get()) : 0;
+}
+
+/**
+ * Next byte, left to be read.
+ *
+ * @return Byte or -1 at the end.
+ */
+int File::peek() {
+    if (!_file) {
+        return -1;
+    }
+    int c = fgetc(_file.get());
+    if (c >= 0) {
+        ungetc(c, _file.get());
+    }
+    return c;
+}
+
+/**
+ * Write buffered bytes to the host file.
+ */
+void File::flush() {
+    if (_file) {
+        fflush(_file.get());
+    }
+}
+
+/**
+ * Move to a position.
+ *
+ * @param position Position.
+ * @param mode From the start, the current position or the end.
+ * @return True if moved.
+ */
+bool File::seek(uint32_t position, SeekMode mode) {
+    return _file && fseek(_file.get(), position, mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END)) == 0;
+}
+
+/**
+ * Get the position.
+ *
+ * @return Position.
+ */
+size_t File::position() {
+    return _file ? ftell(_file.get()) : 0;
+}
+
+/**
+ * Get the size.
+ *
+ * @return Size.
+ */
+size_t File::size() {
+    if (!_file) {
+        return 0;
+    }
+    struct stat status;
+    fflush(_file.get());
+    return fstat(fileno(_file.get()), &status) == 0 ? status.st_size : 0;
+}
+
+/**
+ * Close. Copies of this file are closed too.
+ */
+void File::close() {
+    _file.reset();
+}
+
+/**
+ * True if open.
+ */
+File::operator bool() const {
+    return (bool) _file;
+}
+
+/**
+ * Make the directory.
+ *
+ * @return True.
+ */
+bool FS::begin() {
+    if (!_root.empty()) {
+        mkdir(_root.c_str(), 0755);
+    }
+    return true;
+}
+
+/**
+ * True if a file exists.
+ *
+ * @param path Path.
+ * @return True if it exists.
+ */
+bool FS::exists(const char *path) {
+    struct stat status;
+    return stat(_path(path).c_str(), &status) == 0;
+}
+
+/**
+ * Open a file. Writing makes missing directories.
+ *
+ * @param path Path.
+ * @param mode "r", "w", "a", "r+", "w+" or "a+".
+ * @return File, closed if it can't be opened.
+ */
+File FS::open(const char *path, const char *mode) {
+    std::string hostPath = _path(path);
+    if (mode[0] != 'r') {
+        for (size_t slash = hostPath.find('/', 1); slash != std::string::npos; slash = hostPath.find('/', slash + 1)) {
+            mkdir(hostPath.substr(0, slash).c_str(), 0755);
+        }
+    }
+    std::string hostMode = std::string(mode) + "b";
+    FILE *file = fopen(hostPath.c_str(), hostMode.c_str());
+    return file ? File(file) : File();
+}
+
+/**
+ * Remove a file.
+ *
+ * @param path Path.
+ * @return True if removed.
+ */
+bool FS::remove(const char *path) {
+    return unlink(_path(path).c_str()) == 0;
+}
+
+/**
+ * Rename a file.
+ *
+ * @param from Path.
+ * @param to New path.
+ * @return True if renamed.
+ */
+bool FS::rename(const char *from, const char *to) {
+    return ::rename(_path(from).c_str(), _path(to).c_str()) == 0;
+}
+
+/**
+ * Define host directory, e.g. one per simulated device.
+ *
+ * @param root Host directory.
+ */
+void FS::hostSetRoot(const char *root) {
+    _root = root;
+    while (!_root.empty() && _root.back() == '/') {
+        _root.pop_back();
+    }
+}
+
+/**
+ * Get host path.
+ *
+ * @param path Path.
+ * @return Path under the host directory.
+ */
+std::string FS::_path(const char *path) {
+    if (_root.empty()) {
+        return path[0] == '/' ? std::string(".") + path : path;
+    }
+    return _root + (path[0] == '/' ? "" : "/") + path;
+}
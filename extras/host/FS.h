@@ -0,0 +1,69 @@
+/**
+ * FS.h
+ *
+ * Host HAL: SPIFFS in a host directory, set with FS::hostSetRoot() (the working directory by
+ * default). Paths keep their slashes, missing directories are made when a file is written.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef FS_h
+#define FS_h
+
+#include <Arduino.h>                                                            // Host Arduino.
+#include <memory>                                                               // Shared pointer.
+
+enum SeekMode {SeekSet = 0, SeekCur = 1, SeekEnd = 2};
+
+class File : public Stream {
+    private:
+        // Attributes.
+        std::shared_ptr<FILE> _file;                                            // Host file, shared by copies.
+
+    public:
+        // Methods.
+        File() {}                                                               // Constructor (closed).
+        File(FILE *file);                                                       // Constructor.
+        size_t write(uint8_t c) override;                                       // Write a byte.
+        size_t write(const uint8_t *buffer, size_t size) override;              // Write bytes.
+        int available() override;                                               // Bytes left.
+        int read() override;                                                    // Read a byte (-1 at the end).
+        size_t read(uint8_t *buffer, size_t size);                              // Read bytes.
+        int peek() override;                                                    // Next byte (-1 at the end).
+        void flush() override;                                                  // Write buffered bytes.
+        bool seek(uint32_t position, SeekMode mode = SeekSet);                  // Move.
+        size_t position();                                                      // Get position.
+        size_t size();                                                          // Get size.
+        void close();                                                           // Close.
+        operator bool() const;                                                  // True if open.
+        using Print::write;
+};
+
+class FS {
+    private:
+        // Attributes.
+        std::string _root;                                                      // Host directory.
+
+        // Methods.
+        std::string _path(const char *path);                                    // Get host path.
+
+    public:
+        // Methods.
+        bool begin();                                                           // Make the directory.
+        void end() {}                                                           // Nothing to unmount.
+        bool exists(const char *path);                                          // True if a file exists.
+        bool exists(const String &path) { return exists(path.c_str()); }
+        File open(const char *path, const char *mode);                          // Open a file.
+        File open(const String &path, const char *mode) { return open(path.c_str(), mode); }
+        bool remove(const char *path);                                          // Remove a file.
+        bool rename(const char *from, const char *to);                          // Rename a file.
+
+        // Host only.
+        void hostSetRoot(const char *root);                                     // Define host directory.
+};
+
+extern FS SPIFFS;
+
+#endif
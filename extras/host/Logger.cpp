@@ -0,0 +1,46 @@
+/**
+ * Logger.cpp
+ *
+ * Host HAL: the Logger library API, printing to the standard output.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <Logger.h>                                                             // Host Logger.
+
+Logger::Level Logger::_level = Logger::NOTICE;
+
+/**
+ * Define lowest level printed.
+ *
+ * @param level Level.
+ */
+void Logger::setLogLevel(Level level) {
+    _level = level;
+}
+
+/**
+ * Get lowest level printed.
+ *
+ * @return Level.
+ */
+Logger::Level Logger::getLogLevel() {
+    return _level;
+}
+
+/**
+ * Print a message with its level and virtual time.
+ *
+ * @param level Level.
+ * @param message Message.
+ */
+void Logger::log(Level level, String message) {
+    static const char *names[] = {"VERBOSE", "NOTICE", "WARNING", "ERROR", "FATAL"};
+    if (level < _level || level >= SILENT) {
+        return;
+    }
+    printf("[%lu] [%s] %s\n", millis(), names[level], message.c_str());
+    fflush(stdout);
+}
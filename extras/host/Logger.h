@@ -0,0 +1,37 @@
+/**
+ * Logger.h
+ *
+ * Host HAL: the Logger library API, printing to the standard output.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef Logger_h
+#define Logger_h
+
+#include <Arduino.h>                                                            // Host Arduino.
+
+class Logger {
+    public:
+        // Levels.
+        enum Level {VERBOSE = 0, NOTICE, WARNING, ERROR, FATAL, SILENT};
+
+    private:
+        // Attributes.
+        static Level _level;                                                    // Lowest level printed.
+
+    public:
+        // Methods.
+        static void setLogLevel(Level level);                                   // Define lowest level printed.
+        static Level getLogLevel();                                             // Get lowest level printed.
+        static void log(Level level, String message);                           // Print a message.
+        static void verbose(String message) { log(VERBOSE, message); }
+        static void notice(String message) { log(NOTICE, message); }
+        static void warning(String message) { log(WARNING, message); }
+        static void error(String message) { log(ERROR, message); }
+        static void fatal(String message) { log(FATAL, message); }
+};
+
+#endif
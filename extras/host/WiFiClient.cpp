@@ -0,0 +1,323 @@
+/**
+ * WiFiClient.cpp
+ *
+ * Host HAL: TCP client over POSIX sockets, with the ESP8266 WiFiClient API.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <WiFiClient.h>                                                         // Host WiFiClient.
+#include <ESP8266WiFi.h>                                                        // Host Wi-Fi (DNS).
+#include <errno.h>                                                              // Errors.
+#include <fcntl.h>                                                              // Non-blocking sockets.
+#include <netinet/in.h>                                                         // Addresses.
+#include <netinet/tcp.h>                                                        // TCP_NODELAY.
+#include <poll.h>                                                               // Poll.
+#include <sys/ioctl.h>                                                          // FIONREAD.
+#include <sys/socket.h>                                                         // Sockets.
+#include <unistd.h>                                                             // Close.
+
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL                    0                                   // macOS: SO_NOSIGPIPE is set instead.
+#endif
+
+uint16_t WiFiClient::_redirectFrom = 0;
+uint16_t WiFiClient::_redirectTo = 0;
+
+/**
+ * Constructor.
+ */
+WiFiClient::WiFiClient():
+        _socket(-1), _peeked(-1) {
+
+}
+
+/**
+ * Destructor.
+ */
+WiFiClient::~WiFiClient() {
+    stop();
+}
+
+/**
+ * Connect to an address. It blocks up to the stream timeout.
+ *
+ * @param ip Address.
+ * @param port Port.
+ * @return 1 if connected, 0 if not.
+ */
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    stop();
+    if (port == _redirectFrom) {
+        port = _redirectTo;
+    }
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (_socket < 0) {
+        return 0;
+    }
+    #ifdef SO_NOSIGPIPE
+        int one = 1;
+        setsockopt(_socket, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    #endif
+    fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL) | O_NONBLOCK);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = (uint32_t) ip;
+    if (::connect(_socket, (sockaddr *) &address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+        stop();
+        return 0;
+    }
+
+    // Wait for the connection, virtual timeout in real ms.
+    unsigned long tStart = millis();
+    while (true) {
+        pollfd waiting = {_socket, POLLOUT, 0};
+        if (poll(&waiting, 1, 1) > 0) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(_socket, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error != 0) {
+                stop();
+                return 0;
+            }
+            return 1;
+        }
+        if (millis() - tStart >= _timeout) {
+            stop();
+            return 0;
+        }
+    }
+}
+
+/**
+ * Connect to a host.
+ *
+ * @param host Host name or IP.
+ * @param port Port.
+ * @return 1 if connected, 0 if not.
+ */
+int WiFiClient::connect(const char *host, uint16_t port) {
+    IPAddress ip;
+    if (!WiFi.hostByName(host, ip)) {
+        return 0;
+    }
+    return connect(ip, port);
+}
+
+/**
+ * Write a byte.
+ *
+ * @param c Byte.
+ * @return Bytes written.
+ */
+size_t WiFiClient::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+/**
+ * Write bytes. What the socket doesn't take right away waits up to the stream timeout, like
+ * the ESP8266 core does.
+ *
+ * @param buffer Bytes.
+ * @param size Size.
+ * @return Bytes written.
+ */
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    unsigned long tStart = millis();
+    while (_socket >= 0 && written < size) {
+        ssize_t sent = send(_socket, buffer + written, size - written, MSG_NOSIGNAL);
+        if (sent > 0) {
+            written += sent;
+        } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            stop();
+        } else if (millis() - tStart >= _timeout) {
+            break;
+        } else {
+            pollfd waiting = {_socket, POLLOUT, 0};
+            poll(&waiting, 1, 1);
+        }
+    }
+    if (written > 0) {
+        hostExpectReply();
+    }
+    return written;
+}
+
+/**
+ * Bytes ready to read.
+ *
+ * @return Bytes.
+ */
+int WiFiClient::available() {
+    if (_socket < 0) {
+        return _peeked >= 0 ? 1 : 0;
+    }
+    int count = 0;
+    ioctl(_socket, FIONREAD, &count);
+    if (count == 0 && _peeked < 0) {
+        _fill();
+    }
+    return count + (_peeked >= 0 ? 1 : 0);
+}
+
+/**
+ * Read a byte.
+ *
+ * @return Byte or -1 if none is ready.
+ */
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+/**
+ * Read bytes ready.
+ *
+ * @param buffer Buffer.
+ * @param size Buffer size.
+ * @return Bytes read.
+ */
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    int count = 0;
+    if (_peeked >= 0) {
+        buffer[count++] = _peeked;
+        _peeked = -1;
+    }
+    if (_socket >= 0 && (size_t) count < size) {
+        ssize_t received = recv(_socket, buffer + count, size - count, 0);
+        if (received > 0) {
+            count += received;
+            hostReplied();
+        } else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            stop();
+        }
+    }
+    return count;
+}
+
+/**
+ * Next byte, left to be read.
+ *
+ * @return Byte or -1 if none is ready.
+ */
+int WiFiClient::peek() {
+    _fill();
+    return _peeked;
+}
+
+/**
+ * Nothing is buffered, writes go straight to the socket.
+ */
+void WiFiClient::flush() {
+}
+
+/**
+ * Close.
+ */
+void WiFiClient::stop() {
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+        hostReplied();
+    }
+}
+
+/**
+ * Close. The host doesn't wait for the peer.
+ *
+ * @param maxWaitMs Ignored.
+ * @return True.
+ */
+bool WiFiClient::stop(unsigned int) {
+    stop();
+    return true;
+}
+
+/**
+ * Close.
+ */
+void WiFiClient::abort() {
+    stop();
+}
+
+/**
+ * True if open, or closed with data left to read.
+ *
+ * @return True if connected.
+ */
+uint8_t WiFiClient::connected() {
+    if (_socket >= 0) {
+        _fill();
+    }
+    return _socket >= 0 || _peeked >= 0;
+}
+
+/**
+ * True if open.
+ */
+WiFiClient::operator bool() {
+    return connected();
+}
+
+/**
+ * Disable Nagle.
+ *
+ * @param noDelay True to send small packets right away.
+ */
+void WiFiClient::setNoDelay(bool noDelay) {
+    int value = noDelay;
+    if (_socket >= 0) {
+        setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    }
+}
+
+/**
+ * Room to write, the host socket buffer is large.
+ *
+ * @return Bytes.
+ */
+int WiFiClient::availableForWrite() {
+    return _socket >= 0 ? 1460 : 0;
+}
+
+/**
+ * Send connections for a port to another.
+ *
+ * @param from Port asked for.
+ * @param to Port connected to.
+ */
+void WiFiClient::hostRedirect(uint16_t from, uint16_t to) {
+    _redirectFrom = from;
+    _redirectTo = to;
+}
+
+/**
+ * Peek one byte if there is none, to notice a closed connection.
+ *
+ * @return True if a byte is waiting.
+ */
+bool WiFiClient::_fill() {
+    if (_peeked >= 0) {
+        return true;
+    }
+    if (_socket < 0) {
+        return false;
+    }
+    uint8_t c;
+    ssize_t received = recv(_socket, &c, 1, 0);
+    if (received == 1) {
+        _peeked = c;
+        hostReplied();
+    } else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stop();
+    }
+    return _peeked >= 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * WiFiClient.h
+ *
+ * Host HAL: TCP client over POSIX sockets, with the ESP8266 WiFiClient API. Connect blocks up
+ * to the stream timeout (virtual ms), reads and writes don't block.
+ *
+ * hostRedirect() sends connections for a port to another one, e.g. CF_TB_PORT to a broker
+ * stand-in listening elsewhere.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef WiFiClient_h
+#define WiFiClient_h
+
+#include <Arduino.h>                                                            // Host Arduino.
+#include <Client.h>                                                             // Host Client.
+
+class WiFiClient : public Client {
+    private:
+        // Attributes.
+        int _socket;                                                            // Socket (-1 if closed).
+        int _peeked;                                                            // Byte read by peek() (-1 if none).
+        static uint16_t _redirectFrom;                                          // Port redirected.
+        static uint16_t _redirectTo;                                            // Port it goes to.
+
+        // Methods.
+        bool _fill();                                                           // Peek one byte if there is none.
+
+    public:
+        // Methods.
+        WiFiClient();                                                           // Constructor.
+        ~WiFiClient();                                                          // Destructor.
+        WiFiClient(const WiFiClient &) = delete;
+        WiFiClient &operator=(const WiFiClient &) = delete;
+        int connect(IPAddress ip, uint16_t port) override;                      // Connect to an address.
+        int connect(const char *host, uint16_t port) override;                  // Connect to a host.
+        size_t write(uint8_t c) override;                                       // Write a byte.
+        size_t write(const uint8_t *buffer, size_t size) override;              // Write bytes.
+        int available() override;                                               // Bytes ready to read.
+        int read() override;                                                    // Read a byte (-1 if none).
+        int read(uint8_t *buffer, size_t size) override;                        // Read bytes ready.
+        int peek() override;                                                    // Next byte (-1 if none).
+        void flush() override;                                                  // Nothing is buffered.
+        void stop() override;                                                   // Close.
+        bool stop(unsigned int maxWaitMs);                                      // Close.
+        void abort();                                                           // Close.
+        uint8_t connected() override;                                           // True if open or data is left.
+        operator bool() override;                                               // True if open.
+        void setNoDelay(bool noDelay);                                          // Disable Nagle.
+        int availableForWrite();                                                // Room to write.
+        using Print::write;
+
+        // Host only.
+        static void hostRedirect(uint16_t from, uint16_t to);                   // Send connections for a port to another.
+};
+
+#endif
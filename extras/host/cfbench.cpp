@@ -0,0 +1,175 @@
+/**
+ * cfbench.cpp
+ *
+ * Telemetry encode benchmark on the host HAL: the soil monitor example's telemetry, plus a
+ * soil moisture aggregate of one send interval, encoded the way CFThingsBoardHelper sends it,
+ * as JSON (serializeJson() and CFAggregator::toJson(), one payload each) and as protobuf
+ * (CFProtobufWriter, one payload).
+ *
+ *      g++ -std=gnu++17 -O2 -Iextras/host -I<ArduinoJson 6 src/> -Isrc extras/host/cfbench.cpp \
+ *          extras/host/Arduino.cpp src/CFProtobufWriter.cpp src/CFAggregator.cpp -o cfbench
+ *      ./cfbench --sends 100000
+ *
+ * It prints, per encoding, the mean encode time per send and the payload bytes per send:
+ *
+ *      @bench <encoding> <us per send> <bytes per send> <payloads per send>
+ *
+ * Host times are far from an ESP8266 at 80 MHz; the ratio between encodings and the bytes are
+ * what carry over. On the device, tb_encode_us and tb_payload_b give the real figures.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <Arduino.h>                                                            // Host Arduino.
+#include <ArduinoJson.h>                                                        // Arduino JSON.
+#include <CFProtobufWriter.h>                                                   // CF Protobuf Writer.
+#include <CFAggregator.h>                                                       // CF Aggregator.
+
+#define BENCH_BUFFER_SIZE               256                                     // Payload room, as CF_MQTT_BUFFER_SIZE.
+#define BENCH_SAMPLES                   60                                      // Soil readings per send interval.
+
+// Protobuf field numbers, as set with CFThingsBoardHelper::setEncoding().
+struct Field {
+    const char *key;                                                            // Telemetry key.
+    uint16_t number;                                                            // Field number in the schema.
+};
+
+const Field _fields[] = {
+    { "soi_value", 1 },
+    { "soi_perct", 2 },
+    { "soi_rate", 3 },
+    { "soi_dry_min", 4 },
+    { "dht_temp", 5 },
+    { "dht_hum", 6 },
+    { "soi_perct_n", 7 },
+    { "soi_perct_min", 8 },
+    { "soi_perct_max", 9 },
+    { "soi_perct_avg", 10 },
+    { "soi_perct_std", 11 },
+    { "soi_perct_p50", 12 },
+    { "soi_perct_p90", 13 }
+};
+
+DynamicJsonDocument _data(256);                                                 // Telemetry values.
+CFAggregator _aggregate;                                                        // Soil moisture of one interval.
+uint8_t _buffer[BENCH_BUFFER_SIZE];                                             // Payload.
+volatile size_t _sink;                                                          // Keeps encodes from being optimized out.
+
+/**
+ * Get field number of a telemetry key.
+ *
+ * @param key Telemetry key.
+ * @return Field number, -1 if the key has none.
+ */
+int field(const char *key) {
+    for (size_t i = 0; i < sizeof(_fields) / sizeof(_fields[0]); i++) {
+        if (strcmp(_fields[i].key, key) == 0) {
+            return _fields[i].number;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Encode telemetry as JSON, as CFThingsBoardHelper::_sendTelemetryJson() does.
+ *
+ * @param payloads Output payload quantity.
+ * @return Bytes of all payloads.
+ */
+size_t encodeJson(int &payloads) {
+    size_t bytes = serializeJson(_data, (char *) _buffer, sizeof(_buffer));
+    payloads = 1;
+    int cursor = 0;
+    while (cursor < CFAggregator::ITEMS) {
+        size_t length = _aggregate.toJson("soi_perct", (char *) _buffer, sizeof(_buffer), cursor);
+        if (length == 0) {
+            break;
+        }
+        bytes += length;
+        payloads++;
+    }
+    return bytes;
+}
+
+/**
+ * Encode telemetry as protobuf, as CFThingsBoardHelper::_sendTelemetryProtobuf() does.
+ *
+ * @param payloads Output payload quantity.
+ * @return Payload bytes.
+ */
+size_t encodeProtobuf(int &payloads) {
+    CFProtobufWriter writer(_buffer, sizeof(_buffer));
+    for (JsonPair p : _data.as<JsonObject>()) {
+        int number = field(p.key().c_str());
+        if (number < 0) {
+            continue;
+        }
+        if (p.value().is<long>()) {
+            writer.writeInt(number, p.value().as<long>());
+        } else if (p.value().is<float>()) {
+            writer.writeFloat(number, p.value().as<float>());
+        } else if (p.value().is<const char*>()) {
+            writer.writeString(number, p.value().as<const char*>());
+        }
+    }
+    for (int item = 0; item < CFAggregator::ITEMS; item++) {
+        char key[48];
+        snprintf(key, sizeof(key), "%s%s", "soi_perct", CFAggregator::getItemSuffix(item));
+        int number = field(key);
+        if (number >= 0) {
+            writer.writeFloat(number, _aggregate.getItem(item));
+        }
+    }
+    payloads = 1;
+    return writer.isValid() ? writer.length() : 0;
+}
+
+/**
+ * Time an encoding.
+ *
+ * @param name Encoding name.
+ * @param encode Encoder.
+ * @param sends Sends to time.
+ */
+void bench(const char *name, size_t (*encode)(int &), unsigned long sends) {
+    int payloads = 0;
+    size_t bytes = encode(payloads);                                            // Warm up, and the size.
+    unsigned long tStart = micros();
+    for (unsigned long i = 0; i < sends; i++) {
+        _sink = encode(payloads);
+    }
+    double us = (double) (micros() - tStart) / sends;
+    printf("@bench %-8s %8.3f %5zu %d\n", name, us, bytes, payloads);
+}
+
+/**
+ * Fill the telemetry like the soil monitor example and run both encodings.
+ *
+ * @param argc Argument quantity.
+ * @param argv Arguments.
+ * @return Exit status.
+ */
+int main(int argc, char **argv) {
+    unsigned long sends = 100000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--sends") == 0) {
+            sends = strtoul(argv[i + 1], nullptr, 10);
+        }
+    }
+
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        _aggregate.add(42 + i % 7);
+    }
+    _data["soi_value"] = 612;
+    _data["soi_perct"] = 45;
+    _data["soi_rate"] = -0.42;
+    _data["soi_dry_min"] = 3180;
+    _data["dht_temp"] = 23.4;
+    _data["dht_hum"] = 57.0;
+
+    bench("json", encodeJson, sends);
+    bench("protobuf", encodeProtobuf, sends);
+    return 0;
+}
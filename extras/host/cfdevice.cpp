@@ -0,0 +1,252 @@
+/**
+ * cfdevice.cpp
+ *
+ * One simulated device on the host HAL: the real CFThingsBoardHelper, CFSoilMoistureHelper,
+ * CFDHTHelper and CFTimeSeries composed in a CFDevice, like the soil monitor example.
+ * extras/tools/cffleet.py builds it and runs one process per device.
+ *
+ *      cfdevice --server 127.0.0.1 --port 1884 --token fleet-7 --fs /tmp/fleet/7 --speed 4
+ *      cfdevice --port 1884 --fs /tmp/week --fast-forward 20000 --tick 1000 --duration 604800 --seal trap
+ *
+ * --port redirects CF_TB_PORT, so the helper still connects to 1883 as on the device. --fs is
+ * the SPIFFS root, kept between runs like flash is kept between power cycles. --fast-forward
+ * speeds up delay() only (see hostSetFastForward()), --tick is the virtual ms between loops and
+ * --duration the virtual s to run (0 runs until killed).
+ *
+ * --seal count or trap calls CFHeap::seal() once ThingsBoard is first connected, as the soil
+ * monitor example does. Built with CF_HEAP_WRAP and the malloc wrappers, every allocation after
+ * that is counted (or aborts with trap). At the end of --duration it prints
+ *
+ *      @heap <allocations> <allowed allocations>
+ *
+ * then the last callers that allocated (CFHeap::dump()), and exits with 1 if anything allocated
+ * since sealing, or it never got to seal.
+ *
+ * Every --report real seconds it prints one status line from CFMetrics for cffleet.py:
+ *
+ *      @cf <connected> <connects> <connect failures> <acked> <publish failures> <ack p90 ms> <heap peak>
+ *
+ * and once at start, the size of each helper:
+ *
+ *      @size <helper> <bytes>
+ *
+ * Heap peak is the most hostHeapUsed() told at the end of a loop, in bytes.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <Arduino.h>                                                            // Host Arduino.
+#include <Logger.h>                                                             // Host Logger.
+#include <ESP8266WiFi.h>                                                        // Host Wi-Fi.
+#include <FS.h>                                                                 // Host SPIFFS.
+#include <CFThingsBoardHelper.h>                                                // CF ThingsBoard Helper.
+#include <CFSoilMoistureHelper.h>                                               // CF soil moisture sensor.
+#include <CFDHTHelper.h>                                                        // CF DHT Helper.
+#include <CFTimeSeries.h>                                                       // CF Time Series.
+#include <CFHeap.h>                                                             // CF Heap.
+#include <CFDevice.h>                                                           // CF Device.
+
+// Software info.
+#define APP_CODE                        "fleet"                                 // App code.
+#define APP_VERSION                     "1.0"                                   // App version.
+
+// Pin setup.
+#define PIN_SOILMOISTURE                A0                                      // Soil moisture pin.
+#define PIN_DHT                         5                                       // DHT data pin.
+
+// CF Helpers.
+CFThingsBoardHelper _cfThingsBoard(APP_CODE, APP_VERSION);                      // CF ThingsBoard Helper.
+CFSoilMoistureHelper _soilMoisture(PIN_SOILMOISTURE);                           // CF soil moisture sensor.
+CFDHTHelper _dht(DHT22, PIN_DHT);                                               // CF DHT Helper.
+CFTimeSeries _history;                                                          // Soil moisture history in SPIFFS.
+int _soilSeries;                                                                // Soil moisture percent series.
+
+// Device components, started and looped in this order.
+CFDevice<_soilMoisture, _history, _dht, _cfThingsBoard> _device;
+
+// Options.
+const char *_server = "127.0.0.1";                                              // MQTT server.
+const char *_token = "fleet-0";                                                 // Device token.
+double _speed = 1;                                                              // Virtual clock speed.
+double _report = 1;                                                             // Real s between status lines.
+unsigned long _tick = 50;                                                       // Virtual ms between loops.
+unsigned long _duration = 0;                                                    // Virtual s to run (0 for ever).
+const char *_seal = nullptr;                                                    // Seal the heap once connected ("count" or "trap").
+
+// Metrics read for the status line.
+int _mConnect;                                                                  // Connections.
+int _mConnectFail;                                                              // Failed connections.
+int _mPublishAcked;                                                             // Publishes acknowledged.
+int _mPublishFail;                                                              // Failed publishes.
+int _mAckTime;                                                                  // PUBACK time.
+size_t _heapPeak = 0;                                                           // Most heap in use.
+
+void onDeviceNameCallback(const char *value);
+void RPCDefaultCallback(const RPC_Data &data, RPC_Response &resp);
+
+/**
+ * Read options.
+ *
+ * @param argc Argument quantity.
+ * @param argv Arguments.
+ */
+void options(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *name = argv[i];
+        const char *value = argv[i + 1];
+        if (strcmp(name, "--server") == 0) {
+            _server = value;
+        } else if (strcmp(name, "--port") == 0) {
+            WiFiClient::hostRedirect(1883, atoi(value));
+        } else if (strcmp(name, "--token") == 0) {
+            _token = value;
+        } else if (strcmp(name, "--fs") == 0) {
+            SPIFFS.hostSetRoot(value);
+        } else if (strcmp(name, "--speed") == 0) {
+            _speed = atof(value);
+            hostSetSpeed(_speed);
+        } else if (strcmp(name, "--fast-forward") == 0) {
+            _speed = atof(value);
+            hostSetFastForward(_speed);
+        } else if (strcmp(name, "--report") == 0) {
+            _report = atof(value);
+        } else if (strcmp(name, "--tick") == 0) {
+            _tick = strtoul(value, nullptr, 10);
+        } else if (strcmp(name, "--duration") == 0) {
+            _duration = strtoul(value, nullptr, 10);
+        } else if (strcmp(name, "--seal") == 0) {
+            _seal = value;
+        } else if (strcmp(name, "--log") == 0) {
+            Logger::setLogLevel(strcmp(value, "verbose") == 0 ? Logger::VERBOSE : Logger::NOTICE);
+        }
+    }
+}
+
+void setup() {
+    // Start Serial.
+    Serial.begin(115200);
+
+    // Metrics the helpers registered.
+    _mConnect = CFMetrics::counter("tb_connect");
+    _mConnectFail = CFMetrics::counter("tb_connect_fail");
+    _mPublishAcked = CFMetrics::counter("tb_pub_acked");
+    _mPublishFail = CFMetrics::counter("tb_pub_fail");
+    _mAckTime = CFMetrics::histogram("tb_ack_ms");
+
+    // Start components, MQTT buffer and telemetry document sized from them.
+    _device.begin();
+
+    // Keep history, sent to ThingsBoard after outages.
+    configTime(0, 0, "pool.ntp.org");
+    _soilSeries = _history.addSeries("soi_perct");
+
+    // Config ThingsBoard.
+    _cfThingsBoard.setServerURL(_server);
+    _cfThingsBoard.setToken(_token);
+    _cfThingsBoard.setLocalIP(WiFi.localIP().toString());
+    _cfThingsBoard.setAttributeValue("attr_device_name", _token);
+    _cfThingsBoard.onAttribute("attr_device_name", onDeviceNameCallback);
+    _cfThingsBoard.onRPC("default", RPCDefaultCallback);
+    _cfThingsBoard.setBackfill(_history);
+}
+
+void loop() {
+    // Sensors drift slowly around a value of their own.
+    static long soil = 500 + random(300);
+    soil = constrain(soil + random(-3, 4), 300, 900);
+    hostWrite(PIN_SOILMOISTURE, soil);
+    DHT::hostSetReading(22 + (soil % 50) / 10.0, 40 + soil % 30);
+
+    if (_device.loop() & _device.bit<_soilMoisture>()) {                        // Sensors, history and ThingsBoard loops.
+        _history.add(_soilSeries, _soilMoisture.getSersorPercent());
+    }
+
+    // Set telemetry data, sent on a next loop.
+    _cfThingsBoard.setTelemetryValue("soi_value", _soilMoisture.getRawSensorValue());
+    _cfThingsBoard.setTelemetryValue("soi_perct", _soilMoisture.getSersorPercent());
+    if (_dht.isRead()) {
+        _cfThingsBoard.setTelemetryValue("dht_temp", (double) _dht.getTemperatureC());
+        _cfThingsBoard.setTelemetryValue("dht_hum", (double) _dht.getHumidity());
+    }
+
+    // Setup is over once ThingsBoard is first connected.
+    if (_seal && !CFHeap::isSealed() && _cfThingsBoard.isConnected()) {
+        CFHeap::seal(strcmp(_seal, "trap") == 0);
+        Logger::setLogLevel(max(Logger::getLogLevel(), Logger::WARNING));
+    }
+
+    _heapPeak = std::max(_heapPeak, hostHeapUsed());
+}
+
+/**
+ * Print the status line now and then.
+ */
+void report() {
+    static unsigned long tLastReport = 0;
+    if (millis() - tLastReport < _report * 1000 * _speed) {
+        return;
+    }
+    tLastReport = millis();
+    printf("@cf %d %lu %lu %lu %lu %lu %zu\n", _cfThingsBoard.isConnected() ? 1 : 0,
+            CFMetrics::getCounter(_mConnect), CFMetrics::getCounter(_mConnectFail),
+            CFMetrics::getCounter(_mPublishAcked), CFMetrics::getCounter(_mPublishFail),
+            CFMetrics::getPercentile(_mAckTime, 90), _heapPeak);
+    fflush(stdout);
+}
+
+/**
+ * Callback to be called when device name is updated on ThingsBoard.
+ */
+void onDeviceNameCallback(const char *value) {
+    char message[64];
+    snprintf(message, sizeof(message), "Device name: %s", value);
+    CF_LOG_NOTICE(message);
+}
+
+/**
+ * Callback to be called when receive default RPC from ThingsBoard.
+ */
+void RPCDefaultCallback(const RPC_Data &data, RPC_Response &resp) {
+    int value = data["value"];
+    JsonObject r = resp.to<JsonObject>();
+    r["value"] = value;
+}
+
+/**
+ * Print allocations since sealed.
+ *
+ * @return Exit status, 1 if anything allocated since sealing or it never got to seal.
+ */
+int heapReport() {
+    printf("@heap %lu %lu\n", (unsigned long) CFHeap::getAllocations(),
+            CFMetrics::getCounter(CFMetrics::counter("heap_allowed")));
+    if (CFHeap::getAllocations() != 0) {
+        CFHeap::dump(Serial);                                                   // Decode with addr2line -e cfdevice.
+    }
+    fflush(stdout);
+    return (!CFHeap::isSealed() || CFHeap::getAllocations() != 0) ? 1 : 0;
+}
+
+/**
+ * Run setup() once and loop() every tick, like the ESP8266 core.
+ *
+ * @param argc Argument quantity.
+ * @param argv Arguments.
+ * @return Exit status.
+ */
+int main(int argc, char **argv) {
+    Logger::setLogLevel(Logger::WARNING);
+    options(argc, argv);
+    printf("@size CFThingsBoardHelper %zu\n", sizeof(_cfThingsBoard));
+    printf("@size CFSoilMoistureHelper %zu\n", sizeof(_soilMoisture));
+    printf("@size CFDHTHelper %zu\n", sizeof(_dht));
+    setup();
+    while (_duration == 0 || millis() / 1000 < _duration) {
+        loop();
+        report();
+        delay(_tick);
+    }
+    return _seal ? heapReport() : 0;
+}
@@ -0,0 +1,418 @@
+#!/usr/bin/env python3
+"""
+cfbroker.py
+
+A minimal MQTT 3.1.1 broker that stands in for ThingsBoard's device API (v1/devices/me/...), to
+run CFThingsBoardHelper against without a server and measure it under faults.
+
+Usage:
+    cfbroker.py --port 1883                                                 # Plain stand-in.
+    cfbroker.py --latency 200 --loss 0.05 --disconnect-every 60 --duration 600
+    cfbroker.py --shared '{"attr_device_name": "Garden"}' --rpc-every 30
+
+Point the device at the host running it (setServerURL("192.168.0.10"), or the "ThingsBoard
+server" field of the portal). Any token is accepted unless --token is given.
+
+What it does, per topic:
+    v1/devices/me/telemetry             Counted. QoS 1 gets PUBACK.
+    v1/devices/me/attributes            Counted and kept as client attributes.
+    v1/devices/me/attributes/request/N  Answered on .../response/N with the requested keys of
+                                        --shared, as {"shared": {...}}.
+    v1/devices/me/rpc/response/N        Matched with requests sent by --rpc-every.
+
+Faults:
+    --latency MS        Delay before each incoming packet is handled (and so before its reply).
+    --jitter MS         Random extra delay, up to MS.
+    --loss P            Drop incoming publishes with probability P, without PUBACK.
+    --disconnect-every S
+                        Every S seconds drop a random session.
+    --half-open P       Fraction of those drops that leave the socket open but stop answering,
+                        like a NAT that has forgotten the connection.
+    --accept-rate N     Refuse CONNECT (server unavailable) beyond N per second, like an
+                        overloaded server during a reconnect storm.
+
+Every --report seconds, and on exit, a line is printed with messages/s, bytes/s, sessions,
+reconnect time (from a drop to the next CONNECT of the same client id), duplicates, and
+messages lost: QoS 0 publishes dropped, plus QoS 1 publishes dropped and never sent again.
+
+@author  Caio Frota <caiofrota@gmail.com>
+@version 1.0
+@since   Sep, 2021
+"""
+
+import argparse
+import asyncio
+import json
+import random
+import sys
+import time
+
+CONNECT = 0x10
+CONNACK = 0x20
+PUBLISH = 0x30
+PUBACK = 0x40
+SUBSCRIBE = 0x80
+SUBACK = 0x90
+PINGREQ = 0xC0
+PINGRESP = 0xD0
+DISCONNECT = 0xE0
+
+TOPIC = "v1/devices/me/"
+TELEMETRY_TOPIC = TOPIC + "telemetry"
+ATTRIBUTES_TOPIC = TOPIC + "attributes"
+ATTRIBUTES_REQUEST_TOPIC = TOPIC + "attributes/request/"
+ATTRIBUTES_RESPONSE_TOPIC = TOPIC + "attributes/response/"
+RPC_REQUEST_TOPIC = TOPIC + "rpc/request/"
+RPC_RESPONSE_TOPIC = TOPIC + "rpc/response/"
+
+
+def encode_length(length):
+    """Encode MQTT remaining length."""
+    out = bytearray()
+    while True:
+        digit = length & 0x7F
+        length >>= 7
+        out.append(digit | (0x80 if length else 0))
+        if not length:
+            return bytes(out)
+
+
+def encode_string(text):
+    """Encode a length prefixed string."""
+    data = text.encode()
+    return len(data).to_bytes(2, "big") + data
+
+
+def packet(header, body=b""):
+    """Frame a packet."""
+    return bytes([header]) + encode_length(len(body)) + body
+
+
+def read_string(body, position):
+    """Read a length prefixed string. Returns string and next position."""
+    length = int.from_bytes(body[position:position + 2], "big")
+    position += 2
+    return body[position:position + length].decode(errors="replace"), position + length
+
+
+async def read_packet(reader):
+    """Read one packet. Returns header byte and body."""
+    header = (await reader.readexactly(1))[0]
+    length, shift = 0, 0
+    while True:
+        digit = (await reader.readexactly(1))[0]
+        length |= (digit & 0x7F) << shift
+        shift += 7
+        if not digit & 0x80:
+            break
+    return header, await reader.readexactly(length)
+
+
+class Stats:
+    """Counters, for the whole run and for the current report interval."""
+
+    def __init__(self):
+        self.start = time.monotonic()
+        self.messages = 0
+        self.bytes = 0
+        self.interval_messages = 0
+        self.interval_bytes = 0
+        self.interval_start = self.start
+        self.connects = 0
+        self.rejected = 0
+        self.duplicates = 0
+        self.dropped = 0
+        self.lost_qos0 = 0
+        self.lost_qos1 = {}                                                     # (client, packet id): time dropped.
+        self.reconnect_times = []
+        self.rpc_times = []
+
+    def lost(self):
+        return self.lost_qos0 + len(self.lost_qos1)
+
+    def line(self, sessions, final=False):
+        now = time.monotonic()
+        if final:
+            elapsed, messages, size = now - self.start, self.messages, self.bytes
+        else:
+            elapsed, messages, size = now - self.interval_start, self.interval_messages, self.interval_bytes
+            self.interval_start, self.interval_messages, self.interval_bytes = now, 0, 0
+        elapsed = max(elapsed, 1e-6)
+        reconnect = ""
+        if self.reconnect_times:
+            ordered = sorted(self.reconnect_times)
+            reconnect = " reconnect avg %.1fs max %.1fs (%d)" % (
+                sum(ordered) / len(ordered), ordered[-1], len(ordered))
+        rpc = ""
+        if self.rpc_times:
+            rpc = " rpc avg %.0fms" % (1000 * sum(self.rpc_times) / len(self.rpc_times))
+        return "%s%.1f msg/s %.0f B/s sessions %d connects %d rejected %d dup %d dropped %d lost %d%s%s" % (
+            "TOTAL " if final else "", messages / elapsed, size / elapsed, sessions, self.connects,
+            self.rejected, self.duplicates, self.dropped, self.lost(), reconnect, rpc)
+
+
+class Broker:
+    """ThingsBoard device API stand-in."""
+
+    def __init__(self, args):
+        self.args = args
+        self.stats = Stats()
+        self.sessions = {}                                                      # Client id: Session.
+        self.dropped_at = {}                                                    # Client id: time session was dropped.
+        self.client_attributes = {}                                             # Client id: attributes.
+        self.shared = json.loads(args.shared) if args.shared else {}
+        self.rpc_id = 0
+        self.rpc_sent = {}                                                      # (client, request id): time sent.
+        self.accept_second = 0                                                  # Second of the accept rate window.
+        self.accepted = 0                                                       # Connects accepted in that second.
+
+    def accept(self):
+        """True if a CONNECT can be accepted under --accept-rate."""
+        if self.args.accept_rate <= 0:
+            return True
+        second = int(time.monotonic())
+        if second != self.accept_second:
+            self.accept_second, self.accepted = second, 0
+        self.accepted += 1
+        return self.accepted <= self.args.accept_rate
+
+    async def handle(self, reader, writer):
+        session = Session(self, reader, writer)
+        try:
+            await session.run()
+        except (asyncio.IncompleteReadError, ConnectionError, asyncio.CancelledError):
+            pass
+        finally:
+            session.close()
+
+    async def faults(self):
+        """Drop random sessions, some of them silently."""
+        while True:
+            await asyncio.sleep(self.args.disconnect_every)
+            if not self.sessions:
+                continue
+            session = random.choice(list(self.sessions.values()))
+            if random.random() < self.args.half_open:
+                print("fault: %s half-open" % session.client_id, file=sys.stderr)
+                session.muted = True
+                self.dropped_at[session.client_id] = time.monotonic()
+            else:
+                print("fault: %s dropped" % session.client_id, file=sys.stderr)
+                session.close()
+
+    async def rpc(self):
+        """Send a RPC request to every session."""
+        while True:
+            await asyncio.sleep(self.args.rpc_every)
+            for session in list(self.sessions.values()):
+                self.rpc_id += 1
+                self.rpc_sent[(session.client_id, str(self.rpc_id))] = time.monotonic()
+                session.publish(RPC_REQUEST_TOPIC + str(self.rpc_id),
+                                json.dumps({"method": self.args.rpc_method, "params": {}}))
+
+    async def report(self):
+        while True:
+            await asyncio.sleep(self.args.report)
+            print(self.stats.line(len(self.sessions)))
+
+
+class Session:
+    """One device connection."""
+
+    def __init__(self, broker, reader, writer):
+        self.broker = broker
+        self.stats = broker.stats
+        self.reader = reader
+        self.writer = writer
+        self.client_id = None
+        self.muted = False
+        self.closed = False
+        self.received = set()                                                   # QoS 1 packet ids delivered.
+
+    def send(self, data):
+        if not self.closed and not self.muted:
+            self.writer.write(data)
+
+    def publish(self, topic, payload):
+        self.send(packet(PUBLISH, encode_string(topic) + payload.encode()))
+
+    def close(self):
+        if self.closed:
+            return
+        self.closed = True
+        self.writer.close()
+        if self.client_id and self.broker.sessions.get(self.client_id) is self:
+            del self.broker.sessions[self.client_id]
+            self.broker.dropped_at.setdefault(self.client_id, time.monotonic())
+
+    async def run(self):
+        args = self.broker.args
+        while not self.closed:
+            header, body = await read_packet(self.reader)
+            if self.muted:
+                continue
+            delay = args.latency + random.uniform(0, args.jitter)
+            if delay > 0:
+                await asyncio.sleep(delay / 1000)
+            kind = header & 0xF0
+            if kind == CONNECT:
+                self.on_connect(body)
+            elif kind == PUBLISH:
+                self.on_publish(header, body)
+            elif kind == SUBSCRIBE:
+                granted = bytes(_count_filters(body[2:]))                        # QoS 0 for every filter.
+                self.send(packet(SUBACK, body[:2] + granted))
+            elif kind == PINGREQ:
+                self.send(packet(PINGRESP))
+            elif kind == DISCONNECT:
+                self.close()
+            if not self.closed:
+                await self.writer.drain()
+
+    def on_connect(self, body):
+        _, position = read_string(body, 0)
+        flags = body[position + 1]
+        position += 4
+        self.client_id, position = read_string(body, position)
+        if flags & 0x04:                                                        # Will topic and message.
+            _, position = read_string(body, position)
+            _, position = read_string(body, position)
+        token = read_string(body, position)[0] if flags & 0x80 else ""
+
+        if self.broker.args.token and token not in self.broker.args.token:
+            self.stats.rejected += 1
+            self.send(packet(CONNACK, b"\x00\x05"))
+            self.close()
+            return
+        if not self.broker.accept():
+            self.stats.rejected += 1
+            self.send(packet(CONNACK, b"\x00\x03"))
+            self.close()
+            return
+
+        # Session takeover, as a broker does when the same client id connects again.
+        dropped = self.broker.dropped_at.pop(self.client_id, None)
+        previous = self.broker.sessions.get(self.client_id)
+        if previous:
+            previous.close()
+            self.broker.dropped_at.pop(self.client_id, None)
+        if dropped is not None:
+            self.stats.reconnect_times.append(time.monotonic() - dropped)
+        self.broker.sessions[self.client_id] = self
+        self.stats.connects += 1
+        self.send(packet(CONNACK, b"\x00\x00"))
+
+    def on_publish(self, header, body):
+        qos = (header >> 1) & 0x03
+        dup = bool(header & 0x08)
+        topic, position = read_string(body, 0)
+        packet_id = None
+        if qos > 0:
+            packet_id = int.from_bytes(body[position:position + 2], "big")
+            position += 2
+        payload = body[position:]
+
+        # Injected loss: no PUBACK, so a QoS 1 sender has to send it again.
+        if random.random() < self.broker.args.loss:
+            self.stats.dropped += 1
+            if qos == 0:
+                self.stats.lost_qos0 += 1
+            else:
+                self.stats.lost_qos1.setdefault((self.client_id, packet_id), time.monotonic())
+            return
+
+        if qos > 0:
+            self.stats.lost_qos1.pop((self.client_id, packet_id), None)
+            self.send(packet(PUBACK, packet_id.to_bytes(2, "big")))
+            if dup and packet_id in self.received:
+                self.stats.duplicates += 1
+                return
+            self.received.add(packet_id)
+            # Packet ids wrap, forget old ones.
+            self.received.discard((packet_id - 1024) & 0xFFFF)
+
+        self.stats.messages += 1
+        self.stats.bytes += len(body)
+        self.stats.interval_messages += 1
+        self.stats.interval_bytes += len(body)
+        self.on_message(topic, payload)
+
+    def on_message(self, topic, payload):
+        if topic == ATTRIBUTES_TOPIC:
+            try:
+                self.broker.client_attributes.setdefault(self.client_id, {}).update(json.loads(payload))
+            except ValueError:
+                pass
+        elif topic.startswith(ATTRIBUTES_REQUEST_TOPIC):
+            request_id = topic[len(ATTRIBUTES_REQUEST_TOPIC):]
+            try:
+                keys = json.loads(payload).get("sharedKeys", "")
+            except ValueError:
+                keys = ""
+            shared = {k: v for k, v in self.broker.shared.items() if k in keys.split(",")}
+            self.publish(ATTRIBUTES_RESPONSE_TOPIC + request_id, json.dumps({"shared": shared}))
+        elif topic.startswith(RPC_RESPONSE_TOPIC):
+            sent = self.broker.rpc_sent.pop((self.client_id, topic[len(RPC_RESPONSE_TOPIC):]), None)
+            if sent is not None:
+                self.stats.rpc_times.append(time.monotonic() - sent)
+
+
+def _count_filters(body):
+    """Count topic filters of a SUBSCRIBE."""
+    count, position = 0, 0
+    while position < len(body):
+        _, position = read_string(body, position)
+        position += 1
+        count += 1
+    return count
+
+
+async def serve(args):
+    broker = Broker(args)
+    server = await asyncio.start_server(broker.handle, args.host, args.port)
+    print("Listening on %s:%d" % (args.host, args.port), file=sys.stderr)
+    tasks = [asyncio.ensure_future(broker.report())]
+    if args.disconnect_every > 0:
+        tasks.append(asyncio.ensure_future(broker.faults()))
+    if args.rpc_every > 0:
+        tasks.append(asyncio.ensure_future(broker.rpc()))
+    try:
+        async with server:
+            if args.duration > 0:
+                await asyncio.sleep(args.duration)
+            else:
+                await server.serve_forever()
+    finally:
+        for task in tasks:
+            task.cancel()
+        print(broker.stats.line(len(broker.sessions), final=True))
+
+
+def parse_args(argv=None):
+    parser = argparse.ArgumentParser(description="ThingsBoard device API stand-in.")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--token", action="append", help="accepted token (repeat); any if omitted")
+    parser.add_argument("--shared", help="shared attributes, as JSON")
+    parser.add_argument("--latency", type=float, default=0, help="ms before handling each packet")
+    parser.add_argument("--jitter", type=float, default=0, help="random extra ms")
+    parser.add_argument("--loss", type=float, default=0, help="probability of dropping a publish")
+    parser.add_argument("--disconnect-every", type=float, default=0, help="s between dropped sessions")
+    parser.add_argument("--half-open", type=float, default=0, help="fraction of drops left half-open")
+    parser.add_argument("--accept-rate", type=float, default=0, help="max connects per s (0 for no limit)")
+    parser.add_argument("--rpc-every", type=float, default=0, help="s between RPC requests")
+    parser.add_argument("--rpc-method", default="default")
+    parser.add_argument("--report", type=float, default=10, help="s between report lines")
+    parser.add_argument("--duration", type=float, default=0, help="s to run (0 runs until Ctrl-C)")
+    return parser.parse_args(argv)
+
+
+def main():
+    try:
+        asyncio.run(serve(parse_args()))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,399 @@
+#!/usr/bin/env python3
+"""
+cffleet.py
+
+Runs a fleet of simulated devices with the real CFThingsBoardHelper, CFSoilMoistureHelper and
+CFDHTHelper, to see how a ThingsBoard setup (or cfbroker.py) copes with hundreds of them, e.g.
+all reconnecting after a power outage.
+
+Usage:
+    cffleet.py --devices 200 --outage-at 120 --outage-for 60 --speed 4
+    cffleet.py --devices 200 --server 192.168.0.10 --token-prefix fleet-    # Real server.
+    cffleet.py --devices 200 --accept-rate 50                               # Overloaded server.
+    cffleet.py --heap-week                                                  # Nothing allocates.
+
+Each device is a process running extras/host/cfdevice.cpp, built with g++ from src/ and the host
+HAL in extras/host/ (millis, WiFiClient over sockets, SPIFFS in a directory). Connection,
+backoff, retransmission and attribute sync are the firmware's own, so there's nothing here to
+keep in step with it. The build needs ArduinoJson 6: it's looked up in the Arduino and
+PlatformIO library folders, or give --arduinojson with its src/ folder. It's rebuilt when a
+source is newer than the binary.
+
+Without --server, a cfbroker.py stand-in runs in the same process; --accept-rate and --latency
+are passed to it.
+
+Devices boot after a random Wi-Fi join time. Their timers run on a virtual clock, --speed times
+faster than real time, so an hour of fleet behavior takes minutes; the telemetry interval is the
+firmware's (60 virtual s). A power outage kills every process without DISCONNECT and starts them
+again when it's over; each device keeps its SPIFFS folder, as flash survives a power cycle.
+
+--heap-week runs one device instead, built with CFHeap's malloc wrappers (Linux), for a
+simulated week in a few minutes: delay() is fast-forwarded while round trips keep real time. The
+stand-in drops sessions, leaves some half-open, loses publishes, sends RPCs and goes down now and
+then, so the device reconnects and sends history. The device seals the heap once first
+connected, as the soil monitor example does, and the run fails if anything allocated after that;
+the last callers are printed (decode them with addr2line -e cfdevice).
+
+Report, every --report seconds and at the end: devices connected, connect attempts and refusals
+per second, PUBACK rate and publish failures, the median of the devices' PUBACK time p90, and
+after an outage, the time until 50 %, 90 % and 100 % of the fleet is back. At the end, the
+sizeof of each helper and the peak heap the devices used, as the cfdevice processes measured them.
+
+@author  Caio Frota <caiofrota@gmail.com>
+@version 1.0
+@since   Sep, 2021
+"""
+
+import argparse
+import asyncio
+import glob
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import cfbroker                                                                 # noqa: E402
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..")
+SRC = os.path.join(ROOT, "src")
+HOST = os.path.join(ROOT, "extras", "host")
+
+# Sources cfdevice.cpp pulls in from src/.
+SOURCES = [
+    "CFThingsBoardHelper", "CFMqttClient", "CFProtobufWriter", "CFMetrics", "CFAggregator",
+    "CFAttributeSync", "CFUrlWriter", "CFServerPool", "CFTrace", "CFTimeSeries",
+    "CFSoilMoistureHelper", "CFDHTHelper", "CFAdaptiveSampler", "CFPsychrometrics", "CFHeap",
+]
+
+# CFHeap counts allocations through GNU ld's --wrap, not available on macOS.
+HEAP_WRAP = ["-DCF_HEAP_WRAP", "-Wl,--wrap=malloc", "-Wl,--wrap=calloc", "-Wl,--wrap=realloc"]
+
+WEEK = 7 * 24 * 3600                                                            # Virtual s of --heap-week.
+
+# Where ArduinoJson usually is.
+ARDUINOJSON = [
+    "~/Arduino/libraries/ArduinoJson/src",
+    "~/Documents/Arduino/libraries/ArduinoJson/src",
+    os.path.join(ROOT, ".pio", "libdeps", "*", "ArduinoJson", "src"),
+    "~/.platformio/lib/ArduinoJson/src",
+]
+
+
+def memory_report(devices):
+    """RAM a device takes, as measured by the cfdevice processes."""
+    lines = ["Per-device RAM, measured on the host (8 byte pointers, so an upper bound for the ESP8266):"]
+    sizes = next((device.sizes for device in devices if device.sizes), {})
+    for name, size in sizes.items():
+        lines.append("    %-40s %6d B" % ("sizeof(%s)" % name, size))
+    peaks = [device.heap_peak for device in devices if device.heap_peak]
+    if peaks:
+        lines.append("    %-40s %6d B" % ("Heap in use, peak (median device)", percentile(peaks, 0.5)))
+        lines.append("    %-40s %6d B" % ("Heap in use, peak (worst device)", max(peaks)))
+    return "\n".join(lines)
+
+
+def find_arduinojson(path):
+    """Find the ArduinoJson src/ folder."""
+    candidates = [path] if path else ARDUINOJSON
+    for candidate in candidates:
+        for folder in sorted(glob.glob(os.path.expanduser(candidate))):
+            if os.path.isfile(os.path.join(folder, "ArduinoJson.h")):
+                return folder
+    sys.exit("ArduinoJson 6 not found, give its src/ folder with --arduinojson.")
+
+
+def build(args):
+    """Build cfdevice from src/ and the host HAL, unless it's newer than every source."""
+    binary = os.path.join(args.build_dir, "cfdevice")
+    sources = [os.path.join(SRC, name + ".cpp") for name in SOURCES]
+    sources += sorted(path for path in glob.glob(os.path.join(HOST, "*.cpp"))
+                      if os.path.basename(path) != "cfbench.cpp")                 # A program of its own.
+    inputs = sources + glob.glob(os.path.join(SRC, "*.h")) + glob.glob(os.path.join(HOST, "*.h"))
+    if os.path.exists(binary) and os.path.getmtime(binary) >= max(os.path.getmtime(f) for f in inputs):
+        return binary
+
+    os.makedirs(args.build_dir, exist_ok=True)
+    compiler = os.environ.get("CXX", "g++")
+    command = [compiler, "-std=gnu++17", "-O1", "-Wall", "-Wextra", "-I" + HOST, "-I" + find_arduinojson(args.arduinojson),
+               "-I" + SRC] + sources + ["-o", binary]
+    if sys.platform.startswith("linux"):
+        command += HEAP_WRAP
+    print("Building %s" % binary)
+    if subprocess.run(command).returncode != 0:
+        sys.exit("Build failed.")
+    return binary
+
+
+class Clock:
+    """Virtual clock, --speed times real time."""
+
+    def __init__(self, speed):
+        self.speed = speed
+        self.start = time.monotonic()
+
+    def now(self):
+        return (time.monotonic() - self.start) * self.speed
+
+    async def sleep(self, seconds):
+        await asyncio.sleep(max(seconds, 0) / self.speed)
+
+
+class Device:
+    """One device process. Counters restart with the process, so past runs are kept apart."""
+
+    FIELDS = ("connected", "connects", "refused", "acked", "pub_fail", "ack_p90", "heap_peak")
+
+    def __init__(self, index, args, binary, clock, stats):
+        self.index = index
+        self.args = args
+        self.binary = binary
+        self.clock = clock
+        self.stats = stats
+        self.token = "%s%d" % (args.token_prefix, index)
+        self.folder = os.path.join(args.fs_dir, str(index))
+        self.process = None
+        self.reader = None
+        self.status = dict.fromkeys(self.FIELDS, 0)
+        self.past = dict.fromkeys(self.FIELDS, 0)                               # Counters of killed processes.
+        self.waiting_back = False
+        self.sizes = {}                                                         # sizeof each helper.
+        self.heap_peak = 0                                                      # Most heap in use, any process.
+
+    def connected(self):
+        return self.process is not None and self.status["connected"] == 1
+
+    def total(self, name):
+        return self.past[name] + self.status[name]
+
+    async def boot(self):
+        """Power on: join Wi-Fi, then start the firmware."""
+        await self.clock.sleep(random.uniform(self.args.boot_min, self.args.boot_max))
+        self.process = await asyncio.create_subprocess_exec(
+            self.binary, "--server", self.args.server, "--port", str(self.args.port), "--token", self.token,
+            "--fs", self.folder, "--speed", str(self.args.speed), "--report", "0.2",
+            "--log", "notice" if self.args.log else "warning",
+            stdout=asyncio.subprocess.PIPE, stderr=None if self.args.log else asyncio.subprocess.DEVNULL)
+        self.reader = asyncio.ensure_future(self.read(self.process))
+
+    async def read(self, process):
+        """Read status lines until the process ends."""
+        async for line in process.stdout:
+            line = line.decode(errors="replace").rstrip()
+            if line.startswith("@size "):
+                _, name, size = line.split()
+                self.sizes[name] = int(size)
+                continue
+            if not line.startswith("@cf "):
+                if self.args.log:
+                    print("%s: %s" % (self.token, line))
+                continue
+            self.status = dict(zip(self.FIELDS, (int(value) for value in line.split()[1:])))
+            self.heap_peak = max(self.heap_peak, self.status["heap_peak"])
+            if self.waiting_back and self.status["connected"]:
+                self.waiting_back = False
+                self.stats.back.append(self.clock.now())
+
+    async def power_off(self):
+        """Power outage: the process dies without DISCONNECT."""
+        if self.process is None:
+            return
+        if self.process.returncode is None:
+            self.process.kill()
+        await self.process.wait()
+        if self.reader:
+            self.reader.cancel()
+            await asyncio.gather(self.reader, return_exceptions=True)
+        for name in ("connects", "refused", "acked", "pub_fail"):
+            self.past[name] += self.status[name]
+        self.status = dict.fromkeys(self.FIELDS, 0)
+        self.process = self.reader = None
+
+    async def power_cycle(self, seconds):
+        await self.power_off()
+        await self.clock.sleep(seconds)
+        self.waiting_back = True
+        await self.boot()
+
+
+class FleetStats:
+    """Fleet totals, and totals at the last report for rates."""
+
+    def __init__(self):
+        self.last = dict(attempts=0, refused=0, acked=0, pub_fail=0)
+        self.back = []                                                          # Virtual time each device came back.
+
+    @staticmethod
+    def totals(devices):
+        connects = sum(device.total("connects") for device in devices)
+        refused = sum(device.total("refused") for device in devices)
+        return dict(attempts=connects + refused, refused=refused,
+                    acked=sum(device.total("acked") for device in devices),
+                    pub_fail=sum(device.total("pub_fail") for device in devices))
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(int(fraction * len(ordered)), len(ordered) - 1)] if ordered else 0
+
+
+async def report(args, clock, stats, devices):
+    while True:
+        await asyncio.sleep(args.report)
+        totals = stats.totals(devices)
+        rate = {name: (totals[name] - stats.last[name]) / args.report for name in totals}
+        ack_p90 = percentile([d.status["ack_p90"] for d in devices if d.status["acked"]], 0.5)
+        print("t %6.0fs connected %d/%d attempts %.1f/s refused %.1f/s ack %.1f/s pub fail %.1f/s ack p90 %dms" % (
+            clock.now(), sum(1 for device in devices if device.connected()), len(devices), rate["attempts"],
+            rate["refused"], rate["acked"], rate["pub_fail"], ack_p90))
+        stats.last = totals
+
+
+async def outage(args, clock, devices):
+    await clock.sleep(args.outage_at)
+    print("outage: %d devices down for %.0f s" % (len(devices), args.outage_for))
+    await asyncio.gather(*(device.power_cycle(args.outage_for) for device in devices))
+
+
+def summary(args, clock, stats, devices):
+    totals = stats.totals(devices)
+    lines = ["TOTAL t %.0fs attempts %d refused %d acked %d publish failures %d" % (
+        clock.now(), totals["attempts"], totals["refused"], totals["acked"], totals["pub_fail"])]
+    if args.outage_for > 0 and stats.back:
+        start = args.outage_at + args.outage_for
+        back = sorted(t - start for t in stats.back)
+        lines.append("Recovery after outage: 50%% in %.1fs, 90%% in %.1fs, %d/%d back, last in %.1fs" % (
+            percentile(back, 0.5), percentile(back, 0.9), len(back), len(devices), back[-1]))
+    lines.append(memory_report(devices))
+    print("\n".join(lines))
+
+
+async def simulate(args, binary):
+    broker_server = None
+    if not args.server:
+        broker_args = cfbroker.parse_args(["--host", "127.0.0.1", "--port", "0",
+                                           "--accept-rate", str(args.accept_rate),
+                                           "--latency", str(args.latency), "--report", "3600"])
+        broker = cfbroker.Broker(broker_args)
+        broker_server = await asyncio.start_server(broker.handle, "127.0.0.1", 0, backlog=4096)
+        args.server, args.port = "127.0.0.1", broker_server.sockets[0].getsockname()[1]
+
+    clock = Clock(args.speed)
+    stats = FleetStats()
+    devices = [Device(i, args, binary, clock, stats) for i in range(args.devices)]
+    tasks = [asyncio.ensure_future(device.boot()) for device in devices]
+    tasks.append(asyncio.ensure_future(report(args, clock, stats, devices)))
+    if args.outage_for > 0:
+        tasks.append(asyncio.ensure_future(outage(args, clock, devices)))
+    try:
+        await clock.sleep(args.duration)
+    finally:
+        for task in tasks:
+            task.cancel()
+        await asyncio.gather(*tasks, return_exceptions=True)
+        await asyncio.gather(*(device.power_off() for device in devices), return_exceptions=True)
+        if broker_server:
+            broker_server.close()
+            await broker_server.wait_closed()
+        summary(args, clock, stats, devices)
+
+
+async def server_outages(server_box, broker, port, every, down):
+    """Stop the stand-in now and then: sessions are closed and connections refused for a while."""
+    while True:
+        await asyncio.sleep(every)
+        server_box[0].close()                                                   # Not wait_closed(), it waits for sessions.
+        for session in list(broker.sessions.values()):
+            session.close()
+        await asyncio.sleep(down)
+        server_box[0] = await asyncio.start_server(broker.handle, "127.0.0.1", port)
+
+
+async def heap_week(args, binary):
+    """One device for a simulated week against faults. True if nothing allocated after sealing."""
+    broker_args = cfbroker.parse_args(["--host", "127.0.0.1", "--port", "0", "--report", "3600",
+                                       "--shared", '{"attr_device_name": "week"}', "--disconnect-every", "5",
+                                       "--half-open", "0.3", "--loss", "0.05", "--rpc-every", "2"])
+    broker = cfbroker.Broker(broker_args)
+    server_box = [await asyncio.start_server(broker.handle, "127.0.0.1", 0)]
+    port = server_box[0].sockets[0].getsockname()[1]
+    tasks = [asyncio.ensure_future(broker.faults()), asyncio.ensure_future(broker.rpc()),
+             asyncio.ensure_future(server_outages(server_box, broker, port, 20, 1))]
+
+    print("Running a simulated week, it takes a few minutes.")
+    process = await asyncio.create_subprocess_exec(
+        binary, "--server", "127.0.0.1", "--port", str(port), "--token", "week",
+        "--fs", os.path.join(args.fs_dir, "week"), "--fast-forward", "20000", "--tick", "1000",
+        "--duration", str(WEEK), "--seal", "count", "--report", "1",
+        stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.DEVNULL)
+    status = dict.fromkeys(Device.FIELDS, 0)
+    heap = []
+    try:
+        async for line in process.stdout:
+            line = line.decode(errors="replace").rstrip()
+            if line.startswith("@cf "):
+                status = dict(zip(Device.FIELDS, (int(value) for value in line.split()[1:])))
+            elif not line.startswith("@size "):
+                heap.append(line)
+        await process.wait()
+    finally:
+        if process.returncode is None:
+            process.kill()
+            await process.wait()
+        for task in tasks:
+            task.cancel()
+        await asyncio.gather(*tasks, return_exceptions=True)
+        server_box[0].close()
+
+    print("connects %d refused %d acked %d publish failures %d" % (
+        status["connects"], status["refused"], status["acked"], status["pub_fail"]))
+    print("\n".join(heap) if heap else "No heap report, the device never got to seal (or crashed).")
+    return process.returncode == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ThingsBoard device fleet simulator.")
+    parser.add_argument("--devices", type=int, default=100)
+    parser.add_argument("--server", help="MQTT server (a cfbroker.py stand-in runs in process if omitted)")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--token-prefix", default="fleet-")
+    parser.add_argument("--boot-min", type=float, default=2, help="min virtual s from power to Wi-Fi")
+    parser.add_argument("--boot-max", type=float, default=6, help="max virtual s from power to Wi-Fi")
+    parser.add_argument("--outage-at", type=float, default=120, help="virtual s until the power outage")
+    parser.add_argument("--outage-for", type=float, default=0, help="virtual s without power (0 for none)")
+    parser.add_argument("--accept-rate", type=float, default=0, help="stand-in max connects per real s")
+    parser.add_argument("--latency", type=float, default=0, help="stand-in ms per packet")
+    parser.add_argument("--speed", type=float, default=1, help="virtual clock speed")
+    parser.add_argument("--duration", type=float, default=300, help="virtual s to run")
+    parser.add_argument("--report", type=float, default=5, help="real s between report lines")
+    parser.add_argument("--arduinojson", help="ArduinoJson 6 src/ folder")
+    parser.add_argument("--build-dir", default=os.path.join(tempfile.gettempdir(), "cffleet"))
+    parser.add_argument("--fs-dir", help="device SPIFFS folders (a new temporary one if omitted)")
+    parser.add_argument("--log", action="store_true", help="show device logs")
+    parser.add_argument("--heap-week", action="store_true", help="one device for a simulated week, fail if it allocates")
+    args = parser.parse_args()
+
+    binary = build(args)
+    keep = args.fs_dir is not None
+    if not keep:
+        args.fs_dir = tempfile.mkdtemp(prefix="cffleet-fs-")
+    passed = True
+    try:
+        if args.heap_week:
+            passed = asyncio.run(heap_week(args, binary))
+        else:
+            asyncio.run(simulate(args, binary))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if not keep:
+            shutil.rmtree(args.fs_dir, ignore_errors=True)
+    if not passed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
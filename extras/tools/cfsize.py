@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+cfsize.py
+
+Flash and RAM per component of a firmware ELF, to see what each CF helper (and each library it
+pulls in) costs in a build.
+
+Usage:
+    cfsize.py .pio/build/nodemcuv2/firmware.elf
+    cfsize.py firmware.elf --save base.json                               # Keep a baseline.
+    cfsize.py firmware.elf --baseline base.json                           # Show growth since then.
+
+Arduino IDE keeps the ELF in the build folder shown with "Show verbose output during
+compilation". Symbols are read with nm (xtensa-lx106-elf-nm when it's on PATH, --nm to pick
+another). A symbol belongs to the CF component whose source file defines it (CFFoo.cpp or
+CFFoo.h), else to the library folder it was built from, else to the class in its name. Build
+with debug info (-g, the default) so nm can tell the source file.
+
+Columns follow the ESP8266 memory map:
+    flash   code and constants in flash (.irom0.text, .rodata in flash, PROGMEM).
+    iram    code in instruction RAM (IRAM_ATTR, ISR).
+    ram     data and bss in DRAM (globals, static buffers, constant strings not in PROGMEM).
+
+@author  Caio Frota <caiofrota@gmail.com>
+@version 1.0
+@since   Sep, 2021
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+LINE = re.compile(r"^([0-9a-fA-F]+) ([0-9a-fA-F]+) (\w) (.*?)(?:\t(.*):\d+)?$")
+CF_FILE = re.compile(r"^(CF\w+)\.(?:cpp|h|ino)$")
+CF_NAME = re.compile(r"\b(CF[A-Z]\w*?)(?:<.*)?::")
+LIBRARY = re.compile(r"[/\\]libraries[/\\]([^/\\]+)[/\\]")
+CORE = re.compile(r"[/\\](?:cores|tools|sdk)[/\\]")
+
+# Libraries whose symbols can be told by name when there's no debug info.
+NAMES = [
+    ("ArduinoJson", "ArduinoJson"),
+    ("WiFiManager", "WiFiManager"),
+    ("Adafruit_SSD1306", "Adafruit_SSD1306"),
+    ("Adafruit_GFX", "Adafruit_GFX"),
+    ("DHT", "DHT"),
+    ("Logger", "Logger"),
+]
+
+# ESP8266 address ranges.
+IRAM = (0x40100000, 0x40110000)
+FLASH = (0x40200000, 0x40500000)
+DRAM = (0x3FFE8000, 0x40000000)
+
+
+def find_nm():
+    """Pick the toolchain nm."""
+    for name in ("xtensa-lx106-elf-nm", "nm"):
+        if shutil.which(name):
+            return name
+    return "nm"
+
+
+def region(address, kind):
+    """Memory a symbol takes, from its address, or from its nm type off the ESP8266."""
+    if IRAM[0] <= address < IRAM[1]:
+        return "iram"
+    if FLASH[0] <= address < FLASH[1]:
+        return "flash"
+    if DRAM[0] <= address < DRAM[1]:
+        return "ram"
+    return "flash" if kind.lower() in "trvw" else "ram"
+
+
+def component(name, path):
+    """Component a symbol belongs to."""
+    if path:
+        match = CF_FILE.match(os.path.basename(path))
+        if match:
+            return match.group(1)
+        match = LIBRARY.search(path)
+        if match:
+            return match.group(1)
+        if CORE.search(path):
+            return "core"
+    match = CF_NAME.search(name)
+    if match:
+        return match.group(1)
+    for prefix, owner in NAMES:
+        if prefix in name:
+            return owner
+    return "other"
+
+
+def measure(elf, nm):
+    """Bytes per component and region."""
+    try:
+        output = subprocess.run([nm, "-C", "-S", "-l", "--size-sort", elf],
+                                check=True, capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as error:
+        sys.exit("cfsize: can't read symbols with %s: %s" % (nm, error))
+    sizes = {}
+    for line in output.splitlines():
+        match = LINE.match(line)
+        if not match:
+            continue
+        address, size, kind, name, path = match.groups()
+        row = sizes.setdefault(component(name, path), {"flash": 0, "iram": 0, "ram": 0})
+        row[region(int(address, 16), kind)] += int(size, 16)
+
+        # Initialized data is also copied from flash at boot.
+        if kind in "Dd" and region(int(address, 16), kind) == "ram":
+            row["flash"] += int(size, 16)
+    return sizes
+
+
+def report(sizes, baseline):
+    """Print the table, largest components first."""
+    columns = ("flash", "iram", "ram")
+    print("%-28s %9s %9s %9s" % ("component", *columns))
+    total = {column: 0 for column in columns}
+    names = sorted(set(sizes) | set(baseline or {}),
+                   key=lambda name: -sum(sizes.get(name, {}).values()))
+    for name in names:
+        row = sizes.get(name, {column: 0 for column in columns})
+        before = baseline.get(name, {column: 0 for column in columns}) if baseline else None
+        cells = []
+        for column in columns:
+            total[column] += row[column]
+            if before is None:
+                cells.append("%9d" % row[column])
+            else:
+                cells.append("%+9d" % (row[column] - before.get(column, 0)))
+        print("%-28s %s" % (name, " ".join(cells)))
+    print("%-28s %s" % ("total", " ".join("%9d" % total[column] for column in columns)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flash and RAM per component of a firmware ELF.")
+    parser.add_argument("elf", help="firmware ELF")
+    parser.add_argument("--nm", default=find_nm(), help="nm to use (default: %(default)s)")
+    parser.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    parser.add_argument("--save", metavar="FILE", help="save sizes as a baseline")
+    parser.add_argument("--baseline", metavar="FILE", help="show differences from a saved baseline")
+    args = parser.parse_args()
+
+    sizes = measure(args.elf, args.nm)
+    if args.save:
+        with open(args.save, "w") as out:
+            json.dump(sizes, out, indent=2, sort_keys=True)
+    if args.json:
+        json.dump(sizes, sys.stdout, indent=2, sort_keys=True)
+        print()
+        return
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as source:
+            baseline = json.load(source)
+    report(sizes, baseline)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+cftrace2chrome.py
+
+Decodes CFTrace dumps (CFTrace::dump() output captured from the serial monitor) into Chrome
+trace JSON, to be opened in chrome://tracing or https://ui.perfetto.dev.
+
+Usage:
+    cftrace2chrome.py serial.log > trace.json
+    pio device monitor | tee serial.log                                   # Capture the dump first.
+
+Every "CFTRACE BEGIN" ... "CFTRACE END" block in the log becomes one process in the trace, so
+several dumps can be compared side by side. Event names are read from the Event enum in
+src/CFTrace.h, ids that aren't there show as "event_<id>".
+
+@author  Caio Frota <caiofrota@gmail.com>
+@version 1.0
+@since   Sep, 2021
+"""
+
+import json
+import os
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<IHhi")                                                 # time, id, a, b.
+PHASE_BEGIN = 0x8000
+PHASE_END = 0x4000
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "src", "CFTrace.h")
+
+
+def load_event_names(path):
+    """Read event ids from the Event enum in CFTrace.h."""
+    names = {}
+    try:
+        with open(path) as header:
+            source = header.read()
+    except OSError:
+        return names
+    enum = re.search(r"enum Event \{(.*?)\};", source, re.S)
+    if enum:
+        for name, value in re.findall(r"(\w+)\s*=\s*(\d+)", enum.group(1)):
+            names[int(value)] = name.lower()
+    return names
+
+
+def read_blocks(lines):
+    """Yield the records of every dump block as lists of bytes."""
+    block = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("CFTRACE BEGIN"):
+            block = []
+        elif line.startswith("CFTRACE END"):
+            if block is not None:
+                yield block
+            block = None
+        elif block is not None and re.fullmatch(r"[0-9a-f]{%d}" % (RECORD.size * 2), line):
+            block.append(bytes.fromhex(line))
+
+
+def to_events(block, pid, names):
+    """Turn records into trace events, unwrapping the 32 bit micros() counter."""
+    events = []
+    last, offset = None, 0
+    for raw in block:
+        time, event_id, a, b = RECORD.unpack(raw)
+        if last is not None and time < last:
+            offset += 1 << 32
+        last = time
+
+        phase = "i"
+        if event_id & PHASE_BEGIN:
+            phase = "B"
+        elif event_id & PHASE_END:
+            phase = "E"
+        event_id &= ~(PHASE_BEGIN | PHASE_END) & 0xFFFF
+
+        event = {
+            "name": names.get(event_id, "event_%d" % event_id),
+            "ph": phase,
+            "ts": time + offset,
+            "pid": pid,
+            "tid": 1,
+        }
+        if phase == "i":
+            event["s"] = "t"
+            event["args"] = {"a": a, "b": b}
+        events.append(event)
+    return events
+
+
+def main():
+    names = load_event_names(HEADER)
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    events = []
+    for pid, block in enumerate(read_blocks(source), start=1):
+        events.extend(to_events(block, pid, names))
+    json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,114 @@
+/**
+ * CFAdaptiveSampler.cpp
+ * 
+ * Adaptive reading interval driven by how fast a signal moves.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFAdaptiveSampler.h>                                                  // CF Adaptive Sampler.
+
+/**
+ * Constructor.
+ *
+ * @param ttMin Interval while the signal moves (ms).
+ * @param ttMax Interval when it's stable (ms).
+ */
+CFAdaptiveSampler::CFAdaptiveSampler(unsigned long ttMin, unsigned long ttMax):
+        _ttMin(ttMin), _ttMax(max(ttMin, ttMax)), _ttRead(ttMin),
+        _rate(0), _deadband(0), _deviation(0),
+        _started(false), _moving(true), _last(0), _mean(0), _variance(0),
+        _tLastAdd(0) {
+    
+}
+
+/**
+ * Add a reading.
+ *
+ * @param value Reading.
+ * @return Time until the next reading (ms).
+ */
+unsigned long CFAdaptiveSampler::add(long value) {
+    unsigned long now = millis();
+    if (!_started) {
+        _started = true;
+        _last = value;
+        _mean = value * 16;
+        _variance = 0;
+        _tLastAdd = now;
+        _ttRead = _ttMin;
+        _moving = true;
+        return _ttRead;
+    }
+
+    // Change since last reading, per minute.
+    bool moving = false;
+    long change = abs(value - _last);
+    unsigned long elapsed = max(now - _tLastAdd, 1UL);
+    if (_rate > 0 && change > _deadband && (int64_t) change * 60000 >= (int64_t) _rate * (int64_t) elapsed) {
+        moving = true;
+    }
+
+    // Weighted mean and variance (alpha = 1/8).
+    int32_t diff = value * 16 - _mean;
+    _mean += diff / 8;
+    _variance += ((int64_t) diff * diff - _variance) / 8;
+    if (_deviation > 0 && _variance >= (int64_t) _deviation * _deviation * 256) {
+        moving = true;
+    }
+
+    _last = value;
+    _tLastAdd = now;
+    _moving = moving;
+    _ttRead = moving ? _ttMin : min(_ttRead * 2, _ttMax);
+    return _ttRead;
+}
+
+/**
+ * Forget readings, the next one restarts at the minimum interval.
+ */
+void CFAdaptiveSampler::reset() {
+    _started = false;
+    _moving = true;
+    _ttRead = _ttMin;
+}
+
+/**
+ * Define change per minute that means the signal is moving.
+ *
+ * @param rate Change per minute (0 to ignore).
+ * @param deadband Change between readings ignored as noise.
+ */
+void CFAdaptiveSampler::setRateThreshold(long rate, long deadband) {
+    _rate = rate;
+    _deadband = deadband;
+}
+
+/**
+ * Define deviation that means the signal is moving.
+ *
+ * @param deviation Standard deviation (0 to ignore).
+ */
+void CFAdaptiveSampler::setDeviationThreshold(long deviation) {
+    _deviation = deviation;
+}
+
+/**
+ * Get current interval.
+ *
+ * @return Time between readings (ms).
+ */
+unsigned long CFAdaptiveSampler::getInterval() {
+    return _ttRead;
+}
+
+/**
+ * True while the signal moves.
+ *
+ * @return True if the last reading was moving (or there's none yet).
+ */
+bool CFAdaptiveSampler::isMoving() {
+    return _moving;
+}
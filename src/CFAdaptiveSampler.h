@@ -0,0 +1,60 @@
+/**
+ * CFAdaptiveSampler.h
+ * 
+ * Adaptive reading interval driven by how fast a signal moves.
+ *
+ * Every reading is fed with add(), which returns the interval until the next one:
+ *      - Moving (change rate or deviation above threshold): the minimum interval, straight away,
+ *        so fast events (e.g. watering) are captured at full resolution.
+ *      - Stable: the interval doubles on every reading, up to the maximum.
+ *
+ * Change rate is the change since the last reading per minute, ignoring changes within the
+ * noise deadband. Deviation is the exponentially weighted standard deviation of the last ~8
+ * readings. Both are in the units fed to add() (e.g. raw ADC counts, 0.1 °C), set either
+ * threshold to 0 to ignore it.
+ *
+ * Register it with a sensor helper, e.g. CFSoilMoistureHelper::setAdaptiveSampler(), which
+ * then reads at the interval it returns instead of setReadingInterval().
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFAdaptiveSampler_h
+#define CFAdaptiveSampler_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+class CFAdaptiveSampler {
+    private:
+        // Attributes.
+        unsigned long _ttMin;                                                   // Interval while moving.
+        unsigned long _ttMax;                                                   // Interval when stable for long.
+        unsigned long _ttRead;                                                  // Current interval.
+        long _rate;                                                             // Change per minute that means moving.
+        long _deadband;                                                         // Change ignored as noise.
+        long _deviation;                                                        // Deviation that means moving.
+        bool _started;                                                          // First reading was added.
+        bool _moving;                                                           // Last reading was moving.
+        long _last;                                                             // Last reading.
+        int32_t _mean;                                                          // Weighted mean (1/16).
+        int64_t _variance;                                                      // Weighted variance (1/256).
+
+        // Loop control.
+        unsigned long _tLastAdd;                                                // Last time a reading was added.
+
+    public:
+        // Methods.
+        CFAdaptiveSampler(unsigned long ttMin, unsigned long ttMax);            // Constructor.
+        unsigned long add(long value);                                          // Add a reading, get the next interval.
+        void reset();                                                           // Forget readings, restart at the minimum interval.
+
+        // Accessors.
+        void setRateThreshold(long rate, long deadband);                        // Define change per minute that means moving.
+        void setDeviationThreshold(long deviation);                             // Define deviation that means moving.
+        unsigned long getInterval();                                            // Get current interval.
+        bool isMoving();                                                        // True while the signal moves.
+};
+
+#endif
@@ -0,0 +1,382 @@
+/**
+ * CFAggregator.cpp
+ * 
+ * Streaming aggregation of sensor samples between sends.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFAggregator.h>                                                       // CF Aggregator.
+
+const char *const CFAggregator::_suffixes[ITEMS] = {"_n", "_min", "_max", "_avg", "_sd", "_p50", "_p90"};
+
+/**
+ * Constructor.
+ */
+CFAggregator::CFAggregator(): _p50(0.5), _p90(0.9) {
+    reset();
+}
+
+/**
+ * Add a sample.
+ *
+ * @param value Sample.
+ */
+void CFAggregator::add(long value) {
+    if (_count == 0 || value < _min) {
+        _min = value;
+    }
+    if (_count == 0 || value > _max) {
+        _max = value;
+    }
+    _sum += value;
+    _sumSquares += (int64_t) value * value;
+
+    // Small windows keep their samples, larger ones go on with P² from them.
+    if (_count < CF_AGGREGATOR_EXACT_SIZE) {
+        int i = _count;
+        while (i > 0 && _samples[i - 1] > value) {
+            _samples[i] = _samples[i - 1];
+            i--;
+        }
+        _samples[i] = value;
+    } else {
+        if (_count == CF_AGGREGATOR_EXACT_SIZE) {
+            _p50.seed(_samples, _count);
+            _p90.seed(_samples, _count);
+        }
+        _p50.add(value);
+        _p90.add(value);
+    }
+    _count++;
+}
+
+/**
+ * Start a new window.
+ */
+void CFAggregator::reset() {
+    _count = 0;
+    _min = 0;
+    _max = 0;
+    _sum = 0;
+    _sumSquares = 0;
+    _p50.reset();
+    _p90.reset();
+}
+
+/**
+ * Serialize statistics as compact JSON, e.g. {"soil_n":60,"soil_min":40,...}.
+ * Statistics that don't fit are left for the next call, so a small buffer takes a few calls.
+ *
+ * @param key Telemetry key used as prefix.
+ * @param buffer Buffer.
+ * @param size Buffer size.
+ * @param cursor Next statistic to be serialized. Start with 0.
+ * @return Length written or 0 when there is nothing left (or window is empty).
+ */
+size_t CFAggregator::toJson(const char *key, char *buffer, size_t size, int &cursor) {
+    if (size < 3 || _count == 0) {
+        return 0;
+    }
+    size_t length = 0;
+    buffer[length++] = '{';
+
+    while (cursor < ITEMS) {
+        char item[64];
+        int itemLength;
+        if (cursor < 3) {
+            // Count, min and max are integers.
+            itemLength = snprintf(item, sizeof(item), "\"%s%s\":%ld", key, getItemSuffix(cursor), (long) getItem(cursor));
+        } else {
+            itemLength = snprintf(item, sizeof(item), "\"%s%s\":%.1f", key, getItemSuffix(cursor), getItem(cursor));
+        }
+
+        // Keep room for the separator, the closing brace and the terminator.
+        if (itemLength < 0 || itemLength >= (int) sizeof(item) || length + itemLength + 3 > size) {
+            break;
+        }
+        if (length > 1) {
+            buffer[length++] = ',';
+        }
+        memcpy(buffer + length, item, itemLength);
+        length += itemLength;
+        cursor++;
+    }
+
+    if (length == 1) {
+        return 0;
+    }
+    buffer[length++] = '}';
+    buffer[length] = '\0';
+    return length;
+}
+
+/**
+ * Get a statistic by index, in serialization order.
+ *
+ * @param item Statistic (0 to ITEMS - 1).
+ * @return Value.
+ */
+float CFAggregator::getItem(int item) {
+    switch (item) {
+        case 0:  return _count;
+        case 1:  return _min;
+        case 2:  return _max;
+        case 3:  return getMean();
+        case 4:  return getStdDev();
+        case 5:  return getMedian();
+        default: return getP90();
+    }
+}
+
+/**
+ * Get suffix appended to the telemetry key for a statistic.
+ *
+ * @param item Statistic (0 to ITEMS - 1).
+ * @return Suffix (e.g. "_avg").
+ */
+const char *CFAggregator::getItemSuffix(int item) {
+    return _suffixes[item];
+}
+
+/**
+ * Get samples in window.
+ *
+ * @return Samples.
+ */
+unsigned long CFAggregator::getCount() {
+    return _count;
+}
+
+/**
+ * Get min sample.
+ *
+ * @return Min sample or 0 if window is empty.
+ */
+long CFAggregator::getMin() {
+    return _min;
+}
+
+/**
+ * Get max sample.
+ *
+ * @return Max sample or 0 if window is empty.
+ */
+long CFAggregator::getMax() {
+    return _max;
+}
+
+/**
+ * Get mean.
+ *
+ * @return Mean or 0 if window is empty.
+ */
+float CFAggregator::getMean() {
+    if (_count == 0) {
+        return 0;
+    }
+    return (float) _sum / _count;
+}
+
+/**
+ * Get sample standard deviation.
+ * Sums are kept as integers, so there is no rounding drift however long the window is.
+ *
+ * @return Standard deviation or 0 if there are less than 2 samples.
+ */
+float CFAggregator::getStdDev() {
+    if (_count < 2) {
+        return 0;
+    }
+    // n * sum(x²) - sum(x)² is exact for integer samples.
+    int64_t numerator = (int64_t) _count * _sumSquares - _sum * _sum;
+    if (numerator <= 0) {
+        return 0;
+    }
+    return sqrt((float) numerator / ((float) _count * (_count - 1)));
+}
+
+/**
+ * Get median, exact up to CF_AGGREGATOR_EXACT_SIZE samples.
+ *
+ * @return Median or 0 if window is empty.
+ */
+float CFAggregator::getMedian() {
+    return (_count <= CF_AGGREGATOR_EXACT_SIZE) ? _exact(0.5) : _p50.get();
+}
+
+/**
+ * Get 90th percentile, exact up to CF_AGGREGATOR_EXACT_SIZE samples.
+ *
+ * @return 90th percentile or 0 if window is empty.
+ */
+float CFAggregator::getP90() {
+    return (_count <= CF_AGGREGATOR_EXACT_SIZE) ? _exact(0.9) : _p90.get();
+}
+
+/**
+ * Get exact percentile of the sorted samples, interpolated between the closest ranks.
+ *
+ * @param p Percentile (0-1).
+ * @return Percentile or 0 if window is empty.
+ */
+float CFAggregator::_exact(float p) {
+    if (_count == 0) {
+        return 0;
+    }
+    float rank = p * (_count - 1);
+    int low = (int) rank;
+    if (low + 1 >= (int) _count) {
+        return _samples[_count - 1];
+    }
+    return _samples[low] + (rank - low) * (_samples[low + 1] - _samples[low]);
+}
+
+/**
+ * Constructor.
+ *
+ * @param p Percentile (0-1).
+ */
+CFAggregator::Quantile::Quantile(float p): _p(p) {
+    reset();
+}
+
+/**
+ * Restart.
+ */
+void CFAggregator::Quantile::reset() {
+    _count = 0;
+    for (int i = 0; i < 5; i++) {
+        _height[i] = 0;
+        _position[i] = i;
+    }
+    _desired[0] = 0;
+    _desired[1] = 2 * _p;
+    _desired[2] = 4 * _p;
+    _desired[3] = 2 + 2 * _p;
+    _desired[4] = 4;
+}
+
+/**
+ * Add a sample.
+ *
+ * @param value Sample.
+ */
+void CFAggregator::Quantile::add(float value) {
+    // First 5 samples are kept sorted as the markers.
+    if (_count < 5) {
+        int i = _count++;
+        while (i > 0 && _height[i - 1] > value) {
+            _height[i] = _height[i - 1];
+            i--;
+        }
+        _height[i] = value;
+        return;
+    }
+
+    // Find the cell of the sample, stretching the extremes if needed.
+    int k;
+    if (value < _height[0]) {
+        _height[0] = value;
+        k = 0;
+    } else if (value >= _height[4]) {
+        _height[4] = value;
+        k = 3;
+    } else {
+        k = 0;
+        while (value >= _height[k + 1]) {
+            k++;
+        }
+    }
+
+    // Shift positions above the cell and move desired positions.
+    for (int i = k + 1; i < 5; i++) {
+        _position[i]++;
+    }
+    _desired[1] += _p / 2;
+    _desired[2] += _p;
+    _desired[3] += (1 + _p) / 2;
+    _desired[4] += 1;
+
+    // Adjust middle markers that are off by one position or more.
+    for (int i = 1; i < 4; i++) {
+        float offset = _desired[i] - _position[i];
+        if ((offset >= 1 && _position[i + 1] - _position[i] > 1) || (offset <= -1 && _position[i - 1] - _position[i] < -1)) {
+            int d = (offset > 0) ? 1 : -1;
+            float height = _parabolic(i, d);
+            if (_height[i - 1] < height && height < _height[i + 1]) {
+                _height[i] = height;
+            } else {
+                _height[i] = _linear(i, d);
+            }
+            _position[i] += d;
+        }
+    }
+}
+
+/**
+ * Start markers from sorted samples instead of the first 5, at the ranks they'd have reached.
+ *
+ * @param sorted Samples, sorted.
+ * @param count Samples (5 or more).
+ */
+void CFAggregator::Quantile::seed(const long *sorted, int count) {
+    float last = count - 1;
+    _desired[0] = 0;
+    _desired[1] = last * _p / 2;
+    _desired[2] = last * _p;
+    _desired[3] = last * (1 + _p) / 2;
+    _desired[4] = last;
+    for (int i = 0; i < 5; i++) {
+        long position = lround(_desired[i]);
+        if (i > 0 && position <= _position[i - 1]) {
+            position = _position[i - 1] + 1;
+        }
+        _position[i] = min(position, (long) (count - 5 + i));
+        _height[i] = sorted[_position[i]];
+    }
+    _count = 5;
+}
+
+/**
+ * Get estimate.
+ *
+ * @return Estimate or 0 if there are no samples.
+ */
+float CFAggregator::Quantile::get() {
+    if (_count == 0) {
+        return 0;
+    }
+    if (_count < 5) {
+        // Markers are still the sorted samples.
+        return _height[(int) (_p * (_count - 1) + 0.5)];
+    }
+    return _height[2];
+}
+
+/**
+ * Parabolic marker adjustment.
+ *
+ * @param i Marker.
+ * @param d Direction (-1 or 1).
+ * @return New marker height.
+ */
+float CFAggregator::Quantile::_parabolic(int i, int d) {
+    float n = _position[i], nPrev = _position[i - 1], nNext = _position[i + 1];
+    return _height[i] + d / (nNext - nPrev) * (
+            (n - nPrev + d) * (_height[i + 1] - _height[i]) / (nNext - n)
+            + (nNext - n - d) * (_height[i] - _height[i - 1]) / (n - nPrev));
+}
+
+/**
+ * Linear marker adjustment.
+ *
+ * @param i Marker.
+ * @param d Direction (-1 or 1).
+ * @return New marker height.
+ */
+float CFAggregator::Quantile::_linear(int i, int d) {
+    return _height[i] + d * (_height[i + d] - _height[i]) / (_position[i + d] - _position[i]);
+}
@@ -0,0 +1,88 @@
+/**
+ * CFAggregator.h
+ * 
+ * Streaming aggregation of sensor samples between sends.
+ *
+ * Samples are folded into constant-memory statistics: count, min, max, mean and standard
+ * deviation, plus median and 90th percentile. Percentiles are exact while the window has up to
+ * CF_AGGREGATOR_EXACT_SIZE samples, which are kept sorted; past that they're estimated with the
+ * P² algorithm (Jain & Chlamtac), which keeps 5 markers per percentile instead of the samples and
+ * starts from the sorted ones, so small windows aren't biased. Reset it when the window is
+ * published; CFThingsBoardHelper does so on every send when the aggregator is registered with
+ * setTelemetryAggregate().
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFAggregator_h
+#define CFAggregator_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+#ifndef CF_AGGREGATOR_EXACT_SIZE
+    #define CF_AGGREGATOR_EXACT_SIZE        16                                  // Samples kept for exact percentiles.
+#endif
+
+static_assert(CF_AGGREGATOR_EXACT_SIZE >= 5, "CF_AGGREGATOR_EXACT_SIZE must be at least 5 (P² markers).");
+
+class CFAggregator {
+    private:
+        // P² percentile estimator.
+        class Quantile {
+            private:
+                float _p;                                                       // Percentile (0-1).
+                float _height[5];                                               // Marker heights.
+                long _position[5];                                              // Marker positions.
+                float _desired[5];                                              // Desired marker positions.
+                uint8_t _count;                                                 // Samples, up to 5.
+
+                float _parabolic(int i, int d);                                 // Parabolic marker adjustment.
+                float _linear(int i, int d);                                    // Linear marker adjustment.
+
+            public:
+                Quantile(float p);                                              // Constructor.
+                void add(float value);                                          // Add a sample.
+                void seed(const long *sorted, int count);                       // Start markers from sorted samples.
+                float get();                                                    // Get estimate.
+                void reset();                                                   // Restart.
+        };
+
+        // Attributes.
+        static const char *const _suffixes[];                                   // Key suffix per statistic.
+        unsigned long _count;                                                   // Samples.
+        long _min;                                                              // Min sample.
+        long _max;                                                              // Max sample.
+        int64_t _sum;                                                           // Sum of samples.
+        int64_t _sumSquares;                                                    // Sum of squared samples.
+        Quantile _p50;                                                          // Median.
+        Quantile _p90;                                                          // 90th percentile.
+        long _samples[CF_AGGREGATOR_EXACT_SIZE];                                // First samples, sorted.
+
+        // Methods.
+        float _exact(float p);                                                  // Get exact percentile of the sorted samples.
+
+    public:
+        // Constants.
+        static const int ITEMS = 7;                                             // Statistics per window.
+
+        // Methods.
+        CFAggregator();                                                         // Constructor.
+        void add(long value);                                                   // Add a sample.
+        void reset();                                                           // Start a new window.
+        size_t toJson(const char *key, char *buffer, size_t size, int &cursor); // Serialize statistics as compact JSON.
+
+        // Accessors.
+        unsigned long getCount();                                               // Get samples in window.
+        long getMin();                                                          // Get min sample.
+        long getMax();                                                          // Get max sample.
+        float getMean();                                                        // Get mean.
+        float getStdDev();                                                      // Get sample standard deviation.
+        float getMedian();                                                      // Get median estimate.
+        float getP90();                                                         // Get 90th percentile estimate.
+        float getItem(int item);                                                // Get a statistic by index.
+        static const char *getItemSuffix(int item);                             // Get key suffix of a statistic.
+};
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * CFAttributeSync.cpp
+ * 
+ * Remembers which client attribute values ThingsBoard already has, so only differences are sent.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFAttributeSync.h>                                                    // CF Attribute Sync.
+
+#define CF_ATTRIBUTE_SYNC_MAGIC             0xCFA50001                          // File marker. Change it when layout changes.
+
+/**
+ * Constructor.
+ *
+ * @param path File path in SPIFFS.
+ */
+CFAttributeSync::CFAttributeSync(const char *path):
+        _path(path), _scope(0), _count(0), _pendingCount(0), _loaded(false), _dirty(false) {
+
+}
+
+/**
+ * Define scope. A different scope from the stored one starts an empty table.
+ *
+ * @param server Server URL.
+ * @param token Device token.
+ */
+void CFAttributeSync::setScope(const char *server, const char *token) {
+    uint32_t scope = hash(token, hash(server));
+    _load();
+    if (scope != _scope) {
+        _scope = scope;
+        _count = 0;
+        _pendingCount = 0;
+        _dirty = true;
+    }
+}
+
+/**
+ * True if server already has this value, or it's on its way.
+ *
+ * @param key Attribute key.
+ * @param value Attribute value.
+ * @return True if the last value sent for the key is the same.
+ */
+bool CFAttributeSync::isSynced(const char *key, JsonVariantConst value) {
+    _load();
+    uint32_t keyHash = hash(key);
+    int i = _findPending(keyHash);
+    if (i >= 0) {
+        return _pending[i].value == _hashValue(value);
+    }
+    i = _find(keyHash);
+    return i >= 0 && _entries[i].value == _hashValue(value);
+}
+
+/**
+ * Remember server has this value.
+ *
+ * @param key Attribute key.
+ * @param value Attribute value.
+ */
+void CFAttributeSync::markSynced(const char *key, JsonVariantConst value) {
+    _load();
+    _mark(hash(key), _hashValue(value));
+}
+
+/**
+ * Remember this value is on its way, so it isn't sent again while the broker hasn't acknowledged
+ * it. It replaces any value of the same key still on its way. When the table is full, the oldest
+ * one is forgotten and will be sent again.
+ *
+ * @param key Attribute key.
+ * @param value Attribute value.
+ * @param packetId Packet id of the publish carrying it, or 0 if it was sent with QoS 0.
+ */
+void CFAttributeSync::markSent(const char *key, JsonVariantConst value, uint16_t packetId) {
+    _load();
+    uint32_t keyHash = hash(key);
+    int i = _findPending(keyHash);
+    if (i < 0) {
+        if (_pendingCount == CF_ATTRIBUTE_SYNC_SIZE) {
+            memmove(_pending, _pending + 1, sizeof(Pending) * (CF_ATTRIBUTE_SYNC_SIZE - 1));
+            _pendingCount--;
+        }
+        i = _pendingCount++;
+        _pending[i].key = keyHash;
+    }
+    _pending[i].packetId = packetId;
+    _pending[i].value = _hashValue(value);
+}
+
+/**
+ * Remember values of a publish the broker has acknowledged, and write the table.
+ *
+ * @param packetId Packet id.
+ */
+void CFAttributeSync::acknowledge(uint16_t packetId) {
+    if (packetId == 0) {
+        return;
+    }
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < _pendingCount; i++) {
+        if (_pending[i].packetId == packetId) {
+            _mark(_pending[i].key, _pending[i].value);
+        } else {
+            _pending[kept++] = _pending[i];
+        }
+    }
+    _pendingCount = kept;
+    save();
+}
+
+/**
+ * Write table into file if it changed.
+ */
+void CFAttributeSync::save() {
+    if (!_dirty) {
+        return;
+    }
+    if (!_file || !_file.seek(0)) {
+        return;
+    }
+    uint32_t header[2] = {CF_ATTRIBUTE_SYNC_MAGIC, _scope};
+    _file.write((const uint8_t *) header, sizeof(header));
+    _file.write(&_count, sizeof(_count));
+    _file.write((const uint8_t *) _entries, sizeof(Entry) * _count);
+    _file.flush();
+    _dirty = false;
+}
+
+/**
+ * Forget everything, so all is sent again.
+ */
+void CFAttributeSync::clear() {
+    _load();
+    _count = 0;
+    _pendingCount = 0;
+    _dirty = true;
+    save();
+}
+
+/**
+ * Open the file once and read the table. A missing file is created. Entries past the count are
+ * left over from a larger table, so the file is written in place.
+ */
+void CFAttributeSync::_load() {
+    if (_loaded) {
+        return;
+    }
+    _loaded = true;
+    if (!SPIFFS.begin()) {
+        return;
+    }
+    if (!SPIFFS.exists(_path)) {
+        _file = SPIFFS.open(_path, "w+");
+        return;
+    }
+    _file = SPIFFS.open(_path, "r+");
+    if (!_file) {
+        return;
+    }
+    uint32_t header[2];
+    uint8_t count;
+    if (_file.read((uint8_t *) header, sizeof(header)) == sizeof(header) && header[0] == CF_ATTRIBUTE_SYNC_MAGIC
+            && _file.read(&count, sizeof(count)) == sizeof(count) && count <= CF_ATTRIBUTE_SYNC_SIZE
+            && _file.read((uint8_t *) _entries, sizeof(Entry) * count) == sizeof(Entry) * count) {
+        _scope = header[1];
+        _count = count;
+    }
+}
+
+/**
+ * Find an entry.
+ *
+ * @param key Key hash.
+ * @return Entry index or -1 if there is none.
+ */
+int CFAttributeSync::_find(uint32_t key) {
+    for (int i = 0; i < _count; i++) {
+        if (_entries[i].key == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Find an attribute waiting for PUBACK.
+ *
+ * @param key Key hash.
+ * @return Index or -1 if there is none.
+ */
+int CFAttributeSync::_findPending(uint32_t key) {
+    for (int i = 0; i < _pendingCount; i++) {
+        if (_pending[i].key == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Remember server has a value hash. When the table is full, the oldest entry is replaced.
+ *
+ * @param key Key hash.
+ * @param value Value hash.
+ */
+void CFAttributeSync::_mark(uint32_t key, uint32_t value) {
+    int i = _find(key);
+    if (i < 0) {
+        if (_count == CF_ATTRIBUTE_SYNC_SIZE) {
+            memmove(_entries, _entries + 1, sizeof(Entry) * (CF_ATTRIBUTE_SYNC_SIZE - 1));
+            _count--;
+        }
+        i = _count++;
+        _entries[i].key = key;
+    } else if (_entries[i].value == value) {
+        return;
+    }
+    _entries[i].value = value;
+    _dirty = true;
+}
+
+/**
+ * Hash a value through its JSON text, so 1 and "1" differ.
+ *
+ * @param value Value.
+ * @return Hash.
+ */
+uint32_t CFAttributeSync::_hashValue(JsonVariantConst value) {
+    char text[64];
+    serializeJson(value, text, sizeof(text));
+    // Long texts are cut, their length keeps them apart.
+    return hash(text, 2166136261UL ^ measureJson(value));
+}
+
+/**
+ * Hash a text (FNV-1a).
+ *
+ * @param text Text.
+ * @param hash Initial hash, to chain texts.
+ * @return Hash.
+ */
+uint32_t CFAttributeSync::hash(const char *text, uint32_t hash) {
+    while (*text) {
+        hash ^= (uint8_t) *text++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
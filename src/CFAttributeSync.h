@@ -0,0 +1,78 @@
+/**
+ * CFAttributeSync.h
+ * 
+ * Remembers which client attribute values ThingsBoard already has, so only differences are sent.
+ *
+ * A hash of each attribute key and of its value is kept in a small table, persisted in SPIFFS so
+ * it survives reboots. The table belongs to a scope (hash of server and token): pointing the
+ * device to another server or device clears it, and everything is sent again.
+ *
+ * Values sent with QoS 1 wait in RAM, keyed by packet id, until the broker acknowledges them;
+ * only then they're remembered and written. Values sent with QoS 0 are never acknowledged, so
+ * they're kept in RAM only and sent again after a reboot. The file is opened once and kept
+ * open, so writing it doesn't allocate.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFAttributeSync_h
+#define CFAttributeSync_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <ArduinoJson.h>                                                        // Arduino JSON.
+#include <FS.h>                                                                 // SPIFFS.
+
+#ifndef CF_ATTRIBUTE_SYNC_SIZE
+    #define CF_ATTRIBUTE_SYNC_SIZE          16                                  // Max attributes remembered.
+#endif
+
+class CFAttributeSync {
+    private:
+        // Synced attribute.
+        struct Entry {
+            uint32_t key;                                                       // Key hash.
+            uint32_t value;                                                     // Value hash.
+        };
+
+        // Attribute sent, waiting for PUBACK.
+        struct Pending {
+            uint16_t packetId;                                                  // Packet id (0 if QoS 0).
+            uint32_t key;                                                       // Key hash.
+            uint32_t value;                                                     // Value hash.
+        };
+
+        // Attributes.
+        const char *_path;                                                      // File path.
+        uint32_t _scope;                                                        // Scope hash (server and token).
+        Entry _entries[CF_ATTRIBUTE_SYNC_SIZE];                                 // Synced attributes.
+        uint8_t _count;                                                         // Synced attributes quantity.
+        Pending _pending[CF_ATTRIBUTE_SYNC_SIZE];                               // Attributes waiting for PUBACK.
+        uint8_t _pendingCount;                                                  // Attributes waiting for PUBACK quantity.
+        bool _loaded;                                                           // Flag that indicates file has been read.
+        bool _dirty;                                                            // Flag that indicates table differs from file.
+        File _file;                                                             // File, kept open once read.
+
+        // Methods.
+        void _load();                                                           // Read table from file.
+        int _find(uint32_t key);                                                // Find an entry.
+        int _findPending(uint32_t key);                                         // Find an attribute waiting for PUBACK.
+        void _mark(uint32_t key, uint32_t value);                               // Remember server has a value hash.
+        static uint32_t _hashValue(JsonVariantConst value);                     // Hash a value.
+
+    public:
+        // Methods.
+        CFAttributeSync(const char *path);                                      // Constructor.
+        void setScope(const char *server, const char *token);                   // Define scope.
+        bool isSynced(const char *key, JsonVariantConst value);                 // True if server already has this value.
+        void markSynced(const char *key, JsonVariantConst value);               // Remember server has this value.
+        void markSent(const char *key, JsonVariantConst value,                  // Remember this value is on its way.
+                uint16_t packetId);
+        void acknowledge(uint16_t packetId);                                    // Remember values of an acknowledged publish.
+        void save();                                                            // Write table into file if it changed.
+        void clear();                                                           // Forget everything, so all is sent again.
+        static uint32_t hash(const char *text, uint32_t hash = 2166136261UL);   // Hash a text (FNV-1a).
+};
+
+#endif
@@ -33,8 +33,11 @@
 CFDHTHelper::CFDHTHelper(int dhtType, int pinData):
         _dht(dhtType, pinData), _pinReset(-1),
         _read(false),
-        _temperatureC(0), _temperatureF(0), _heatIndexC(0), _heatIndexF(0), _humidity(0),
-        _lastReading(0), _readingDelay(1000) {
+        _temperatureC(0), _temperatureF(0), _heatIndexC(0), _heatIndexF(0),
+        _dewPointC(0), _absoluteHumidity(0), _humidity(0),
+        _lastReading(0), _readingDelay(1000), _temperatureSampler(nullptr), _humiditySampler(nullptr),
+        _mReads(CFMetrics::counter("dht_reads")), _mReadFail(CFMetrics::counter("dht_fail")),
+        _mReadTime(CFMetrics::histogram("dht_read_us")), _mCalcTime(CFMetrics::histogram("dht_calc_us")) {
     
 }
 
@@ -48,8 +51,11 @@ CFDHTHelper::CFDHTHelper(int dhtType, int pinData):
 CFDHTHelper::CFDHTHelper(int dhtType, int pinData, int pinReset):
         _dht(dhtType, pinData), _pinReset(pinReset),
         _read(false),
-        _temperatureC(0), _temperatureF(0), _heatIndexC(0), _heatIndexF(0), _humidity(0),
-        _lastReading(0), _readingDelay(1000) {
+        _temperatureC(0), _temperatureF(0), _heatIndexC(0), _heatIndexF(0),
+        _dewPointC(0), _absoluteHumidity(0), _humidity(0),
+        _lastReading(0), _readingDelay(1000), _temperatureSampler(nullptr), _humiditySampler(nullptr),
+        _mReads(CFMetrics::counter("dht_reads")), _mReadFail(CFMetrics::counter("dht_fail")),
+        _mReadTime(CFMetrics::histogram("dht_read_us")), _mCalcTime(CFMetrics::histogram("dht_calc_us")) {
     
 }
 
@@ -65,39 +71,83 @@ void CFDHTHelper::begin() {
 
 /**
  * Loop.
+ *
+ * @return True if a reading succeeded in this call.
  */
 bool CFDHTHelper::loop() {
     if (_lastReading == 0 || millis() - _lastReading > _readingDelay) {
         // Read
         _lastReading = millis();
         
-        _temperatureC = _dht.readTemperature();
-        _temperatureF = _dht.readTemperature(true);
-        _humidity = _dht.readHumidity();
+        CF_TRACE_BEGIN(CFTrace::DHT_READ);
+        unsigned long tRead = micros();
+        float temperature = _dht.readTemperature();
+        float humidity = _dht.readHumidity();
+        CFMetrics::record(_mReadTime, micros() - tRead);
+        CF_TRACE_END(CFTrace::DHT_READ);
+        CFMetrics::increment(_mReads);
         
         // Check if it was read.
-        if (isnan(_temperatureC) || isnan(_temperatureF) || isnan(_humidity)) {
+        if (isnan(temperature) || isnan(humidity)) {
             _temperatureC = 0;
             _temperatureF = 0;
             _heatIndexC = 0;
             _heatIndexF = 0;
+            _dewPointC = 0;
+            _absoluteHumidity = 0;
             _humidity = 0;
             _read = false;
+            CFMetrics::increment(_mReadFail);
             
             // DHT Workaround for fail reading failure.
-            digitalWrite(_pinReset, !digitalRead(_pinReset));                                       // Force pshysical power recycle.
+            if (_pinReset > -1) {
+                digitalWrite(_pinReset, !digitalRead(_pinReset));               // Force pshysical power recycle.
+            }
             
             return false;
         }
         
-        _temperatureC = roundf(_temperatureC * 10) / 10;
-        _temperatureF = roundf(_temperatureF * 10) / 10;
-        _humidity = roundf(_humidity * 10) / 10;
-        _heatIndexC = roundf(_dht.computeHeatIndex(_temperatureC, _humidity, false) * 10) / 10;
-        _heatIndexF = roundf(_dht.computeHeatIndex(_temperatureC, _humidity) * 10) / 10;
+        _temperatureC = lroundf(temperature * 10);
+        _humidity = lroundf(humidity * 10);
+        unsigned long tCalc = micros();
+        _compute();
+        CFMetrics::record(_mCalcTime, micros() - tCalc);
+
+        // Next reading when it adapts to the readings, the sooner of both.
+        if (_temperatureSampler) {
+            _readingDelay = _temperatureSampler->add(_temperatureC);
+            if (_humiditySampler) {
+                _readingDelay = min(_readingDelay, _humiditySampler->add(_humidity));
+            }
+        }
         
         _read = true;
+        return true;
     }
+    return false;
+}
+
+/**
+ * Compute derived values from temperature in C and humidity.
+ */
+void CFDHTHelper::_compute() {
+#ifdef CF_DHT_FLOAT_MATH
+    float temperature = _temperatureC / 10.0f;
+    float humidity = _humidity / 10.0f;
+    float gamma = logf(humidity / 100) + 17.62f * temperature / (243.12f + temperature);
+    _temperatureF = lroundf(_dht.convertCtoF(temperature) * 10);
+    _heatIndexC = lroundf(_dht.computeHeatIndex(temperature, humidity, false) * 10);
+    _heatIndexF = lroundf(_dht.computeHeatIndex(temperature, humidity, false) * 18 + 320);
+    _dewPointC = lroundf(243.12f * gamma / (17.62f - gamma) * 10);
+    _absoluteHumidity = lroundf(6.112f * expf(17.67f * temperature / (temperature + 243.5f))
+            * humidity * 21.674f / (273.15f + temperature));
+#else
+    _temperatureF = CFPsychrometrics::toFahrenheit(_temperatureC);
+    _heatIndexC = CFPsychrometrics::heatIndexC(_temperatureC, _humidity);
+    _heatIndexF = CFPsychrometrics::heatIndexF(_temperatureF, _humidity);
+    _dewPointC = CFPsychrometrics::dewPointC(_temperatureC, _humidity);
+    _absoluteHumidity = CFPsychrometrics::absoluteHumidity(_temperatureC, _humidity);
+#endif
 }
 
 /**
@@ -109,6 +159,30 @@ void CFDHTHelper::setReadingInterval(long readingDelay) {
     _readingDelay = readingDelay;
 }
 
+/**
+ * Adapt time between readings to how fast temperature moves. It replaces setReadingInterval().
+ *
+ * @param temperature Adaptive sampler, fed with temperature in C (0.1).
+ */
+void CFDHTHelper::setAdaptiveSampler(CFAdaptiveSampler &temperature) {
+    _temperatureSampler = &temperature;
+    _humiditySampler = nullptr;
+    _readingDelay = temperature.getInterval();
+}
+
+/**
+ * Adapt time between readings to how fast temperature or humidity move, whichever asks for
+ * the shorter interval. It replaces setReadingInterval().
+ *
+ * @param temperature Adaptive sampler, fed with temperature in C (0.1).
+ * @param humidity Adaptive sampler, fed with humidity (0.1 %).
+ */
+void CFDHTHelper::setAdaptiveSampler(CFAdaptiveSampler &temperature, CFAdaptiveSampler &humidity) {
+    _temperatureSampler = &temperature;
+    _humiditySampler = &humidity;
+    _readingDelay = min(temperature.getInterval(), humidity.getInterval());
+}
+
 /**
  * Check if it's read.
  *
@@ -124,7 +198,7 @@ bool CFDHTHelper::isRead() {
  * @returns Temperature in C.
  */
 float CFDHTHelper::getTemperatureC() {
-    return _temperatureC;
+    return _temperatureC / 10.0f;
 }
 
 /**
@@ -133,7 +207,7 @@ float CFDHTHelper::getTemperatureC() {
  * @returns Temperature in F.
  */
 float CFDHTHelper::getTemperatureF() {
-    return _temperatureF;
+    return _temperatureF / 10.0f;
 }
 
 /**
@@ -142,7 +216,7 @@ float CFDHTHelper::getTemperatureF() {
  * @returns Heat index in C.
  */
 float CFDHTHelper::getHeatIndexC() {
-    return _heatIndexC;
+    return _heatIndexC / 10.0f;
 }
 
 /**
@@ -151,7 +225,34 @@ float CFDHTHelper::getHeatIndexC() {
  * @returns Heat index in F.
  */
 float CFDHTHelper::getHeatIndexF() {
-    return _heatIndexF;
+    return _heatIndexF / 10.0f;
+}
+
+/**
+ * Get dew point in C.
+ *
+ * @returns Dew point in C.
+ */
+float CFDHTHelper::getDewPointC() {
+    return _dewPointC / 10.0f;
+}
+
+/**
+ * Get dew point in F.
+ *
+ * @returns Dew point in F.
+ */
+float CFDHTHelper::getDewPointF() {
+    return CFPsychrometrics::toFahrenheit(_dewPointC) / 10.0f;
+}
+
+/**
+ * Get absolute humidity.
+ *
+ * @returns Absolute humidity in g/m³.
+ */
+float CFDHTHelper::getAbsoluteHumidity() {
+    return _absoluteHumidity / 10.0f;
 }
 
 /**
@@ -160,7 +261,7 @@ float CFDHTHelper::getHeatIndexF() {
  * @returns Humidity.
  */
 float CFDHTHelper::getHumidity() {
-    return _humidity;
+    return _humidity / 10.0f;
 }
 
 /**
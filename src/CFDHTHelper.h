@@ -17,6 +17,11 @@
  *
  * Workaround:
  *      A pin is being used for physically restarting DHT when it's getting NaN.
+ *
+ * Derived values (Fahrenheit, heat index, dew point, absolute humidity) are computed from one
+ * temperature and one humidity reading with CFPsychrometrics integer kernels. Define
+ * CF_DHT_FLOAT_MATH to compute them with the float DHT library functions instead, e.g. to
+ * compare the dht_calc_us histogram of both.
  * 
  * @author  Caio Frota <caiofrota@gmail.com>
  * @version 1.0
@@ -29,6 +34,10 @@
 #include <Arduino.h>                                                            // Arduino library.
 #include <Logger.h>                                                             // Logger.
 #include <DHT.h>                                                                // DHT.
+#include <CFMetrics.h>                                                          // CF Metrics.
+#include <CFTrace.h>                                                           // CF Trace.
+#include <CFPsychrometrics.h>                                                   // CF Psychrometrics.
+#include <CFAdaptiveSampler.h>                                                  // CF Adaptive Sampler.
 
 class CFDHTHelper {
     private:
@@ -36,17 +45,33 @@ class CFDHTHelper {
         DHT _dht;                                                               // DHT object.
         int _pinReset;                                                          // DHT Workaround for fail reading failure.
         bool _read;                                                             // Flag that indicate if data was read.
-        float _temperatureC;                                                    // Temperature in C.
-        float _temperatureF;                                                    // Temperature in F.
-        float _heatIndexC;                                                      // Heat index in C.
-        float _heatIndexF;                                                      // Heat index in F.
-        float _humidity;                                                        // Humidity.
+        int16_t _temperatureC;                                                  // Temperature in C (0.1).
+        int16_t _temperatureF;                                                  // Temperature in F (0.1).
+        int16_t _heatIndexC;                                                    // Heat index in C (0.1).
+        int16_t _heatIndexF;                                                    // Heat index in F (0.1).
+        int16_t _dewPointC;                                                     // Dew point in C (0.1).
+        int16_t _absoluteHumidity;                                              // Absolute humidity in g/m³ (0.1).
+        int16_t _humidity;                                                      // Humidity (0.1).
 
         // Loop control.
         unsigned long _lastReading;                                             // Last time data was read.
         unsigned long _readingDelay;                                            // Time between readings.
+        CFAdaptiveSampler *_temperatureSampler;                                 // Adaptive reading interval (optional).
+        CFAdaptiveSampler *_humiditySampler;                                    // Adaptive reading interval (optional).
+
+        // Metrics.
+        int _mReads;                                                            // Readings.
+        int _mReadFail;                                                         // Failed readings.
+        int _mReadTime;                                                         // Reading time histogram (us).
+        int _mCalcTime;                                                         // Derived values time histogram (us).
+
+        // Methods.
+        void _compute();                                                        // Compute derived values.
     
     public:
+        // Sizes.
+        static constexpr int TELEMETRY_KEYS = 7;                                // Values published (temperatures, indexes, humidity).
+
         // Constructors.
         CFDHTHelper(int dhtType, int pinData);                                  // Constructor.
         CFDHTHelper(int dhtType, int pinData, int pinReset);                    // Constructor with DHT Workaround for fail reading failure.
@@ -57,11 +82,17 @@ class CFDHTHelper {
         
         // Accessors.
         void setReadingInterval(long readingDelay);                             // Define time between readings.
+        void setAdaptiveSampler(CFAdaptiveSampler &temperature);                // Adapt time between readings to temperature.
+        void setAdaptiveSampler(CFAdaptiveSampler &temperature,                 // Adapt time between readings to temperature and humidity.
+                CFAdaptiveSampler &humidity);
         bool isRead();                                                          // Check if it's read.
         float getTemperatureC();                                                // Get temperature in C.
         float getTemperatureF();                                                // Get temperature in F.
         float getHeatIndexC();                                                  // Get heat index in C.
         float getHeatIndexF();                                                  // Get heat inter in F.
+        float getDewPointC();                                                   // Get dew point in C.
+        float getDewPointF();                                                   // Get dew point in F.
+        float getAbsoluteHumidity();                                            // Get absolute humidity in g/m³.
         float getHumidity();                                                    // Get humidity.
         DHT getDHT();                                                           // Get DHT object.
 };
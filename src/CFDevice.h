@@ -0,0 +1,273 @@
+/**
+ * CFDevice.h
+ *
+ * Compile-time composition of the CF helpers a device is made of.
+ *
+ * A device is declared as a type listing its components (sensors, transports, UI), which are
+ * the sketch's own global helpers:
+ *
+ *      CFWiFiManagerHelper _cfWiFiManager;
+ *      CFSoilMoistureHelper _soilMoisture(A0);
+ *      CFThingsBoardHelper _cfThingsBoard(APP_CODE, APP_VERSION);
+ *      CFTelemetryValues<2> _trend;                                            // Values the sketch sets itself.
+ *      CFDevice<_cfWiFiManager, _soilMoisture, _cfThingsBoard, _trend> _device;
+ *
+ *      _device.begin();                                                        // setup(): sizes, then begin() of every component.
+ *      if (_device.loop() & _device.bit<_soilMoisture>()) {                    // loop(): loop() of every component, in order.
+ *          ...                                                                 // New soil moisture reading.
+ *      }
+ *
+ * Components are bound at compile time, so begin() and loop() are direct calls with no table of
+ * pointers, CFDevice itself takes no RAM, and helpers that aren't listed (or otherwise used) are
+ * never referenced and are dropped by the linker. has<T>() tells if a component type is listed,
+ * e.g. to skip rendering when there's no display. Sizes derived from the component list are
+ * constants:
+ *
+ *      - RAM: bytes taken by the components.
+ *      - TELEMETRY_KEYS: values published by the components (TELEMETRY_KEYS of each helper).
+ *      - PAYLOAD_SIZE: worst case JSON telemetry payload.
+ *      - TELEMETRY_DOC_SIZE: telemetry document capacity for those values.
+ *
+ * begin() hands the last two to components that take them (setTelemetryCapacity(), i.e. the
+ * ThingsBoard helper), which size their telemetry document and MQTT buffer from them.
+ *
+ * loop() takes a CFLoopSupervisor and a section per component to run each one in its section:
+ *
+ *      const int sections[] = {_sectionWiFi, _sectionSoil, _sectionThingsBoard, -1};
+ *      _device.loop(_supervisor, sections);
+ *
+ * extras/tools/cfsize.py reports flash and RAM per component from the firmware ELF.
+ *
+ * Requires C++17 (ESP8266 core 3.0 or later).
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFDevice_h
+#define CFDevice_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <ArduinoJson.h>                                                        // Arduino JSON (JSON_OBJECT_SIZE).
+#include <type_traits>                                                          // Type traits.
+#include <utility>                                                              // Index sequences.
+
+#ifndef CF_DEVICE_KEY_SIZE
+    #define CF_DEVICE_KEY_SIZE              24                                  // JSON bytes per telemetry value ("key12chars": 12345678,).
+#endif
+
+/**
+ * Telemetry values published by a component, from its TELEMETRY_KEYS constant (0 if it has none).
+ */
+template <typename T, typename = void>
+struct CFTelemetryKeys : std::integral_constant<size_t, 0> {};
+
+template <typename T>
+struct CFTelemetryKeys<T, std::void_t<decltype(T::TELEMETRY_KEYS)>>
+        : std::integral_constant<size_t, T::TELEMETRY_KEYS> {};
+
+/**
+ * Telemetry values the sketch sets itself (e.g. computed from readings), listed as a component
+ * so they're counted in the sizes.
+ */
+template <size_t N>
+struct CFTelemetryValues {
+    static constexpr size_t TELEMETRY_KEYS = N;                                 // Values published.
+};
+
+/**
+ * True if both are the same component.
+ */
+template <auto &A, auto &B>
+struct CFSameComponent : std::false_type {};
+
+template <auto &A>
+struct CFSameComponent<A, A> : std::true_type {};
+
+template <auto &... Components>
+class CFDevice {
+    private:
+        // Methods.
+
+        /**
+         * Size the telemetry of a component that takes it.
+         *
+         * @param component Component.
+         */
+        template <typename T>
+        static auto _size(T &component, int) -> decltype(component.setTelemetryCapacity(size_t(), size_t()), void()) {
+            component.setTelemetryCapacity(PAYLOAD_SIZE, TELEMETRY_DOC_SIZE);
+        }
+
+        /**
+         * Components without telemetry buffers have nothing to size.
+         */
+        template <typename T>
+        static void _size(T &, long) {
+        }
+
+        /**
+         * Begin a component that has begin().
+         *
+         * @param component Component.
+         */
+        template <typename T>
+        static auto _begin(T &component, int) -> decltype(component.begin(), void()) {
+            component.begin();
+        }
+
+        /**
+         * Components without begin() have nothing to start.
+         */
+        template <typename T>
+        static void _begin(T &, long) {
+        }
+
+        /**
+         * Loop a component that has loop().
+         *
+         * @param component Component.
+         * @return True if its loop() returns true (e.g. a new reading was taken).
+         */
+        template <typename T>
+        static auto _loop(T &component, int) -> decltype(component.loop(), bool()) {
+            if constexpr (std::is_same<decltype(component.loop()), bool>::value) {
+                return component.loop();
+            } else {
+                component.loop();
+                return false;
+            }
+        }
+
+        /**
+         * Components without loop() have nothing to do.
+         *
+         * @return False.
+         */
+        template <typename T>
+        static bool _loop(T &, long) {
+            return false;
+        }
+
+        /**
+         * Loop a component in a supervisor section.
+         *
+         * @param component Component.
+         * @param supervisor Loop supervisor.
+         * @param section Section id (-1 for none).
+         * @return True if its loop() returns true, false if the section is deferred.
+         */
+        template <typename T, typename Supervisor>
+        static bool _supervise(T &component, Supervisor &supervisor, int section) {
+            if (!supervisor.start(section)) {
+                return false;
+            }
+            bool updated = _loop(component, 0);
+            supervisor.stop(section);
+            return updated;
+        }
+
+        /**
+         * Loop every component.
+         *
+         * @return Bits of the components whose loop() returned true.
+         */
+        template <size_t... I>
+        static uint32_t _loopAll(std::index_sequence<I...>) {
+            uint32_t updated = 0;
+            ((updated |= (uint32_t) _loop(Components, 0) << I), ...);
+            return updated;
+        }
+
+        /**
+         * Loop every component in its supervisor section.
+         *
+         * @param supervisor Loop supervisor.
+         * @param sections Section id per component.
+         * @return Bits of the components whose loop() returned true.
+         */
+        template <typename Supervisor, size_t... I>
+        static uint32_t _superviseAll(Supervisor &supervisor, const int *sections, std::index_sequence<I...>) {
+            uint32_t updated = 0;
+            ((updated |= (uint32_t) _supervise(Components, supervisor, sections[I]) << I), ...);
+            return updated;
+        }
+
+        /**
+         * Get the bit of a component.
+         *
+         * @return Bit of the component in loop() results, 0 if it isn't listed.
+         */
+        template <auto &Component, size_t... I>
+        static constexpr uint32_t _bit(std::index_sequence<I...>) {
+            return (0u | ... | (CFSameComponent<Component, Components>::value ? (1u << I) : 0u));
+        }
+
+    public:
+        // Sizes.
+        static constexpr size_t COMPONENTS = sizeof...(Components);             // Components.
+        static constexpr size_t RAM = (0 + ... + sizeof(Components));           // Bytes taken by the components.
+        static constexpr size_t TELEMETRY_KEYS =                                // Telemetry values published.
+                (0 + ... + CFTelemetryKeys<std::remove_reference_t<decltype(Components)>>::value);
+        static constexpr size_t PAYLOAD_SIZE = 2 + TELEMETRY_KEYS * CF_DEVICE_KEY_SIZE;   // Worst case JSON telemetry.
+        static constexpr size_t TELEMETRY_DOC_SIZE =                            // Telemetry document (String keys are copied).
+                JSON_OBJECT_SIZE(TELEMETRY_KEYS) + TELEMETRY_KEYS * CF_DEVICE_KEY_SIZE;
+
+        static_assert(COMPONENTS <= 32, "loop() tells which components updated in 32 bits.");
+
+        // Methods.
+
+        /**
+         * Size the telemetry of the components that take it, then begin every component that has
+         * begin(), in the order they're listed.
+         */
+        static void begin() {
+            (_size(Components, 0), ...);
+            (_begin(Components, 0), ...);
+        }
+
+        /**
+         * Loop every component that has loop(), in the order they're listed.
+         *
+         * @return Bits of the components whose loop() returned true (see bit()).
+         */
+        static uint32_t loop() {
+            return _loopAll(std::make_index_sequence<COMPONENTS>());
+        }
+
+        /**
+         * Loop every component that has loop(), in the order they're listed, each in its
+         * supervisor section. A deferred section skips its component for this loop.
+         *
+         * @param supervisor Loop supervisor (CFLoopSupervisor).
+         * @param sections Section id per component, in the order they're listed (-1 for none).
+         * @return Bits of the components whose loop() returned true (see bit()).
+         */
+        template <typename Supervisor>
+        static uint32_t loop(Supervisor &supervisor, const int (&sections)[COMPONENTS]) {
+            return _superviseAll(supervisor, sections, std::make_index_sequence<COMPONENTS>());
+        }
+
+        /**
+         * Get the bit of a component in loop() results.
+         *
+         * @return Bit of the component, 0 if it isn't listed.
+         */
+        template <auto &Component>
+        static constexpr uint32_t bit() {
+            return _bit<Component>(std::make_index_sequence<COMPONENTS>());
+        }
+
+        /**
+         * Check if a component type is part of the device.
+         *
+         * @return True if any component is a T.
+         */
+        template <typename T>
+        static constexpr bool has() {
+            return (false || ... || std::is_same<std::remove_reference_t<decltype(Components)>, T>::value);
+        }
+};
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * CFHeap.cpp
+ * 
+ * Steady-state heap monitoring for the CF helpers.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFHeap.h>                                                             // CF Heap.
+
+bool CFHeap::_sealed;
+bool CFHeap::_trap;
+uint32_t CFHeap::_freeAtSeal;
+volatile uint32_t CFHeap::_allocations;
+uint8_t CFHeap::_allowed;
+void *CFHeap::_callers[CF_HEAP_CALLERS];
+int CFHeap::_mAllocations = -1;
+int CFHeap::_mAllowed = -1;
+
+#ifdef CF_HEAP_WRAP
+extern "C" {
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    void *__wrap_malloc(size_t size) {
+        CFHeap::record(__builtin_return_address(0));
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t count, size_t size) {
+        CFHeap::record(__builtin_return_address(0));
+        return __real_calloc(count, size);
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size) {
+        CFHeap::record(__builtin_return_address(0));
+        return __real_realloc(ptr, size);
+    }
+}
+#endif
+
+/**
+ * Setup is over. Allocations from now on are counted, or abort when trapping.
+ *
+ * @param trap True to abort on the first allocation.
+ */
+void CFHeap::seal(bool trap) {
+    _mAllocations = CFMetrics::counter("heap_allocs");
+    _mAllowed = CFMetrics::counter("heap_allowed");
+    _freeAtSeal = ESP.getFreeHeap();
+    _allocations = 0;
+    _trap = trap;
+    _sealed = true;
+}
+
+/**
+ * Allow allocations again, e.g. while reconfiguring. Seal again when done.
+ */
+void CFHeap::unseal() {
+    _sealed = false;
+}
+
+/**
+ * Start a section the core allocates in, e.g. a client connecting. Allocations until
+ * disallow() are counted in heap_allowed and don't trap. Sections can nest.
+ */
+void CFHeap::allow() {
+    _allowed++;
+}
+
+/**
+ * End a section started with allow().
+ */
+void CFHeap::disallow() {
+    if (_allowed > 0) {
+        _allowed--;
+    }
+}
+
+/**
+ * Record an allocation. Called by the allocator wrappers, so it must not allocate itself.
+ *
+ * @param caller Return address of the allocation.
+ */
+void CFHeap::record(void *caller) {
+    if (!_sealed) {
+        return;
+    }
+    if (_allowed > 0) {
+        CFMetrics::increment(_mAllowed);
+        return;
+    }
+    if (_trap) {
+        _sealed = false;                                                        // The crash dump may allocate.
+        abort();
+    }
+    _callers[_allocations & (CF_HEAP_CALLERS - 1)] = caller;
+    _allocations = _allocations + 1;
+    CFMetrics::increment(_mAllocations);
+}
+
+/**
+ * Print the last callers that allocated since sealed, most recent first.
+ *
+ * @param out Output (e.g. Serial).
+ */
+void CFHeap::dump(Print &out) {
+    uint32_t allocations = _allocations;
+    uint32_t count = min(allocations, (uint32_t) CF_HEAP_CALLERS);
+    out.print("CFHEAP ");
+    out.print((unsigned long) allocations);
+    out.print(" allocation(s), drift ");
+    out.println(getDrift());
+    for (uint32_t i = 1; i <= count; i++) {
+        out.print("  0x");
+        out.println((unsigned long) _callers[(allocations - i) & (CF_HEAP_CALLERS - 1)], HEX);
+    }
+}
+
+/**
+ * True once sealed.
+ *
+ * @return True if sealed.
+ */
+bool CFHeap::isSealed() {
+    return _sealed;
+}
+
+/**
+ * Get allocations since sealed.
+ *
+ * @return Allocations.
+ */
+uint32_t CFHeap::getAllocations() {
+    return _allocations;
+}
+
+/**
+ * Get free heap lost since sealed. Works without the allocator wrappers.
+ *
+ * @return Bytes (negative if there's more free heap now).
+ */
+long CFHeap::getDrift() {
+    if (_freeAtSeal == 0) {
+        return 0;
+    }
+    return (long) _freeAtSeal - (long) ESP.getFreeHeap();
+}
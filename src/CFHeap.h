@@ -0,0 +1,80 @@
+/**
+ * CFHeap.h
+ * 
+ * Steady-state heap monitoring for the CF helpers.
+ *
+ * Long running devices fail from heap fragmentation, so after setup() nothing should allocate:
+ * helpers reserve their buffers at construction or begin(), and take and return const char *
+ * where a String would allocate. CFHeap::seal() marks the end of setup, from then on:
+ *
+ *      - Every malloc/calloc/realloc is counted (heap_allocs counter) and its caller is kept in
+ *        a small ring, so CFHeap::dump() can print the offenders (decode them with
+ *        xtensa-lx106-elf-addr2line -e firmware.elf).
+ *      - With seal(true), the first allocation aborts, so the crash dump points at the caller.
+ *      - getDrift() tells how much free heap was lost since sealing.
+ *
+ * Counting needs the allocator wrapped at link time, e.g. in platformio.ini:
+ *      build_flags = -DCF_HEAP_WRAP -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+ * Without CF_HEAP_WRAP only getDrift() is available. String, new and ArduinoJson go through
+ * malloc, the network stack (lwIP buffers) doesn't and isn't counted.
+ *
+ * Some allocations belong to the core and can't be avoided: a WiFiClient connecting or
+ * accepted allocates its ClientContext, and WiFiManager's portal works on Strings. Helpers
+ * wrap those in allow() and disallow(), so they're counted in heap_allowed instead and never
+ * trap. Everything else on the steady path (sends, reconnects, history writes and queries,
+ * attribute sync) doesn't allocate, so seal(true) can be used once ThingsBoard is connected.
+ *
+ * Logger takes a String, so every message logged allocates. Helpers log what happens on every
+ * send at VERBOSE (see CFTrace.h), and what the network or the server can cause (reconnects,
+ * failed publishes, unknown RPCs) at NOTICE; WARNING and above are configuration errors. Set
+ * the level to WARNING once sealed. extras/tools/cffleet.py --heap-week runs a device for a
+ * simulated week against faults and fails if heap_allocs isn't 0.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFHeap_h
+#define CFHeap_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <CFMetrics.h>                                                          // CF Metrics.
+
+#ifndef CF_HEAP_CALLERS
+    #define CF_HEAP_CALLERS                 8                                   // Last callers kept. Power of 2.
+#endif
+
+static_assert(CF_HEAP_CALLERS > 0 && (CF_HEAP_CALLERS & (CF_HEAP_CALLERS - 1)) == 0,
+        "CF_HEAP_CALLERS must be a power of 2, callers are kept in a ring indexed with a mask.");
+
+class CFHeap {
+    private:
+        // Attributes.
+        static bool _sealed;                                                    // Setup is over.
+        static bool _trap;                                                      // Abort on allocation once sealed.
+        static uint32_t _freeAtSeal;                                            // Free heap when sealed.
+        static volatile uint32_t _allocations;                                  // Allocations since sealed.
+        static uint8_t _allowed;                                                // Nested allow() calls.
+        static void *_callers[CF_HEAP_CALLERS];                                 // Last callers.
+
+        // Metrics.
+        static int _mAllocations;                                               // Allocations after setup.
+        static int _mAllowed;                                                   // Allocations allowed after setup.
+
+    public:
+        // Methods.
+        static void seal(bool trap = false);                                    // Setup is over, count (or trap) allocations.
+        static void unseal();                                                   // Allow allocations again (e.g. reconfiguration).
+        static void allow();                                                    // Start a section the core allocates in.
+        static void disallow();                                                 // End it.
+        static void record(void *caller);                                       // Record an allocation (allocator wrappers).
+        static void dump(Print &out);                                           // Print last callers.
+
+        // Accessors.
+        static bool isSealed();                                                 // True once sealed.
+        static uint32_t getAllocations();                                       // Get allocations since sealed.
+        static long getDrift();                                                 // Get free heap lost since sealed.
+};
+
+#endif
@@ -0,0 +1,331 @@
+/**
+ * CFHttpsClient.cpp
+ * 
+ * HTTPS client layer shared by the helpers that talk to HTTPS servers.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFHttpsClient.h>                                                      // CF HTTPS Client.
+
+/**
+ * Constructor.
+ */
+CFHttpsClient::CFHttpsClient():
+        _client(), _current(NULL), _fragmentLength(512), _owner(NULL), _tLastActivity(0),
+        _handshakeCount(0), _reuseCount(0), _failureCount(0),
+        _lastHandshakeTime(0), _maxHandshakeTime(0), _totalHandshakeTime(0),
+        _requestCount(0), _lastRequestTime(0), _maxRequestTime(0), _totalRequestTime(0),
+        _tRequest(0) {
+    for (int i = 0; i < CF_HTTPS_SESSION_CACHE_SIZE; i++) {
+        _cache[i].host[0] = '\0';
+        _cache[i].port = 0;
+        _cache[i].mfln = 0;
+        _cache[i].tLastUsed = 0;
+    }
+    _client.setInsecure();
+}
+
+/**
+ * Connect or reuse open connection.
+ *
+ * @param host Host.
+ * @param port Port.
+ * @return True if connected.
+ */
+bool CFHttpsClient::connect(const char *host, uint16_t port) {
+    // Reuse open connection.
+    if (isConnectedTo(host, port)) {
+        _current->tLastUsed = millis();
+        _tLastActivity = millis();
+        _reuseCount++;
+        return true;
+    }
+    stop();
+
+    CachedHost *cached = _getCachedHost(host, port);
+
+    // Probe max fragment length once per host. It costs an extra round trip, but saves
+    // ~15 KB of heap on every connection when supported.
+    if (_fragmentLength > 0 && cached->mfln == 0) {
+        cached->mfln = BearSSL::WiFiClientSecure::probeMaxFragmentLength(host, port, _fragmentLength) ? 1 : -1;
+        CF_LOG_VERBOSE("MFLN " + String(_fragmentLength) + " " + (cached->mfln > 0 ? "supported" : "not supported") + " by " + String(host) + ".");
+    }
+    if (_fragmentLength > 0 && cached->mfln > 0) {
+        _client.setBufferSizes(_fragmentLength, _fragmentLength);
+    } else {
+        _client.setBufferSizes(16384, 512);                                     // BearSSL defaults.
+    }
+
+    // Connect resuming the cached session when there is one.
+    _client.setSession(&cached->session);
+    unsigned long tStart = millis();
+    if (!_client.connect(host, port)) {
+        _failureCount++;
+        return false;
+    }
+    _lastHandshakeTime = millis() - tStart;
+    _maxHandshakeTime = max(_maxHandshakeTime, _lastHandshakeTime);
+    _totalHandshakeTime += _lastHandshakeTime;
+    _handshakeCount++;
+    CF_LOG_VERBOSE("Connected to " + String(host) + " in " + String(_lastHandshakeTime) + " ms.");
+
+    cached->tLastUsed = millis();
+    _tLastActivity = millis();
+    _current = cached;
+    return true;
+}
+
+/**
+ * Find host in cache or take the least recently used slot.
+ *
+ * @param host Host.
+ * @param port Port.
+ * @return Cached host.
+ */
+CFHttpsClient::CachedHost *CFHttpsClient::_getCachedHost(const char *host, uint16_t port) {
+    CachedHost *lru = &_cache[0];
+    for (int i = 0; i < CF_HTTPS_SESSION_CACHE_SIZE; i++) {
+        if (_cache[i].port == port && strcmp(_cache[i].host, host) == 0) {
+            return &_cache[i];
+        }
+        if (_cache[i].tLastUsed < lru->tLastUsed) {
+            lru = &_cache[i];
+        }
+    }
+
+    // Evict.
+    strlcpy(lru->host, host, sizeof(lru->host));
+    lru->port = port;
+    lru->session = BearSSL::Session();
+    lru->mfln = 0;
+    lru->tLastUsed = millis();
+    return lru;
+}
+
+/**
+ * True if connection to host is open.
+ *
+ * @param host Host.
+ * @param port Port.
+ * @return True if connected to host.
+ */
+bool CFHttpsClient::isConnectedTo(const char *host, uint16_t port) {
+    return _current && _current->port == port && strcmp(_current->host, host) == 0 && _client.connected();
+}
+
+/**
+ * True if connection is open.
+ *
+ * @return True if connected.
+ */
+bool CFHttpsClient::connected() {
+    return _current && _client.connected();
+}
+
+/**
+ * Close connection. TLS session stays in the cache.
+ */
+void CFHttpsClient::stop() {
+    _client.stop();
+    _current = NULL;
+}
+
+/**
+ * Take the client for a request. It fails while another helper's request is in progress.
+ *
+ * @param owner Helper taking it.
+ * @return True if it's now owned by the helper.
+ */
+bool CFHttpsClient::acquire(const void *owner) {
+    if (_owner && _owner != owner) {
+        return false;
+    }
+    _owner = owner;
+    return true;
+}
+
+/**
+ * Give the client back once the request is over.
+ *
+ * @param owner Helper giving it back.
+ */
+void CFHttpsClient::release(const void *owner) {
+    if (_owner == owner) {
+        _owner = NULL;
+        _tLastActivity = millis();
+    }
+}
+
+/**
+ * Close connection when nobody is using it and it has been idle for a while.
+ *
+ * @param ttIdle Time an idle connection is kept.
+ */
+void CFHttpsClient::stopIfIdle(unsigned long ttIdle) {
+    if (!_owner && connected() && (millis() - _tLastActivity) > ttIdle) {
+        stop();
+    }
+}
+
+/**
+ * Write data.
+ *
+ * @param buffer Data.
+ * @param size Data size.
+ * @return Bytes written.
+ */
+size_t CFHttpsClient::write(const uint8_t *buffer, size_t size) {
+    return _client.write(buffer, size);
+}
+
+/**
+ * Bytes available to read.
+ *
+ * @return Bytes available.
+ */
+int CFHttpsClient::available() {
+    return _client.available();
+}
+
+/**
+ * Read a byte.
+ *
+ * @return Byte or -1 if there is nothing to read.
+ */
+int CFHttpsClient::read() {
+    return _client.read();
+}
+
+/**
+ * Read bytes.
+ *
+ * @param buffer Buffer.
+ * @param size Buffer size.
+ * @return Bytes read.
+ */
+int CFHttpsClient::read(uint8_t *buffer, size_t size) {
+    return _client.read(buffer, size);
+}
+
+/**
+ * Mark request start (latency metric).
+ */
+void CFHttpsClient::beginRequest() {
+    _tRequest = millis();
+}
+
+/**
+ * Mark request end (latency metric).
+ */
+void CFHttpsClient::endRequest() {
+    _lastRequestTime = millis() - _tRequest;
+    _maxRequestTime = max(_maxRequestTime, _lastRequestTime);
+    _totalRequestTime += _lastRequestTime;
+    _requestCount++;
+}
+
+/**
+ * Define max fragment length.
+ * Valid lengths are 512, 1024, 2048 and 4096. Use 0 to disable the probe.
+ *
+ * @param fragmentLength Max fragment length.
+ */
+void CFHttpsClient::setMaxFragmentLength(uint16_t fragmentLength) {
+    _fragmentLength = fragmentLength;
+    for (int i = 0; i < CF_HTTPS_SESSION_CACHE_SIZE; i++) {
+        _cache[i].mfln = 0;                                                     // Probe again with the new length.
+    }
+}
+
+/**
+ * Get connections opened.
+ *
+ * @return Handshake count.
+ */
+unsigned long CFHttpsClient::getHandshakeCount() {
+    return _handshakeCount;
+}
+
+/**
+ * Get connections reused.
+ *
+ * @return Reuse count.
+ */
+unsigned long CFHttpsClient::getReuseCount() {
+    return _reuseCount;
+}
+
+/**
+ * Get connections failed.
+ *
+ * @return Failure count.
+ */
+unsigned long CFHttpsClient::getFailureCount() {
+    return _failureCount;
+}
+
+/**
+ * Get last handshake time.
+ *
+ * @return Last handshake time (ms).
+ */
+unsigned long CFHttpsClient::getLastHandshakeTime() {
+    return _lastHandshakeTime;
+}
+
+/**
+ * Get max handshake time.
+ *
+ * @return Max handshake time (ms).
+ */
+unsigned long CFHttpsClient::getMaxHandshakeTime() {
+    return _maxHandshakeTime;
+}
+
+/**
+ * Get average handshake time.
+ *
+ * @return Average handshake time (ms).
+ */
+unsigned long CFHttpsClient::getAvgHandshakeTime() {
+    return _handshakeCount > 0 ? _totalHandshakeTime / _handshakeCount : 0;
+}
+
+/**
+ * Get requests completed.
+ *
+ * @return Request count.
+ */
+unsigned long CFHttpsClient::getRequestCount() {
+    return _requestCount;
+}
+
+/**
+ * Get last request time.
+ *
+ * @return Last request time (ms).
+ */
+unsigned long CFHttpsClient::getLastRequestTime() {
+    return _lastRequestTime;
+}
+
+/**
+ * Get max request time.
+ *
+ * @return Max request time (ms).
+ */
+unsigned long CFHttpsClient::getMaxRequestTime() {
+    return _maxRequestTime;
+}
+
+/**
+ * Get average request time.
+ *
+ * @return Average request time (ms).
+ */
+unsigned long CFHttpsClient::getAvgRequestTime() {
+    return _requestCount > 0 ? _totalRequestTime / _requestCount : 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * CFHttpsClient.h
+ * 
+ * HTTPS client layer shared by the helpers that talk to HTTPS servers.
+ *
+ * A full TLS handshake on ESP8266 takes 1-3 s and ~20 KB of heap, so this layer avoids it
+ * whenever it can:
+ *      - The open connection is kept and reused while requests go to the same host.
+ *      - TLS sessions are cached per host (LRU), so reconnecting resumes the session.
+ *      - Max fragment length is probed once per host and, when the server supports it,
+ *        BearSSL buffers are shrunk from 16 KB to the negotiated size.
+ *
+ * Handshake and request latencies are recorded, so the gain can be measured on device.
+ * It handles a single connection. Helpers sharing it take it with acquire() for each request
+ * and give it back with release(), so requests don't overlap and an idle connection is only
+ * closed while nobody is using it.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFHttpsClient_h
+#define CFHttpsClient_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <Logger.h>                                                             // Logger.
+#include <CFTrace.h>                                                           // CF Trace.
+#include <WiFiClientSecure.h>                                                   // WiFiClientSecure (BearSSL).
+
+#ifndef CF_HTTPS_SESSION_CACHE_SIZE
+    #define CF_HTTPS_SESSION_CACHE_SIZE     2                                   // Hosts with cached TLS session.
+#endif
+
+class CFHttpsClient {
+    private:
+        // Cached host.
+        struct CachedHost {
+            char host[64];                                                      // Host.
+            uint16_t port;                                                      // Port.
+            BearSSL::Session session;                                           // TLS session.
+            int8_t mfln;                                                        // Max fragment length support (0 unknown, 1 yes, -1 no).
+            unsigned long tLastUsed;                                            // Last time it was used (LRU).
+        };
+
+        // Attributes.
+        BearSSL::WiFiClientSecure _client;                                      // TLS client.
+        CachedHost _cache[CF_HTTPS_SESSION_CACHE_SIZE];                         // TLS session cache.
+        CachedHost *_current;                                                   // Host of the open connection.
+        uint16_t _fragmentLength;                                               // Requested max fragment length (0 disabled).
+        const void *_owner;                                                     // Helper whose request is in progress (NULL if none).
+        unsigned long _tLastActivity;                                           // Last time the connection was used.
+
+        // Metrics.
+        unsigned long _handshakeCount;                                          // Connections opened.
+        unsigned long _reuseCount;                                              // Connections reused.
+        unsigned long _failureCount;                                            // Connections failed.
+        unsigned long _lastHandshakeTime;                                       // Last handshake time.
+        unsigned long _maxHandshakeTime;                                        // Max handshake time.
+        unsigned long _totalHandshakeTime;                                      // Sum of handshake times.
+        unsigned long _requestCount;                                            // Requests completed.
+        unsigned long _lastRequestTime;                                         // Last request time.
+        unsigned long _maxRequestTime;                                          // Max request time.
+        unsigned long _totalRequestTime;                                        // Sum of request times.
+        unsigned long _tRequest;                                                // Time current request started.
+
+        // Methods.
+        CachedHost *_getCachedHost(const char *host, uint16_t port);            // Find host in cache or take the LRU slot.
+
+    public:
+        // Methods.
+        CFHttpsClient();                                                        // Constructor.
+        bool connect(const char *host, uint16_t port);                          // Connect or reuse open connection.
+        bool isConnectedTo(const char *host, uint16_t port);                    // True if connection to host is open.
+        bool connected();                                                       // True if connection is open.
+        void stop();                                                            // Close connection.
+        bool acquire(const void *owner);                                        // Take the client for a request.
+        void release(const void *owner);                                        // Give the client back.
+        void stopIfIdle(unsigned long ttIdle);                                  // Close connection unused for a while.
+        size_t write(const uint8_t *buffer, size_t size);                       // Write data.
+        int available();                                                        // Bytes available to read.
+        int read();                                                             // Read a byte.
+        int read(uint8_t *buffer, size_t size);                                 // Read bytes.
+        void beginRequest();                                                    // Mark request start (latency metric).
+        void endRequest();                                                      // Mark request end (latency metric).
+
+        // Accessors.
+        void setMaxFragmentLength(uint16_t fragmentLength);                     // Define max fragment length (0 disables).
+        unsigned long getHandshakeCount();                                      // Get connections opened.
+        unsigned long getReuseCount();                                          // Get connections reused.
+        unsigned long getFailureCount();                                        // Get connections failed.
+        unsigned long getLastHandshakeTime();                                   // Get last handshake time.
+        unsigned long getMaxHandshakeTime();                                    // Get max handshake time.
+        unsigned long getAvgHandshakeTime();                                    // Get average handshake time.
+        unsigned long getRequestCount();                                        // Get requests completed.
+        unsigned long getLastRequestTime();                                     // Get last request time.
+        unsigned long getMaxRequestTime();                                      // Get max request time.
+        unsigned long getAvgRequestTime();                                      // Get average request time.
+};
+
+#endif
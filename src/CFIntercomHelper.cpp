@@ -0,0 +1,256 @@
+/**
+ * CFIntercomHelper.cpp
+ * 
+ * A library for Arduino that helps to detect intercom rings.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFIntercomHelper.h>                                                   // CF Intercom Helper.
+
+/**
+ * Constructor (analog mode).
+ *
+ * @param pin Analog pin wired to the intercom line.
+ */
+CFIntercomHelper::CFIntercomHelper(int pin):
+        CFIntercomHelper(pin, ANALOG) {
+    
+}
+
+/**
+ * Constructor with mode.
+ *
+ * Default analog thresholds match a 12 V line scaled into the 10-bit ADC:
+ * on above 7 V (598) and off below 6 V (512).
+ *
+ * @param pin Pin wired to the intercom line.
+ * @param mode Detection mode.
+ */
+CFIntercomHelper::CFIntercomHelper(int pin, Mode mode):
+        _pin(pin), _mode(mode),
+        _thresholdOn(598), _thresholdOff(512), _sampledLevel(false),
+        _head(0), _tail(0), _droppedEdges(0),
+        _level(false), _active(false), _confirmed(false),
+        _ringStart(0), _lowSince(0), _ringCount(0), _lastRingDuration(0),
+        _ttSample(5), _tLastSample(0), _debounce(300), _minDuration(50),
+        _onRingCallback(NULL), _onRingEndCallback(NULL) {
+    
+}
+
+/**
+ * Initial setup.
+ */
+void CFIntercomHelper::begin() {
+    if (_mode == INTERRUPT) {
+        pinMode(_pin, INPUT);
+        _pushEdge(digitalRead(_pin), millis());                                 // Line may already be on. Before the ISR, the only producer.
+        attachInterruptArg(digitalPinToInterrupt(_pin), _isr, this, CHANGE);
+    }
+}
+
+/**
+ * Loop.
+ */
+void CFIntercomHelper::loop() {
+    if (_mode == ANALOG) {
+        _sample();
+    }
+    _processEdges();
+}
+
+/**
+ * Pin change interrupt.
+ *
+ * @param arg Helper instance.
+ */
+void IRAM_ATTR CFIntercomHelper::_isr(void *arg) {
+    CFIntercomHelper *intercom = (CFIntercomHelper *) arg;
+    intercom->_pushEdge(digitalRead(intercom->_pin), millis());
+}
+
+/**
+ * Queue an edge.
+ * Only the producer (ISR or analog sampler) moves the head, so no lock is needed.
+ *
+ * @param level Line level after the edge.
+ * @param time Edge time.
+ */
+void IRAM_ATTR CFIntercomHelper::_pushEdge(bool level, uint32_t time) {
+    uint8_t next = (_head + 1) & (CF_INTERCOM_QUEUE_SIZE - 1);
+    if (next == _tail) {
+        _droppedEdges++;
+        return;
+    }
+    _edgeTime[_head] = time;
+    _edgeLevel[_head] = level;
+    _head = next;                                                               // Publish only after the slot is written.
+}
+
+/**
+ * Sample analog line.
+ * Integer thresholds with hysteresis, so a noisy line around a single threshold doesn't chatter.
+ */
+void CFIntercomHelper::_sample() {
+    if (_tLastSample == 0 || (millis() - _tLastSample) >= _ttSample) {
+        _tLastSample = millis();
+
+        int value = analogRead(_pin);
+        bool level = _sampledLevel ? (value > _thresholdOff) : (value >= _thresholdOn);
+        if (level != _sampledLevel) {
+            _sampledLevel = level;
+            _pushEdge(level, _tLastSample);
+        }
+    }
+}
+
+/**
+ * Group queued edges into rings.
+ */
+void CFIntercomHelper::_processEdges() {
+    // Drain the queue. Only the consumer moves the tail.
+    while (_tail != _head) {
+        uint32_t time = _edgeTime[_tail];
+        bool level = _edgeLevel[_tail];
+        _tail = (_tail + 1) & (CF_INTERCOM_QUEUE_SIZE - 1);
+
+        if (level == _level) {
+            continue;
+        }
+        _level = level;
+        if (level) {
+            if (!_active) {
+                // New ring candidate.
+                _active = true;
+                _confirmed = false;
+                _ringStart = time;
+            }
+        } else {
+            _lowSince = time;
+        }
+    }
+
+    if (!_active) {
+        return;
+    }
+
+    // Confirm the ring once it lasts longer than the minimum duration.
+    unsigned long now = millis();
+    if (!_confirmed && ((_level ? now : _lowSince) - _ringStart) >= _minDuration) {
+        _confirmed = true;
+        _ringCount++;
+        Logger::notice("Ring detected.");
+        if (_onRingCallback) {
+            _onRingCallback();
+        }
+    }
+
+    // End the ring once the line is idle longer than the debounce time.
+    if (!_level && (now - _lowSince) >= _debounce) {
+        _active = false;
+        if (_confirmed) {
+            _lastRingDuration = _lowSince - _ringStart;
+            CF_TRACE_EVENT(CFTrace::INTERCOM_RING, _ringCount, _lastRingDuration);
+            if (_onRingEndCallback) {
+                _onRingEndCallback(_lastRingDuration);
+            }
+        }
+    }
+}
+
+/**
+ * Define analog hysteresis thresholds.
+ * If the on threshold is less than the off threshold it will keep the previous values.
+ *
+ * @param thresholdOn Raw value that turns the line on.
+ * @param thresholdOff Raw value that turns the line off.
+ */
+void CFIntercomHelper::setThresholds(int thresholdOn, int thresholdOff) {
+    if (thresholdOn >= thresholdOff) {
+        _thresholdOn = thresholdOn;
+        _thresholdOff = thresholdOff;
+    }
+}
+
+/**
+ * Define time between analog samples.
+ *
+ * @param ttSample Time between samples.
+ */
+void CFIntercomHelper::setSamplingInterval(unsigned long ttSample) {
+    _ttSample = ttSample;
+}
+
+/**
+ * Define idle time that ends a ring.
+ *
+ * @param debounce Idle time.
+ */
+void CFIntercomHelper::setDebounce(unsigned long debounce) {
+    _debounce = debounce;
+}
+
+/**
+ * Define minimum ring duration.
+ *
+ * @param minDuration Minimum ring duration.
+ */
+void CFIntercomHelper::setMinRingDuration(unsigned long minDuration) {
+    _minDuration = minDuration;
+}
+
+/**
+ * True while a ring is in progress.
+ *
+ * @return True if it's ringing.
+ */
+bool CFIntercomHelper::isRinging() {
+    return _active && _confirmed;
+}
+
+/**
+ * Get rings detected since begin.
+ *
+ * @return Ring count.
+ */
+unsigned long CFIntercomHelper::getRingCount() {
+    return _ringCount;
+}
+
+/**
+ * Get duration of the last ring.
+ *
+ * @return Last ring duration.
+ */
+unsigned long CFIntercomHelper::getLastRingDuration() {
+    return _lastRingDuration;
+}
+
+/**
+ * Get edges lost by a full queue.
+ *
+ * @return Dropped edges.
+ */
+unsigned long CFIntercomHelper::getDroppedEdges() {
+    return _droppedEdges;
+}
+
+/**
+ * Define on ring callback.
+ *
+ * @param callback Callback.
+ */
+void CFIntercomHelper::setOnRingCallback(VoidCallback callback) {
+    _onRingCallback = callback;
+}
+
+/**
+ * Define on ring end callback.
+ *
+ * @param callback Callback that receives the ring duration.
+ */
+void CFIntercomHelper::setOnRingEndCallback(RingCallback callback) {
+    _onRingEndCallback = callback;
+}
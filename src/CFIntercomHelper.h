@@ -0,0 +1,109 @@
+/**
+ * CFIntercomHelper.h
+ * 
+ * A library for Arduino that helps to detect intercom rings.
+ *
+ * Modes:
+ *      ANALOG      The intercom line is sampled through the ADC with hysteresis (e.g. A0 on ESP8266).
+ *      INTERRUPT   A comparator (or opto-coupler) output is wired to a digital pin and every edge
+ *                  is caught by an interrupt, so short rings can't be missed between polls.
+ *
+ * In both modes edges are timestamped into a lock-free queue (single producer, single consumer)
+ * and grouped into rings in loop(): a ring ends when the line stays idle longer than the debounce
+ * time, and rings shorter than the minimum duration are discarded as noise.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFIntercomHelper_h
+#define CFIntercomHelper_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <Logger.h>                                                             // Logger.
+#include <CFTrace.h>                                                           // CF Trace.
+
+#ifndef CF_INTERCOM_QUEUE_SIZE
+    #define CF_INTERCOM_QUEUE_SIZE      16                                      // Edge queue size. Must be a power of two.
+#endif
+
+static_assert(CF_INTERCOM_QUEUE_SIZE > 0 && CF_INTERCOM_QUEUE_SIZE <= 256
+        && (CF_INTERCOM_QUEUE_SIZE & (CF_INTERCOM_QUEUE_SIZE - 1)) == 0,
+        "CF_INTERCOM_QUEUE_SIZE must be a power of 2 up to 256, the queue is indexed with a mask in 8 bits.");
+
+class CFIntercomHelper {
+    public:
+        // Detection modes.
+        enum Mode {
+            ANALOG,                                                             // Sampled ADC with hysteresis.
+            INTERRUPT                                                           // Digital pin edge interrupt.
+        };
+
+    private:
+        // Aliases.
+        using VoidCallback = void (*)();                                        // Alias for callback.
+        using RingCallback = void (*)(unsigned long duration);                  // Alias for ring end callback.
+
+        // Attributes.
+        int _pin;                                                               // Pin wired to the intercom line.
+        Mode _mode;                                                             // Detection mode.
+        int _thresholdOn;                                                       // Raw value that turns the line on (analog).
+        int _thresholdOff;                                                      // Raw value that turns the line off (analog).
+        bool _sampledLevel;                                                     // Last level after hysteresis (analog).
+
+        // Edge queue (ISR to loop).
+        volatile uint32_t _edgeTime[CF_INTERCOM_QUEUE_SIZE];                    // Edge timestamps (ms).
+        volatile bool _edgeLevel[CF_INTERCOM_QUEUE_SIZE];                       // Edge levels.
+        volatile uint8_t _head;                                                 // Write position (producer).
+        volatile uint8_t _tail;                                                 // Read position (consumer).
+        volatile unsigned long _droppedEdges;                                   // Edges lost because the queue was full.
+
+        // Ring state.
+        bool _level;                                                            // Current line level.
+        bool _active;                                                           // A ring candidate is in progress.
+        bool _confirmed;                                                        // The candidate passed the minimum duration.
+        unsigned long _ringStart;                                               // Time the ring started.
+        unsigned long _lowSince;                                                // Time the line went idle.
+        unsigned long _ringCount;                                               // Rings detected since begin.
+        unsigned long _lastRingDuration;                                        // Duration of the last ring.
+
+        // Loop control.
+        unsigned long _ttSample;                                                // Time between samples (analog).
+        unsigned long _tLastSample;                                             // Last time line was sampled.
+        unsigned long _debounce;                                                // Idle time that ends a ring.
+        unsigned long _minDuration;                                             // Minimum ring duration.
+
+        // Callbacks.
+        VoidCallback _onRingCallback;                                           // On ring callback.
+        RingCallback _onRingEndCallback;                                        // On ring end callback.
+
+        // Methods.
+        void _pushEdge(bool level, uint32_t time);                              // Queue an edge.
+        void _sample();                                                         // Sample analog line.
+        void _processEdges();                                                   // Group queued edges into rings.
+        static void _isr(void *arg);                                            // Pin change interrupt.
+
+    public:
+        // Constructors.
+        CFIntercomHelper(int pin);                                              // Constructor (analog mode).
+        CFIntercomHelper(int pin, Mode mode);                                   // Constructor with mode.
+
+        // Methods.
+        void begin();                                                           // Initial setup.
+        void loop();                                                            // Loop.
+
+        // Accessors.
+        void setThresholds(int thresholdOn, int thresholdOff);                  // Define analog hysteresis thresholds.
+        void setSamplingInterval(unsigned long ttSample);                       // Define time between analog samples.
+        void setDebounce(unsigned long debounce);                               // Define idle time that ends a ring.
+        void setMinRingDuration(unsigned long minDuration);                     // Define minimum ring duration.
+        bool isRinging();                                                       // True while a ring is in progress.
+        unsigned long getRingCount();                                           // Get rings detected since begin.
+        unsigned long getLastRingDuration();                                    // Get duration of the last ring.
+        unsigned long getDroppedEdges();                                        // Get edges lost by a full queue.
+        void setOnRingCallback(const VoidCallback);                             // Define on ring callback.
+        void setOnRingEndCallback(const RingCallback);                          // Define on ring end callback.
+};
+
+#endif
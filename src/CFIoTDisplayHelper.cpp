@@ -21,8 +21,15 @@
 CFIoTDisplayHelper::CFIoTDisplayHelper(int width, int height, int addr):
         _display(width, height, &Wire, -1),
         _width(width), _height(height), _address(addr),
-        _showLogo(true), _logoTime(3000) {
-    
+        _showLogo(true), _logoTime(3000),
+        _front(nullptr), _dirtyPages(0), _flushOffset(0), _pending(false), _maxFlushTime(0),
+        _cols(min(width / CF_DISPLAY_CELL_WIDTH, CF_DISPLAY_MAX_COLS)),
+        _rows(min(height / 8, CF_DISPLAY_MAX_ROWS)) {
+    memset(_glyphs, 0, sizeof(_glyphs));
+    memset(_cells, 0, sizeof(_cells));
+    memset(_drawnCells, 0, sizeof(_drawnCells));
+    memset(_touchedCells, 0, sizeof(_touchedCells));
+    _mMaxFlushTime = CFMetrics::gauge("disp_flush_us");
 }
 
 /**
@@ -50,20 +57,193 @@ void CFIoTDisplayHelper::begin() {
     _display.cp437(true);
     _display.setTextSize(1);
     _display.setTextColor(WHITE);
+
+    // Rasterize printable characters once, straight from the Adafruit font.
+    for (int c = CF_DISPLAY_GLYPH_FIRST; c <= CF_DISPLAY_GLYPH_LAST; c++) {
+        _display.drawChar(0, 0, c, WHITE, BLACK, 1);
+        memcpy(_glyphs[c - CF_DISPLAY_GLYPH_FIRST], _display.getBuffer(), 5);
+    }
+    _display.clearDisplay();
+}
+
+/**
+ * Stream the front buffer to the panel, at most CF_DISPLAY_FLUSH_BYTES per call. Call it every
+ * loop in double buffered mode.
+ */
+void CFIoTDisplayHelper::loop() {
+    if (!_dirtyPages) {
+        return;
+    }
+    unsigned long tFlush = micros();
+    Wire.setClock(CF_DISPLAY_I2C_CLOCK);
+    int budget = CF_DISPLAY_FLUSH_BYTES;
+    while (budget > 0 && _dirtyPages) {
+        uint8_t page = __builtin_ctz(_dirtyPages);
+        if (_flushOffset == 0) {
+            _setWindow(page);
+        }
+
+        // Send a chunk of the page.
+        int length = min(min(budget, _width - _flushOffset), CF_DISPLAY_I2C_CHUNK);
+        Wire.beginTransmission(_address);
+        Wire.write((uint8_t) 0x40);                                             // Co = 0, D/C = 1: data.
+        Wire.write(_front + page * _width + _flushOffset, length);
+        Wire.endTransmission();
+        _flushOffset += length;
+        budget -= length;
+
+        // Next page, and the waiting frame once every page is sent.
+        if (_flushOffset >= _width) {
+            _flushOffset = 0;
+            _dirtyPages &= ~(1 << page);
+            if (!_dirtyPages && _pending) {
+                _swap();
+            }
+        }
+    }
+    Wire.setClock(CF_DISPLAY_I2C_CLOCK_IDLE);
+
+    unsigned long elapsed = micros() - tFlush;
+    if (elapsed > _maxFlushTime) {
+        _maxFlushTime = elapsed;
+        CFMetrics::set(_mMaxFlushTime, elapsed);
+    }
 }
 
 /**
- * Render display.
+ * Render display. In double buffered mode it swaps and returns right away, see swap().
  */
 void CFIoTDisplayHelper::display() {
-    _display.display();
+    if (_front) {
+        swap();
+    } else {
+        _expire();
+        _display.display();
+    }
+}
+
+/**
+ * Show what has been drawn into the back buffer. In double buffered mode changed pages are sent
+ * by next loop() calls; while a flush is running, the frame waits for it to end.
+ *
+ * @return True if the frame is being shown, false if it's waiting.
+ */
+bool CFIoTDisplayHelper::swap() {
+    _expire();
+    if (!_front) {
+        _display.display();
+        return true;
+    }
+    if (_dirtyPages) {
+        _pending = true;
+        return false;
+    }
+    _swap();
+    return true;
+}
+
+/**
+ * Copy pages that differ from the front buffer and mark them to be sent.
+ */
+void CFIoTDisplayHelper::_swap() {
+    uint8_t *back = _display.getBuffer();
+    for (int page = 0; page < _height / 8; page++) {
+        size_t offset = page * _width;
+        if (memcmp(_front + offset, back + offset, _width) != 0) {
+            memcpy(_front + offset, back + offset, _width);
+            _dirtyPages |= 1 << page;
+        }
+    }
+    _flushOffset = 0;
+    _pending = false;
+}
+
+/**
+ * Point panel RAM at the start of a page, so data fills the page left to right.
+ *
+ * @param page Page (8 rows each).
+ */
+void CFIoTDisplayHelper::_setWindow(uint8_t page) {
+    Wire.beginTransmission(_address);
+    Wire.write((uint8_t) 0x00);                                                 // Co = 0, D/C = 0: commands.
+    Wire.write((uint8_t) SSD1306_PAGEADDR);
+    Wire.write(page);
+    Wire.write(page);
+    Wire.write((uint8_t) SSD1306_COLUMNADDR);
+    Wire.write((uint8_t) 0);
+    Wire.write((uint8_t) (_width - 1));
+    Wire.endTransmission();
+}
+
+/**
+ * Enable double buffered mode. The front buffer is allocated once and starts as what the panel
+ * shows now.
+ *
+ * @param doubleBuffered True to enable.
+ * @return False if the front buffer can't be allocated.
+ */
+bool CFIoTDisplayHelper::setDoubleBuffered(bool doubleBuffered) {
+    if (!doubleBuffered) {
+        if (_front) {
+            _display.display();
+        }
+        free(_front);
+        _front = nullptr;
+        _dirtyPages = 0;
+        _pending = false;
+        return true;
+    }
+    if (!_front) {
+        _front = (uint8_t *) malloc(_width * _height / 8);
+        if (!_front) {
+            Logger::error("Display front buffer allocation failed.");
+            return false;
+        }
+        memcpy(_front, _display.getBuffer(), _width * _height / 8);
+        _display.display();
+    }
+    return true;
+}
+
+/**
+ * True if front buffer is being sent.
+ *
+ * @return True if there are pages to be sent.
+ */
+bool CFIoTDisplayHelper::isFlushing() {
+    return _dirtyPages != 0;
+}
+
+/**
+ * Get longest loop() spent on display I/O. With the defaults it's about 3 ms at 400 kHz.
+ *
+ * @return Time (us).
+ */
+unsigned long CFIoTDisplayHelper::getMaxFlushTime() {
+    return _maxFlushTime;
 }
 
 /**
- * Clear display.
+ * Clear display. Cells holding only a character are kept until display(), so printing the same
+ * character there again costs nothing.
  */
 void CFIoTDisplayHelper::clearDisplay() {
-    _display.clearDisplay();
+    uint8_t *buffer = _display.getBuffer();
+    for (int row = 0; row < _height / 8; row++) {
+        uint8_t *page = buffer + row * _width;
+        if (row >= _rows) {
+            memset(page, 0, _width);
+            continue;
+        }
+        for (int col = 0; col < _cols; col++) {
+            if (!_cells[row][col]) {
+                memset(page + col * CF_DISPLAY_CELL_WIDTH, 0, CF_DISPLAY_CELL_WIDTH);
+            }
+        }
+        memset(page + _cols * CF_DISPLAY_CELL_WIDTH, 0, _width - _cols * CF_DISPLAY_CELL_WIDTH);
+        _drawnCells[row] = 0;
+        _touchedCells[row] = 0;
+    }
 }
 
 /**
@@ -82,7 +262,129 @@ void CFIoTDisplayHelper::setCursor(int col, int lin) {
  * @param text Text.
  */
 void CFIoTDisplayHelper::print(String text) {
-    _display.print(text);
+    print(text.c_str());
+}
+
+/**
+ * Print what should be rendered.
+ *
+ * @param text Text.
+ */
+void CFIoTDisplayHelper::print(const char *text) {
+    int x = _display.getCursorX();
+    int y = _display.getCursorY();
+    for (const char *c = text; *c; c++) {
+        if (*c == '\n') {
+            x = 0;
+            y += 8;
+            continue;
+        }
+        if (*c == '\r') {
+            continue;
+        }
+        if (x + CF_DISPLAY_CELL_WIDTH > _width) {                               // Wrap, like Adafruit GFX.
+            x = 0;
+            y += 8;
+        }
+        _drawChar(*c, x, y);
+        x += CF_DISPLAY_CELL_WIDTH;
+    }
+    _display.setCursor(x, y);
+}
+
+/**
+ * Draw a character. Printable characters on a page row are OR'ed into the buffer (transparent
+ * background, as Adafruit GFX draws with a single text color); the rest goes through Adafruit GFX.
+ *
+ * @param c Character.
+ * @param x Column.
+ * @param y Line.
+ */
+void CFIoTDisplayHelper::_drawChar(uint8_t c, int x, int y) {
+    if (c < CF_DISPLAY_GLYPH_FIRST || c > CF_DISPLAY_GLYPH_LAST || x < 0 || y < 0
+            || y % 8 != 0 || y + 8 > _height) {
+        _touch(x, y, CF_DISPLAY_CELL_WIDTH, 8);
+        _display.drawChar(x, y, c, WHITE, WHITE, 1);
+        return;
+    }
+    uint8_t *dst = _display.getBuffer() + (y / 8) * _width + x;
+    const uint8_t *glyph = _glyphs[c - CF_DISPLAY_GLYPH_FIRST];
+    int row = y / 8;
+    int col = x / CF_DISPLAY_CELL_WIDTH;
+    if (x % CF_DISPLAY_CELL_WIDTH == 0 && col < _cols) {
+        uint32_t bit = 1UL << col;
+        if (!((_drawnCells[row] | _touchedCells[row]) & bit)) {
+            // First thing in the cell this frame.
+            if (_cells[row][col] == c) {
+                _drawnCells[row] |= bit;
+                return;
+            }
+            if (_cells[row][col]) {
+                memset(dst, 0, CF_DISPLAY_CELL_WIDTH);
+            }
+            memcpy(dst, glyph, 5);
+            _cells[row][col] = c;
+        } else {
+            // Over something else, the cell isn't a single character anymore.
+            for (int i = 0; i < 5; i++) {
+                dst[i] |= glyph[i];
+            }
+            _cells[row][col] = 0;
+        }
+        _drawnCells[row] |= bit;
+        return;
+    }
+
+    // Off the cell grid, still byte aligned.
+    _touch(x, y, CF_DISPLAY_CELL_WIDTH, 8);
+    for (int i = 0; i < 5 && x + i < _width; i++) {
+        dst[i] |= glyph[i];
+    }
+}
+
+/**
+ * Mark cells under drawing other than printed text. A character kept from last frame is erased
+ * first, what was drawn this frame stays.
+ *
+ * @param x Column.
+ * @param y Line.
+ * @param w Width.
+ * @param h Height.
+ */
+void CFIoTDisplayHelper::_touch(int x, int y, int w, int h) {
+    int firstRow = max(y, 0) / 8;
+    int lastRow = min((y + h - 1) / 8, _rows - 1);
+    int firstCol = max(x, 0) / CF_DISPLAY_CELL_WIDTH;
+    int lastCol = min((x + w - 1) / CF_DISPLAY_CELL_WIDTH, _cols - 1);
+    if (x + w <= 0 || y + h <= 0) {
+        return;
+    }
+    uint8_t *buffer = _display.getBuffer();
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int col = firstCol; col <= lastCol; col++) {
+            uint32_t bit = 1UL << col;
+            if (_cells[row][col] && !(_drawnCells[row] & bit)) {
+                memset(buffer + row * _width + col * CF_DISPLAY_CELL_WIDTH, 0, CF_DISPLAY_CELL_WIDTH);
+            }
+            _cells[row][col] = 0;
+            _touchedCells[row] |= bit;
+        }
+    }
+}
+
+/**
+ * Erase characters kept by clearDisplay() that haven't been printed again.
+ */
+void CFIoTDisplayHelper::_expire() {
+    uint8_t *buffer = _display.getBuffer();
+    for (int row = 0; row < _rows; row++) {
+        for (int col = 0; col < _cols; col++) {
+            if (_cells[row][col] && !(_drawnCells[row] & (1UL << col))) {
+                memset(buffer + row * _width + col * CF_DISPLAY_CELL_WIDTH, 0, CF_DISPLAY_CELL_WIDTH);
+                _cells[row][col] = 0;
+            }
+        }
+    }
 }
 
 /**
@@ -96,5 +398,6 @@ void CFIoTDisplayHelper::print(String text) {
  * @param color Color.
  */
 void CFIoTDisplayHelper::drawBitmap(int x, int y, const unsigned char bmap[], int w, int h, int color) {
+    _touch(x, y, w, h);
     _display.drawBitmap(x, y, bmap, w, h, color);
 }
\ No newline at end of file
@@ -2,6 +2,25 @@
  * CFIoTDisplayHelper.h
  * 
  * A library for Arduino that helps to print display for CF IoT devices.
+ *
+ * display() sends the whole frame over I2C and blocks until it's done, 1 KB for 128x64. In
+ * double buffered mode the app keeps drawing into the back buffer (the Adafruit one) and
+ * display() only swaps: changed pages are copied into the front buffer and loop() streams them
+ * to the panel, at most CF_DISPLAY_FLUSH_BYTES per call. A swap while a flush is running is
+ * kept and taken from the back buffer when the flush ends, so draw whole frames between loop()
+ * calls. The flush runs from loop() and not from an interrupt: ESP8266 Wire isn't interrupt safe.
+ *
+ *      _display.begin();
+ *      _display.setDoubleBuffered(true);
+ *      ...
+ *      _display.loop();                                                        // Every loop.
+ *
+ * Text is written straight into the page buffer when the cursor row is a multiple of 8: glyph
+ * columns are already in SSD1306 page format, rasterized once from the Adafruit font by begin().
+ * Text on a 6x8 cell grid is remembered per cell, so clearDisplay() keeps cells holding only
+ * text and print() skips those that get the same character again; cells not printed again are
+ * erased on display(). Other rows, and characters outside printable ASCII, go through Adafruit
+ * GFX as before.
  * 
  * @author  Caio Frota <caiofrota@gmail.com>
  * @version 1.0
@@ -16,6 +35,25 @@
 #include <Adafruit_GFX.h>                                                       // Adafruit GFX.
 #include <Adafruit_SSD1306.h>                                                   // Adafruit display.
 #include <Wire.h>                                                               // Wire.
+#include <CFMetrics.h>                                                          // CF Metrics.
+
+#ifndef CF_DISPLAY_FLUSH_BYTES
+    #define CF_DISPLAY_FLUSH_BYTES          128                                 // Max bytes sent to the panel per loop().
+#endif
+
+#ifdef BUFFER_LENGTH
+    #define CF_DISPLAY_I2C_CHUNK            (BUFFER_LENGTH - 1)                 // Data bytes per I2C transmission.
+#else
+    #define CF_DISPLAY_I2C_CHUNK            31                                  // Data bytes per I2C transmission.
+#endif
+#define CF_DISPLAY_I2C_CLOCK                400000                              // I2C clock while flushing.
+#define CF_DISPLAY_I2C_CLOCK_IDLE           100000                              // I2C clock restored after flushing.
+
+#define CF_DISPLAY_CELL_WIDTH               6                                   // Text cell width (5 + spacing).
+#define CF_DISPLAY_MAX_COLS                 21                                  // Text cells per row (128 / 6).
+#define CF_DISPLAY_MAX_ROWS                 8                                   // Text rows (64 / 8).
+#define CF_DISPLAY_GLYPH_FIRST              32                                  // First rasterized character.
+#define CF_DISPLAY_GLYPH_LAST               126                                 // Last rasterized character.
 
 class CFIoTDisplayHelper {
     private:
@@ -27,16 +65,46 @@ class CFIoTDisplayHelper {
         bool _showLogo;                                                         // Flag that indicates if it's to show the logo.
         unsigned long _logoTime;                                                // Time that will show the logo.
 
+        // Double buffer attributes.
+        uint8_t *_front;                                                        // Front buffer, being sent (nullptr if single buffered).
+        uint8_t _dirtyPages;                                                    // Pages of the front buffer not sent yet.
+        int _flushOffset;                                                       // Bytes of the current page already sent.
+        bool _pending;                                                          // Flag that indicates a swap is waiting the flush.
+        unsigned long _maxFlushTime;                                            // Longest loop() spent on display I/O (us).
+
+        // Text attributes.
+        uint8_t _glyphs[CF_DISPLAY_GLYPH_LAST - CF_DISPLAY_GLYPH_FIRST + 1][5]; // Glyph columns, in page format.
+        uint8_t _cells[CF_DISPLAY_MAX_ROWS][CF_DISPLAY_MAX_COLS];               // Character each cell holds alone (0 if none).
+        uint32_t _drawnCells[CF_DISPLAY_MAX_ROWS];                              // Cells printed since clearDisplay().
+        uint32_t _touchedCells[CF_DISPLAY_MAX_ROWS];                            // Cells drawn over by anything else.
+        int _cols;                                                              // Text cells per row.
+        int _rows;                                                              // Text rows.
+
+        // Metrics.
+        int _mMaxFlushTime;                                                     // Longest loop() spent on display I/O (us).
+
+        // Methods.
+        void _swap();                                                           // Copy changed pages into the front buffer.
+        void _setWindow(uint8_t page);                                          // Point panel RAM at the start of a page.
+        void _drawChar(uint8_t c, int x, int y);                                // Draw a character.
+        void _touch(int x, int y, int w, int h);                                // Mark cells under other drawing.
+        void _expire();                                                         // Erase cells not printed again.
+
     public:
         CFIoTDisplayHelper(int width, int height, int addr);                    // Constructor.
         void begin();                                                           // Initialize.
+        void loop();                                                            // Stream front buffer (double buffered mode).
         void display();                                                         // Render display.
+        bool swap();                                                            // Show back buffer (double buffered mode).
+        bool setDoubleBuffered(bool doubleBuffered);                            // Enable double buffered mode.
+        bool isFlushing();                                                      // True if front buffer is being sent.
+        unsigned long getMaxFlushTime();                                        // Get longest loop() spent on display I/O (us).
         void clearDisplay();                                                    // Clear display.
         void setCursor(int col, int lin);                                       // Set cursor position.
         void print(String text);                                                // Print what should be rendered.
+        void print(const char *text);                                           // Print what should be rendered without allocating.
         void drawBitmap(int x, int y, const unsigned char bmap[],               // Draw bitmap.
                 int w, int h, int color);
-
 };
 
 #endif
\ No newline at end of file
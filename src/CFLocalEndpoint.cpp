@@ -0,0 +1,522 @@
+/**
+ * CFLocalEndpoint.cpp
+ *
+ * Local HTTP endpoint with current readings and device metrics.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFLocalEndpoint.h>                                                    // CF Local Endpoint.
+
+static const char *const CONTENT_TYPES[] = {
+    "application/json",
+    "text/plain; version=0.0.4",
+    "application/json",
+    "text/plain"
+};
+
+/**
+ * Constructor.
+ */
+CFLocalEndpoint::CFLocalEndpoint():
+        _readingCount(0), _version(1), _ttRender(1000), _timeSeries(nullptr),
+        _mRequests(CFMetrics::counter("lan_requests")),
+        _mRejected(CFMetrics::counter("lan_rejected")) {
+    for (int i = 0; i < CF_ENDPOINT_MAX_CLIENTS; i++) {
+        _slots[i].state = FREE;
+    }
+    memset(_readings, 0, sizeof(_readings));
+    memset(_lengths, 0, sizeof(_lengths));
+    memset(_versions, 0, sizeof(_versions));
+    memset(_tRendered, 0, sizeof(_tRendered));
+}
+
+/**
+ * Serve clients. Accepts at most one new client per call and never waits on a socket.
+ *
+ * @param server Started server.
+ */
+void CFLocalEndpoint::loop(WiFiServer &server) {
+    _accept(server);
+    for (int i = 0; i < CF_ENDPOINT_MAX_CLIENTS; i++) {
+        Slot &slot = _slots[i];
+        if (slot.state == FREE) {
+            continue;
+        }
+        if (!slot.client.connected() || millis() - slot.tStart > CF_ENDPOINT_TIMEOUT) {
+            _close(slot, true);
+            continue;
+        }
+        if (slot.state == READING) {
+            _read(slot);
+        }
+        if (slot.state == WRITING) {
+            _write(slot);
+        }
+    }
+}
+
+/**
+ * Accept a new client into a free slot. Without one, the client is closed right away.
+ *
+ * @param server Started server.
+ */
+void CFLocalEndpoint::_accept(WiFiServer &server) {
+    CFHeap::allow();                                                            // The core allocates the connection.
+    WiFiClient client = server.available();
+    CFHeap::disallow();
+    if (!client) {
+        return;
+    }
+    for (int i = 0; i < CF_ENDPOINT_MAX_CLIENTS; i++) {
+        Slot &slot = _slots[i];
+        if (slot.state == FREE) {
+            slot.client = client;
+            slot.client.setNoDelay(true);
+            slot.state = READING;
+            slot.tail = 0;
+            slot.tStart = millis();
+            slot.length = 0;
+            slot.sent = 0;
+            return;
+        }
+    }
+    CFMetrics::increment(_mRejected);
+    client.abort();
+}
+
+/**
+ * Read what arrived of the request. The first line is kept, the rest is only scanned for the
+ * end of the header.
+ *
+ * @param slot Client slot.
+ */
+void CFLocalEndpoint::_read(Slot &slot) {
+    while (slot.client.available() > 0) {
+        int c = slot.client.read();
+        if (c < 0) {
+            return;
+        }
+        slot.tail = (slot.tail << 8) | (uint8_t) c;
+        if (slot.length < sizeof(slot.buffer) - 1 && !memchr(slot.buffer, '\n', slot.length)) {
+            slot.buffer[slot.length++] = c;
+        }
+        if (slot.tail == 0x0D0A0D0A || (slot.tail & 0xFFFF) == 0x0A0A) {
+            slot.buffer[slot.length] = '\0';
+            _respond(slot);
+            return;
+        }
+    }
+}
+
+/**
+ * Pick the response from the request line and write its header into the slot buffer.
+ *
+ * @param slot Client slot.
+ */
+void CFLocalEndpoint::_respond(Slot &slot) {
+    const char *path = nullptr;
+    if (strncmp(slot.buffer, "GET ", 4) == 0) {
+        path = slot.buffer + 4;
+    }
+    if (path && strncmp(path, "/metrics", 8) == 0 && (path[8] == ' ' || path[8] == '?')) {
+        slot.format = PROMETHEUS;
+    } else if (path && (strncmp(path, "/ ", 2) == 0 || strncmp(path, "/data.json ", 11) == 0)) {
+        slot.format = JSON;
+    } else if (path && strncmp(path, "/history", 8) == 0 && (path[8] == ' ' || path[8] == '?')
+            && _parseHistory(slot, path)) {
+        slot.format = HISTORY;
+    } else {
+        slot.format = NOT_FOUND;
+    }
+
+    // History length isn't known ahead, it ends when the connection closes.
+    int length;
+    if (slot.format == HISTORY) {
+        length = snprintf(slot.buffer, sizeof(slot.buffer),
+                "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nConnection: close\r\n\r\n", CONTENT_TYPES[HISTORY]);
+    } else {
+        size_t bodyLength = 0;
+        if (slot.format != NOT_FOUND) {
+            _render(slot.format);
+            bodyLength = _lengths[slot.format];
+        }
+        length = snprintf(slot.buffer, sizeof(slot.buffer),
+                "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+                slot.format == NOT_FOUND ? "404 Not Found" : "200 OK",
+                CONTENT_TYPES[slot.format], (unsigned) bodyLength);
+    }
+    slot.length = min((size_t) max(length, 0), sizeof(slot.buffer) - 1);
+    slot.sent = 0;
+    slot.state = WRITING;
+    CFMetrics::increment(_mRequests);
+}
+
+/**
+ * Write as much of the header and body as the socket takes without waiting.
+ *
+ * @param slot Client slot.
+ */
+void CFLocalEndpoint::_write(Slot &slot) {
+    if (slot.format == HISTORY) {
+        _writeHistory(slot);
+        return;
+    }
+    const char *body = (slot.format == JSON) ? _json : _prometheus;
+    size_t bodyLength = (slot.format == NOT_FOUND) ? 0 : _lengths[slot.format];
+    size_t total = slot.length + bodyLength;
+    while (slot.sent < total) {
+        size_t room = slot.client.availableForWrite();
+        if (room == 0) {
+            return;
+        }
+        const char *data;
+        size_t remaining;
+        if (slot.sent < slot.length) {
+            data = slot.buffer + slot.sent;
+            remaining = slot.length - slot.sent;
+        } else {
+            data = body + (slot.sent - slot.length);
+            remaining = total - slot.sent;
+        }
+        size_t written = slot.client.write((const uint8_t *) data, min(room, remaining));
+        if (written == 0) {
+            return;
+        }
+        slot.sent += written;
+        slot.tStart = millis();
+    }
+    _close(slot, false);
+}
+
+/**
+ * Write history as the socket takes it. At most one chunk is queried per call, so a long range
+ * is spread over several loops.
+ *
+ * @param slot Client slot.
+ */
+void CFLocalEndpoint::_writeHistory(Slot &slot) {
+    bool rendered = false;
+    while (true) {
+        if (slot.sent >= slot.length) {
+            if (slot.part == HISTORY_DONE) {
+                _close(slot, false);
+                return;
+            }
+            if (rendered) {
+                return;
+            }
+            slot.length = _renderHistory(slot);
+            slot.sent = 0;
+            rendered = true;
+            continue;
+        }
+        size_t room = slot.client.availableForWrite();
+        if (room == 0) {
+            return;
+        }
+        size_t written = slot.client.write((const uint8_t *) slot.buffer + slot.sent, min(room, slot.length - slot.sent));
+        if (written == 0) {
+            return;
+        }
+        slot.sent += written;
+        slot.tStart = millis();
+    }
+}
+
+/**
+ * Read history range from the path, e.g. /history?key=soi_perct&from=1700000000&tier=minute.
+ *
+ * @param slot Client slot.
+ * @param path Path, up to the end of the request line.
+ * @return False if there is no history or no series with that key.
+ */
+bool CFLocalEndpoint::_parseHistory(Slot &slot, const char *path) {
+    const char *key = _param(path, "key");
+    if (!_timeSeries || !key) {
+        return false;
+    }
+    char name[32];
+    size_t length = strcspn(key, "& \r\n");
+    if (length >= sizeof(name)) {
+        return false;
+    }
+    memcpy(name, key, length);
+    name[length] = '\0';
+    slot.series = _timeSeries->getSeries(name);
+    if (slot.series < 0) {
+        return false;
+    }
+    const char *to = _param(path, "to");
+    const char *from = _param(path, "from");
+    const char *tier = _param(path, "tier");
+    uint32_t now = CFTimeSeries::now();
+    slot.to = to ? strtoul(to, nullptr, 10) : (now ? now : UINT32_MAX);
+    slot.from = from ? strtoul(from, nullptr, 10) : ((slot.to != UINT32_MAX && slot.to > 3600) ? slot.to - 3600 : 0);
+    if (tier && strncmp(tier, "raw", 3) == 0) {
+        slot.tier = CFTimeSeries::RAW;
+    } else if (tier && strncmp(tier, "minute", 6) == 0) {
+        slot.tier = CFTimeSeries::MINUTE;
+    } else if (tier && strncmp(tier, "hour", 4) == 0) {
+        slot.tier = CFTimeSeries::HOUR;
+    } else {
+        slot.tier = _timeSeries->getTier(slot.series, slot.from);
+    }
+    slot.part = HISTORY_START;
+    return true;
+}
+
+/**
+ * Render next history chunk into the slot buffer: the opening, up to CF_ENDPOINT_HISTORY_POINTS
+ * points, or the closing.
+ *
+ * @param slot Client slot.
+ * @return Length.
+ */
+size_t CFLocalEndpoint::_renderHistory(Slot &slot) {
+    size_t size = sizeof(slot.buffer);
+    size_t length = 0;
+    if (slot.part == HISTORY_START) {
+        length = snprintf(slot.buffer, size, "{\"key\":\"%s\",\"points\":[", _timeSeries->getKey(slot.series));
+        slot.part = HISTORY_FIRST;
+        return min(length, size - 1);
+    }
+    if (slot.part == HISTORY_FIRST || slot.part == HISTORY_POINTS) {
+        CFTimeSeries::Point points[CF_ENDPOINT_HISTORY_POINTS];
+        size_t count = (slot.from <= slot.to)
+                ? _timeSeries->query(slot.series, slot.from, slot.to, points, CF_ENDPOINT_HISTORY_POINTS, slot.tier) : 0;
+        for (size_t i = 0; i < count; i++) {
+            length += snprintf(slot.buffer + length, size - length, "%s[%lu,%ld]",
+                    slot.part == HISTORY_FIRST ? "" : ",", (unsigned long) points[i].timestamp, points[i].value);
+            slot.part = HISTORY_POINTS;
+        }
+        if (count < CF_ENDPOINT_HISTORY_POINTS || points[count - 1].timestamp == UINT32_MAX) {
+            slot.part = HISTORY_END;
+        } else {
+            slot.from = points[count - 1].timestamp + 1;
+        }
+    }
+    if (slot.part == HISTORY_END && length + 3 <= size) {
+        length += snprintf(slot.buffer + length, size - length, "]}");
+        slot.part = HISTORY_DONE;
+    }
+    return length;
+}
+
+/**
+ * Close a client and free its slot without waiting on the socket. stop() would wait up to
+ * WIFICLIENT_MAX_FLUSH_WAIT_MS for the client to acknowledge what was written.
+ *
+ * @param slot Client slot.
+ * @param abort True to reset the connection (client gone or timed out), false after a response.
+ */
+void CFLocalEndpoint::_close(Slot &slot, bool abort) {
+    if (abort) {
+        slot.client.abort();
+    } else {
+        slot.client.stop(1);
+    }
+    slot.state = FREE;
+}
+
+/**
+ * True if a client is receiving a format, so its buffer can't change.
+ *
+ * @param format Format.
+ * @return True if busy.
+ */
+bool CFLocalEndpoint::_isBusy(Format format) {
+    for (int i = 0; i < CF_ENDPOINT_MAX_CLIENTS; i++) {
+        if (_slots[i].state == WRITING && _slots[i].format == format) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Render a format again if a reading changed or metrics are older than the render interval,
+ * unless a client is still receiving it.
+ *
+ * @param format Format.
+ */
+void CFLocalEndpoint::_render(Format format) {
+    bool stale = _lengths[format] == 0 || _versions[format] != _version
+            || millis() - _tRendered[format] >= _ttRender;
+    if (!stale || _isBusy(format)) {
+        return;
+    }
+    _lengths[format] = (format == JSON) ? _renderJson() : _renderPrometheus();
+    _versions[format] = _version;
+    _tRendered[format] = millis();
+}
+
+/**
+ * Render JSON. Metrics that don't fit CF_ENDPOINT_JSON_SIZE are left out.
+ *
+ * @return Length.
+ */
+size_t CFLocalEndpoint::_renderJson() {
+    size_t size = sizeof(_json);
+    size_t length = snprintf(_json, size, "{\"readings\":{");
+    for (uint8_t i = 0; i < _readingCount && length < size; i++) {
+        length += snprintf(_json + length, size - length, "%s\"%s\":", i > 0 ? "," : "", _readings[i].key);
+        if (length < size) {
+            length += _formatReading(_json + length, size - length, _readings[i]);
+        }
+    }
+    if (length < size) {
+        length += snprintf(_json + length, size - length, "},\"metrics\":");
+    }
+
+    // Leave room for the closing brace.
+    int cursor = 0;
+    size_t metrics = 0;
+    if (length + 3 < size) {
+        metrics = CFMetrics::toJson(_json + length, size - length - 1, cursor);
+    }
+    if (metrics == 0 && length + 3 < size) {
+        metrics = snprintf(_json + length, size - length, "{}");
+    }
+    length += metrics;
+    if (length + 1 >= size) {
+        Logger::warning("Local endpoint JSON doesn't fit. Increase CF_ENDPOINT_JSON_SIZE.");
+        return 0;
+    }
+    _json[length++] = '}';
+    _json[length] = '\0';
+    return length;
+}
+
+/**
+ * Render Prometheus text. Metrics that don't fit CF_ENDPOINT_PROMETHEUS_SIZE are left out.
+ *
+ * @return Length.
+ */
+size_t CFLocalEndpoint::_renderPrometheus() {
+    size_t size = sizeof(_prometheus);
+    size_t length = 0;
+    for (uint8_t i = 0; i < _readingCount && length < size; i++) {
+        length += snprintf(_prometheus + length, size - length, "cf_%s ", _readings[i].key);
+        if (length < size) {
+            length += _formatReading(_prometheus + length, size - length, _readings[i]);
+        }
+        if (length < size) {
+            length += snprintf(_prometheus + length, size - length, "\n");
+        }
+    }
+    if (length >= size) {
+        Logger::warning("Local endpoint text doesn't fit. Increase CF_ENDPOINT_PROMETHEUS_SIZE.");
+        return 0;
+    }
+    int cursor = 0;
+    length += CFMetrics::toPrometheus(_prometheus + length, size - length, cursor);
+    if (cursor < CFMetrics::getItemCount()) {
+        Logger::warning("Local endpoint metrics don't fit. Increase CF_ENDPOINT_PROMETHEUS_SIZE.");
+    }
+    return length;
+}
+
+/**
+ * Format a reading value, e.g. 234 with 1 decimal as 23.4.
+ *
+ * @param buffer Output buffer.
+ * @param size Buffer size.
+ * @param reading Reading.
+ * @return Length written (as snprintf).
+ */
+int CFLocalEndpoint::_formatReading(char *buffer, size_t size, const Reading &reading) {
+    if (reading.decimals == 0) {
+        return snprintf(buffer, size, "%ld", reading.value);
+    }
+    long scale = 1;
+    for (uint8_t i = 0; i < reading.decimals; i++) {
+        scale *= 10;
+    }
+    unsigned long absolute = labs(reading.value);
+    return snprintf(buffer, size, "%s%lu.%0*lu", reading.value < 0 ? "-" : "",
+            absolute / scale, (int) reading.decimals, absolute % scale);
+}
+
+/**
+ * Find a query parameter value.
+ *
+ * @param path Path, up to the end of the request line.
+ * @param name Parameter name.
+ * @return Value, ending at '&' or ' ', or nullptr if there is none.
+ */
+const char *CFLocalEndpoint::_param(const char *path, const char *name) {
+    size_t length = strlen(name);
+    const char *query = strchr(path, '?');
+    const char *end = strchr(path, ' ');
+    while (query && (!end || query < end)) {
+        query++;
+        if (strncmp(query, name, length) == 0 && query[length] == '=') {
+            return query + length + 1;
+        }
+        query = strchr(query, '&');
+    }
+    return nullptr;
+}
+
+/**
+ * Set a reading. Responses are rendered again only when a value changes.
+ *
+ * @param key Key. It must outlive the endpoint (e.g. a literal).
+ * @param value Value, scaled by 10^decimals (e.g. 234 for 23.4 with 1 decimal).
+ * @param decimals Decimal places.
+ * @return False if there is no room for another reading.
+ */
+bool CFLocalEndpoint::setReading(const char *key, long value, uint8_t decimals) {
+    for (uint8_t i = 0; i < _readingCount; i++) {
+        if (strcmp(_readings[i].key, key) == 0) {
+            if (_readings[i].value != value || _readings[i].decimals != decimals) {
+                _readings[i].value = value;
+                _readings[i].decimals = decimals;
+                _version++;
+            }
+            return true;
+        }
+    }
+    if (_readingCount >= CF_ENDPOINT_MAX_READINGS) {
+        return false;
+    }
+    _readings[_readingCount++] = { key, value, decimals };
+    _version++;
+    return true;
+}
+
+/**
+ * Define min time between renders of metrics. Readings changes render right away.
+ *
+ * @param ttRender Time (ms).
+ */
+void CFLocalEndpoint::setRenderInterval(unsigned long ttRender) {
+    _ttRender = ttRender;
+}
+
+/**
+ * Get clients being served.
+ *
+ * @return Clients.
+ */
+int CFLocalEndpoint::getClientCount() {
+    int count = 0;
+    for (int i = 0; i < CF_ENDPOINT_MAX_CLIENTS; i++) {
+        if (_slots[i].state != FREE) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Define history served on /history.
+ *
+ * @param timeSeries Time series store.
+ */
+void CFLocalEndpoint::setTimeSeries(CFTimeSeries &timeSeries) {
+    _timeSeries = &timeSeries;
+}
@@ -0,0 +1,158 @@
+/**
+ * CFLocalEndpoint.h
+ *
+ * Local HTTP endpoint with current readings and device metrics, so monitoring on the LAN can
+ * poll a device directly instead of going through ThingsBoard:
+ *
+ *      GET /metrics            Prometheus text (readings as cf_<key>, then CFMetrics).
+ *      GET / or /data.json     JSON, {"readings":{...},"metrics":{...}}.
+ *      GET /history?key=soi_perct&from=1700000000&to=1700003600&tier=minute
+ *                              JSON, {"key":"soi_perct","points":[[timestamp,value],...]}, from
+ *                              the CFTimeSeries set with setTimeSeries(). Times are Unix time
+ *                              (s), to defaults to now and from to an hour before. Without tier
+ *                              (raw, minute or hour), the finest one holding from.
+ *
+ * Responses come from buffers rendered ahead, shared by every client: they're rendered again
+ * on a request only when a reading changed or metrics are older than the render interval, and
+ * never while a client is still receiving them. Each client goes through a small state
+ * machine driven by loop() (read request, write as much as the socket takes, close), so up to
+ * CF_ENDPOINT_MAX_CLIENTS scrapers are served at once without ever blocking the sketch loop.
+ * History is streamed instead: a few points are queried into the client's own buffer each time
+ * the previous ones were taken by the socket, so any range is served with no extra RAM.
+ *
+ * CFWiFiManagerHelper drives it on its WiFiServer once Wi-Fi is connected, see
+ * CFWiFiManagerHelper::setLocalEndpoint(). The port is CF_WM_SERVER_PORT (8080), as the
+ * WiFiManager web portal keeps port 80.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFLocalEndpoint_h
+#define CFLocalEndpoint_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <WiFiClient.h>                                                         // WiFiClient.
+#include <WiFiServer.h>                                                         // WiFiServer.
+#include <Logger.h>                                                             // Logger.
+#include <CFMetrics.h>                                                          // CF Metrics.
+#include <CFHeap.h>                                                             // CF Heap.
+#include <CFTimeSeries.h>                                                       // CF Time Series.
+
+#ifndef CF_ENDPOINT_MAX_CLIENTS
+    #define CF_ENDPOINT_MAX_CLIENTS         3                                   // Clients served at once.
+#endif
+
+#ifndef CF_ENDPOINT_MAX_READINGS
+    #define CF_ENDPOINT_MAX_READINGS        8                                   // Readings published.
+#endif
+
+#ifndef CF_ENDPOINT_JSON_SIZE
+    #define CF_ENDPOINT_JSON_SIZE           1280                                // Rendered JSON.
+#endif
+
+#ifndef CF_ENDPOINT_PROMETHEUS_SIZE
+    #define CF_ENDPOINT_PROMETHEUS_SIZE     3072                                // Rendered Prometheus text.
+#endif
+
+#define CF_ENDPOINT_REQUEST_SIZE            128                                 // Request line, then response header.
+#define CF_ENDPOINT_TIMEOUT                 3000                                // Max time a client goes without progress (ms).
+#define CF_ENDPOINT_HISTORY_POINTS          4                                   // History points per chunk, they must fit the slot buffer.
+
+class CFLocalEndpoint {
+    private:
+        // Formats.
+        enum Format : uint8_t {
+            JSON,                                                               // JSON.
+            PROMETHEUS,                                                         // Prometheus text.
+            HISTORY,                                                            // Time series range, streamed.
+            NOT_FOUND                                                           // Unknown path.
+        };
+
+        // Client states.
+        enum State : uint8_t {
+            FREE,                                                               // Slot is free.
+            READING,                                                            // Reading request.
+            WRITING                                                             // Writing response.
+        };
+
+        // History parts.
+        enum Part : uint8_t {
+            HISTORY_START,                                                      // Header sent, opening next.
+            HISTORY_FIRST,                                                      // First points.
+            HISTORY_POINTS,                                                     // Following points.
+            HISTORY_END,                                                        // Closing next.
+            HISTORY_DONE                                                        // Everything rendered.
+        };
+
+        // Client slot.
+        struct Slot {
+            WiFiClient client;                                                  // Client.
+            State state;                                                        // State.
+            Format format;                                                      // Requested format.
+            uint32_t tail;                                                      // Last 4 request bytes, to find the header end.
+            unsigned long tStart;                                               // Time it was accepted.
+            size_t length;                                                      // Request (then header) length.
+            size_t sent;                                                        // Header and body bytes sent.
+            char buffer[CF_ENDPOINT_REQUEST_SIZE];                              // Request line, then response header (and history chunks).
+            int8_t series;                                                      // History series.
+            CFTimeSeries::Tier tier;                                            // History tier.
+            Part part;                                                          // History part to render next.
+            uint32_t from;                                                      // History points left from this time.
+            uint32_t to;                                                        // History range end.
+        };
+
+        // Reading.
+        struct Reading {
+            const char *key;                                                    // Key (NULL if free).
+            long value;                                                         // Value, scaled by 10^decimals.
+            uint8_t decimals;                                                   // Decimal places.
+        };
+
+        // Attributes.
+        Slot _slots[CF_ENDPOINT_MAX_CLIENTS];                                   // Clients.
+        Reading _readings[CF_ENDPOINT_MAX_READINGS];                            // Readings.
+        uint8_t _readingCount;                                                  // Registered readings.
+        uint32_t _version;                                                      // Incremented when a reading changes.
+        char _json[CF_ENDPOINT_JSON_SIZE];                                      // Rendered JSON.
+        char _prometheus[CF_ENDPOINT_PROMETHEUS_SIZE];                          // Rendered Prometheus text.
+        size_t _lengths[2];                                                     // Rendered lengths per format.
+        uint32_t _versions[2];                                                  // Reading version rendered per format.
+        unsigned long _tRendered[2];                                            // Last render time per format.
+        unsigned long _ttRender;                                                // Min time between renders of metrics.
+        CFTimeSeries *_timeSeries;                                              // History (optional).
+
+        // Metrics.
+        int _mRequests;                                                         // Requests served.
+        int _mRejected;                                                         // Clients rejected (all slots busy).
+
+        // Methods.
+        void _accept(WiFiServer &server);                                       // Accept a new client.
+        void _read(Slot &slot);                                                 // Read request.
+        void _respond(Slot &slot);                                              // Prepare the response.
+        void _write(Slot &slot);                                                // Write what the socket takes.
+        void _writeHistory(Slot &slot);                                         // Write history as the socket takes it.
+        bool _parseHistory(Slot &slot, const char *path);                       // Read history range from the path.
+        size_t _renderHistory(Slot &slot);                                      // Render next history chunk.
+        void _close(Slot &slot, bool abort);                                    // Close and free a slot.
+        bool _isBusy(Format format);                                            // True if a client is receiving a format.
+        void _render(Format format);                                            // Render a format if stale.
+        size_t _renderJson();                                                   // Render JSON.
+        size_t _renderPrometheus();                                             // Render Prometheus text.
+        int _formatReading(char *buffer, size_t size, const Reading &reading);  // Format a reading value.
+        static const char *_param(const char *path, const char *name);          // Find a query parameter value.
+
+    public:
+        // Methods.
+        CFLocalEndpoint();                                                      // Constructor.
+        void loop(WiFiServer &server);                                          // Serve clients of a started server.
+        bool setReading(const char *key, long value, uint8_t decimals = 0);     // Set a reading.
+
+        // Accessors.
+        void setRenderInterval(unsigned long ttRender);                         // Define min time between renders of metrics.
+        void setTimeSeries(CFTimeSeries &timeSeries);                           // Define history served on /history.
+        int getClientCount();                                                   // Get clients being served.
+};
+
+#endif
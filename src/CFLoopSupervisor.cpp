@@ -0,0 +1,251 @@
+/**
+ * CFLoopSupervisor.cpp
+ * 
+ * Loop supervisor for CF IoT devices.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFLoopSupervisor.h>                                                   // CF Loop Supervisor.
+
+extern "C" {
+    #include <user_interface.h>                                                 // ESP8266 reset info.
+}
+
+#define CF_SUPERVISOR_MAGIC                 0xCF5E0001                          // Log marker. Change it when Log layout changes.
+#define CF_SUPERVISOR_NONE                  0xFF                                // No section running.
+
+/**
+ * Constructor.
+ */
+CFLoopSupervisor::CFLoopSupervisor() {
+    _sectionCount = 0;
+    _loopBudget = 0;
+    _tLoop = micros();
+    _resetSection = -1;
+    memset(&_log, 0, sizeof(_log));
+    _log.running = CF_SUPERVISOR_NONE;
+    _mOverruns = CFMetrics::counter("loop_overrun");
+    _mSkips = CFMetrics::counter("loop_deferred");
+}
+
+/**
+ * Load the log from RTC memory and report it if the device was reset with a section running.
+ */
+void CFLoopSupervisor::begin() {
+    ESP.rtcUserMemoryRead(CF_SUPERVISOR_RTC_OFFSET, (uint32_t *) &_log, sizeof(_log));
+    if (_log.magic != CF_SUPERVISOR_MAGIC) {
+        // Power on or layout change.
+        memset(&_log, 0, sizeof(_log));
+        _log.magic = CF_SUPERVISOR_MAGIC;
+        _log.running = CF_SUPERVISOR_NONE;
+    }
+    _log.boots++;
+
+    // A section was running when device has been reset.
+    uint32_t reason = ESP.getResetInfoPtr()->reason;
+    bool crashed = reason == REASON_WDT_RST || reason == REASON_EXCEPTION_RST || reason == REASON_SOFT_WDT_RST;
+    if (crashed && _log.running < CF_SUPERVISOR_MAX_SECTIONS) {
+        _resetSection = _log.running;
+        _log.entries[_resetSection].resets++;
+        Logger::error("Device has been reset (" + ESP.getResetReason() + ") while running " + String(_log.entries[_resetSection].name) + ".");
+    }
+    _log.running = CF_SUPERVISOR_NONE;
+    _saveLog();
+    if (_log.boots > 1) {
+        report();
+    }
+}
+
+/**
+ * Mark the start of a loop. Call it first thing in loop().
+ */
+void CFLoopSupervisor::loop() {
+    ESP.wdtFeed();
+    _tLoop = micros();
+}
+
+/**
+ * Add a section that is never skipped.
+ *
+ * @param name Name. It must outlive the supervisor (e.g. a literal).
+ * @param budget Time budget (us).
+ * @return Id or -1 if there is no room.
+ */
+int CFLoopSupervisor::addSection(const char *name, unsigned long budget) {
+    return addSection(name, budget, false);
+}
+
+/**
+ * Add a section.
+ *
+ * @param name Name. It must outlive the supervisor (e.g. a literal).
+ * @param budget Time budget (us).
+ * @param deferrable True if it may be skipped when the loop is over budget.
+ * @return Id or -1 if there is no room.
+ */
+int CFLoopSupervisor::addSection(const char *name, unsigned long budget, bool deferrable) {
+    if (_sectionCount >= CF_SUPERVISOR_MAX_SECTIONS) {
+        return -1;
+    }
+    Section &section = _sections[_sectionCount];
+    section.name = name;
+    section.budget = budget;
+    section.deferrable = deferrable;
+    section.skips = 0;
+    section.tStart = 0;
+    section.lastTime = 0;
+
+    // Keep history only if the firmware still has the same section in this slot.
+    LogEntry &entry = _log.entries[_sectionCount];
+    if (strncmp(entry.name, name, sizeof(entry.name) - 1) != 0) {
+        memset(&entry, 0, sizeof(entry));
+        strlcpy(entry.name, name, sizeof(entry.name));
+    }
+    return _sectionCount++;
+}
+
+/**
+ * Start a section.
+ *
+ * @param id Section id.
+ * @return False if the section is deferred to a next loop.
+ */
+bool CFLoopSupervisor::start(int id) {
+    if (id < 0 || id >= _sectionCount) {
+        return true;
+    }
+    Section &section = _sections[id];
+    unsigned long now = micros();
+    if (section.deferrable && _loopBudget > 0 && now - _tLoop >= _loopBudget && section.skips < CF_SUPERVISOR_MAX_SKIPS) {
+        section.skips++;
+        CFMetrics::increment(_mSkips);
+        return false;
+    }
+    section.skips = 0;
+    ESP.wdtFeed();
+    _setRunning(id);
+    section.tStart = micros();
+    return true;
+}
+
+/**
+ * Stop a section and check its budget.
+ *
+ * @param id Section id.
+ */
+void CFLoopSupervisor::stop(int id) {
+    if (id < 0 || id >= _sectionCount) {
+        return;
+    }
+    Section &section = _sections[id];
+    section.lastTime = micros() - section.tStart;
+    if (section.lastTime > section.budget) {
+        LogEntry &entry = _log.entries[id];
+        entry.overruns++;
+        if (section.lastTime > entry.maxTime) {
+            entry.maxTime = section.lastTime;
+        }
+        CFMetrics::increment(_mOverruns);
+        CF_LOG_VERBOSE("Section " + String(section.name) + " took " + String(section.lastTime) + " us. Budget is " + String(section.budget) + " us.");
+        _log.running = CF_SUPERVISOR_NONE;
+        _saveLog();
+    } else {
+        _setRunning(CF_SUPERVISOR_NONE);
+    }
+}
+
+/**
+ * Log sections with overruns or resets, worst first.
+ */
+void CFLoopSupervisor::report() {
+    bool reported[CF_SUPERVISOR_MAX_SECTIONS] = {false};
+    for (uint8_t n = 0; n < CF_SUPERVISOR_MAX_SECTIONS; n++) {
+        // Selection by resets, then overruns. Sections are few.
+        int worst = -1;
+        for (uint8_t i = 0; i < CF_SUPERVISOR_MAX_SECTIONS; i++) {
+            LogEntry &entry = _log.entries[i];
+            if (reported[i] || (entry.overruns == 0 && entry.resets == 0)) {
+                continue;
+            }
+            if (worst < 0 || entry.resets > _log.entries[worst].resets
+                    || (entry.resets == _log.entries[worst].resets && entry.overruns > _log.entries[worst].overruns)) {
+                worst = i;
+            }
+        }
+        if (worst < 0) {
+            return;
+        }
+        reported[worst] = true;
+        LogEntry &entry = _log.entries[worst];
+        Logger::warning("Loop offender " + String(entry.name) + ": " + String(entry.overruns) + " overrun(s), "
+                + String(entry.resets) + " reset(s), max " + String(entry.maxTime) + " us in " + String(_log.boots) + " boot(s).");
+    }
+}
+
+/**
+ * Discard the overrun log.
+ */
+void CFLoopSupervisor::clearLog() {
+    for (uint8_t i = 0; i < CF_SUPERVISOR_MAX_SECTIONS; i++) {
+        _log.entries[i].overruns = 0;
+        _log.entries[i].resets = 0;
+        _log.entries[i].maxTime = 0;
+    }
+    _log.boots = 1;
+    _saveLog();
+}
+
+/**
+ * Write log into RTC memory.
+ */
+void CFLoopSupervisor::_saveLog() {
+    ESP.rtcUserMemoryWrite(CF_SUPERVISOR_RTC_OFFSET, (uint32_t *) &_log, sizeof(_log));
+}
+
+/**
+ * Write running section into RTC memory. Only its word is written, so it's cheap to call on
+ * every section.
+ *
+ * @param id Section id or CF_SUPERVISOR_NONE.
+ */
+void CFLoopSupervisor::_setRunning(uint32_t id) {
+    _log.running = id;
+    ESP.rtcUserMemoryWrite(CF_SUPERVISOR_RTC_OFFSET + offsetof(Log, running) / 4, &_log.running, sizeof(_log.running));
+}
+
+/**
+ * Define loop budget. Deferrable sections are skipped once a loop takes longer than it.
+ *
+ * @param loopBudget Loop budget (us). 0 disables deferring.
+ */
+void CFLoopSupervisor::setLoopBudget(unsigned long loopBudget) {
+    _loopBudget = loopBudget;
+}
+
+/**
+ * Get last run time of a section.
+ *
+ * @param id Section id.
+ * @return Last run time (us).
+ */
+unsigned long CFLoopSupervisor::getLastTime(int id) {
+    if (id < 0 || id >= _sectionCount) {
+        return 0;
+    }
+    return _sections[id].lastTime;
+}
+
+/**
+ * Get name of the section that was running when the device has been reset.
+ *
+ * @return Section name or empty string if none.
+ */
+const char *CFLoopSupervisor::getResetSection() {
+    if (_resetSection < 0) {
+        return "";
+    }
+    return _log.entries[_resetSection].name;
+}
@@ -0,0 +1,104 @@
+/**
+ * CFLoopSupervisor.h
+ * 
+ * Loop supervisor for CF IoT devices.
+ *
+ * Each helper call in loop() is wrapped in a section with a time budget:
+ *
+ *      if (_supervisor.start(SECTION_TB)) {
+ *          _cfThingsBoard.loop();
+ *          _supervisor.stop(SECTION_TB);
+ *      }
+ *
+ * The supervisor feeds the watchdog between sections, counts budget overruns and keeps an
+ * overrun log in RTC user memory, which survives resets (not power loss). The section running
+ * when the device resets is recorded too, so after a watchdog reset or an exception the
+ * culprit is known. begin() reports the log after reboot.
+ *
+ * Deferrable sections are skipped when the loop already spent its budget, but never more than
+ * a few loops in a row.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFLoopSupervisor_h
+#define CFLoopSupervisor_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <Logger.h>                                                             // Logger.
+#include <CFMetrics.h>                                                          // CF Metrics.
+#include <CFTrace.h>                                                            // CF Trace.
+
+#ifndef CF_SUPERVISOR_MAX_SECTIONS
+    #define CF_SUPERVISOR_MAX_SECTIONS      8                                   // Max supervised sections.
+#endif
+
+#ifndef CF_SUPERVISOR_RTC_OFFSET
+    #define CF_SUPERVISOR_RTC_OFFSET        32                                  // RTC block of the log. First 32 blocks are used by OTA.
+#endif
+
+#define CF_SUPERVISOR_MAX_SKIPS             3                                   // Max loops in a row a deferrable section is skipped.
+
+class CFLoopSupervisor {
+    private:
+        // Section.
+        struct Section {
+            const char *name;                                                   // Name.
+            unsigned long budget;                                               // Time budget (us).
+            bool deferrable;                                                    // Flag that indicates it can be skipped.
+            uint8_t skips;                                                      // Loops skipped in a row.
+            unsigned long tStart;                                               // Start time (us).
+            unsigned long lastTime;                                             // Last run time (us).
+        };
+
+        // Overrun log kept in RTC user memory.
+        struct LogEntry {
+            char name[12];                                                      // Section name (truncated).
+            uint32_t overruns;                                                  // Budget overruns.
+            uint32_t resets;                                                    // Resets while it was running.
+            uint32_t maxTime;                                                   // Max run time (us).
+        };
+        struct Log {
+            uint32_t magic;                                                     // Valid log marker.
+            uint32_t boots;                                                     // Boots since power on.
+            uint32_t running;                                                   // Section running (0xFF if none).
+            LogEntry entries[CF_SUPERVISOR_MAX_SECTIONS];                       // Entries by section id.
+        };
+
+        // Attributes.
+        Section _sections[CF_SUPERVISOR_MAX_SECTIONS];                          // Sections.
+        uint8_t _sectionCount;                                                  // Registered sections.
+        Log _log;                                                               // Overrun log (RAM copy).
+        unsigned long _loopBudget;                                              // Loop budget (us).
+        unsigned long _tLoop;                                                   // Loop start (us).
+        int _resetSection;                                                      // Section running at last reset (-1 if none).
+
+        // Metrics.
+        int _mOverruns;                                                         // Budget overruns.
+        int _mSkips;                                                            // Deferred sections.
+
+        // Methods.
+        void _saveLog();                                                        // Write log into RTC memory.
+        void _setRunning(uint32_t id);                                          // Write running section into RTC memory.
+
+    public:
+        // Methods.
+        CFLoopSupervisor();                                                     // Constructor.
+        void begin();                                                           // Load and report log from before reboot.
+        void loop();                                                            // Mark loop start.
+        int addSection(const char *name, unsigned long budget);                 // Add a section.
+        int addSection(const char *name, unsigned long budget, bool deferrable);// Add a section that may be skipped.
+        bool start(int id);                                                     // Start a section. False if it's deferred.
+        void stop(int id);                                                      // Stop a section.
+        void report();                                                          // Log top offenders.
+        void clearLog();                                                        // Discard the overrun log.
+
+        // Accessors.
+        void setLoopBudget(unsigned long loopBudget);                           // Define loop budget.
+        unsigned long getLastTime(int id);                                      // Get last run time of a section (us).
+        const char *getResetSection();                                          // Get section running at last reset.
+};
+
+#endif
@@ -0,0 +1,343 @@
+/**
+ * CFMetrics.cpp
+ * 
+ * Runtime metrics shared by the CF helpers.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFMetrics.h>                                                          // CF Metrics.
+#include <Logger.h>                                                             // Logger.
+
+// Tables are zero initialized before any constructor runs, so helpers can register from theirs.
+const char *CFMetrics::_counterNames[CF_METRICS_MAX_COUNTERS];
+unsigned long CFMetrics::_counters[CF_METRICS_MAX_COUNTERS];
+uint8_t CFMetrics::_counterCount;
+const char *CFMetrics::_gaugeNames[CF_METRICS_MAX_GAUGES];
+long CFMetrics::_gauges[CF_METRICS_MAX_GAUGES];
+uint8_t CFMetrics::_gaugeCount;
+const char *CFMetrics::_histogramNames[CF_METRICS_MAX_HISTOGRAMS];
+CFMetrics::Histogram CFMetrics::_histograms[CF_METRICS_MAX_HISTOGRAMS];
+uint8_t CFMetrics::_histogramCount;
+bool CFMetrics::_skipLogged;
+
+/**
+ * Find or add a name.
+ *
+ * @param names Name table.
+ * @param count Registered names.
+ * @param max Table size.
+ * @param name Name. It must outlive the metrics (e.g. a literal).
+ * @return Id or -1 if table is full.
+ */
+int CFMetrics::_register(const char **names, uint8_t &count, uint8_t max, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    if (count >= max) {
+        return -1;
+    }
+    names[count] = name;
+    return count++;
+}
+
+/**
+ * Register a counter.
+ *
+ * @param name Name.
+ * @return Id or -1 if table is full.
+ */
+int CFMetrics::counter(const char *name) {
+    return _register(_counterNames, _counterCount, CF_METRICS_MAX_COUNTERS, name);
+}
+
+/**
+ * Register a gauge.
+ *
+ * @param name Name.
+ * @return Id or -1 if table is full.
+ */
+int CFMetrics::gauge(const char *name) {
+    return _register(_gaugeNames, _gaugeCount, CF_METRICS_MAX_GAUGES, name);
+}
+
+/**
+ * Register a histogram.
+ *
+ * @param name Name.
+ * @return Id or -1 if table is full.
+ */
+int CFMetrics::histogram(const char *name) {
+    return _register(_histogramNames, _histogramCount, CF_METRICS_MAX_HISTOGRAMS, name);
+}
+
+/**
+ * Increment a counter.
+ *
+ * @param id Counter id.
+ */
+void CFMetrics::increment(int id) {
+    add(id, 1);
+}
+
+/**
+ * Add to a counter.
+ *
+ * @param id Counter id.
+ * @param value Value.
+ */
+void CFMetrics::add(int id, unsigned long value) {
+    if (id >= 0 && id < _counterCount) {
+        _counters[id] += value;
+    }
+}
+
+/**
+ * Set a gauge.
+ *
+ * @param id Gauge id.
+ * @param value Value.
+ */
+void CFMetrics::set(int id, long value) {
+    if (id >= 0 && id < _gaugeCount) {
+        _gauges[id] = value;
+    }
+}
+
+/**
+ * Record a histogram value.
+ *
+ * @param id Histogram id.
+ * @param value Value.
+ */
+void CFMetrics::record(int id, unsigned long value) {
+    if (id < 0 || id >= _histogramCount) {
+        return;
+    }
+    Histogram &histogram = _histograms[id];
+
+    // Bucket is the bit length of the value.
+    int bucket = value == 0 ? 0 : 8 * sizeof(unsigned long) - __builtin_clzl(value);
+    if (bucket >= CF_METRICS_HISTOGRAM_BUCKETS) {
+        bucket = CF_METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    if (value > histogram.max) {
+        histogram.max = value;
+    }
+}
+
+/**
+ * Get counter value.
+ *
+ * @param id Counter id.
+ * @return Value.
+ */
+unsigned long CFMetrics::getCounter(int id) {
+    return (id >= 0 && id < _counterCount) ? _counters[id] : 0;
+}
+
+/**
+ * Get gauge value.
+ *
+ * @param id Gauge id.
+ * @return Value.
+ */
+long CFMetrics::getGauge(int id) {
+    return (id >= 0 && id < _gaugeCount) ? _gauges[id] : 0;
+}
+
+/**
+ * Get histogram percentile.
+ * Buckets are log2, so the result is the upper bound of the bucket holding the percentile,
+ * capped by the max recorded value.
+ *
+ * @param id Histogram id.
+ * @param percentile Percentile (0-100).
+ * @return Percentile value.
+ */
+unsigned long CFMetrics::getPercentile(int id, uint8_t percentile) {
+    if (id < 0 || id >= _histogramCount || _histograms[id].count == 0) {
+        return 0;
+    }
+    Histogram &histogram = _histograms[id];
+    unsigned long rank = (histogram.count * percentile + 99) / 100;
+    unsigned long seen = 0;
+    for (int i = 0; i < CF_METRICS_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= rank && seen > 0) {
+            unsigned long upper = i == 0 ? 0 : (1UL << i) - 1;
+            return min(upper, histogram.max);
+        }
+    }
+    return histogram.max;
+}
+
+/**
+ * Get histogram max.
+ *
+ * @param id Histogram id.
+ * @return Max value.
+ */
+unsigned long CFMetrics::getMax(int id) {
+    return (id >= 0 && id < _histogramCount) ? _histograms[id].max : 0;
+}
+
+/**
+ * Get histogram count.
+ *
+ * @param id Histogram id.
+ * @return Values recorded.
+ */
+unsigned long CFMetrics::getCount(int id) {
+    return (id >= 0 && id < _histogramCount) ? _histograms[id].count : 0;
+}
+
+/**
+ * Reset all histograms.
+ */
+void CFMetrics::resetHistograms() {
+    memset(_histograms, 0, sizeof(_histograms));
+}
+
+/**
+ * Get metrics to be serialized.
+ * A histogram counts as one item.
+ *
+ * @return Items.
+ */
+int CFMetrics::getItemCount() {
+    return _counterCount + _gaugeCount + _histogramCount;
+}
+
+/**
+ * Serialize metrics as compact JSON.
+ * Writes as many items as fit, starting at the cursor, and moves the cursor past them. Call it
+ * again until the cursor reaches getItemCount() to split metrics into payloads of a given size.
+ * An item that doesn't fit even an empty buffer is skipped, so the rest still goes out.
+ * Histograms are written as <name>_n, <name>_p50, <name>_p99 and <name>_max.
+ *
+ * @param buffer Output buffer.
+ * @param size Buffer size.
+ * @param cursor First item to write. Updated to the first item not written.
+ * @return JSON length or 0 if nothing was written.
+ */
+size_t CFMetrics::toJson(char *buffer, size_t size, int &cursor) {
+    if (size < 3) {
+        return 0;
+    }
+    size_t length = 0;
+    buffer[length++] = '{';
+
+    while (cursor < getItemCount()) {
+        char item[96];
+        int id = cursor;
+        int itemLength;
+        if (id < _counterCount) {
+            itemLength = snprintf(item, sizeof(item), "\"%s\":%lu", _counterNames[id], _counters[id]);
+        } else if ((id -= _counterCount) < _gaugeCount) {
+            itemLength = snprintf(item, sizeof(item), "\"%s\":%ld", _gaugeNames[id], _gauges[id]);
+        } else {
+            id -= _gaugeCount;
+            const char *name = _histogramNames[id];
+            itemLength = snprintf(item, sizeof(item), "\"%s_n\":%lu,\"%s_p50\":%lu,\"%s_p99\":%lu,\"%s_max\":%lu",
+                    name, _histograms[id].count, name, getPercentile(id, 50),
+                    name, getPercentile(id, 99), name, _histograms[id].max);
+        }
+
+        // Keep room for the separator, the closing brace and the terminator.
+        if (itemLength < 0 || itemLength >= (int) sizeof(item) || length + itemLength + 3 > size) {
+            if (length == 1) {
+                _skip(cursor);                                                  // It won't fit the next buffer either.
+                continue;
+            }
+            break;
+        }
+        if (length > 1) {
+            buffer[length++] = ',';
+        }
+        memcpy(buffer + length, item, itemLength);
+        length += itemLength;
+        cursor++;
+    }
+
+    if (length == 1) {
+        return 0;
+    }
+    buffer[length++] = '}';
+    buffer[length] = '\0';
+    return length;
+}
+
+/**
+ * Serialize metrics in the Prometheus text format, names prefixed with cf_.
+ * Writes as many items as fit, starting at the cursor, and moves the cursor past them, like
+ * toJson(), skipping items that don't fit an empty buffer. Histograms are written as gauges,
+ * since they're reset every publish interval and would break counter semantics:
+ * cf_<name>{quantile="0.5"} and "0.99", cf_<name>_count and cf_<name>_max, all describing the
+ * current interval.
+ *
+ * @param buffer Output buffer.
+ * @param size Buffer size.
+ * @param cursor First item to write. Updated to the first item not written.
+ * @return Text length or 0 if nothing was written.
+ */
+size_t CFMetrics::toPrometheus(char *buffer, size_t size, int &cursor) {
+    size_t length = 0;
+    while (cursor < getItemCount()) {
+        char item[320];
+        int id = cursor;
+        int itemLength;
+        if (id < _counterCount) {
+            itemLength = snprintf(item, sizeof(item), "# TYPE cf_%s counter\ncf_%s %lu\n",
+                    _counterNames[id], _counterNames[id], _counters[id]);
+        } else if ((id -= _counterCount) < _gaugeCount) {
+            itemLength = snprintf(item, sizeof(item), "# TYPE cf_%s gauge\ncf_%s %ld\n",
+                    _gaugeNames[id], _gaugeNames[id], _gauges[id]);
+        } else {
+            id -= _gaugeCount;
+            const char *name = _histogramNames[id];
+            itemLength = snprintf(item, sizeof(item),
+                    "# TYPE cf_%s gauge\ncf_%s{quantile=\"0.5\"} %lu\ncf_%s{quantile=\"0.99\"} %lu\n"
+                    "# TYPE cf_%s_count gauge\ncf_%s_count %lu\n# TYPE cf_%s_max gauge\ncf_%s_max %lu\n",
+                    name, name, getPercentile(id, 50), name, getPercentile(id, 99),
+                    name, name, _histograms[id].count, name, name, _histograms[id].max);
+        }
+
+        // Keep room for the terminator.
+        if (itemLength < 0 || itemLength >= (int) sizeof(item) || length + itemLength + 1 > size) {
+            if (length == 0) {
+                _skip(cursor);                                                  // It won't fit the next buffer either.
+                continue;
+            }
+            break;
+        }
+        memcpy(buffer + length, item, itemLength);
+        length += itemLength;
+        cursor++;
+    }
+
+    if (length > 0) {
+        buffer[length] = '\0';
+    }
+    return length;
+}
+
+/**
+ * Skip an item that doesn't fit an empty buffer, so later items aren't held back by it. It's
+ * logged once: the buffer or the names need to be shorter.
+ *
+ * @param cursor Item skipped. Moved to the next one.
+ */
+void CFMetrics::_skip(int &cursor) {
+    if (!_skipLogged) {
+        _skipLogged = true;
+        Logger::warning("Metric doesn't fit the buffer, skipped.");
+    }
+    cursor++;
+}
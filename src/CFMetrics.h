@@ -0,0 +1,98 @@
+/**
+ * CFMetrics.h
+ * 
+ * Runtime metrics shared by the CF helpers.
+ *
+ * Metrics live in fixed-size static tables, so recording never allocates:
+ *      Counters    Monotonic totals (e.g. reconnects, publish failures).
+ *      Gauges      Last value set (e.g. free heap).
+ *      Histograms  Latencies in log2 buckets, plus count and max. Reset on every publish, so
+ *                  they describe the last publish interval.
+ *
+ * A metric is registered once by name (usually in a helper constructor) and the returned id
+ * is used to record it. Registering the same name again returns the same id, and a full
+ * table returns -1, which every record method ignores.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFMetrics_h
+#define CFMetrics_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+#ifndef CF_METRICS_MAX_COUNTERS
+    #define CF_METRICS_MAX_COUNTERS         16                                  // Max counters.
+#endif
+
+#ifndef CF_METRICS_MAX_GAUGES
+    #define CF_METRICS_MAX_GAUGES           8                                   // Max gauges.
+#endif
+
+#ifndef CF_METRICS_MAX_HISTOGRAMS
+    #define CF_METRICS_MAX_HISTOGRAMS       8                                   // Max histograms.
+#endif
+
+#define CF_METRICS_HISTOGRAM_BUCKETS        24                                  // Bucket n holds values in [2^(n-1), 2^n).
+
+class CFMetrics {
+    private:
+        // Histogram.
+        struct Histogram {
+            unsigned long buckets[CF_METRICS_HISTOGRAM_BUCKETS];                // Values per log2 bucket.
+            unsigned long count;                                                // Values recorded.
+            unsigned long max;                                                  // Max value recorded.
+        };
+
+        // Counters.
+        static const char *_counterNames[CF_METRICS_MAX_COUNTERS];              // Counter names.
+        static unsigned long _counters[CF_METRICS_MAX_COUNTERS];                // Counter values.
+        static uint8_t _counterCount;                                           // Registered counters.
+
+        // Gauges.
+        static const char *_gaugeNames[CF_METRICS_MAX_GAUGES];                  // Gauge names.
+        static long _gauges[CF_METRICS_MAX_GAUGES];                             // Gauge values.
+        static uint8_t _gaugeCount;                                             // Registered gauges.
+
+        // Histograms.
+        static const char *_histogramNames[CF_METRICS_MAX_HISTOGRAMS];          // Histogram names.
+        static Histogram _histograms[CF_METRICS_MAX_HISTOGRAMS];                // Histograms.
+        static uint8_t _histogramCount;                                         // Registered histograms.
+
+        // Serialization.
+        static bool _skipLogged;                                                // Flag that indicates a skipped item was logged.
+
+        // Methods.
+        static int _register(const char **names, uint8_t &count,                // Find or add a name.
+                uint8_t max, const char *name);
+        static void _skip(int &cursor);                                         // Skip an item that doesn't fit an empty buffer.
+
+    public:
+        // Registration.
+        static int counter(const char *name);                                   // Register a counter.
+        static int gauge(const char *name);                                     // Register a gauge.
+        static int histogram(const char *name);                                 // Register a histogram.
+
+        // Recording.
+        static void increment(int id);                                          // Increment a counter.
+        static void add(int id, unsigned long value);                           // Add to a counter.
+        static void set(int id, long value);                                    // Set a gauge.
+        static void record(int id, unsigned long value);                        // Record a histogram value.
+
+        // Reading.
+        static unsigned long getCounter(int id);                                // Get counter value.
+        static long getGauge(int id);                                           // Get gauge value.
+        static unsigned long getPercentile(int id, uint8_t percentile);         // Get histogram percentile (bucket upper bound).
+        static unsigned long getMax(int id);                                    // Get histogram max.
+        static unsigned long getCount(int id);                                  // Get histogram count.
+        static void resetHistograms();                                          // Reset all histograms.
+
+        // Serialization.
+        static int getItemCount();                                              // Get metrics to be serialized.
+        static size_t toJson(char *buffer, size_t size, int &cursor);           // Serialize metrics as compact JSON.
+        static size_t toPrometheus(char *buffer, size_t size, int &cursor);     // Serialize metrics as Prometheus text.
+};
+
+#endif
@@ -0,0 +1,702 @@
+/**
+ * CFMqttClient.cpp
+ * 
+ * Minimal MQTT 3.1.1 client for CF IoT devices.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFMqttClient.h>                                                       // CF MQTT Client.
+
+// Packet types (fixed header first byte).
+#define CF_MQTT_CONNECT                     0x10
+#define CF_MQTT_CONNACK                     0x20
+#define CF_MQTT_PUBLISH                     0x30
+#define CF_MQTT_PUBACK                      0x40
+#define CF_MQTT_DUP                         0x08
+#define CF_MQTT_SUBSCRIBE                   0x82
+#define CF_MQTT_SUBACK                      0x90
+#define CF_MQTT_PINGREQ                     0xC0
+#define CF_MQTT_PINGRESP                    0xD0
+#define CF_MQTT_DISCONNECT                  0xE0
+
+/**
+ * Constructor.
+ *
+ * @param client Network client. Use a WiFiClient or a BearSSL::WiFiClientSecure.
+ */
+CFMqttClient::CFMqttClient(Client &client):
+        _client(&client), _txBuffer(nullptr), _rxBuffer(nullptr), _bufferSize(0),
+        _txTopicEnd(0), _txQoS(0), _txStart(0), _txTotal(0),
+        _keepAlive(15), _ttTimeout(5000),
+        _tLastOut(0), _tLastIn(0), _pingOutstanding(false), _tPing(0), _ttPingTimeout(10000),
+        _connected(false), _nextPacketId(0), _lastPacketId(0), _droppedPackets(0),
+        _inFlightCount(0), _ttRetransmit(5000), _maxAttempts(3), _acked(0), _retransmits(0),
+        _rxState(RX_TYPE), _rxType(0), _rxLength(0), _rxShift(0), _rxRead(0),
+        _onMessageCallback(nullptr), _onAckCallback(nullptr), _callbackContext(nullptr) {
+    memset(_inFlight, 0, sizeof(_inFlight));
+}
+
+/**
+ * Allocate packet buffers, CF_MQTT_BUFFER_SIZE each, unless they already are.
+ *
+ * @return False if there's no memory for them.
+ */
+bool CFMqttClient::_allocate() {
+    return _txBuffer || setBufferSize(CF_MQTT_BUFFER_SIZE);
+}
+
+/**
+ * Connect and wait for CONNACK. It blocks up to the connect timeout.
+ *
+ * @param host Broker host.
+ * @param port Broker port.
+ * @param clientId Client id.
+ * @param username User name (ThingsBoard device token) or nullptr.
+ * @return True if the broker accepted the session.
+ */
+bool CFMqttClient::connect(const char *host, uint16_t port, const char *clientId, const char *username) {
+    _connected = false;
+    if (!_allocate() || !_client->connect(host, port)) {
+        return false;
+    }
+    return _handshake(clientId, username);
+}
+
+/**
+ * Connect to an address (e.g. a cached DNS result) and wait for CONNACK. It blocks up to the
+ * connect timeout.
+ *
+ * @param ip Broker address.
+ * @param port Broker port.
+ * @param clientId Client id.
+ * @param username User name (ThingsBoard device token) or nullptr.
+ * @return True if the broker accepted the session.
+ */
+bool CFMqttClient::connect(IPAddress ip, uint16_t port, const char *clientId, const char *username) {
+    _connected = false;
+    if (!_allocate() || !_client->connect(ip, port)) {
+        return false;
+    }
+    return _handshake(clientId, username);
+}
+
+/**
+ * Send CONNECT over the open connection and wait for CONNACK.
+ *
+ * @param clientId Client id.
+ * @param username User name or nullptr.
+ * @return True if the broker accepted the session.
+ */
+bool CFMqttClient::_handshake(const char *clientId, const char *username) {
+    // Variable header: protocol name, level, flags (clean session) and keep alive.
+    size_t position = CF_MQTT_HEADER_SIZE;
+    position = _writeString(position, "MQTT");
+    _txBuffer[position++] = 4;
+    _txBuffer[position++] = 0x02 | (username ? 0x80 : 0);
+    _txBuffer[position++] = _keepAlive >> 8;
+    _txBuffer[position++] = _keepAlive & 0xFF;
+
+    // Payload.
+    position = _writeString(position, clientId);
+    if (position != 0 && username) {
+        position = _writeString(position, username);
+    }
+    if (position == 0 || !_send(CF_MQTT_CONNECT, position - CF_MQTT_HEADER_SIZE)) {
+        _client->stop();
+        return false;
+    }
+
+    // Wait for CONNACK.
+    _rxState = RX_TYPE;
+    unsigned long tStart = millis();
+    while (millis() - tStart < _ttTimeout) {
+        if (_readPacket()) {
+            if (_rxType == CF_MQTT_CONNACK && _rxLength == 2 && _rxBuffer[1] == 0) {
+                _connected = true;
+                _pingOutstanding = false;
+                _tLastIn = millis();
+                // Publishes not acknowledged on the previous connection.
+                return _retransmit(true);
+            }
+            break;
+        }
+        if (!_client->connected()) {
+            return false;
+        }
+        yield();
+    }
+    _client->stop();
+    return false;
+}
+
+/**
+ * Send DISCONNECT and close.
+ */
+void CFMqttClient::disconnect() {
+    if (_connected) {
+        _send(CF_MQTT_DISCONNECT, 0);
+    }
+    _client->stop();
+    _connected = false;
+}
+
+/**
+ * True if session is up.
+ *
+ * @return True if session is up.
+ */
+bool CFMqttClient::connected() {
+    if (_connected && !_client->connected()) {
+        _connected = false;
+    }
+    return _connected;
+}
+
+/**
+ * Read packets and keep session alive.
+ *
+ * @return False if session is down.
+ */
+bool CFMqttClient::loop() {
+    if (!connected()) {
+        return false;
+    }
+    while (_readPacket()) {
+        _handlePacket();
+    }
+    if (!_retransmit(false)) {
+        return false;
+    }
+
+    // Keep alive. A ping not answered in time means the connection is half-open.
+    unsigned long ttKeepAlive = _keepAlive * 1000UL;
+    unsigned long now = millis();
+    if (_pingOutstanding) {
+        if (now - _tPing >= _ttPingTimeout) {
+            _client->stop();
+            _connected = false;
+            return false;
+        }
+    } else if (ttKeepAlive > 0 && (now - _tLastOut >= ttKeepAlive || now - _tLastIn >= ttKeepAlive)) {
+        _send(CF_MQTT_PINGREQ, 0);
+        _tPing = now;
+        _pingOutstanding = true;
+    }
+    return _connected;
+}
+
+/**
+ * Subscribe (QoS 0).
+ *
+ * @param topic Topic filter.
+ * @return True if SUBSCRIBE has been sent.
+ */
+bool CFMqttClient::subscribe(const char *topic) {
+    if (!connected()) {
+        return false;
+    }
+    size_t position = CF_MQTT_HEADER_SIZE;
+    uint16_t packetId = _packetId();
+    _txBuffer[position++] = packetId >> 8;
+    _txBuffer[position++] = packetId & 0xFF;
+    position = _writeString(position, topic);
+    if (position == 0 || position >= _bufferSize) {
+        return false;
+    }
+    _txBuffer[position++] = 0;
+    return _send(CF_MQTT_SUBSCRIBE, position - CF_MQTT_HEADER_SIZE);
+}
+
+/**
+ * Publish a text.
+ *
+ * @param topic Topic.
+ * @param payload Null terminated payload.
+ * @return True if it has been sent.
+ */
+bool CFMqttClient::publish(const char *topic, const char *payload) {
+    size_t capacity;
+    uint8_t *buffer = beginPublish(topic, capacity);
+    size_t length = strlen(payload);
+    if (!buffer || length > capacity) {
+        return false;
+    }
+    memcpy(buffer, payload, length);
+    return endPublish(length);
+}
+
+/**
+ * Start a QoS 0 publish. Write the payload where the returned pointer says, then call
+ * endPublish().
+ *
+ * @param topic Topic.
+ * @param capacity Receives room left for the payload.
+ * @return Where payload goes or nullptr if topic doesn't fit.
+ */
+uint8_t *CFMqttClient::beginPublish(const char *topic, size_t &capacity) {
+    return beginPublish(topic, capacity, 0);
+}
+
+/**
+ * Start a publish. Write the payload where the returned pointer says, then call endPublish().
+ *
+ * @param topic Topic.
+ * @param capacity Receives room left for the payload.
+ * @param qos QoS (0 or 1).
+ * @return Where payload goes or nullptr if topic doesn't fit or the in-flight window is full.
+ */
+uint8_t *CFMqttClient::beginPublish(const char *topic, size_t &capacity, uint8_t qos) {
+    capacity = 0;
+    if ((qos > 0 && _inFlightCount >= CF_MQTT_MAX_INFLIGHT) || !_allocate()) {
+        return nullptr;
+    }
+    size_t position = _writeString(CF_MQTT_HEADER_SIZE, topic);
+    if (position == 0 || position + 2 > _bufferSize) {
+        return nullptr;
+    }
+    if (qos > 0) {
+        // Room for the packet id, filled by endPublish().
+        position += 2;
+    }
+    _txQoS = qos > 0 ? 1 : 0;
+    _txTopicEnd = position;
+    capacity = _bufferSize - position;
+    return _txBuffer + position;
+}
+
+/**
+ * Send publish started with beginPublish(). A QoS 1 publish is kept until PUBACK arrives, and
+ * it's accepted even if the connection is down: it goes out on reconnection.
+ *
+ * @param length Payload length.
+ * @return True if it has been sent (QoS 0) or accepted for delivery (QoS 1).
+ */
+bool CFMqttClient::endPublish(size_t length) {
+    if (_txTopicEnd == 0 || _txTopicEnd + length > _bufferSize) {
+        return false;
+    }
+    size_t packetLength = _txTopicEnd - CF_MQTT_HEADER_SIZE + length;
+    size_t payloadStart = _txTopicEnd;
+    _txTopicEnd = 0;
+    _lastPacketId = 0;
+    if (_txQoS == 0) {
+        return connected() && _send(CF_MQTT_PUBLISH, packetLength);
+    }
+
+    // Fill packet id and keep a copy in a free in-flight slot.
+    InFlight *slot = nullptr;
+    for (uint8_t i = 0; i < CF_MQTT_MAX_INFLIGHT && !slot; i++) {
+        if (_inFlight[i].packetId == 0) {
+            slot = &_inFlight[i];
+        }
+    }
+    if (!slot) {
+        return false;
+    }
+    uint16_t packetId = _packetId();
+    _txBuffer[payloadStart - 2] = packetId >> 8;
+    _txBuffer[payloadStart - 1] = packetId & 0xFF;
+    _frame(CF_MQTT_PUBLISH | 0x02, packetLength);
+
+    slot->packetId = packetId;
+    _lastPacketId = packetId;
+    slot->length = _txTotal;
+    slot->tFirstSent = millis();
+    slot->tSent = slot->tFirstSent;
+    slot->attempts = 1;
+    memcpy(slot->packet, _txBuffer + _txStart, _txTotal);
+    _inFlightCount++;
+    if (connected()) {
+        _write(slot->packet, slot->length);
+    }
+    return true;
+}
+
+/**
+ * Fill fixed header in front of the packet and send it.
+ *
+ * @param type Packet type and flags.
+ * @param length Packet length after the fixed header, written from CF_MQTT_HEADER_SIZE.
+ * @return True if it has been sent.
+ */
+bool CFMqttClient::_send(uint8_t type, size_t length) {
+    _frame(type, length);
+    return _write(_txBuffer + _txStart, _txTotal);
+}
+
+/**
+ * Fill fixed header in front of the packet. The packet is left at _txStart, _txTotal long.
+ *
+ * @param type Packet type and flags.
+ * @param length Packet length after the fixed header, written from CF_MQTT_HEADER_SIZE.
+ */
+void CFMqttClient::_frame(uint8_t type, size_t length) {
+    // Remaining length varint, right aligned with the packet.
+    uint8_t varint[4];
+    uint8_t varintLength = 0;
+    size_t remaining = length;
+    do {
+        uint8_t digit = remaining & 0x7F;
+        remaining >>= 7;
+        varint[varintLength++] = digit | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0 && varintLength < sizeof(varint));
+
+    _txStart = CF_MQTT_HEADER_SIZE - 1 - varintLength;
+    _txBuffer[_txStart] = type;
+    memcpy(_txBuffer + _txStart + 1, varint, varintLength);
+    _txTotal = 1 + varintLength + length;
+}
+
+/**
+ * Write a whole packet. A short write drops the connection.
+ *
+ * @param packet Packet.
+ * @param length Packet length.
+ * @return True if it has been written.
+ */
+bool CFMqttClient::_write(const uint8_t *packet, size_t length) {
+    if (_client->write(packet, length) != length) {
+        _client->stop();
+        _connected = false;
+        return false;
+    }
+    _tLastOut = millis();
+    return true;
+}
+
+/**
+ * Send unacknowledged publishes again, flagged as duplicates. When a publish runs out of
+ * attempts the connection is dropped as half-open; publishes stay for the next connection.
+ *
+ * @param all True to send every one now (after reconnection), false to send timed out ones.
+ * @return False if connection has been dropped.
+ */
+bool CFMqttClient::_retransmit(bool all) {
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < CF_MQTT_MAX_INFLIGHT; i++) {
+        InFlight &slot = _inFlight[i];
+        if (slot.packetId == 0 || (!all && now - slot.tSent < _ttRetransmit)) {
+            continue;
+        }
+        if (all) {
+            slot.attempts = 0;
+        } else if (slot.attempts >= _maxAttempts) {
+            _client->stop();
+            _connected = false;
+            return false;
+        }
+        slot.packet[0] |= CF_MQTT_DUP;
+        slot.tSent = now;
+        slot.attempts++;
+        _retransmits++;
+        if (!_write(slot.packet, slot.length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Write a length prefixed string into the outgoing buffer.
+ *
+ * @param position Position.
+ * @param text Text.
+ * @return Position after the string or 0 if it doesn't fit.
+ */
+size_t CFMqttClient::_writeString(size_t position, const char *text) {
+    size_t length = strlen(text);
+    if (position == 0 || position + 2 + length > _bufferSize) {
+        return 0;
+    }
+    _txBuffer[position++] = length >> 8;
+    _txBuffer[position++] = length & 0xFF;
+    memcpy(_txBuffer + position, text, length);
+    return position + length;
+}
+
+/**
+ * Read available bytes without blocking.
+ *
+ * @return True when a packet is complete in the incoming buffer.
+ */
+bool CFMqttClient::_readPacket() {
+    while (_client->available() > 0) {
+        switch (_rxState) {
+            case RX_TYPE:
+                _rxType = _client->read();
+                _rxLength = 0;
+                _rxShift = 0;
+                _rxState = RX_LENGTH;
+                break;
+
+            case RX_LENGTH: {
+                uint8_t digit = _client->read();
+                _rxLength |= (size_t) (digit & 0x7F) << _rxShift;
+                _rxShift += 7;
+                if (digit & 0x80) {
+                    if (_rxShift > 21) {
+                        // Malformed length, the stream can't be trusted anymore.
+                        _client->stop();
+                        _connected = false;
+                        _rxState = RX_TYPE;
+                        return false;
+                    }
+                    break;
+                }
+                _rxRead = 0;
+                if (_rxLength > _bufferSize) {
+                    _droppedPackets++;
+                    _rxState = RX_SKIP;
+                    break;
+                }
+                if (_rxLength == 0) {
+                    _rxState = RX_TYPE;
+                    _rxBuffer[0] = '\0';
+                    _tLastIn = millis();
+                    return true;
+                }
+                _rxState = RX_BODY;
+                break;
+            }
+
+            case RX_BODY: {
+                size_t wanted = min((size_t) _client->available(), _rxLength - _rxRead);
+                int read = _client->read(_rxBuffer + _rxRead, wanted);
+                if (read <= 0) {
+                    return false;
+                }
+                _rxRead += read;
+                if (_rxRead == _rxLength) {
+                    _rxBuffer[_rxLength] = '\0';
+                    _rxState = RX_TYPE;
+                    _tLastIn = millis();
+                    return true;
+                }
+                break;
+            }
+
+            case RX_SKIP:
+                _client->read();
+                if (++_rxRead == _rxLength) {
+                    _rxState = RX_TYPE;
+                    _tLastIn = millis();
+                }
+                break;
+        }
+    }
+    return false;
+}
+
+/**
+ * Handle a complete packet.
+ */
+void CFMqttClient::_handlePacket() {
+    switch (_rxType & 0xF0) {
+        case CF_MQTT_PUBLISH: {
+            uint8_t qos = (_rxType >> 1) & 0x03;
+            size_t topicLength = (_rxBuffer[0] << 8) | _rxBuffer[1];
+            size_t position = 2 + topicLength + (qos > 0 ? 2 : 0);
+            if (position > _rxLength) {
+                return;
+            }
+            uint16_t packetId = (qos > 0) ? (_rxBuffer[2 + topicLength] << 8) | _rxBuffer[3 + topicLength] : 0;
+
+            // Move topic over its length so it can be null terminated in place.
+            memmove(_rxBuffer, _rxBuffer + 2, topicLength);
+            _rxBuffer[topicLength] = '\0';
+            if (_onMessageCallback) {
+                _onMessageCallback(_callbackContext, (char *) _rxBuffer, _rxBuffer + position, _rxLength - position);
+            }
+
+            if (qos == 1) {
+                size_t ack = CF_MQTT_HEADER_SIZE;
+                _txBuffer[ack++] = packetId >> 8;
+                _txBuffer[ack++] = packetId & 0xFF;
+                _send(CF_MQTT_PUBACK, 2);
+            }
+            break;
+        }
+
+        case CF_MQTT_PUBACK: {
+            if (_rxLength < 2) {
+                return;
+            }
+            uint16_t packetId = (_rxBuffer[0] << 8) | _rxBuffer[1];
+            for (uint8_t i = 0; i < CF_MQTT_MAX_INFLIGHT; i++) {
+                if (_inFlight[i].packetId == packetId) {
+                    _inFlight[i].packetId = 0;
+                    _inFlightCount--;
+                    _acked++;
+                    if (_onAckCallback) {
+                        _onAckCallback(_callbackContext, packetId, millis() - _inFlight[i].tFirstSent);
+                    }
+                    break;
+                }
+            }
+            break;
+        }
+
+        case CF_MQTT_PINGRESP:
+            _pingOutstanding = false;
+            break;
+
+        default:
+            // SUBACK needs nothing as subscriptions are QoS 0.
+            break;
+    }
+}
+
+/**
+ * Get next packet id. 0 isn't a valid id.
+ *
+ * @return Packet id.
+ */
+uint16_t CFMqttClient::_packetId() {
+    if (++_nextPacketId == 0) {
+        _nextPacketId = 1;
+    }
+    return _nextPacketId;
+}
+
+/**
+ * Define max packet size, each direction. The outgoing, incoming and in-flight buffers are
+ * allocated in one block; call it before connecting, it fails while publishes are in flight.
+ *
+ * @param size Max packet size, header included.
+ * @return False if publishes are in flight or there's no memory (the buffers are kept).
+ */
+bool CFMqttClient::setBufferSize(size_t size) {
+    if (size == _bufferSize) {
+        return true;
+    }
+    if (_inFlightCount > 0 || size <= CF_MQTT_HEADER_SIZE) {
+        return false;
+    }
+    uint8_t *buffer = (uint8_t *) realloc(_txBuffer, size * (2 + CF_MQTT_MAX_INFLIGHT) + 1);
+    if (!buffer) {
+        return false;
+    }
+    _txBuffer = buffer;
+    _rxBuffer = buffer + size;
+    for (uint8_t i = 0; i < CF_MQTT_MAX_INFLIGHT; i++) {
+        _inFlight[i].packet = buffer + 2 * size + 1 + i * size;
+    }
+    _bufferSize = size;
+    return true;
+}
+
+/**
+ * Get max packet size.
+ *
+ * @return Max packet size, 0 while the buffers aren't allocated.
+ */
+size_t CFMqttClient::getBufferSize() {
+    return _bufferSize;
+}
+
+/**
+ * Define on message callback.
+ *
+ * @param callback Callback. Topic and payload are only valid while it runs.
+ * @param context Context passed to the callback (e.g. the helper).
+ */
+void CFMqttClient::setOnMessageCallback(MessageCallback callback, void *context) {
+    _onMessageCallback = callback;
+    _callbackContext = context;
+}
+
+/**
+ * Define on PUBACK callback. It gets the context given to setOnMessageCallback().
+ *
+ * @param callback Callback, with packet id and time from first send to PUBACK.
+ */
+void CFMqttClient::setOnAckCallback(AckCallback callback) {
+    _onAckCallback = callback;
+}
+
+/**
+ * Define keep alive.
+ *
+ * @param keepAlive Keep alive (s). Takes effect on next connection.
+ */
+void CFMqttClient::setKeepAlive(uint16_t keepAlive) {
+    _keepAlive = keepAlive;
+}
+
+/**
+ * Define time waiting for CONNACK.
+ *
+ * @param ttTimeout Time waiting for CONNACK.
+ */
+void CFMqttClient::setConnectTimeout(unsigned long ttTimeout) {
+    _ttTimeout = ttTimeout;
+}
+
+/**
+ * Define time waiting for PINGRESP before the connection is taken as half-open.
+ *
+ * @param ttPingTimeout Time waiting for PINGRESP.
+ */
+void CFMqttClient::setPingTimeout(unsigned long ttPingTimeout) {
+    _ttPingTimeout = ttPingTimeout;
+}
+
+/**
+ * Define PUBACK timeout and attempts. A publish still unacknowledged after the last attempt
+ * drops the connection.
+ *
+ * @param ttRetransmit Time waiting for PUBACK before sending again.
+ * @param maxAttempts Attempts per connection.
+ */
+void CFMqttClient::setRetransmit(unsigned long ttRetransmit, uint8_t maxAttempts) {
+    _ttRetransmit = ttRetransmit;
+    _maxAttempts = maxAttempts;
+}
+
+/**
+ * Get publishes waiting for PUBACK.
+ *
+ * @return Publishes in flight.
+ */
+uint8_t CFMqttClient::getInFlightCount() {
+    return _inFlightCount;
+}
+
+/**
+ * Get acknowledged publishes.
+ *
+ * @return Acknowledged publishes.
+ */
+unsigned long CFMqttClient::getAckedCount() {
+    return _acked;
+}
+
+/**
+ * Get publishes sent again.
+ *
+ * @return Retransmissions.
+ */
+unsigned long CFMqttClient::getRetransmitCount() {
+    return _retransmits;
+}
+
+/**
+ * Get incoming packets that were too big for the buffer and have been skipped.
+ *
+ * @return Dropped packets.
+ */
+unsigned long CFMqttClient::getDroppedPackets() {
+    return _droppedPackets;
+}
+
+/**
+ * Get packet id of last publish sent by endPublish(), to match it with its PUBACK.
+ *
+ * @return Packet id or 0 if it was a QoS 0 or failed publish.
+ */
+uint16_t CFMqttClient::getLastPacketId() {
+    return _lastPacketId;
+}
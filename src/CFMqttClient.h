@@ -0,0 +1,153 @@
+/**
+ * CFMqttClient.h
+ * 
+ * Minimal MQTT 3.1.1 client for CF IoT devices.
+ *
+ * Payloads are written straight into the packet buffer:
+ *
+ *      size_t capacity;
+ *      uint8_t *payload = _mqtt.beginPublish("v1/devices/me/telemetry", capacity);
+ *      size_t length = serializeJson(doc, (char *) payload, capacity);
+ *      _mqtt.endPublish(length);
+ *
+ * The fixed header is filled in front of the topic by endPublish(), so nothing is copied.
+ * Incoming packets are read without blocking across loop() calls. Received messages are handed
+ * to the callback in place, with both topic and payload null terminated.
+ *
+ * QoS 1 publishes are kept in a bounded in-flight window until PUBACK arrives. Unacknowledged
+ * ones are sent again (DUP) after a timeout; when retries run out the connection is taken as
+ * half-open and dropped. The window survives the reconnection and is sent again, so QoS 1 data
+ * is delivered at least once. beginPublish() returns nullptr while the window is full.
+ *
+ * The outgoing, incoming and in-flight packet buffers are allocated together, once, the first
+ * time they're needed, CF_MQTT_BUFFER_SIZE bytes each. setBufferSize() sizes them before that,
+ * e.g. from a CFDevice component list.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFMqttClient_h
+#define CFMqttClient_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <Client.h>                                                             // Arduino client.
+
+#ifndef CF_MQTT_BUFFER_SIZE
+    #define CF_MQTT_BUFFER_SIZE             256                                 // Default max packet size (each direction).
+#endif
+
+#ifndef CF_MQTT_MAX_INFLIGHT
+    #define CF_MQTT_MAX_INFLIGHT            4                                   // QoS 1 publishes waiting for PUBACK.
+#endif
+
+#define CF_MQTT_HEADER_SIZE                 5                                   // Room for the fixed header (type + remaining length).
+
+class CFMqttClient {
+    private:
+        // Aliases.
+        using MessageCallback = void (*)(void *context, char *topic,            // Alias for message callback.
+                uint8_t *payload, size_t length);
+        using AckCallback = void (*)(void *context, uint16_t packetId,         // Alias for PUBACK callback.
+                unsigned long ackTime);
+
+        // QoS 1 publish waiting for PUBACK.
+        struct InFlight {
+            uint16_t packetId;                                                  // Packet id (0 if slot is free).
+            uint16_t length;                                                    // Packet length.
+            unsigned long tFirstSent;                                           // First time it was sent.
+            unsigned long tSent;                                                // Last time it was sent.
+            uint8_t attempts;                                                   // Attempts on this connection.
+            uint8_t *packet;                                                    // Whole packet (in the packet buffers).
+        };
+
+        // Receive state.
+        enum RxState {RX_TYPE, RX_LENGTH, RX_BODY, RX_SKIP};
+
+        // Attributes.
+        Client *_client;                                                        // Network client.
+        uint8_t *_txBuffer;                                                     // Outgoing packet (nullptr until allocated).
+        uint8_t *_rxBuffer;                                                     // Incoming packet (+1 for terminator).
+        size_t _bufferSize;                                                     // Max packet size (each direction).
+        size_t _txTopicEnd;                                                     // Payload start in outgoing publish.
+        uint8_t _txQoS;                                                         // QoS of outgoing publish.
+        size_t _txStart;                                                        // Start of last framed packet.
+        size_t _txTotal;                                                        // Length of last framed packet.
+        uint16_t _keepAlive;                                                    // Keep alive (s).
+        unsigned long _ttTimeout;                                               // Time waiting for CONNACK.
+        unsigned long _tLastOut;                                                // Last time a packet was sent.
+        unsigned long _tLastIn;                                                 // Last time a packet was received.
+        bool _pingOutstanding;                                                  // Flag that indicates a PINGREQ is waiting response.
+        unsigned long _tPing;                                                   // Last time PINGREQ was sent.
+        unsigned long _ttPingTimeout;                                           // Time waiting for PINGRESP.
+        bool _connected;                                                        // Flag that indicates session is up.
+        uint16_t _nextPacketId;                                                 // Next packet id.
+        uint16_t _lastPacketId;                                                 // Packet id of last publish (0 if QoS 0).
+        unsigned long _droppedPackets;                                          // Incoming packets too big for the buffer.
+
+        // In-flight attributes.
+        InFlight _inFlight[CF_MQTT_MAX_INFLIGHT];                               // QoS 1 publishes waiting for PUBACK.
+        uint8_t _inFlightCount;                                                 // Slots in use.
+        unsigned long _ttRetransmit;                                            // Time waiting for PUBACK before sending again.
+        uint8_t _maxAttempts;                                                   // Attempts before dropping the connection.
+        unsigned long _acked;                                                   // Acknowledged publishes.
+        unsigned long _retransmits;                                             // Publishes sent again.
+
+        // Receive attributes.
+        RxState _rxState;                                                       // Receive state.
+        uint8_t _rxType;                                                        // Incoming packet type and flags.
+        size_t _rxLength;                                                       // Incoming remaining length.
+        uint8_t _rxShift;                                                       // Remaining length varint shift.
+        size_t _rxRead;                                                         // Incoming bytes read.
+
+        // Callbacks.
+        MessageCallback _onMessageCallback;                                     // On message callback.
+        AckCallback _onAckCallback;                                             // On PUBACK callback.
+        void *_callbackContext;                                                 // Context passed to the callbacks.
+
+        // Methods.
+        bool _allocate();                                                       // Allocate packet buffers if not yet.
+        bool _handshake(const char *clientId, const char *username);            // Send CONNECT and wait for CONNACK.
+        bool _send(uint8_t type, size_t length);                                // Fill fixed header and send a packet.
+        void _frame(uint8_t type, size_t length);                               // Fill fixed header in front of a packet.
+        bool _write(const uint8_t *packet, size_t length);                      // Write a whole packet.
+        bool _retransmit(bool all);                                             // Send unacknowledged publishes again.
+        size_t _writeString(size_t position, const char *text);                 // Write a length prefixed string.
+        bool _readPacket();                                                     // Read available bytes. True when a packet is complete.
+        void _handlePacket();                                                   // Handle a complete packet.
+        uint16_t _packetId();                                                   // Get next packet id.
+
+    public:
+        // Methods.
+        CFMqttClient(Client &client);                                           // Constructor.
+        bool connect(const char *host, uint16_t port, const char *clientId,     // Connect and wait for CONNACK.
+                const char *username);
+        bool connect(IPAddress ip, uint16_t port, const char *clientId,         // Connect to an address and wait for CONNACK.
+                const char *username);
+        void disconnect();                                                      // Send DISCONNECT and close.
+        bool connected();                                                       // True if session is up.
+        bool loop();                                                            // Read packets and keep session alive.
+        bool subscribe(const char *topic);                                      // Subscribe (QoS 0).
+        bool publish(const char *topic, const char *payload);                   // Publish a text.
+        uint8_t *beginPublish(const char *topic, size_t &capacity);             // Start a QoS 0 publish. Returns where payload goes.
+        uint8_t *beginPublish(const char *topic, size_t &capacity, uint8_t qos);// Start a publish. Returns where payload goes.
+        bool endPublish(size_t length);                                         // Send publish started with beginPublish().
+
+        // Accessors.
+        bool setBufferSize(size_t size);                                        // Define max packet size (each direction).
+        size_t getBufferSize();                                                 // Get max packet size.
+        void setOnMessageCallback(MessageCallback callback, void *context);     // Define on message callback.
+        void setOnAckCallback(AckCallback callback);                            // Define on PUBACK callback.
+        void setKeepAlive(uint16_t keepAlive);                                  // Define keep alive (s).
+        void setConnectTimeout(unsigned long ttTimeout);                        // Define time waiting for CONNACK.
+        void setPingTimeout(unsigned long ttPingTimeout);                       // Define time waiting for PINGRESP.
+        void setRetransmit(unsigned long ttRetransmit, uint8_t maxAttempts);    // Define PUBACK timeout and attempts.
+        uint8_t getInFlightCount();                                             // Get publishes waiting for PUBACK.
+        unsigned long getAckedCount();                                          // Get acknowledged publishes.
+        unsigned long getRetransmitCount();                                     // Get publishes sent again.
+        unsigned long getDroppedPackets();                                      // Get incoming packets too big for the buffer.
+        uint16_t getLastPacketId();                                             // Get packet id of last publish.
+};
+
+#endif
@@ -0,0 +1,318 @@
+/**
+ * CFNotificationHelper.cpp
+ * 
+ * A library for Arduino that helps to send HTTPS notifications without freezing loop().
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFNotificationHelper.h>                                               // CF Notification Helper.
+
+/**
+ * Constructor. The HTTPS client of its own is allocated here, before CFHeap::seal().
+ */
+CFNotificationHelper::CFNotificationHelper():
+        CFNotificationHelper(*new CFHttpsClient()) {
+    _ownsClient = true;
+}
+
+/**
+ * Constructor with shared HTTPS client.
+ *
+ * @param https HTTPS client.
+ */
+CFNotificationHelper::CFNotificationHelper(CFHttpsClient &https):
+        _https(&https), _ownsClient(false), _keepAlive(false),
+        _head(0), _count(0),
+        _lineLength(0), _state(IDLE), _httpCode(0), _contentLength(-1),
+        _tRequest(0),
+        _ttResponse(10000), _ttKeepAlive(30000), _ttRetry(2000), _ttMaxRetry(60000), _maxAttempts(5) {
+    
+}
+
+/**
+ * Destructor.
+ */
+CFNotificationHelper::~CFNotificationHelper() {
+    if (_ownsClient) {
+        delete _https;
+    }
+}
+
+/**
+ * Loop.
+ */
+void CFNotificationHelper::loop() {
+    // Request in progress.
+    if (_state != IDLE) {
+        _readResponse();
+        if (_state != IDLE && (millis() - _tRequest) > _ttResponse) {
+            Logger::warning("Notification response timeout.");
+            _finish(false);
+        }
+        return;
+    }
+
+    // Close idle connection, unless another helper is using it.
+    _https->stopIfIdle(_ttKeepAlive);
+
+    // Check the next notification.
+    if (_count == 0) {
+        return;
+    }
+    Notification &notification = _queue[_head];
+    if ((long) (millis() - notification.tNextAttempt) < 0) {
+        // It's not time to retry.
+        return;
+    }
+    if (!_https->acquire(this)) {
+        // Another helper's request is in progress.
+        return;
+    }
+    if (!_send(notification)) {
+        _finish(false);
+    }
+}
+
+/**
+ * Queue a notification.
+ *
+ * @param target Target that receives the notification.
+ * @param message Message. It's truncated if it doesn't fit CF_NOTIFICATION_MESSAGE_SIZE.
+ * @return False if queue is full.
+ */
+bool CFNotificationHelper::notify(CFNotificationTarget *target, const char *message) {
+    if (_count >= CF_NOTIFICATION_QUEUE_SIZE) {
+        Logger::warning("Notification queue is full. Notification discarded.");
+        return false;
+    }
+
+    Notification &notification = _queue[(_head + _count) % CF_NOTIFICATION_QUEUE_SIZE];
+    notification.target = target;
+    strlcpy(notification.message, message, sizeof(notification.message));
+    notification.attempts = 0;
+    notification.tNextAttempt = millis();
+    _count++;
+    return true;
+}
+
+/**
+ * Connect and send request.
+ * Connection is reused when it's still open to the same host.
+ *
+ * @param notification Notification.
+ * @return False if it couldn't be sent.
+ */
+bool CFNotificationHelper::_send(Notification &notification) {
+    CFNotificationTarget *target = notification.target;
+    const char *host = target->getHost();
+
+    // Build the whole request, so it goes in a single TLS record.
+    CFUrlWriter request(_request, sizeof(_request));
+    request.append("GET ");
+    target->writePath(request, notification.message);
+    request.append(" HTTP/1.1\r\nHost: ").append(host)
+           .append("\r\nUser-Agent: CF\r\nConnection: keep-alive\r\n\r\n");
+    if (!request.isValid()) {
+        Logger::error("Notification request doesn't fit CF_NOTIFICATION_REQUEST_SIZE.");
+        notification.attempts = _maxAttempts;                                   // Retrying won't help.
+        return false;
+    }
+
+    // Connect.
+    bool reused = _https->isConnectedTo(host, target->getPort());
+    if (!_https->connect(host, target->getPort())) {
+        Logger::warning("Fail connecting to " + String(host) + ".");
+        return false;
+    }
+
+    // Send.
+    CF_TRACE_EVENT(CFTrace::NOTIFY_SEND, _count, notification.attempts);
+    _https->beginRequest();
+    if (_https->write((const uint8_t *) _request, request.length()) != request.length()) {
+        _https->stop();
+        // Kept connection was closed by the server, try again with a new one.
+        return reused ? _send(notification) : false;
+    }
+
+    _state = STATUS;
+    _httpCode = 0;
+    _contentLength = -1;
+    _keepAlive = true;
+    _lineLength = 0;
+    _tRequest = millis();
+    return true;
+}
+
+/**
+ * Read available response bytes.
+ * It never waits for data, whatever isn't there yet is read in the next loop.
+ */
+void CFNotificationHelper::_readResponse() {
+    // Status line and headers are read line by line.
+    while ((_state == STATUS || _state == HEADERS) && _https->available() > 0) {
+        char c = _https->read();
+        if (c == '\n') {
+            if (_lineLength > 0 && _line[_lineLength - 1] == '\r') {
+                _lineLength--;
+            }
+            _line[_lineLength] = '\0';
+            _processLine();
+            _lineLength = 0;
+        } else if (_lineLength < sizeof(_line) - 1) {
+            _line[_lineLength++] = c;
+        }
+    }
+
+    // Body is discarded, it's only drained so the connection can be reused.
+    if (_state == BODY) {
+        uint8_t buffer[64];
+        int available;
+        while (_contentLength > 0 && (available = _https->available()) > 0) {
+            size_t len = min((long) sizeof(buffer), min((long) available, _contentLength));
+            _contentLength -= _https->read(buffer, len);
+        }
+        if (_contentLength <= 0) {
+            _finish(_httpCode >= 200 && _httpCode < 300);
+        }
+    }
+
+    // Connection closed before the response was complete.
+    if (_state != IDLE && !_https->connected() && _https->available() <= 0) {
+        _finish(false);
+    }
+}
+
+/**
+ * Process a response line.
+ */
+void CFNotificationHelper::_processLine() {
+    // Status line. E.g.: "HTTP/1.1 200 OK".
+    if (_state == STATUS) {
+        const char *code = strchr(_line, ' ');
+        _httpCode = code ? atoi(code + 1) : 0;
+        _state = HEADERS;
+        return;
+    }
+
+    // End of headers.
+    if (_lineLength == 0) {
+        if (_contentLength < 0) {
+            _keepAlive = false;                                                 // Unknown body length (e.g. chunked).
+        }
+        if (_keepAlive && _contentLength > 0) {
+            _state = BODY;
+        } else {
+            _finish(_httpCode >= 200 && _httpCode < 300);
+        }
+        return;
+    }
+
+    // Headers.
+    if (strncasecmp(_line, "Content-Length:", 15) == 0) {
+        _contentLength = atol(_line + 15);
+    } else if (strncasecmp(_line, "Connection:", 11) == 0 && strstr(_line + 11, "close")) {
+        _keepAlive = false;
+    }
+}
+
+/**
+ * Finish current notification.
+ * On failure it's retried with exponential backoff until max attempts.
+ *
+ * @param success True if it was sent.
+ */
+void CFNotificationHelper::_finish(bool success) {
+    _state = IDLE;
+
+    Notification &notification = _queue[_head];
+    bool done = true;
+    if (success) {
+        _https->endRequest();
+        Logger::notice("A notification has been sent in " + String(_https->getLastRequestTime()) + " ms.");
+        if (!_keepAlive) {
+            _https->stop();
+        }
+    } else {
+        _https->stop();
+        notification.attempts++;
+        if (notification.attempts >= _maxAttempts) {
+            Logger::error("Sending notification has failed. Discarded after " + String(notification.attempts) + " attempt(s).");
+        } else {
+            unsigned long delay = _ttRetry;
+            for (uint8_t i = 1; i < notification.attempts && delay < _ttMaxRetry; i++) {
+                delay <<= 1;
+            }
+            delay = min(delay, _ttMaxRetry);
+            notification.tNextAttempt = millis() + delay;
+            Logger::warning("Sending notification has failed (HTTP " + String(_httpCode) + "). Retrying in " + String(delay / 1000) + " second(s).");
+            done = false;
+        }
+    }
+
+    // Remove from queue.
+    if (done) {
+        _head = (_head + 1) % CF_NOTIFICATION_QUEUE_SIZE;
+        _count--;
+    }
+    _https->release(this);
+}
+
+/**
+ * True if there is something queued or in progress.
+ *
+ * @return True if it's busy.
+ */
+bool CFNotificationHelper::isBusy() {
+    return _count > 0;
+}
+
+/**
+ * Get queued notifications.
+ *
+ * @return Queued notifications, including the one in progress.
+ */
+int CFNotificationHelper::getQueuedCount() {
+    return _count;
+}
+
+/**
+ * Get HTTPS client.
+ *
+ * @return HTTPS client, for its handshake and request metrics.
+ */
+CFHttpsClient &CFNotificationHelper::getHttpsClient() {
+    return *_https;
+}
+
+/**
+ * Define response timeout.
+ *
+ * @param ttResponse Response timeout.
+ */
+void CFNotificationHelper::setResponseTimeout(unsigned long ttResponse) {
+    _ttResponse = ttResponse;
+}
+
+/**
+ * Define retry backoff.
+ * Time between retries doubles on every failure up to the max.
+ *
+ * @param ttRetry Time before first retry.
+ * @param ttMaxRetry Max time between retries.
+ */
+void CFNotificationHelper::setRetryInterval(unsigned long ttRetry, unsigned long ttMaxRetry) {
+    _ttRetry = ttRetry;
+    _ttMaxRetry = ttMaxRetry;
+}
+
+/**
+ * Define max attempts per notification.
+ *
+ * @param maxAttempts Max attempts.
+ */
+void CFNotificationHelper::setMaxAttempts(uint8_t maxAttempts) {
+    _maxAttempts = maxAttempts > 0 ? maxAttempts : 1;
+}
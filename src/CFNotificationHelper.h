@@ -0,0 +1,108 @@
+/**
+ * CFNotificationHelper.h
+ * 
+ * A library for Arduino that helps to send HTTPS notifications without freezing loop().
+ *
+ * Notifications are queued (bounded) and sent one at a time from loop(). The TLS connect is
+ * the only blocking step and it's kept short by CFHttpsClient, which resumes cached TLS
+ * sessions and reuses the connection (keep-alive) while the server allows it. The client
+ * can be shared with other helpers: a notification waits while another helper's request is in
+ * progress. A client of its own is only allocated when none is shared. Waiting for and
+ * reading the response is spread across loop() iterations. Failed notifications are retried
+ * with exponential backoff until the max attempts is reached.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFNotificationHelper_h
+#define CFNotificationHelper_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <Logger.h>                                                             // Logger.
+#include <CFHttpsClient.h>                                                      // CF HTTPS Client.
+#include <CFUrlWriter.h>                                                        // CF URL Writer.
+#include <CFNotificationTarget.h>                                               // CF Notification Target.
+#include <CFTrace.h>                                                           // CF Trace.
+
+#ifndef CF_NOTIFICATION_QUEUE_SIZE
+    #define CF_NOTIFICATION_QUEUE_SIZE      4                                   // Max queued notifications.
+#endif
+
+#ifndef CF_NOTIFICATION_MESSAGE_SIZE
+    #define CF_NOTIFICATION_MESSAGE_SIZE    64                                  // Max message length (with terminator).
+#endif
+
+#ifndef CF_NOTIFICATION_REQUEST_SIZE
+    #define CF_NOTIFICATION_REQUEST_SIZE    400                                 // Max HTTP request length.
+#endif
+
+class CFNotificationHelper {
+    private:
+        // Send states.
+        enum State {
+            IDLE,                                                               // Nothing in progress.
+            STATUS,                                                             // Waiting for status line.
+            HEADERS,                                                            // Reading headers.
+            BODY                                                                // Draining body.
+        };
+
+        // Queued notification.
+        struct Notification {
+            CFNotificationTarget *target;                                       // Target.
+            char message[CF_NOTIFICATION_MESSAGE_SIZE];                         // Message.
+            uint8_t attempts;                                                   // Failed attempts.
+            unsigned long tNextAttempt;                                         // Time of next attempt.
+        };
+
+        // Connection attributes.
+        CFHttpsClient *_https;                                                  // HTTPS client.
+        bool _ownsClient;                                                       // Flag that indicates client isn't shared.
+        bool _keepAlive;                                                        // Flag that indicates server keeps the connection.
+
+        // Queue attributes.
+        Notification _queue[CF_NOTIFICATION_QUEUE_SIZE];                        // Queue.
+        uint8_t _head;                                                          // First notification.
+        uint8_t _count;                                                         // Queued notifications.
+
+        // Request attributes.
+        char _request[CF_NOTIFICATION_REQUEST_SIZE];                            // HTTP request.
+        char _line[128];                                                        // Response line being read.
+        uint8_t _lineLength;                                                    // Response line length.
+        State _state;                                                           // Send state.
+        int _httpCode;                                                          // Response status code.
+        long _contentLength;                                                    // Response body length left (-1 if unknown).
+
+        // Loop control.
+        unsigned long _tRequest;                                                // Time request was sent.
+        unsigned long _ttResponse;                                              // Response timeout.
+        unsigned long _ttKeepAlive;                                             // Time an idle connection is kept.
+        unsigned long _ttRetry;                                                 // Time before first retry.
+        unsigned long _ttMaxRetry;                                              // Max time between retries.
+        uint8_t _maxAttempts;                                                   // Max attempts per notification.
+
+        // Methods.
+        bool _send(Notification &notification);                                 // Connect and send request.
+        void _readResponse();                                                   // Read available response bytes.
+        void _processLine();                                                    // Process a response line.
+        void _finish(bool success);                                             // Finish current notification.
+
+    public:
+        // Methods.
+        CFNotificationHelper();                                                 // Constructor.
+        CFNotificationHelper(CFHttpsClient &https);                             // Constructor with shared HTTPS client.
+        ~CFNotificationHelper();                                                // Destructor.
+        void loop();                                                            // Loop.
+        bool notify(CFNotificationTarget *target, const char *message);         // Queue a notification.
+
+        // Accessors.
+        bool isBusy();                                                          // True if there is something queued or in progress.
+        int getQueuedCount();                                                   // Get queued notifications.
+        CFHttpsClient &getHttpsClient();                                        // Get HTTPS client (metrics).
+        void setResponseTimeout(unsigned long ttResponse);                      // Define response timeout.
+        void setRetryInterval(unsigned long ttRetry, unsigned long ttMaxRetry); // Define retry backoff.
+        void setMaxAttempts(uint8_t maxAttempts);                               // Define max attempts per notification.
+};
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * CFNotificationTarget.cpp
+ * 
+ * Notification targets for CFNotificationHelper.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFNotificationTarget.h>                                               // CF Notification Target.
+
+/**
+ * Get port.
+ *
+ * @return HTTPS port.
+ */
+uint16_t CFNotificationTarget::getPort() {
+    return 443;
+}
+
+/**
+ * Constructor.
+ */
+CFTelegramTarget::CFTelegramTarget() {
+    set("", "");
+}
+
+/**
+ * Define bot token and chat id.
+ *
+ * @param botToken Bot token.
+ * @param chatId Chat id.
+ */
+void CFTelegramTarget::set(const char *botToken, const char *chatId) {
+    strlcpy(_botToken, botToken, sizeof(_botToken));
+    strlcpy(_chatId, chatId, sizeof(_chatId));
+}
+
+/**
+ * Get host.
+ *
+ * @return Host.
+ */
+const char *CFTelegramTarget::getHost() {
+    return "api.telegram.org";
+}
+
+/**
+ * Write request path for a message.
+ *
+ * @param url URL writer.
+ * @param message Message.
+ */
+void CFTelegramTarget::writePath(CFUrlWriter &url, const char *message) {
+    url.append("/bot").append(_botToken).append("/sendMessage")
+       .append("?chat_id=").appendEncoded(_chatId)
+       .append("&text=").appendEncoded(message);
+}
+
+/**
+ * Constructor.
+ */
+CFWhatsAppTarget::CFWhatsAppTarget() {
+    set("", "");
+}
+
+/**
+ * Define phone and API key.
+ *
+ * @param phone Phone.
+ * @param apiKey CallMeBot API key.
+ */
+void CFWhatsAppTarget::set(const char *phone, const char *apiKey) {
+    strlcpy(_phone, phone, sizeof(_phone));
+    strlcpy(_apiKey, apiKey, sizeof(_apiKey));
+}
+
+/**
+ * Get host.
+ *
+ * @return Host.
+ */
+const char *CFWhatsAppTarget::getHost() {
+    return "api.callmebot.com";
+}
+
+/**
+ * Write request path for a message.
+ *
+ * @param url URL writer.
+ * @param message Message.
+ */
+void CFWhatsAppTarget::writePath(CFUrlWriter &url, const char *message) {
+    url.append("/whatsapp.php")
+       .append("?phone=").appendEncoded(_phone)
+       .append("&text=").appendEncoded(message)
+       .append("&apikey=").appendEncoded(_apiKey);
+}
+
+/**
+ * Constructor.
+ */
+CFWebhookTarget::CFWebhookTarget():
+        _port(443) {
+    _host[0] = '\0';
+    _path[0] = '\0';
+    strlcpy(_messageParam, "message", sizeof(_messageParam));
+}
+
+/**
+ * Define URL and message parameter.
+ * URL must be like "https://host[:port]/path[?query]".
+ *
+ * @param url Webhook URL.
+ * @param messageParam Query parameter that carries the message.
+ * @return False if URL is not valid or doesn't fit.
+ */
+bool CFWebhookTarget::set(const char *url, const char *messageParam) {
+    _host[0] = '\0';
+    strlcpy(_messageParam, messageParam, sizeof(_messageParam));
+
+    // Skip scheme.
+    const char *start = strstr(url, "://");
+    start = start ? start + 3 : url;
+
+    // Split host, port and path.
+    const char *path = strchr(start, '/');
+    const char *end = path ? path : start + strlen(start);
+    const char *colon = (const char *) memchr(start, ':', end - start);
+    size_t hostLength = (colon ? colon : end) - start;
+    if (hostLength == 0 || hostLength >= sizeof(_host)) {
+        return false;
+    }
+    _port = colon ? atoi(colon + 1) : 443;
+    if (strlcpy(_path, path ? path : "/", sizeof(_path)) >= sizeof(_path)) {
+        return false;
+    }
+    memcpy(_host, start, hostLength);
+    _host[hostLength] = '\0';
+    return true;
+}
+
+/**
+ * Get host.
+ *
+ * @return Host.
+ */
+const char *CFWebhookTarget::getHost() {
+    return _host;
+}
+
+/**
+ * Get port.
+ *
+ * @return Port.
+ */
+uint16_t CFWebhookTarget::getPort() {
+    return _port;
+}
+
+/**
+ * Write request path for a message.
+ *
+ * @param url URL writer.
+ * @param message Message.
+ */
+void CFWebhookTarget::writePath(CFUrlWriter &url, const char *message) {
+    url.append(_path)
+       .append(strchr(_path, '?') ? '&' : '?')
+       .append(_messageParam).append('=').appendEncoded(message);
+}
@@ -0,0 +1,72 @@
+/**
+ * CFNotificationTarget.h
+ * 
+ * Notification targets for CFNotificationHelper.
+ *
+ * A target knows which host receives the notification and how to write the request path for a
+ * message. Parameters are copied into fixed buffers, so targets can be reconfigured straight
+ * from WiFiManager parameters at any time.
+ *
+ * Targets:
+ *      CFTelegramTarget    Telegram bot API (sendMessage).
+ *      CFWhatsAppTarget    WhatsApp through CallMeBot.
+ *      CFWebhookTarget     Any HTTPS GET webhook, message is appended as a query parameter.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFNotificationTarget_h
+#define CFNotificationTarget_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <CFUrlWriter.h>                                                        // CF URL Writer.
+
+class CFNotificationTarget {
+    public:
+        virtual const char *getHost() = 0;                                      // Get host.
+        virtual uint16_t getPort();                                             // Get port.
+        virtual void writePath(CFUrlWriter &url, const char *message) = 0;      // Write request path for a message.
+};
+
+class CFTelegramTarget : public CFNotificationTarget {
+    private:
+        char _botToken[100];                                                    // Bot token.
+        char _chatId[50];                                                       // Chat id.
+
+    public:
+        CFTelegramTarget();                                                     // Constructor.
+        void set(const char *botToken, const char *chatId);                     // Define bot token and chat id.
+        const char *getHost();                                                  // Get host.
+        void writePath(CFUrlWriter &url, const char *message);                  // Write request path for a message.
+};
+
+class CFWhatsAppTarget : public CFNotificationTarget {
+    private:
+        char _phone[20];                                                        // Phone.
+        char _apiKey[20];                                                       // CallMeBot API key.
+
+    public:
+        CFWhatsAppTarget();                                                     // Constructor.
+        void set(const char *phone, const char *apiKey);                        // Define phone and API key.
+        const char *getHost();                                                  // Get host.
+        void writePath(CFUrlWriter &url, const char *message);                  // Write request path for a message.
+};
+
+class CFWebhookTarget : public CFNotificationTarget {
+    private:
+        char _host[64];                                                         // Host.
+        uint16_t _port;                                                         // Port.
+        char _path[128];                                                        // Path with query.
+        char _messageParam[16];                                                 // Query parameter that carries the message.
+
+    public:
+        CFWebhookTarget();                                                      // Constructor.
+        bool set(const char *url, const char *messageParam);                    // Define URL and message parameter.
+        const char *getHost();                                                  // Get host.
+        uint16_t getPort();                                                     // Get port.
+        void writePath(CFUrlWriter &url, const char *message);                  // Write request path for a message.
+};
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * CFProtobufWriter.cpp
+ * 
+ * Writes protobuf (proto3 wire format) fields into a caller owned buffer.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFProtobufWriter.h>                                                   // CF Protobuf Writer.
+
+// Wire types.
+#define CF_PB_VARINT                        0
+#define CF_PB_LENGTH_DELIMITED              2
+#define CF_PB_FIXED32                       5
+
+/**
+ * Constructor.
+ *
+ * @param buffer Output buffer.
+ * @param size Buffer size.
+ */
+CFProtobufWriter::CFProtobufWriter(uint8_t *buffer, size_t size):
+        _buffer(buffer), _size(size) {
+    reset();
+}
+
+/**
+ * Write an int32/int64 field. Negative values take 10 bytes, as proto3 int32 does; use small
+ * offsets in the schema if values are often negative.
+ *
+ * @param field Field number.
+ * @param value Value.
+ * @return Writer.
+ */
+CFProtobufWriter &CFProtobufWriter::writeInt(uint32_t field, long value) {
+    _writeTag(field, CF_PB_VARINT);
+    _writeVarint((uint64_t) (int64_t) value);
+    return *this;
+}
+
+/**
+ * Write a float field (little endian fixed32).
+ *
+ * @param field Field number.
+ * @param value Value.
+ * @return Writer.
+ */
+CFProtobufWriter &CFProtobufWriter::writeFloat(uint32_t field, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    _writeTag(field, CF_PB_FIXED32);
+    for (int i = 0; i < 4; i++) {
+        _writeByte(bits >> (8 * i));
+    }
+    return *this;
+}
+
+/**
+ * Write a string field.
+ *
+ * @param field Field number.
+ * @param text Text.
+ * @return Writer.
+ */
+CFProtobufWriter &CFProtobufWriter::writeString(uint32_t field, const char *text) {
+    size_t length = strlen(text);
+    _writeTag(field, CF_PB_LENGTH_DELIMITED);
+    _writeVarint(length);
+    if (_length + length > _size) {
+        _overflow = true;
+        return *this;
+    }
+    memcpy(_buffer + _length, text, length);
+    _length += length;
+    return *this;
+}
+
+/**
+ * Write a bool field.
+ *
+ * @param field Field number.
+ * @param value Value.
+ * @return Writer.
+ */
+CFProtobufWriter &CFProtobufWriter::writeBool(uint32_t field, bool value) {
+    _writeTag(field, CF_PB_VARINT);
+    _writeByte(value ? 1 : 0);
+    return *this;
+}
+
+/**
+ * Discard written data.
+ */
+void CFProtobufWriter::reset() {
+    _length = 0;
+    _overflow = false;
+}
+
+/**
+ * Write a byte.
+ *
+ * @param value Byte.
+ */
+void CFProtobufWriter::_writeByte(uint8_t value) {
+    if (_length < _size) {
+        _buffer[_length++] = value;
+    } else {
+        _overflow = true;
+    }
+}
+
+/**
+ * Write a varint.
+ *
+ * @param value Value.
+ */
+void CFProtobufWriter::_writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        _writeByte((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    _writeByte(value);
+}
+
+/**
+ * Write a field tag.
+ *
+ * @param field Field number.
+ * @param wireType Wire type.
+ */
+void CFProtobufWriter::_writeTag(uint32_t field, uint8_t wireType) {
+    _writeVarint((field << 3) | wireType);
+}
+
+/**
+ * Get written length.
+ *
+ * @return Written length.
+ */
+size_t CFProtobufWriter::length() {
+    return _length;
+}
+
+/**
+ * True if everything fit into the buffer.
+ *
+ * @return True if everything fit into the buffer.
+ */
+bool CFProtobufWriter::isValid() {
+    return !_overflow;
+}
@@ -0,0 +1,50 @@
+/**
+ * CFProtobufWriter.h
+ * 
+ * Writes protobuf (proto3 wire format) fields into a caller owned buffer, e.g. straight into
+ * the MQTT packet buffer. Writes past the end are dropped and flag the writer as overflowed.
+ *
+ * Field types match the schema types they are meant for:
+ *      writeInt    int32 / int64.
+ *      writeFloat  float.
+ *      writeString string.
+ *      writeBool   bool.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFProtobufWriter_h
+#define CFProtobufWriter_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+class CFProtobufWriter {
+    private:
+        // Attributes.
+        uint8_t *_buffer;                                                       // Output buffer.
+        size_t _size;                                                           // Buffer size.
+        size_t _length;                                                         // Written length.
+        bool _overflow;                                                         // Flag that indicates the buffer was too small.
+
+        // Methods.
+        void _writeByte(uint8_t value);                                         // Write a byte.
+        void _writeVarint(uint64_t value);                                      // Write a varint.
+        void _writeTag(uint32_t field, uint8_t wireType);                       // Write a field tag.
+
+    public:
+        // Methods.
+        CFProtobufWriter(uint8_t *buffer, size_t size);                         // Constructor.
+        CFProtobufWriter &writeInt(uint32_t field, long value);                 // Write an int32/int64 field.
+        CFProtobufWriter &writeFloat(uint32_t field, float value);              // Write a float field.
+        CFProtobufWriter &writeString(uint32_t field, const char *text);        // Write a string field.
+        CFProtobufWriter &writeBool(uint32_t field, bool value);                // Write a bool field.
+        void reset();                                                           // Discard written data.
+
+        // Accessors.
+        size_t length();                                                        // Get written length.
+        bool isValid();                                                         // True if everything fit into the buffer.
+};
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * CFPsychrometrics.cpp
+ *
+ * Integer kernels for temperature and humidity derived values.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFPsychrometrics.h>                                                   // CF Psychrometrics.
+
+#define CF_PSY_LN2_Q16                      45426                               // ln(2) in Q16.
+#define CF_PSY_ES_MIN                       -40                                 // First saturation table entry (°C).
+#define CF_PSY_ES_MAX                       80                                  // Last saturation table entry (°C).
+
+// ln(x) in Q16, x from 0.50 to 1.00 in steps of 0.01.
+static const int32_t LN_TABLE[] PROGMEM = {
+    -45426, -44128, -42856, -41607, -40382, -39180, -37999, -36839,
+    -35699, -34579, -33477, -32394, -31329, -30280, -29248, -28232,
+    -27231, -26246, -25275, -24318, -23375, -22445, -21529, -20625,
+    -19733, -18854, -17985, -17129, -16283, -15448, -14624, -13810,
+    -13006, -12211, -11426, -10651, -9884, -9127, -8378, -7637,
+    -6905, -6181, -5464, -4756, -4055, -3362, -2675, -1996,
+    -1324, -659, 0
+};
+
+// Saturation vapor pressure (Pa), 611.2 * exp(17.67 T / (T + 243.5)), from -40 °C to 80 °C.
+static const uint16_t ES_TABLE[] PROGMEM = {
+    19, 21, 23, 26, 28, 31, 35, 38, 42, 46,
+    51, 56, 62, 67, 74, 81, 89, 97, 106, 115,
+    126, 137, 149, 162, 176, 192, 208, 226, 245, 265,
+    287, 310, 335, 362, 391, 422, 455, 490, 528, 568,
+    611, 657, 706, 758, 813, 872, 935, 1001, 1072, 1147,
+    1227, 1312, 1402, 1497, 1597, 1704, 1817, 1936, 2063, 2196,
+    2337, 2486, 2643, 2809, 2983, 3167, 3361, 3566, 3781, 4007,
+    4246, 4496, 4759, 5036, 5326, 5631, 5951, 6287, 6639, 7008,
+    7395, 7800, 8224, 8669, 9133, 9620, 10128, 10660, 11216, 11796,
+    12402, 13035, 13696, 14385, 15105, 15854, 16636, 17451, 18299, 19183,
+    20104, 21062, 22059, 23096, 24175, 25297, 26463, 27675, 28934, 30241,
+    31599, 33008, 34471, 35989, 37563, 39196, 40889, 42644, 44462, 46346,
+    48297
+};
+
+/**
+ * Divide rounding half away from zero.
+ *
+ * @param n Numerator.
+ * @param d Denominator (positive).
+ * @return Rounded quotient.
+ */
+static int32_t divRound(int64_t n, int64_t d) {
+    return (int32_t) ((n >= 0) ? (n + d / 2) / d : (n - d / 2) / d);
+}
+
+/**
+ * Integer square root.
+ *
+ * @param n Value.
+ * @return Floor of the square root.
+ */
+static uint32_t isqrt(uint32_t n) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > n) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/**
+ * Convert 0.1 °C into 0.1 °F.
+ *
+ * @param celsius Temperature (0.1 °C).
+ * @return Temperature (0.1 °F).
+ */
+int16_t CFPsychrometrics::toFahrenheit(int16_t celsius) {
+    return divRound((int32_t) celsius * 9, 5) + 320;
+}
+
+/**
+ * Convert 0.1 °F into 0.1 °C.
+ *
+ * @param fahrenheit Temperature (0.1 °F).
+ * @return Temperature (0.1 °C).
+ */
+int16_t CFPsychrometrics::toCelsius(int16_t fahrenheit) {
+    return divRound(((int32_t) fahrenheit - 320) * 5, 9);
+}
+
+/**
+ * Get heat index, the temperature it feels like.
+ *
+ * @param fahrenheit Temperature (0.1 °F).
+ * @param humidity Relative humidity (0.1 %).
+ * @return Heat index (0.1 °F).
+ */
+int16_t CFPsychrometrics::heatIndexF(int16_t fahrenheit, int16_t humidity) {
+    return _heatIndex((int32_t) fahrenheit * 10, humidity);
+}
+
+/**
+ * Get heat index, the temperature it feels like.
+ *
+ * @param celsius Temperature (0.1 °C).
+ * @param humidity Relative humidity (0.1 %).
+ * @return Heat index (0.1 °C).
+ */
+int16_t CFPsychrometrics::heatIndexC(int16_t celsius, int16_t humidity) {
+    // 0.1 °C is exact in 0.01 °F, so the formula switch happens where the float one does.
+    return toCelsius(_heatIndex((int32_t) celsius * 18 + 3200, humidity));
+}
+
+/**
+ * Get dew point, the temperature where air would saturate.
+ *
+ * @param celsius Temperature (0.1 °C).
+ * @param humidity Relative humidity (0.1 %).
+ * @return Dew point (0.1 °C).
+ */
+int16_t CFPsychrometrics::dewPointC(int16_t celsius, int16_t humidity) {
+    // gamma = ln(RH) + b T / (c + T), Q16.
+    int32_t t = celsius;
+    int64_t gamma = _ln(humidity) + ((int64_t) 1762 * t << 16) / (10 * (24312 + 10 * t));
+
+    // Td = c gamma / (b - gamma).
+    return divRound(24312 * gamma, 10 * (((int64_t) 1762 << 16) / 100 - gamma));
+}
+
+/**
+ * Get absolute humidity, the water mass in a cubic meter of air.
+ *
+ * @param celsius Temperature (0.1 °C), from -40 °C to 80 °C.
+ * @param humidity Relative humidity (0.1 %).
+ * @return Absolute humidity (0.1 g/m³).
+ */
+int16_t CFPsychrometrics::absoluteHumidity(int16_t celsius, int16_t humidity) {
+    int32_t t = constrain(celsius, CF_PSY_ES_MIN * 10, CF_PSY_ES_MAX * 10);
+
+    // Saturation pressure, interpolated between whole degrees.
+    int32_t offset = t - CF_PSY_ES_MIN * 10;
+    int32_t i = offset / 10;
+    int32_t es = pgm_read_word(&ES_TABLE[i]);
+    if (i < CF_PSY_ES_MAX - CF_PSY_ES_MIN) {
+        es += ((int32_t) pgm_read_word(&ES_TABLE[i + 1]) - es) * (offset % 10) / 10;
+    }
+
+    // AH = es RH * 2.1674 / (273.15 + T), es in hPa, RH in %.
+    return divRound((int64_t) es * humidity * 21674, (int64_t) 10000 * (27315 + 10 * t));
+}
+
+/**
+ * Heat index kernel. Same regression and adjustments as DHT::computeHeatIndex(), with every
+ * term on a common 10^13 denominator.
+ *
+ * @param fahrenheit Temperature (0.01 °F).
+ * @param humidity Relative humidity (0.1 %).
+ * @return Heat index (0.1 °F).
+ */
+int16_t CFPsychrometrics::_heatIndex(int32_t fahrenheit, int16_t humidity) {
+    int32_t t = fahrenheit;
+    int32_t h = humidity;
+
+    // Simple formula, good below 79 °F (* 1000).
+    int32_t simple = 50 * t + 305000 + 60 * (t - 6800) + 47 * h;
+    if (simple <= 790000) {
+        return divRound(simple, 1000);
+    }
+
+    // Rothfusz regression. Coefficients * 10^8, terms scaled to 100^(2 - t power) 10^(2 - h power).
+    int64_t t2 = (int64_t) t * t;
+    int64_t h2 = (int64_t) h * h;
+    int64_t sum = -4237900000LL * 1000000
+            + 204901523LL * t * 10000
+            + 1014333127LL * h * 100000
+            - 22475541LL * t * h * 1000
+            - 683783LL * t2 * 100
+            - 5481717LL * h2 * 10000
+            + 122874LL * t2 * h * 10
+            + 85282LL * t * h2 * 100
+            - 199LL * t2 * h2;
+    int32_t hi = divRound(sum, 10000000000000LL);
+
+    // Adjustments for low and high humidity.
+    if (h < 130 && t >= 8000 && t <= 11200) {
+        // sqrt((17 - |T - 95|) * 0.05882) * 10^4.
+        uint32_t root = isqrt((uint32_t) (1700 - abs(t - 9500)) * 58820);
+        hi -= divRound((int64_t) (130 - h) * root, 40000);
+    } else if (h > 850 && t >= 8000 && t <= 8700) {
+        hi += divRound((int64_t) (h - 850) * (8700 - t), 5000);
+    }
+    return hi;
+}
+
+/**
+ * Natural log of humidity / 100 %. The argument is doubled into [50 %, 100 %], where a table
+ * with steps of 1 % is accurate to 10^-4.
+ *
+ * @param humidity Relative humidity (0.1 %), above 0.
+ * @return ln(humidity / 1000) in Q16.
+ */
+int32_t CFPsychrometrics::_ln(int16_t humidity) {
+    int32_t h = constrain(humidity, 1, 1000);
+    int32_t result = 0;
+    while (h < 500) {
+        h <<= 1;
+        result -= CF_PSY_LN2_Q16;
+    }
+    int32_t i = (h - 500) / 10;
+    int32_t value = pgm_read_dword(&LN_TABLE[i]);
+    if (i < 50) {
+        value += ((int32_t) pgm_read_dword(&LN_TABLE[i + 1]) - value) * ((h - 500) % 10) / 10;
+    }
+    return result + value;
+}
@@ -0,0 +1,41 @@
+/**
+ * CFPsychrometrics.h
+ *
+ * Integer kernels for temperature and humidity derived values. The ESP8266 has no FPU, so
+ * these work on tenths (0.1 °C, 0.1 °F, 0.1 %) in integer math instead of soft-float:
+ *
+ *      - Fahrenheit conversion.
+ *      - Heat index (NWS Rothfusz regression, same as DHT::computeHeatIndex()).
+ *      - Dew point (Magnus formula, b = 17.62, c = 243.12 °C).
+ *      - Absolute humidity (g/m³), from a saturation vapor pressure table (-40 °C to 80 °C).
+ *
+ * Results stay within 0.1 of the float formulas over the DHT22 range (-40 °C to 80 °C,
+ * 0 % to 100 %). Logarithms and exponentials come from small PROGMEM tables.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFPsychrometrics_h
+#define CFPsychrometrics_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+class CFPsychrometrics {
+    private:
+        // Methods.
+        static int16_t _heatIndex(int32_t fahrenheit, int16_t humidity);        // Heat index kernel (0.01 °F in, 0.1 °F out).
+        static int32_t _ln(int16_t humidity);                                   // Natural log of humidity / 100 % (Q16).
+
+    public:
+        // Methods.
+        static int16_t toFahrenheit(int16_t celsius);                           // Convert 0.1 °C into 0.1 °F.
+        static int16_t toCelsius(int16_t fahrenheit);                           // Convert 0.1 °F into 0.1 °C.
+        static int16_t heatIndexF(int16_t fahrenheit, int16_t humidity);        // Get heat index (0.1 °F).
+        static int16_t heatIndexC(int16_t celsius, int16_t humidity);           // Get heat index (0.1 °C).
+        static int16_t dewPointC(int16_t celsius, int16_t humidity);            // Get dew point (0.1 °C).
+        static int16_t absoluteHumidity(int16_t celsius, int16_t humidity);     // Get absolute humidity (0.1 g/m³).
+};
+
+#endif
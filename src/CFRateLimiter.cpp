@@ -0,0 +1,175 @@
+/**
+ * CFRateLimiter.cpp
+ * 
+ * Rate limiter and coalescer for helpers that emit alerts.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFRateLimiter.h>                                                      // CF Rate Limiter.
+
+/**
+ * Constructor.
+ *
+ * @param ttWindow Coalescing window.
+ * @param burst Max alerts sent back to back (bucket capacity).
+ * @param ttRefill Time to earn a token.
+ */
+CFRateLimiter::CFRateLimiter(unsigned long ttWindow, uint8_t burst, unsigned long ttRefill):
+        _ttWindow(ttWindow), _ttRefill(ttRefill), _burst(burst > 0 ? burst : 1),
+        _droppedCount(0), _onAlertCallback(NULL) {
+    for (int i = 0; i < CF_RATE_LIMITER_SLOTS; i++) {
+        _slots[i].destination = NULL;
+    }
+}
+
+/**
+ * Loop.
+ * Emits merged events whose window is over.
+ */
+void CFRateLimiter::loop() {
+    for (int i = 0; i < CF_RATE_LIMITER_SLOTS; i++) {
+        Slot &slot = _slots[i];
+        if (slot.destination == NULL || !slot.windowOpen || (millis() - slot.tWindow) < _ttWindow) {
+            continue;
+        }
+        if (slot.count == 0) {
+            slot.windowOpen = false;                                            // Nothing merged, destination is idle again.
+        } else {
+            _emit(slot);                                                        // Waits for a token when the bucket is empty.
+        }
+    }
+}
+
+/**
+ * Record an event for a destination.
+ *
+ * @param destination Destination (any address that identifies it).
+ */
+void CFRateLimiter::trigger(const void *destination) {
+    Slot *slot = _getSlot(destination);
+    if (slot == NULL) {
+        _droppedCount++;
+        Logger::warning("Rate limiter has no free slot. Event discarded.");
+        return;
+    }
+
+    slot->count++;
+    if (!slot->windowOpen) {
+        // Leading edge: first event goes right away when there is a token.
+        slot->windowOpen = true;
+        slot->tWindow = millis();
+        _emit(*slot);
+    }
+}
+
+/**
+ * Find destination slot or take a free one.
+ * A slot is free when its window is closed and its bucket is full again.
+ *
+ * @param destination Destination.
+ * @return Slot or NULL if all slots are busy.
+ */
+CFRateLimiter::Slot *CFRateLimiter::_getSlot(const void *destination) {
+    Slot *freeSlot = NULL;
+    for (int i = 0; i < CF_RATE_LIMITER_SLOTS; i++) {
+        Slot &slot = _slots[i];
+        if (slot.destination == destination) {
+            return &slot;
+        }
+        if (freeSlot == NULL) {
+            if (slot.destination == NULL) {
+                freeSlot = &slot;
+            } else if (!slot.windowOpen) {
+                _refill(slot);
+                if (slot.tokens >= _burst) {
+                    freeSlot = &slot;
+                }
+            }
+        }
+    }
+
+    if (freeSlot != NULL) {
+        freeSlot->destination = destination;
+        freeSlot->tokens = _burst;
+        freeSlot->tLastRefill = millis();
+        freeSlot->windowOpen = false;
+        freeSlot->count = 0;
+    }
+    return freeSlot;
+}
+
+/**
+ * Earn tokens for elapsed time.
+ *
+ * @param slot Slot.
+ */
+void CFRateLimiter::_refill(Slot &slot) {
+    if (slot.tokens >= _burst) {
+        slot.tLastRefill = millis();
+        return;
+    }
+    unsigned long earned = _ttRefill > 0 ? (millis() - slot.tLastRefill) / _ttRefill : _burst;
+    if (earned > 0) {
+        slot.tokens = min((unsigned long) _burst, slot.tokens + earned);
+        slot.tLastRefill += earned * _ttRefill;                                 // Keep the remainder for the next token.
+    }
+}
+
+/**
+ * Emit merged events if there is a token.
+ * Emitting restarts the window, so events keep being merged while they arrive.
+ *
+ * @param slot Slot.
+ * @return True if alert was emitted.
+ */
+bool CFRateLimiter::_emit(Slot &slot) {
+    _refill(slot);
+    if (slot.tokens == 0) {
+        return false;
+    }
+    slot.tokens--;
+
+    unsigned long count = slot.count;
+    slot.count = 0;
+    slot.tWindow = millis();
+    if (_onAlertCallback) {
+        _onAlertCallback(slot.destination, count);
+    }
+    return true;
+}
+
+/**
+ * Get events waiting for a destination.
+ *
+ * @param destination Destination.
+ * @return Pending events.
+ */
+unsigned long CFRateLimiter::getPendingCount(const void *destination) {
+    for (int i = 0; i < CF_RATE_LIMITER_SLOTS; i++) {
+        if (_slots[i].destination == destination) {
+            return _slots[i].count;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Get events dropped for lack of slots.
+ *
+ * @return Dropped events.
+ */
+unsigned long CFRateLimiter::getDroppedCount() {
+    return _droppedCount;
+}
+
+/**
+ * Define on alert callback.
+ *
+ * @param callback Callback that receives the destination and the merged event count.
+ */
+void CFRateLimiter::setOnAlertCallback(AlertCallback callback) {
+    _onAlertCallback = callback;
+}
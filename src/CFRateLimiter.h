@@ -0,0 +1,71 @@
+/**
+ * CFRateLimiter.h
+ * 
+ * Rate limiter and coalescer for helpers that emit alerts.
+ *
+ * Every destination (e.g. a notification target) gets its own token bucket: it holds up to
+ * burst tokens and earns one token every refill interval. An alert costs one token.
+ *
+ * The first event for an idle destination is emitted right away (if there is a token) and
+ * opens a coalescing window. Events that arrive while the window is open are merged, and
+ * when it closes they are emitted as a single alert carrying the event count. When the
+ * bucket is empty merged events keep waiting, so bursts are never spammed nor silently lost.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFRateLimiter_h
+#define CFRateLimiter_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <Logger.h>                                                             // Logger.
+
+#ifndef CF_RATE_LIMITER_SLOTS
+    #define CF_RATE_LIMITER_SLOTS       4                                       // Max destinations.
+#endif
+
+class CFRateLimiter {
+    private:
+        // Aliases.
+        using AlertCallback = void (*)(const void *destination, unsigned long count); // Alias for alert callback.
+
+        // Destination slot.
+        struct Slot {
+            const void *destination;                                            // Destination (NULL if free).
+            uint8_t tokens;                                                     // Available tokens.
+            unsigned long tLastRefill;                                          // Last time a token was earned.
+            bool windowOpen;                                                    // Flag that indicates coalescing window is open.
+            unsigned long tWindow;                                              // Time window was opened.
+            unsigned long count;                                                // Events merged in the window.
+        };
+
+        // Attributes.
+        Slot _slots[CF_RATE_LIMITER_SLOTS];                                     // Destinations.
+        unsigned long _ttWindow;                                                // Coalescing window.
+        unsigned long _ttRefill;                                                // Time to earn a token.
+        uint8_t _burst;                                                         // Bucket capacity.
+        unsigned long _droppedCount;                                            // Events dropped for lack of slots.
+
+        // Callbacks.
+        AlertCallback _onAlertCallback;                                         // On alert callback.
+
+        // Methods.
+        Slot *_getSlot(const void *destination);                                // Find destination slot or take a free one.
+        void _refill(Slot &slot);                                               // Earn tokens for elapsed time.
+        bool _emit(Slot &slot);                                                 // Emit merged events if there is a token.
+
+    public:
+        // Methods.
+        CFRateLimiter(unsigned long ttWindow, uint8_t burst, unsigned long ttRefill); // Constructor.
+        void loop();                                                            // Loop.
+        void trigger(const void *destination);                                  // Record an event for a destination.
+
+        // Accessors.
+        unsigned long getPendingCount(const void *destination);                 // Get events waiting for a destination.
+        unsigned long getDroppedCount();                                        // Get events dropped for lack of slots.
+        void setOnAlertCallback(const AlertCallback);                           // Define on alert callback.
+};
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * CFServerPool.cpp
+ * 
+ * Ordered list of servers with health scoring and DNS caching, for failover.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFServerPool.h>                                                       // CF Server Pool.
+
+/**
+ * Constructor.
+ */
+CFServerPool::CFServerPool():
+        _count(0),
+        _ttBackoff(5000), _ttMaxBackoff(60000), _jitter(50),
+        _ttDNS(600000), _ttDNSTimeout(2000) {
+
+}
+
+/**
+ * Add a server after the others.
+ *
+ * @param host Host name or IP.
+ * @param port Port.
+ * @return False if pool is full or host is too long.
+ */
+bool CFServerPool::add(const char *host, uint16_t port) {
+    if (_count >= CF_SERVER_POOL_SIZE || strlen(host) >= CF_SERVER_HOST_SIZE) {
+        return false;
+    }
+    set(_count, host, port);
+    return true;
+}
+
+/**
+ * Define a server. Health and cached address restart if host or port change.
+ *
+ * @param index Server index (0 is the primary). It can be the next free index.
+ * @param host Host name or IP.
+ * @param port Port.
+ */
+void CFServerPool::set(uint8_t index, const char *host, uint16_t port) {
+    if (index > _count || index >= CF_SERVER_POOL_SIZE) {
+        return;
+    }
+    Server &server = _servers[index];
+    if (index < _count && server.port == port && strcmp(server.host, host) == 0) {
+        return;
+    }
+    strlcpy(server.host, host, sizeof(server.host));
+    server.port = port;
+    server.tResolved = 0;
+    server.refresh = false;
+    server.failures = 0;
+    server.tRetry = millis();
+    server.score = 100;
+    if (index == _count) {
+        _count++;
+    }
+}
+
+/**
+ * Remove all servers.
+ */
+void CFServerPool::clear() {
+    _count = 0;
+}
+
+/**
+ * Get server to be tried now: the primary if it's ready, else the healthiest ready standby.
+ *
+ * @return Server index or -1 if every server is backing off.
+ */
+int CFServerPool::next() {
+    int best = -1;
+    for (int i = 0; i < _count; i++) {
+        if (!isReady(i)) {
+            continue;
+        }
+        if (i == 0) {
+            return 0;
+        }
+        if (best < 0 || _servers[i].score > _servers[best].score) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * Get server address, from cache if fresh. A stale address is kept if DNS fails, and then DNS
+ * isn't asked again before the max backoff, so failover retries don't block on it each time.
+ *
+ * @param index Server index.
+ * @param ip Receives the address.
+ * @return False if host can't be resolved.
+ */
+bool CFServerPool::resolve(int index, IPAddress &ip) {
+    Server &server = _servers[index];
+    bool stale = server.refresh || millis() - server.tResolved > _ttDNS;
+    if (server.tResolved == 0 || (stale && millis() - server.tLookup >= _ttMaxBackoff)) {
+        IPAddress resolved;
+        server.tLookup = millis();
+        if (WiFi.hostByName(server.host, resolved, _ttDNSTimeout)) {
+            server.ip = resolved;
+            server.tResolved = millis();
+            server.refresh = false;
+        } else if (server.tResolved == 0) {
+            return false;
+        }
+    }
+    ip = server.ip;
+    return true;
+}
+
+/**
+ * Record a connection.
+ *
+ * @param index Server index.
+ */
+void CFServerPool::reportSuccess(int index) {
+    Server &server = _servers[index];
+    server.failures = 0;
+    server.score += (100 - server.score) / 4 + ((server.score < 100) ? 1 : 0);
+}
+
+/**
+ * Record a failed connection. The server backs off and its address is resolved again next time,
+ * keeping the old one in case DNS fails.
+ *
+ * @param index Server index.
+ */
+void CFServerPool::reportFailure(int index) {
+    Server &server = _servers[index];
+    server.score /= 2;
+    server.refresh = true;
+    unsigned long backoff = min(_ttBackoff << min(server.failures, (uint8_t) 10), _ttMaxBackoff);
+    backoff -= random(backoff * _jitter / 100 + 1);
+    server.tRetry = millis() + backoff;
+    if (server.failures < 255) {
+        server.failures++;
+    }
+}
+
+/**
+ * True if server isn't backing off.
+ *
+ * @param index Server index.
+ * @return True if it can be tried now.
+ */
+bool CFServerPool::isReady(int index) {
+    return index >= 0 && index < _count && (long) (millis() - _servers[index].tRetry) >= 0;
+}
+
+/**
+ * Get servers quantity.
+ *
+ * @return Servers quantity.
+ */
+uint8_t CFServerPool::size() {
+    return _count;
+}
+
+/**
+ * Get server host.
+ *
+ * @param index Server index.
+ * @return Host.
+ */
+const char *CFServerPool::getHost(int index) {
+    return _servers[index].host;
+}
+
+/**
+ * Get server port.
+ *
+ * @param index Server index.
+ * @return Port.
+ */
+uint16_t CFServerPool::getPort(int index) {
+    return _servers[index].port;
+}
+
+/**
+ * Get server health score.
+ *
+ * @param index Server index.
+ * @return Score from 0 (failing) to 100 (healthy).
+ */
+uint8_t CFServerPool::getScore(int index) {
+    return _servers[index].score;
+}
+
+/**
+ * Get time left until next attempt.
+ *
+ * @param index Server index.
+ * @return Time left or 0 if ready.
+ */
+unsigned long CFServerPool::getRetryDelay(int index) {
+    return isReady(index) ? 0 : _servers[index].tRetry - millis();
+}
+
+/**
+ * Define first and max backoff. Backoff doubles on each failure in a row.
+ *
+ * @param ttBackoff First backoff.
+ * @param ttMaxBackoff Max backoff.
+ */
+void CFServerPool::setBackoff(unsigned long ttBackoff, unsigned long ttMaxBackoff) {
+    _ttBackoff = ttBackoff;
+    _ttMaxBackoff = ttMaxBackoff;
+}
+
+/**
+ * Define random part of each backoff. With 50, a 60 s backoff lasts between 30 s and 60 s.
+ *
+ * @param jitter Random part (0-100 %).
+ */
+void CFServerPool::setJitter(uint8_t jitter) {
+    _jitter = min(jitter, (uint8_t) 100);
+}
+
+/**
+ * Define DNS cache time and timeout.
+ *
+ * @param ttDNS Time a resolved address is kept.
+ * @param ttDNSTimeout Time waiting for DNS.
+ */
+void CFServerPool::setDNSCache(unsigned long ttDNS, unsigned long ttDNSTimeout) {
+    _ttDNS = ttDNS;
+    _ttDNSTimeout = ttDNSTimeout;
+}
@@ -0,0 +1,78 @@
+/**
+ * CFServerPool.h
+ * 
+ * Ordered list of servers with health scoring and DNS caching, for failover.
+ *
+ * The first server is the primary. next() picks the primary whenever it isn't backing off, so
+ * the device returns to it on its own; otherwise it picks the healthiest standby ready to be
+ * tried. Failures back off exponentially per server, so a dead server doesn't delay the others.
+ * Health is a 0-100 score moved by every connection result.
+ *
+ * Backoffs are shortened by a random part (jitter), so devices that lost the server at the same
+ * time, e.g. after a power outage, don't all come back at the same moment.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFServerPool_h
+#define CFServerPool_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <ESP8266WiFi.h>                                                        // ESP8266 Wi-Fi (DNS).
+
+#ifndef CF_SERVER_POOL_SIZE
+    #define CF_SERVER_POOL_SIZE             3                                   // Max servers.
+#endif
+
+#define CF_SERVER_HOST_SIZE                 64                                  // Max host length (+1).
+
+class CFServerPool {
+    private:
+        // Server.
+        struct Server {
+            char host[CF_SERVER_HOST_SIZE];                                     // Host name or IP.
+            uint16_t port;                                                      // Port.
+            IPAddress ip;                                                       // Resolved address.
+            unsigned long tResolved;                                            // Last time host was resolved (0 if not).
+            unsigned long tLookup;                                              // Last time DNS was asked.
+            bool refresh;                                                       // Flag that indicates address is resolved again next time.
+            uint8_t failures;                                                   // Failures in a row.
+            unsigned long tRetry;                                               // Time it can be tried again.
+            uint8_t score;                                                      // Health score (0-100).
+        };
+
+        // Attributes.
+        Server _servers[CF_SERVER_POOL_SIZE];                                   // Servers, primary first.
+        uint8_t _count;                                                         // Servers quantity.
+        unsigned long _ttBackoff;                                               // First backoff after a failure.
+        unsigned long _ttMaxBackoff;                                            // Max backoff.
+        uint8_t _jitter;                                                        // Random part of each backoff (%).
+        unsigned long _ttDNS;                                                   // Time a resolved address is kept.
+        unsigned long _ttDNSTimeout;                                            // Time waiting for DNS.
+
+    public:
+        // Methods.
+        CFServerPool();                                                         // Constructor.
+        bool add(const char *host, uint16_t port);                              // Add a server after the others.
+        void set(uint8_t index, const char *host, uint16_t port);               // Define a server.
+        void clear();                                                           // Remove all servers.
+        int next();                                                             // Get server to be tried now.
+        bool resolve(int index, IPAddress &ip);                                 // Get server address, from cache if fresh.
+        void reportSuccess(int index);                                          // Record a connection.
+        void reportFailure(int index);                                          // Record a failed connection.
+        bool isReady(int index);                                                // True if server isn't backing off.
+
+        // Accessors.
+        uint8_t size();                                                         // Get servers quantity.
+        const char *getHost(int index);                                         // Get server host.
+        uint16_t getPort(int index);                                            // Get server port.
+        uint8_t getScore(int index);                                            // Get server health score.
+        unsigned long getRetryDelay(int index);                                 // Get time left until next attempt.
+        void setBackoff(unsigned long ttBackoff, unsigned long ttMaxBackoff);   // Define first and max backoff.
+        void setJitter(uint8_t jitter);                                         // Define random part of each backoff (%).
+        void setDNSCache(unsigned long ttDNS, unsigned long ttDNSTimeout);      // Define DNS cache time and timeout.
+};
+
+#endif
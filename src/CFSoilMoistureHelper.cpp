@@ -18,27 +18,33 @@
 CFSoilMoistureHelper::CFSoilMoistureHelper(int analogPin):
         _analogPin(analogPin),
         _moistureValue(1023), _moisturePercent(0),
-        _ttRead(1000),
-        _dryValue(1023), _wetValue(0) {
+        _dryValue(1023), _wetValue(0),
+        _ttRead(1000), _tLastRead(0), _sampler(nullptr),
+        _mReads(CFMetrics::counter("soil_reads")) {
     
 }
 
 /**
  * Loop.
+ *
+ * @return True when a new reading was taken, so it can be aggregated.
  */
-void CFSoilMoistureHelper::loop() {
-    _readData();
+bool CFSoilMoistureHelper::loop() {
+    return _readData();
 }
 
 /**
  * Collect soil moisture data.
+ *
+ * @return True when a new reading was taken.
  */
-void CFSoilMoistureHelper::_readData() {
+bool CFSoilMoistureHelper::_readData() {
     if (_tLastRead == 0 || (millis() - _tLastRead) > _ttRead) {
-        Logger::verbose("Reading values.");
+        CF_LOG_VERBOSE("Reading values.");
 
         // Read value from analog pin.
         _moistureValue = analogRead(_analogPin);
+        CFMetrics::increment(_mReads);
 
         // Map the raw value to a reverse read-friendly value.
         _reverseMoistureValue = map(_moistureValue, 1023, 0, 0, 1023);
@@ -49,13 +55,19 @@ void CFSoilMoistureHelper::_readData() {
         // Adjust percent value if it's out of 0-100 range.
         _moisturePercent = (_moisturePercent > 100) ? 100 : ((_moisturePercent < 0) ? 0 : _moisturePercent);
 
-        Logger::verbose("Dry / Wet: " + String(_dryValue) + " / " + String(_wetValue));
-        Logger::verbose("Raw value: " + String(_moistureValue));
-        Logger::verbose("Percent: " + String(_moisturePercent) + " %");
+        CF_TRACE_EVENT(CFTrace::SOIL_READ, _moistureValue, _moisturePercent);
+        CF_LOG_VERBOSE("Dry / Wet: " + String(_dryValue) + " / " + String(_wetValue));
+        CF_LOG_VERBOSE("Raw value: " + String(_moistureValue));
+        CF_LOG_VERBOSE("Percent: " + String(_moisturePercent) + " %");
 
-        // Update last read time.
+        // Update last read time, and next one when it adapts to the readings.
         _tLastRead = millis();
+        if (_sampler) {
+            _ttRead = _sampler->add(_moistureValue);
+        }
+        return true;
     }
+    return false;
 }
 
 /**
@@ -138,4 +150,15 @@ int CFSoilMoistureHelper::getSersorPercent() {
  */
 void CFSoilMoistureHelper::setReadingInterval(long ttRead) {
     _ttRead = ttRead;
+}
+
+/**
+ * Adapt time between readings to how fast the raw value moves, e.g. read every second while
+ * watering and every few minutes otherwise. It replaces setReadingInterval().
+ *
+ * @param sampler Adaptive sampler, fed with raw values.
+ */
+void CFSoilMoistureHelper::setAdaptiveSampler(CFAdaptiveSampler &sampler) {
+    _sampler = &sampler;
+    _ttRead = sampler.getInterval();
 }
\ No newline at end of file
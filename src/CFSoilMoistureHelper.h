@@ -13,6 +13,9 @@
 
 #include <Arduino.h>                                                            // Arduino library.
 #include <Logger.h>                                                             // Logger.
+#include <CFMetrics.h>                                                          // CF Metrics.
+#include <CFTrace.h>                                                           // CF Trace.
+#include <CFAdaptiveSampler.h>                                                  // CF Adaptive Sampler.
 
 class CFSoilMoistureHelper {
     private:
@@ -27,14 +30,21 @@ class CFSoilMoistureHelper {
         // Loop control.
         unsigned long _ttRead;                                                  // Time between readings.
         unsigned long _tLastRead;                                               // Last time data was read.
+        CFAdaptiveSampler *_sampler;                                            // Adaptive reading interval (optional).
+
+        // Metrics.
+        int _mReads;                                                            // Readings.
 
         // Methods.
-        void _readData();                                                       // Collect soil moisture data.
+        bool _readData();                                                       // Collect soil moisture data.
 
     public:
+        // Sizes.
+        static constexpr int TELEMETRY_KEYS = 2;                                // Values published (raw, percent).
+
         // Methods.
         CFSoilMoistureHelper(int analogPin);                                    // Constructor.
-        void loop();                                                            // Loop.
+        bool loop();                                                            // Loop. True when a new reading was taken.
 
         // Accessors.
         int getRawDryValue();                                                   // Get dry value.
@@ -45,6 +55,7 @@ class CFSoilMoistureHelper {
         int getRawSensorReverseValue();                                         // Get mapped value from sensor.
         int getSersorPercent();                                                 // Get mapped percent value.
         void setReadingInterval(long ttRead);                                   // Define time between readings.
+        void setAdaptiveSampler(CFAdaptiveSampler &sampler);                    // Adapt time between readings to the raw value.
 };
 
 #endif
\ No newline at end of file
@@ -10,118 +10,900 @@
 
 #include <CFThingsBoardHelper.h>                                                // CF Wi-Fi Manager.
 
+// ThingsBoard MQTT API.
+#define CF_TB_PORT                          1883
+#define CF_TB_CONNECT_TIMEOUT               3000                                // TCP connect and CONNACK timeout, each.
+#define CF_TB_PROBE_TIMEOUT                 1000                                // Primary probe timeout.
+#define CF_TB_TELEMETRY_TOPIC               "v1/devices/me/telemetry"
+#define CF_TB_ATTRIBUTES_TOPIC              "v1/devices/me/attributes"
+#define CF_TB_ATTRIBUTES_REQUEST_TOPIC      "v1/devices/me/attributes/request/"
+#define CF_TB_ATTRIBUTES_RESPONSE_TOPIC     "v1/devices/me/attributes/response/"
+#define CF_TB_RPC_REQUEST_TOPIC             "v1/devices/me/rpc/request/"
+#define CF_TB_RPC_RESPONSE_TOPIC            "v1/devices/me/rpc/response/"
+
 /**
  * Constructor.
  */
 CFThingsBoardHelper::CFThingsBoardHelper(String appCode, String appVersion):
-        _wifiClient(), _thingsBoard(_wifiClient),
-        _ttRetry(60000), _ttSend(60000),
-        _data(64), _attributes(1024), _TBconnected(false),
-        _appCode(appCode), _appVersion(appVersion) {
-    
+        _wifiClient(), _mqtt(_wifiClient),
+        _appCode(appCode), _appVersion(appVersion),
+        _server(0), _ttPrimaryCheck(300000), _tLastPrimaryCheck(0),
+        _ttSend(60000), _TBconnected(false),
+        _ttMetrics(300000), _tLastMetrics(0), _tLastLoop(0),
+        _encoding(JSON), _protobufFields(nullptr), _protobufFieldCount(0), _qos(1),
+        _data(128), _attributes(1024),
+        _attributeSync("/cf_attributes.bin"), _attributeRequestId(0),
+        _aggregateCount(0), _textCount(0),
+        _history(nullptr), _backfillTier(CFTimeSeries::MINUTE), _tsLastSent(0), _backfillFrom(0),
+        _backfillTo(0), _backfillCursor(0), _backfillSeries(-1),
+        _attrCallback(nullptr), _handlerCount(0), _attrSubscribed(false), _rpcSubscribed(false) {
+    // Register metrics.
+    _mConnect = CFMetrics::counter("tb_connect");
+    _mConnectFail = CFMetrics::counter("tb_connect_fail");
+    _mFailover = CFMetrics::counter("tb_failover");
+    _mPublishFail = CFMetrics::counter("tb_pub_fail");
+    _mPublishAcked = CFMetrics::counter("tb_pub_acked");
+    _mConnectTime = CFMetrics::histogram("tb_connect_ms");
+    _mLoopTime = CFMetrics::histogram("loop_us");
+    _mEncodeTime = CFMetrics::histogram("tb_encode_us");
+    _mDispatchTime = CFMetrics::histogram("tb_dispatch_us");
+    _mPayloadSize = CFMetrics::histogram("tb_payload_b");
+    _mAckTime = CFMetrics::histogram("tb_ack_ms");
+    _mServer = CFMetrics::gauge("tb_server");
+    _mInFlight = CFMetrics::gauge("tb_inflight");
+    _mRetransmit = CFMetrics::gauge("tb_retransmit");
+    _mHeapFree = CFMetrics::gauge("heap_free");
+    _mHeapFragmentation = CFMetrics::gauge("heap_frag");
+    _mHeapMaxBlock = CFMetrics::gauge("heap_max_block");
+
+    _mqtt.setOnMessageCallback(_onMessage, this);
+    _mqtt.setOnAckCallback(_onAck);
+    _mqtt.setConnectTimeout(CF_TB_CONNECT_TIMEOUT);
+    _wifiClient.setTimeout(CF_TB_CONNECT_TIMEOUT);
+    memset(_handlers, 0, sizeof(_handlers));
 }
 
 /**
  * Loop.
  */
 void CFThingsBoardHelper::loop() {
-    // Check if it's disconnected.
-    if (!_thingsBoard.connected()) {
+    // Nothing to do without Wi-Fi, e.g. while the config portal runs.
+    if (WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+
+    // Time between loops, it's the whole sketch loop when called once per loop.
+    unsigned long tLoop = micros();
+    if (_tLastLoop != 0) {
+        CFMetrics::record(_mLoopTime, tLoop - _tLastLoop);
+    }
+    _tLastLoop = tLoop;
+
+    // Check if it's disconnected. One attempt per loop, on the server the pool picks.
+    if (!_mqtt.connected()) {
         _TBconnected = false;
-        // Check the last attempt.
-        if (_tLastSent == 0 || (millis() - _tLastSent) > _ttRetry) {
-            // Connect to ThingsBoard.
-            Logger::notice("Connecting to Things Board node.");
-            Logger::verbose("ServerURL: " + _serverURL);
-            Logger::verbose("Token: " + _token);
-            
-            char serverURL[50]; strcpy(serverURL, _serverURL.c_str());
-            char token[50]; strcpy(token, _token.c_str());
-            if (_thingsBoard.connect(serverURL, token)) {
-                _TBconnected = true;
-                // Get chip id.
-                char espChipId[6];
-                sprintf(espChipId, "%06X", ESP.getChipId());
-                
-                // Send attributes to ThingsBoard.
-                _thingsBoard.sendAttributeString("app_code", _appCode.c_str());
-                _thingsBoard.sendAttributeString("app_version", _appVersion.c_str());
-                _thingsBoard.sendAttributeString("device_chip_id", espChipId);
-                _thingsBoard.sendAttributeString("device_local_ip", _localIP.c_str());
-
-                // Call on ThingsBoard connect.
-                if (_onThingsBoardConnectCallback) {
-                    _onThingsBoardConnectCallback();
-                }
-            } else {
-                Logger::warning("Fail connecting Things Board. Retrying in " + String(_ttRetry / 1000) + " second(s).");
-                _tLastSent = millis();
-                return;
-            }
-        } else {
-            // It's not time to retry.
+        int server = _servers.next();
+        if (server < 0 || !_connect(server)) {
             return;
         }
+    } else if (_server != 0) {
+        _checkPrimary();
     }
 
     // Check the last submission.
     if (_tLastSent == 0 || (millis() - _tLastSent) > _ttSend) {
-        Logger::notice("Sending data to Things Board.");
+        CF_LOG_VERBOSE("Sending data to Things Board.");
+        CF_TRACE_BEGIN(CFTrace::TB_SEND);
         
         // Send telemetry.
-        char serializedJson[64]; serializeJson(_data, serializedJson);
-        _thingsBoard.sendTelemetryJson(serializedJson);
-
-        // Send attributes.
-        for (JsonPair p : _attributes.as<JsonObject>()) {
-            const char* key = p.key().c_str();
-            if (p.value().is<const char*>()) {
-                _thingsBoard.sendAttributeString(key, p.value());
-            }
-            if (p.value().is<int>()) {
-                _thingsBoard.sendAttributeInt(key, p.value());
-            }
+        if (!_sendTelemetry()) {
+            CFMetrics::increment(_mPublishFail);
+        } else if (_history) {
+            _tsLastSent = CFTimeSeries::now();
+        }
+
+        // Send attributes that changed.
+        if (!_syncAttributes(_attributes)) {
+            CFMetrics::increment(_mPublishFail);
         }
 
         // Update last sent time.
         _tLastSent = millis();
+        CF_TRACE_END(CFTrace::TB_SEND);
+    }
+
+    // Check the last metrics submission.
+    if (_ttMetrics > 0 && (millis() - _tLastMetrics) > _ttMetrics) {
+        _sendMetrics();
+        _tLastMetrics = millis();
+    }
+
+    // Send history of the last outage, if any is left.
+    if (_backfillSeries >= 0) {
+        _sendBackfill();
+    }
+
+    _mqtt.loop();
+}
+
+/**
+ * Connect to a server of the pool. It blocks up to DNS and connect timeouts when the address
+ * isn't cached.
+ *
+ * @param server Server index.
+ * @return True if it's connected.
+ */
+bool CFThingsBoardHelper::_connect(int server) {
+    char message[96];
+    snprintf(message, sizeof(message), "Connecting to Things Board node %s.", _servers.getHost(server));
+    CF_LOG_NOTICE(message);
+    snprintf(message, sizeof(message), "Token: %s", _token.c_str());
+    CF_LOG_VERBOSE(message);
+
+    // Get chip id.
+    char espChipId[7];
+    sprintf(espChipId, "%06X", ESP.getChipId());
+
+    CF_TRACE_BEGIN(CFTrace::TB_CONNECT);
+    unsigned long tConnect = millis();
+    IPAddress ip;
+    CFHeap::allow();                                                            // The core allocates the connection.
+    bool connected = _servers.resolve(server, ip)
+            && _mqtt.connect(ip, _servers.getPort(server), espChipId, _token.c_str());
+    CFHeap::disallow();
+    CFMetrics::record(_mConnectTime, millis() - tConnect);
+    CF_TRACE_END(CFTrace::TB_CONNECT);
+    if (!connected) {
+        CFMetrics::increment(_mConnectFail);
+        _servers.reportFailure(server);
+        int next = _servers.next();
+        if (next >= 0) {
+            snprintf(message, sizeof(message), "Fail connecting Things Board. Trying %s.", _servers.getHost(next));
+        } else {
+            snprintf(message, sizeof(message), "Fail connecting Things Board. Retrying in %lu second(s).",
+                    _servers.getRetryDelay(server) / 1000);
+        }
+        CF_LOG_NOTICE(message);
+        return false;
+    }
+
+    _TBconnected = true;
+    _servers.reportSuccess(server);
+    CFMetrics::increment(_mConnect);
+    if (server != _server) {
+        CFMetrics::increment(_mFailover);
+        _server = server;
+    }
+    CFMetrics::set(_mServer, server);
+    _tLastPrimaryCheck = millis();
+
+    // Send attributes the server doesn't have yet. Servers of the pool share device data.
+    _attributeSync.setScope(_servers.getHost(0), _token.c_str());
+    StaticJsonDocument<192> device;
+    device["app_code"] = _appCode.c_str();
+    device["app_version"] = _appVersion.c_str();
+    device["device_chip_id"] = espChipId;
+    device["device_local_ip"] = _localIP.c_str();
+    if (!_syncAttributes(device) || !_syncAttributes(_attributes)) {
+        CFMetrics::increment(_mPublishFail);
+    }
+
+    // Subscribe to topics that have handlers and fetch shared attributes.
+    _subscribe();
+    if (!_requestSharedAttributes()) {
+        CFMetrics::increment(_mPublishFail);
+    }
+
+    // Send what was missed while disconnected.
+    _startBackfill();
+
+    // Call on ThingsBoard connect.
+    if (_onThingsBoardConnectCallback) {
+        _onThingsBoardConnectCallback();
+    }
+    return true;
+}
+
+/**
+ * While on a standby server, check from time to time if the primary accepts connections and
+ * drop the session if so, so next loop connects to the primary.
+ */
+void CFThingsBoardHelper::_checkPrimary() {
+    if (millis() - _tLastPrimaryCheck < _ttPrimaryCheck || !_servers.isReady(0)) {
+        return;
+    }
+    _tLastPrimaryCheck = millis();
+
+    IPAddress ip;
+    WiFiClient probe;
+    probe.setTimeout(CF_TB_PROBE_TIMEOUT);
+    CFHeap::allow();                                                            // The core allocates the connection.
+    bool back = _servers.resolve(0, ip) && probe.connect(ip, _servers.getPort(0));
+    CFHeap::disallow();
+    if (back) {
+        probe.stop();
+        CF_LOG_NOTICE("Primary Things Board node is back. Switching over.");
+        _mqtt.disconnect();
+        _TBconnected = false;
+    } else {
+        _servers.reportFailure(0);
     }
+}
 
-    _thingsBoard.loop();
+/**
+ * Start sending history of the gap since the last telemetry sent. A backfill still going on
+ * keeps its start, so a short reconnection doesn't skip what it didn't send yet.
+ */
+void CFThingsBoardHelper::_startBackfill() {
+    uint32_t now = CFTimeSeries::now();
+    if (!_history || _tsLastSent == 0 || now == 0 || now <= _tsLastSent + _ttSend / 1000) {
+        return;
+    }
+    if (_backfillSeries < 0) {
+        _backfillFrom = _tsLastSent + 1;
+    }
+    _backfillTo = now;
+    _backfillSeries = 0;
+    _backfillCursor = _backfillFrom;
+    char message[64];
+    snprintf(message, sizeof(message), "Sending history of the last %lu minute(s).",
+            (unsigned long) (now - _backfillFrom) / 60);
+    CF_LOG_NOTICE(message);
 }
 
 /**
- * Subscribe to attr.
+ * Send next history points of the gap, as many as fit one publish, with their timestamps:
+ * [{"ts":1700000000000,"values":{"soi_perct":45}},...]. A full in-flight window waits for the
+ * next loop.
+ */
+void CFThingsBoardHelper::_sendBackfill() {
+    if (_backfillSeries >= _history->getSeriesCount()) {
+        _backfillSeries = -1;
+        return;
+    }
+    CFTimeSeries::Point points[CF_TB_BACKFILL_POINTS];
+    size_t count = _history->query(_backfillSeries, _backfillCursor, _backfillTo, points,
+            CF_TB_BACKFILL_POINTS, _backfillTier);
+    if (count == 0) {
+        _backfillSeries++;
+        _backfillCursor = _backfillFrom;
+        return;
+    }
+    size_t capacity;
+    char *payload = (char *) _beginPublish(CF_TB_TELEMETRY_TOPIC, capacity, _qos);
+    if (!payload) {
+        return;
+    }
+
+    // Points that fit, leaving room for the closing bracket.
+    const char *key = _history->getKey(_backfillSeries);
+    size_t length = 0;
+    size_t sent = 0;
+    for (; sent < count; sent++) {
+        int written = snprintf(payload + length, capacity - length, "%c{\"ts\":%lu000,\"values\":{\"%s\":%ld}}",
+                sent == 0 ? '[' : ',', (unsigned long) points[sent].timestamp, key, points[sent].value);
+        if (written < 0 || length + written + 1 >= capacity) {
+            break;
+        }
+        length += written;
+    }
+    if (sent == 0) {
+        Logger::error("History point doesn't fit the MQTT buffer.");
+        _backfillSeries = -1;
+        return;
+    }
+    payload[length++] = ']';
+    if (!_mqtt.endPublish(length)) {
+        CFMetrics::increment(_mPublishFail);
+        return;
+    }
+    _backfillCursor = points[sent - 1].timestamp + 1;
+}
+
+/**
+ * Send telemetry with the selected encoding. Aggregators start a new window once their
+ * statistics are sent, so each window matches a send interval; a failed send keeps them for the
+ * next one.
+ *
+ * @return False if any publish has failed.
+ */
+bool CFThingsBoardHelper::_sendTelemetry() {
+    if (_encoding == JSON) {
+        return _sendTelemetryJson();
+    }
+    if (!_sendTelemetryProtobuf()) {
+        return false;
+    }
+    for (uint8_t i = 0; i < _aggregateCount; i++) {
+        _aggregates[i]->reset();
+    }
+    return true;
+}
+
+/**
+ * Send telemetry as JSON. Values and each aggregator go in separate payloads, so they fit the
+ * MQTT buffer. An aggregator is reset once all its payloads are accepted.
+ *
+ * @return False if any publish has failed.
+ */
+bool CFThingsBoardHelper::_sendTelemetryJson() {
+    if (!_publishJson(CF_TB_TELEMETRY_TOPIC, _data, _qos)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < _aggregateCount; i++) {
+        int cursor = 0;
+        while (cursor < CFAggregator::ITEMS && _aggregates[i]->getCount() > 0) {
+            size_t capacity;
+            uint8_t *payload = _beginPublish(CF_TB_TELEMETRY_TOPIC, capacity, _qos);
+            if (!payload) {
+                return false;
+            }
+            size_t length = _aggregates[i]->toJson(_aggregateKeys[i], (char *) payload, capacity, cursor);
+            if (length == 0) {
+                break;                                                          // Statistic doesn't fit the MQTT buffer.
+            }
+            if (!_mqtt.endPublish(length)) {
+                return false;
+            }
+        }
+        _aggregates[i]->reset();
+    }
+    return true;
+}
+
+/**
+ * Send telemetry as protobuf. Values and aggregates go in one message, encoded straight into
+ * the MQTT buffer.
+ *
+ * @return False if publish has failed or the message doesn't fit.
+ */
+bool CFThingsBoardHelper::_sendTelemetryProtobuf() {
+    size_t capacity;
+    uint8_t *payload = _beginPublish(CF_TB_TELEMETRY_TOPIC, capacity, _qos);
+    if (!payload) {
+        return false;
+    }
+
+    unsigned long tEncode = micros();
+    CFProtobufWriter writer(payload, capacity);
+    for (JsonPair p : _data.as<JsonObject>()) {
+        int field = _getProtobufField(p.key().c_str());
+        if (field < 0) {
+            continue;
+        }
+        if (p.value().is<long>()) {
+            writer.writeInt(field, p.value().as<long>());
+        } else if (p.value().is<float>()) {
+            writer.writeFloat(field, p.value().as<float>());
+        } else if (p.value().is<const char*>()) {
+            writer.writeString(field, p.value().as<const char*>());
+        }
+    }
+    for (uint8_t i = 0; i < _aggregateCount; i++) {
+        if (_aggregates[i]->getCount() == 0) {
+            continue;
+        }
+        for (int item = 0; item < CFAggregator::ITEMS; item++) {
+            char key[48];
+            snprintf(key, sizeof(key), "%s%s", _aggregateKeys[i], CFAggregator::getItemSuffix(item));
+            int field = _getProtobufField(key);
+            if (field >= 0) {
+                writer.writeFloat(field, _aggregates[i]->getItem(item));
+            }
+        }
+    }
+    CFMetrics::record(_mEncodeTime, micros() - tEncode);
+
+    if (!writer.isValid()) {
+        Logger::error("Telemetry doesn't fit the MQTT buffer.");
+        return false;
+    }
+    CFMetrics::record(_mPayloadSize, writer.length());
+    return _mqtt.endPublish(writer.length());
+}
+
+/**
+ * Serialize a document straight into the MQTT buffer and publish it.
+ *
+ * @param topic Topic.
+ * @param doc Document.
+ * @param qos QoS.
+ * @return False if publish has failed or the document doesn't fit.
+ */
+bool CFThingsBoardHelper::_publishJson(const char *topic, JsonDocument &doc, uint8_t qos) {
+    size_t capacity;
+    uint8_t *payload = _beginPublish(topic, capacity, qos);
+    if (!payload) {
+        return false;
+    }
+    if (measureJson(doc) >= capacity) {
+        Logger::error("JSON payload doesn't fit the MQTT buffer.");
+        return false;
+    }
+    unsigned long tEncode = micros();
+    size_t length = serializeJson(doc, (char *) payload, capacity);
+    if (strcmp(topic, CF_TB_TELEMETRY_TOPIC) == 0) {
+        CFMetrics::record(_mEncodeTime, micros() - tEncode);
+        CFMetrics::record(_mPayloadSize, length);
+    }
+    return _mqtt.endPublish(length);
+}
+
+/**
+ * Start a publish. A QoS 1 publish can't start while the in-flight window is full, that is,
+ * while the broker is behind on acknowledgements.
+ *
+ * @param topic Topic.
+ * @param capacity Receives room left for the payload.
+ * @param qos QoS.
+ * @return Where payload goes or nullptr if it can't start.
+ */
+uint8_t *CFThingsBoardHelper::_beginPublish(const char *topic, size_t &capacity, uint8_t qos) {
+    uint8_t *payload = _mqtt.beginPublish(topic, capacity, qos);
+    if (!payload && qos > 0 && _mqtt.getInFlightCount() >= CF_MQTT_MAX_INFLIGHT) {
+        CF_LOG_NOTICE("Publish window is full.");
+    }
+    return payload;
+}
+
+/**
+ * Get field number of a telemetry key.
+ *
+ * @param key Telemetry key.
+ * @return Field number or -1 if key isn't mapped.
+ */
+int CFThingsBoardHelper::_getProtobufField(const char *key) {
+    for (size_t i = 0; i < _protobufFieldCount; i++) {
+        if (strcmp(_protobufFields[i].key, key) == 0) {
+            return _protobufFields[i].number;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Send metrics as telemetry.
+ * Metrics are split into payloads that fit the MQTT buffer. Histograms restart afterwards, so
+ * each submission describes the last interval.
+ */
+void CFThingsBoardHelper::_sendMetrics() {
+    CF_LOG_VERBOSE("Sending metrics to Things Board.");
+
+    // Heap health.
+    CFMetrics::set(_mHeapFree, ESP.getFreeHeap());
+    CFMetrics::set(_mHeapFragmentation, ESP.getHeapFragmentation());
+    CFMetrics::set(_mHeapMaxBlock, ESP.getMaxFreeBlockSize());
+
+    // Delivery.
+    CFMetrics::set(_mInFlight, _mqtt.getInFlightCount());
+    CFMetrics::set(_mRetransmit, _mqtt.getRetransmitCount());
+
+    int cursor = 0;
+    while (cursor < CFMetrics::getItemCount()) {
+        size_t capacity;
+        uint8_t *payload = _mqtt.beginPublish(CF_TB_TELEMETRY_TOPIC, capacity);
+        size_t length = payload ? CFMetrics::toJson((char *) payload, capacity, cursor) : 0;
+        if (length == 0) {
+            break;
+        }
+        if (!_mqtt.endPublish(length)) {
+            CFMetrics::increment(_mPublishFail);
+            break;
+        }
+    }
+    CFMetrics::resetHistograms();
+}
+
+/**
+ * MQTT message callback.
+ *
+ * @param context Helper.
+ * @param topic Topic.
+ * @param payload Payload, null terminated.
+ * @param length Payload length.
+ */
+void CFThingsBoardHelper::_onMessage(void *context, char *topic, uint8_t *payload, size_t length) {
+    ((CFThingsBoardHelper *) context)->_handleMessage(topic, payload, length);
+}
+
+/**
+ * MQTT PUBACK callback. Attributes carried by the publish are remembered as synced.
+ *
+ * @param context Helper.
+ * @param packetId Packet id.
+ * @param ackTime Time from first send to PUBACK.
+ */
+void CFThingsBoardHelper::_onAck(void *context, uint16_t packetId, unsigned long ackTime) {
+    CFThingsBoardHelper *helper = (CFThingsBoardHelper *) context;
+    CFMetrics::increment(helper->_mPublishAcked);
+    CFMetrics::record(helper->_mAckTime, ackTime);
+    helper->_attributeSync.acknowledge(packetId);
+}
+
+/**
+ * Handle an incoming message: shared attribute updates and RPC requests.
+ * The payload is parsed once, in place, so strings handed to handlers point into it.
+ *
+ * @param topic Topic.
+ * @param payload Payload, null terminated.
+ * @param length Payload length.
+ */
+void CFThingsBoardHelper::_handleMessage(char *topic, uint8_t *payload, size_t length) {
+    unsigned long tDispatch = micros();
+    StaticJsonDocument<CF_TB_JSON_SIZE> doc;
+    if (deserializeJson(doc, (char *) payload, length) != DeserializationError::Ok) {
+        CF_LOG_NOTICE("Invalid message received from Things Board.");
+        return;
+    }
+
+    size_t prefixLength = strlen(CF_TB_RPC_REQUEST_TOPIC);
+    if (strcmp(topic, CF_TB_ATTRIBUTES_TOPIC) == 0) {
+        // Shared attributes update.
+        _dispatchAttributes(doc.as<JsonObject>());
+        if (_attrCallback) {
+            _attrCallback(doc.as<JsonVariantConst>());
+        }
+    } else if (strncmp(topic, CF_TB_ATTRIBUTES_RESPONSE_TOPIC, strlen(CF_TB_ATTRIBUTES_RESPONSE_TOPIC)) == 0) {
+        // Shared attributes requested on connect.
+        _dispatchAttributes(doc["shared"].as<JsonObject>());
+        if (_attrCallback) {
+            _attrCallback(doc["shared"]);
+        }
+    } else if (strncmp(topic, CF_TB_RPC_REQUEST_TOPIC, prefixLength) == 0) {
+        // RPC request. Topic ends with the request id.
+        _dispatchRPC(topic + prefixLength, doc);
+    }
+    CFMetrics::record(_mDispatchTime, micros() - tDispatch);
+}
+
+/**
+ * Call handlers of the attributes present in a message.
+ *
+ * @param attributes Attributes.
+ */
+void CFThingsBoardHelper::_dispatchAttributes(JsonObject attributes) {
+    for (JsonPair p : attributes) {
+        Handler *handler = _findHandler(p.key().c_str(), false);
+        if (!handler) {
+            continue;
+        }
+        JsonVariant value = p.value();
+        if (handler->type == HANDLER_INT) {
+            // Values set from config portal parameters arrive as text.
+            handler->intCallback(value.is<const char*>() ? atol(value.as<const char*>()) : value.as<long>());
+        } else if (value.is<const char*>()) {
+            handler->textCallback(value.as<const char*>());
+        } else {
+            char text[24];
+            serializeJson(value, text, sizeof(text));
+            handler->textCallback(text);
+        }
+    }
+}
+
+/**
+ * Call RPC handler and respond.
+ *
+ * @param requestId Request id from the topic.
+ * @param request Request, with method and params.
+ */
+void CFThingsBoardHelper::_dispatchRPC(const char *requestId, JsonDocument &request) {
+    const char *method = request["method"];
+    Handler *handler = method ? _findHandler(method, true) : nullptr;
+    if (!handler) {
+        char message[64];
+        snprintf(message, sizeof(message), "No RPC callback for %s.", method ? method : "(null)");
+        CF_LOG_NOTICE(message);
+        return;
+    }
+
+    StaticJsonDocument<128> response;
+    handler->rpcCallback(request["params"], response);
+    if (response.isNull()) {
+        response.to<JsonObject>();
+    }
+
+    char responseTopic[48];
+    snprintf(responseTopic, sizeof(responseTopic), "%s%s", CF_TB_RPC_RESPONSE_TOPIC, requestId);
+    if (!_publishJson(responseTopic, response, 0)) {
+        CFMetrics::increment(_mPublishFail);
+    }
+}
+
+/**
+ * Subscribe to topics that have handlers. Called on connection.
+ */
+void CFThingsBoardHelper::_subscribe() {
+    _attrSubscribed = false;
+    _rpcSubscribed = false;
+    bool attributes = _attrCallback != nullptr;
+    bool rpc = false;
+    for (uint8_t i = 0; i < CF_TB_MAX_HANDLERS; i++) {
+        attributes |= _handlers[i].type == HANDLER_INT || _handlers[i].type == HANDLER_TEXT;
+        rpc |= _handlers[i].type == HANDLER_RPC;
+    }
+    if (attributes) {
+        _subscribeAttributes();
+    }
+    if (rpc && !(_rpcSubscribed = _mqtt.subscribe(CF_TB_RPC_REQUEST_TOPIC "+"))) {
+        CF_LOG_NOTICE("Fail subscribing to RPC.");
+    }
+}
+
+/**
+ * Subscribe to attribute updates and to responses of shared attribute requests, unless it's
+ * done for this connection.
+ *
+ * @return False if subscribing has failed.
+ */
+bool CFThingsBoardHelper::_subscribeAttributes() {
+    if (!_attrSubscribed) {
+        _attrSubscribed = _mqtt.subscribe(CF_TB_ATTRIBUTES_TOPIC) && _mqtt.subscribe(CF_TB_ATTRIBUTES_RESPONSE_TOPIC "+");
+        if (!_attrSubscribed) {
+            CF_LOG_NOTICE("Fail subscribing to attributes.");
+        }
+    }
+    return _attrSubscribed;
+}
+
+/**
+ * Send attributes the server doesn't have, in one message. They're remembered once the broker
+ * acknowledges it (see _onAck()).
+ *
+ * @param attributes Attributes.
+ * @return False if publish has failed.
+ */
+bool CFThingsBoardHelper::_syncAttributes(JsonDocument &attributes) {
+    StaticJsonDocument<CF_TB_JSON_SIZE> diff;
+    for (JsonPair p : attributes.as<JsonObject>()) {
+        if (!_attributeSync.isSynced(p.key().c_str(), p.value())) {
+            diff[p.key().c_str()] = p.value();
+        }
+    }
+    if (diff.size() == 0) {
+        return true;
+    }
+    char message[48];
+    snprintf(message, sizeof(message), "Sending %u changed attribute(s).", (unsigned) diff.size());
+    CF_LOG_VERBOSE(message);
+    if (!_publishJson(CF_TB_ATTRIBUTES_TOPIC, diff, _qos)) {
+        return false;
+    }
+    uint16_t packetId = _mqtt.getLastPacketId();
+    for (JsonPair p : diff.as<JsonObject>()) {
+        _attributeSync.markSent(p.key().c_str(), p.value(), packetId);
+    }
+    return true;
+}
+
+/**
+ * Request shared attributes that have handlers, with a single request. The response is
+ * dispatched as an update.
+ *
+ * @param key Only this key, for a handler added while connected (nullptr for all).
+ * @return False if publish has failed.
+ */
+bool CFThingsBoardHelper::_requestSharedAttributes(const char *key) {
+    if (!_attrSubscribed) {
+        return true;
+    }
+
+    // Topic ends with the request id.
+    char topic[48];
+    snprintf(topic, sizeof(topic), "%s%u", CF_TB_ATTRIBUTES_REQUEST_TOPIC, ++_attributeRequestId);
+
+    // Keys are written straight into the MQTT buffer: {"sharedKeys":"key1,key2"}.
+    size_t capacity;
+    char *payload = (char *) _mqtt.beginPublish(topic, capacity);
+    if (!payload) {
+        return false;
+    }
+    CFUrlWriter writer(payload, capacity);
+    writer.append("{\"sharedKeys\":\"");
+    bool first = true;
+    for (uint8_t i = 0; i < CF_TB_MAX_HANDLERS; i++) {
+        if ((_handlers[i].type == HANDLER_INT || _handlers[i].type == HANDLER_TEXT)
+                && (!key || strcmp(_handlers[i].name, key) == 0)) {
+            if (!first) {
+                writer.append(',');
+            }
+            writer.append(_handlers[i].name);
+            first = false;
+        }
+    }
+    writer.append("\"}");
+    if (first) {
+        // Only a whole message callback, there are no keys to ask for.
+        return true;
+    }
+    if (!writer.isValid()) {
+        Logger::error("Shared attributes request doesn't fit the MQTT buffer.");
+        return false;
+    }
+    return _mqtt.endPublish(writer.length());
+}
+
+/**
+ * Find or add a handler slot. The table uses open addressing with linear probing.
+ *
+ * @param name Attribute key or RPC method.
+ * @param rpc True for RPC methods.
+ * @return Handler slot or nullptr if the table is full.
+ */
+CFThingsBoardHelper::Handler *CFThingsBoardHelper::_addHandler(const char *name, bool rpc) {
+    Handler *handler = _findHandler(name, rpc);
+    if (handler) {
+        return handler;
+    }
+    // Keep a free slot, so lookups of unknown names always stop.
+    if (_handlerCount >= CF_TB_MAX_HANDLERS - 1) {
+        Logger::warning("No room for handler. Increase CF_TB_MAX_HANDLERS.");
+        return nullptr;
+    }
+    uint32_t hash = _hash(name);
+    uint8_t i = hash & (CF_TB_MAX_HANDLERS - 1);
+    while (_handlers[i].type != HANDLER_NONE) {
+        i = (i + 1) & (CF_TB_MAX_HANDLERS - 1);
+    }
+    _handlers[i].hash = hash;
+    _handlers[i].name = name;
+    _handlerCount++;
+    return &_handlers[i];
+}
+
+/**
+ * Find a handler.
+ *
+ * @param name Attribute key or RPC method.
+ * @param rpc True for RPC methods.
+ * @return Handler or nullptr if there is none.
+ */
+CFThingsBoardHelper::Handler *CFThingsBoardHelper::_findHandler(const char *name, bool rpc) {
+    uint32_t hash = _hash(name);
+    uint8_t i = hash & (CF_TB_MAX_HANDLERS - 1);
+    while (_handlers[i].type != HANDLER_NONE) {
+        Handler &handler = _handlers[i];
+        if (handler.hash == hash && (handler.type == HANDLER_RPC) == rpc && strcmp(handler.name, name) == 0) {
+            return &handler;
+        }
+        i = (i + 1) & (CF_TB_MAX_HANDLERS - 1);
+    }
+    return nullptr;
+}
+
+/**
+ * Hash a name (FNV-1a).
+ *
+ * @param name Name.
+ * @return Hash.
+ */
+uint32_t CFThingsBoardHelper::_hash(const char *name) {
+    uint32_t hash = 2166136261UL;
+    while (*name) {
+        hash ^= (uint8_t) *name++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * Subscribe to attr. The callback gets every attribute update, onAttribute() handlers are
+ * called first.
  * 
  * @param attrCallback Callback method to be called when receive an attr request.
  */
 void CFThingsBoardHelper::ATTRSubscribe(const Attr_Callback attrCallback) {
-    if (!_thingsBoard.Attr_Subscribe(attrCallback)) {
-        Logger::warning("Fail subscribing to attributes.");
-        return;
+    _attrCallback = attrCallback;
+    if (_mqtt.connected()) {
+        _subscribeAttributes();
     }
 }
 
 /**
- * Subscribe to RPC.
+ * Subscribe to RPC. Same as calling onRPC() for each callback.
  * 
  * @param callbacks List of callback methods to be called when receive a RPC request.
  * @param size Quantity of callback methods.
  */
 void CFThingsBoardHelper::RPCSubscribe(const RPC_Callback *callbacks, size_t size) {
-    if (!_thingsBoard.RPC_Subscribe(callbacks, size)) {
-        Logger::warning("Fail subscribing to RPC.");
-        return;
+    for (size_t i = 0; i < size; i++) {
+        onRPC(callbacks[i].name, callbacks[i].callback);
+    }
+}
+
+/**
+ * Handle an int attribute. Text values are converted.
+ *
+ * @param key Attribute key. It must outlive the helper (e.g. a literal).
+ * @param callback Callback called when the attribute is in an update. Added while connected, the
+ *                 current value is requested right away.
+ * @return False if there is no room for another handler.
+ */
+bool CFThingsBoardHelper::onAttribute(const char *key, IntAttributeCallback callback) {
+    Handler *handler = _addHandler(key, false);
+    if (!handler) {
+        return false;
+    }
+    handler->type = HANDLER_INT;
+    handler->intCallback = callback;
+    if (_mqtt.connected() && _subscribeAttributes() && !_requestSharedAttributes(key)) {
+        CFMetrics::increment(_mPublishFail);
+    }
+    return true;
+}
+
+/**
+ * Handle a text attribute. Other values are passed as their JSON text.
+ *
+ * @param key Attribute key. It must outlive the helper (e.g. a literal).
+ * @param callback Callback called when the attribute is in an update. Value is only valid
+ *                 while it runs. Added while connected, the current value is requested right
+ *                 away.
+ * @return False if there is no room for another handler.
+ */
+bool CFThingsBoardHelper::onAttribute(const char *key, TextAttributeCallback callback) {
+    Handler *handler = _addHandler(key, false);
+    if (!handler) {
+        return false;
+    }
+    handler->type = HANDLER_TEXT;
+    handler->textCallback = callback;
+    if (_mqtt.connected() && _subscribeAttributes() && !_requestSharedAttributes(key)) {
+        CFMetrics::increment(_mPublishFail);
+    }
+    return true;
+}
+
+/**
+ * Handle a RPC method.
+ *
+ * @param method RPC method. It must outlive the helper (e.g. a literal).
+ * @param callback Callback called with the request params. Fill the response if any.
+ * @return False if there is no room for another handler.
+ */
+bool CFThingsBoardHelper::onRPC(const char *method, RPCCallback callback) {
+    Handler *handler = _addHandler(method, true);
+    if (!handler) {
+        return false;
     }
+    handler->type = HANDLER_RPC;
+    handler->rpcCallback = callback;
+    if (!_rpcSubscribed && _mqtt.connected()) {
+        _rpcSubscribed = _mqtt.subscribe(CF_TB_RPC_REQUEST_TOPIC "+");
+    }
+    return true;
 }
 
 /**
- * Define server URL.
+ * Define server URL of the primary server.
  *
- * @param serverURL Server URL.
+ * @param serverURL Server URL (host name or IP).
  */
 void CFThingsBoardHelper::setServerURL(String serverURL) {
-    _serverURL = serverURL;
+    _servers.set(0, serverURL.c_str(), CF_TB_PORT);
+}
+
+/**
+ * Add a standby server, used while the primary is down. Call it after setServerURL().
+ *
+ * @param serverURL Server URL (host name or IP).
+ * @return False if there is no room for another server.
+ */
+bool CFThingsBoardHelper::addServer(String serverURL) {
+    if (!_servers.add(serverURL.c_str(), CF_TB_PORT)) {
+        Logger::warning("No room for server. Increase CF_SERVER_POOL_SIZE.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Define time between checks for the primary server while on a standby.
+ *
+ * @param ttPrimaryCheck Time between checks.
+ */
+void CFThingsBoardHelper::setPrimaryCheckInterval(unsigned long ttPrimaryCheck) {
+    _ttPrimaryCheck = ttPrimaryCheck;
 }
 
 /**
@@ -148,6 +930,14 @@ bool CFThingsBoardHelper::isConnected() {
     return _TBconnected;
 }
 
+/**
+ * Send telemetry and changed attributes on the next loop instead of waiting for the send
+ * interval, e.g. when a sensor predicts something urgent. The interval restarts from there.
+ */
+void CFThingsBoardHelper::sendNow() {
+    _tLastSent = 0;
+}
+
 /**
  * Set telemetry int value.
  *
@@ -168,6 +958,92 @@ void CFThingsBoardHelper::setTelemetryValue(String key, String value) {
     _data[key] = value;
 }
 
+/**
+ * Set telemetry int value. The key isn't copied, so nothing is allocated.
+ *
+ * @param key Key. It must outlive the helper (e.g. a literal).
+ * @param value Int value.
+ */
+void CFThingsBoardHelper::setTelemetryValue(const char *key, int value) {
+    _data[key] = value;
+}
+
+/**
+ * Set telemetry text value. The key isn't copied, the value is copied into a slot of its own
+ * (up to CF_TB_TEXT_SIZE - 1 chars), so setting it again doesn't use up the document.
+ *
+ * @param key Key. It must outlive the helper (e.g. a literal).
+ * @param value Text value.
+ */
+void CFThingsBoardHelper::setTelemetryValue(const char *key, const char *value) {
+    if (!value) {
+        return;
+    }
+    uint8_t i = 0;
+    while (i < _textCount && strcmp(_textKeys[i], key) != 0) {
+        i++;
+    }
+    if (i == _textCount) {
+        if (_textCount >= CF_TB_MAX_TEXTS) {
+            Logger::warning("No room for telemetry text. Increase CF_TB_MAX_TEXTS.");
+            return;
+        }
+        _textKeys[i] = key;
+        _textCount++;
+    }
+    strlcpy(_texts[i], value, CF_TB_TEXT_SIZE);
+    _data[key] = (const char *) _texts[i];                                      // ArduinoJson keeps const char *, doesn't copy.
+}
+
+/**
+ * Set telemetry decimal value. The key isn't copied, so nothing is allocated.
+ *
+ * @param key Key. It must outlive the helper (e.g. a literal).
+ * @param value Decimal value.
+ */
+void CFThingsBoardHelper::setTelemetryValue(const char *key, double value) {
+    _data[key] = value;
+}
+
+/**
+ * Size the telemetry document and the MQTT buffer for the telemetry payload, e.g. from a
+ * CFDevice component list. The MQTT buffer isn't made smaller than CF_MQTT_BUFFER_SIZE, which
+ * attributes, RPC and metrics use. Call it in setup(), before setting telemetry values.
+ *
+ * @param payload Max telemetry JSON payload (bytes).
+ * @param document Telemetry document capacity (bytes).
+ * @return False if there's no memory for them.
+ */
+bool CFThingsBoardHelper::setTelemetryCapacity(size_t payload, size_t document) {
+    // Fixed header, topic, packet id, payload and the terminator serializeJson() writes.
+    size_t packet = CF_MQTT_HEADER_SIZE + 2 + strlen(CF_TB_TELEMETRY_TOPIC) + 2 + payload + 1;
+    if (!_mqtt.setBufferSize(max(packet, (size_t) CF_MQTT_BUFFER_SIZE))) {
+        Logger::error("No memory for the MQTT buffer.");
+        return false;
+    }
+    _data = DynamicJsonDocument(document);
+    return _data.capacity() >= document;
+}
+
+/**
+ * Send aggregator statistics as telemetry on every send, as key_n, key_min, key_max, key_avg,
+ * key_sd, key_p50 and key_p90. The aggregator is reset after each send.
+ *
+ * @param key Telemetry key. It must outlive the helper (e.g. a literal).
+ * @param aggregator Aggregator fed by the sketch.
+ * @return False if there is no room for another aggregator.
+ */
+bool CFThingsBoardHelper::setTelemetryAggregate(const char *key, CFAggregator &aggregator) {
+    if (_aggregateCount >= CF_TB_MAX_AGGREGATES) {
+        Logger::warning("No room for aggregated telemetry. Increase CF_TB_MAX_AGGREGATES.");
+        return false;
+    }
+    _aggregateKeys[_aggregateCount] = key;
+    _aggregates[_aggregateCount] = &aggregator;
+    _aggregateCount++;
+    return true;
+}
+
 /**
  * Set attribute int value.
  *
@@ -188,6 +1064,29 @@ void CFThingsBoardHelper::setAttributeValue(String key, String value) {
     _attributes[key] = value;
 }
 
+/**
+ * Set attribute int value. The key isn't copied, so nothing is allocated.
+ *
+ * @param key Key. It must outlive the helper (e.g. a literal).
+ * @param value Int value.
+ */
+void CFThingsBoardHelper::setAttributeValue(const char *key, int value) {
+    _attributes[key] = value;
+}
+
+/**
+ * Set attribute text value. The key isn't copied, the value is copied into the document.
+ *
+ * @param key Key. It must outlive the helper (e.g. a literal).
+ * @param value Text value.
+ */
+void CFThingsBoardHelper::setAttributeValue(const char *key, const char *value) {
+    if (!value) {
+        return;
+    }
+    _attributes[key] = (char *) value;                                          // ArduinoJson copies char *, not const char *.
+}
+
 /**
  * Define on ThingsBoard connect callback.
  *
@@ -195,4 +1094,75 @@ void CFThingsBoardHelper::setAttributeValue(String key, String value) {
  */
 void CFThingsBoardHelper::setOnThingsBoardConnectCallback(VoidCallback onThingsBoardConnectCallback) {
     _onThingsBoardConnectCallback = onThingsBoardConnectCallback;
-}
\ No newline at end of file
+}
+
+/**
+ * Define time between metrics submissions.
+ *
+ * @param ttMetrics Time between metrics submissions. Use 0 to disable it.
+ */
+void CFThingsBoardHelper::setMetricsInterval(unsigned long ttMetrics) {
+    _ttMetrics = ttMetrics;
+}
+
+/**
+ * Send every client attribute again on next connection or send, e.g. after attributes have
+ * been deleted on the server.
+ */
+void CFThingsBoardHelper::resyncAttributes() {
+    _attributeSync.clear();
+}
+
+/**
+ * Define telemetry encoding.
+ *
+ * @param encoding JSON or PROTOBUF.
+ */
+void CFThingsBoardHelper::setEncoding(Encoding encoding) {
+    _encoding = encoding;
+}
+
+/**
+ * Define telemetry encoding and protobuf field numbers.
+ *
+ * @param encoding JSON or PROTOBUF.
+ * @param fields Field number per telemetry key. It must outlive the helper.
+ * @param size Quantity of fields.
+ */
+void CFThingsBoardHelper::setEncoding(Encoding encoding, const ProtobufField *fields, size_t size) {
+    _encoding = encoding;
+    _protobufFields = fields;
+    _protobufFieldCount = size;
+}
+/**
+ * Define QoS of telemetry and attributes. QoS 1 trades a copy of each publish in RAM, kept until
+ * acknowledged, for at least once delivery.
+ *
+ * @param qos QoS (0 or 1).
+ */
+void CFThingsBoardHelper::setQoS(uint8_t qos) {
+    _qos = qos > 0 ? 1 : 0;
+}
+
+/**
+ * Define keep alive and ping timeout. A lower ping timeout detects half-open connections sooner.
+ *
+ * @param keepAlive Keep alive (s). Applies on next connection.
+ * @param ttPingTimeout Time waiting for PINGRESP.
+ */
+void CFThingsBoardHelper::setKeepAlive(uint16_t keepAlive, unsigned long ttPingTimeout) {
+    _mqtt.setKeepAlive(keepAlive);
+    _mqtt.setPingTimeout(ttPingTimeout);
+}
+
+/**
+ * Send history of outages once connected again. Points of the gap since the last telemetry sent
+ * go with their own timestamps, so ThingsBoard charts have no hole.
+ *
+ * @param history Time series store, its keys are the telemetry keys.
+ * @param tier Tier sent, MINUTE by default (RAW sends every sample, HOUR the fewest).
+ */
+void CFThingsBoardHelper::setBackfill(CFTimeSeries &history, CFTimeSeries::Tier tier) {
+    _history = &history;
+    _backfillTier = tier;
+}
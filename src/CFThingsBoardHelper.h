@@ -2,6 +2,49 @@
  * CFThingsBoardHelper.h
  * 
  * A library for Arduino that helps to integrate with ThingsBoard.
+ *
+ * Telemetry is encoded as JSON by default. Devices whose profile uses the protobuf payload
+ * type can send it as protobuf instead, with telemetry keys mapped to the schema field numbers:
+ *
+ *      const CFThingsBoardHelper::ProtobufField fields[] = {
+ *          { "soi_value", 1 },
+ *          { "soi_perct", 2 },
+ *          { "soi_perct_avg", 3 }                                              // Aggregates are floats.
+ *      };
+ *      _cfThingsBoard.setEncoding(CFThingsBoardHelper::PROTOBUF, fields, 3);
+ *
+ * Keys without a field number are left out. Attributes, RPC and metrics stay JSON, so enable
+ * compatibility with other payload formats in the device profile. extras/host/cfbench.cpp
+ * compares both encodings' time and payload bytes on the host.
+ *
+ * Incoming messages are parsed once, in place, and routed by name through a hash table to typed
+ * handlers. Only handlers of attributes present in the message are called:
+ *
+ *      _cfThingsBoard.onAttribute("attr_device_name", onDeviceNameCallback);   // void (const char *value)
+ *      _cfThingsBoard.onAttribute("attr_soilm_dryval", onDryValueCallback);    // void (long value)
+ *      _cfThingsBoard.onRPC("default", RPCDefaultCallback);                    // void (const RPC_Data &, RPC_Response &)
+ *
+ * On connect, shared attributes with handlers are fetched with a single request. Client
+ * attributes are only sent when their value differs from what the server already has; see
+ * CFAttributeSync.
+ *
+ * Standby servers are added after the primary with addServer(). While the primary is down the
+ * helper switches to a standby on the next loop, and goes back once the primary accepts
+ * connections again; see CFServerPool.
+ *
+ * Telemetry and attributes are published with QoS 1 by default: each is kept until the broker
+ * acknowledges it and sent again across reconnections, within a window of CF_MQTT_MAX_INFLIGHT
+ * publishes. A send that finds the window full fails and is counted in tb_pub_fail. RPC
+ * responses, attribute requests and metrics stay QoS 0.
+ *
+ * With a CFTimeSeries set with setBackfill(), history recorded while ThingsBoard was out of
+ * reach is sent with its timestamps once it's back, one publish per loop, from the minute tier
+ * by default. The gap starts at the last telemetry sent, so it needs the clock set and isn't
+ * known after a reboot.
+ *
+ * The telemetry document and the MQTT buffer are sized with setTelemetryCapacity(); listed in a
+ * CFDevice, the helper gets them from the other components. loop() does nothing while Wi-Fi is
+ * down, so it can be looped with them.
  * 
  * @author  Caio Frota <caiofrota@gmail.com>
  * @version 1.0
@@ -14,50 +57,235 @@
 #include <Arduino.h>                                                            // Arduino library.
 #include <Logger.h>                                                             // Logger.
 #include <WiFiClient.h>                                                         // WIFiClient.
-#include <ThingsBoard.h>                                                        // Things Board.
+#include <ArduinoJson.h>                                                        // Arduino JSON.
+#include <CFMqttClient.h>                                                       // CF MQTT Client.
+#include <CFProtobufWriter.h>                                                   // CF Protobuf Writer.
+#include <CFMetrics.h>                                                          // CF Metrics.
+#include <CFHeap.h>                                                             // CF Heap.
+#include <CFAggregator.h>                                                       // CF Aggregator.
+#include <CFAttributeSync.h>                                                    // CF Attribute Sync.
+#include <CFUrlWriter.h>                                                        // CF URL Writer.
+#include <CFServerPool.h>                                                       // CF Server Pool.
+#include <CFTrace.h>                                                           // CF Trace.
+#include <CFTimeSeries.h>                                                       // CF Time Series.
+
+#ifndef CF_TB_MAX_AGGREGATES
+    #define CF_TB_MAX_AGGREGATES            4                                   // Max aggregated telemetry keys.
+#endif
+
+#ifndef CF_TB_MAX_TEXTS
+    #define CF_TB_MAX_TEXTS                 4                                   // Max telemetry text values set as const char *.
+#endif
+
+#ifndef CF_TB_TEXT_SIZE
+    #define CF_TB_TEXT_SIZE                 24                                  // Max telemetry text value length (+1).
+#endif
+
+#ifndef CF_TB_MAX_HANDLERS
+    #define CF_TB_MAX_HANDLERS              16                                  // Hash table size for attribute and RPC handlers. Power of 2.
+#endif
+
+static_assert(CF_TB_MAX_HANDLERS > 0 && (CF_TB_MAX_HANDLERS & (CF_TB_MAX_HANDLERS - 1)) == 0,
+        "CF_TB_MAX_HANDLERS must be a power of 2, handlers are probed with a mask.");
+
+#ifndef CF_TB_BACKFILL_POINTS
+    #define CF_TB_BACKFILL_POINTS           8                                   // Max history points per backfill publish.
+#endif
+
+#ifndef CF_TB_JSON_SIZE
+    #define CF_TB_JSON_SIZE                 256                                 // JSON document for incoming messages.
+#endif
+
+// Callback types, same as the ThingsBoard SDK ones the sketches were written for.
+using RPC_Data = JsonVariantConst;                                              // RPC params or attributes.
+using RPC_Response = JsonDocument;                                              // RPC response.
+using Attr_Callback = void (*)(const RPC_Data &data);                           // Attributes callback.
+using RPCCallback = void (*)(const RPC_Data &data, RPC_Response &response);     // RPC callback.
+using IntAttributeCallback = void (*)(long value);                              // Int attribute callback.
+using TextAttributeCallback = void (*)(const char *value);                      // Text attribute callback.
+struct RPC_Callback {
+    const char *name;                                                           // RPC method.
+    RPCCallback callback;                                                       // RPC callback.
+};
 
 class CFThingsBoardHelper {
+    public:
+        // Telemetry encodings.
+        enum Encoding {
+            JSON,                                                               // JSON text.
+            PROTOBUF                                                            // ThingsBoard protobuf device profile.
+        };
+
+        // Protobuf field number of a telemetry key.
+        struct ProtobufField {
+            const char *key;                                                    // Telemetry key.
+            uint16_t number;                                                    // Field number in the schema.
+        };
+
     private:
         // Aliases.
         using VoidCallback = void (*)();                                        // Alias for callback.
 
-        // ThingsBoard and WiFiClient attributes.
+        // Handler types.
+        enum HandlerType : uint8_t {HANDLER_NONE, HANDLER_INT, HANDLER_TEXT, HANDLER_RPC};
+
+        // Handler, stored by name hash.
+        struct Handler {
+            uint32_t hash;                                                      // Name hash.
+            const char *name;                                                   // Attribute key or RPC method.
+            HandlerType type;                                                   // Handler type.
+            union {
+                IntAttributeCallback intCallback;                               // Int attribute callback.
+                TextAttributeCallback textCallback;                             // Text attribute callback.
+                RPCCallback rpcCallback;                                        // RPC callback.
+            };
+        };
+
+        // MQTT and WiFiClient attributes.
         WiFiClient _wifiClient;                                                 // WiFi Client.
-        ThingsBoard _thingsBoard;                                               // ThingsBoard.
+        CFMqttClient _mqtt;                                                     // MQTT client.
         
         // Config attributes.
         String _appCode;                                                        // Software code.
         String _appVersion;                                                     // Software version.
-        String _serverURL;                                                      // Server URL.
+        CFServerPool _servers;                                                  // Servers, primary first.
+        int _server;                                                            // Server of the current or last session.
+        unsigned long _ttPrimaryCheck;                                          // Time between checks for the primary while on a standby.
+        unsigned long _tLastPrimaryCheck;                                       // Last time primary was checked.
         String _token;                                                          // Device token to connect to ThingsBoard device.
         String _localIP;                                                        // Local IP.
         String _deviceName;                                                     // Device name.
-        unsigned long _ttRetry;                                                 // Time between connection attempts.
         unsigned long _ttSend;                                                  // Time between submissions.
         unsigned long _tLastSent;                                               // Last time data was sent.
         bool _TBconnected;                                                      // Flag that indicates if ThingsBoard is connected.
+        unsigned long _ttMetrics;                                               // Time between metrics submissions (0 disables).
+        unsigned long _tLastMetrics;                                            // Last time metrics were sent.
+        unsigned long _tLastLoop;                                               // Last loop start (us).
+
+        // Encoding attributes.
+        Encoding _encoding;                                                     // Telemetry encoding.
+        const ProtobufField *_protobufFields;                                   // Protobuf field numbers.
+        size_t _protobufFieldCount;                                             // Protobuf field numbers quantity.
+        uint8_t _qos;                                                           // QoS of telemetry and attributes.
+
+        // Metrics.
+        int _mConnect;                                                          // Connections.
+        int _mConnectFail;                                                      // Failed connections.
+        int _mFailover;                                                         // Server switches.
+        int _mServer;                                                           // Server index of the session.
+        int _mPublishFail;                                                      // Failed publishes.
+        int _mPublishAcked;                                                     // Acknowledged QoS 1 publishes.
+        int _mAckTime;                                                          // Time from publish to PUBACK histogram (ms).
+        int _mInFlight;                                                         // Publishes waiting for PUBACK.
+        int _mRetransmit;                                                       // Publishes sent again.
+        int _mConnectTime;                                                      // Connection time histogram (ms).
+        int _mLoopTime;                                                         // Time between loops histogram (us).
+        int _mEncodeTime;                                                       // Telemetry encoding time histogram (us).
+        int _mDispatchTime;                                                     // Incoming message handling time histogram (us).
+        int _mPayloadSize;                                                      // Telemetry payload size histogram (bytes).
+        int _mHeapFree;                                                         // Free heap.
+        int _mHeapFragmentation;                                                // Heap fragmentation (%).
+        int _mHeapMaxBlock;                                                     // Largest free heap block.
 
         // JSON Data.
         DynamicJsonDocument _data;                                              // JSON telemetry data.
         DynamicJsonDocument _attributes;                                        // JSON attributes.
 
+        // Attribute sync.
+        CFAttributeSync _attributeSync;                                         // Client attributes the server already has.
+        uint16_t _attributeRequestId;                                           // Last shared attributes request id.
+
+        // Aggregated telemetry.
+        const char *_aggregateKeys[CF_TB_MAX_AGGREGATES];                       // Aggregated telemetry keys.
+        CFAggregator *_aggregates[CF_TB_MAX_AGGREGATES];                        // Aggregators.
+        uint8_t _aggregateCount;                                                // Registered aggregators.
+
+        // Telemetry texts.
+        const char *_textKeys[CF_TB_MAX_TEXTS];                                 // Telemetry text keys.
+        char _texts[CF_TB_MAX_TEXTS][CF_TB_TEXT_SIZE];                          // Telemetry text values.
+        uint8_t _textCount;                                                     // Telemetry texts in use.
+
+        // Backfill.
+        CFTimeSeries *_history;                                                 // History sent after an outage (optional).
+        CFTimeSeries::Tier _backfillTier;                                       // History tier sent.
+        uint32_t _tsLastSent;                                                   // Unix time of the last telemetry sent.
+        uint32_t _backfillFrom;                                                 // Gap start (Unix time).
+        uint32_t _backfillTo;                                                   // Gap end (Unix time).
+        uint32_t _backfillCursor;                                               // Next point of the series being sent.
+        int8_t _backfillSeries;                                                 // Series being sent (-1 if none).
+
         // Callbacks.
         VoidCallback _onThingsBoardConnectCallback;                             // On ThingsBoard connect callback.
+        Attr_Callback _attrCallback;                                            // Attributes callback (whole message).
+        Handler _handlers[CF_TB_MAX_HANDLERS];                                  // Handlers hash table.
+        uint8_t _handlerCount;                                                  // Registered handlers.
+        bool _attrSubscribed;                                                   // Flag that indicates attributes are subscribed.
+        bool _rpcSubscribed;                                                    // Flag that indicates RPC is subscribed.
+
+        // Methods.
+        bool _connect(int server);                                              // Connect to a server of the pool.
+        void _checkPrimary();                                                   // Switch back to the primary once it's up.
+        void _sendMetrics();                                                    // Send metrics as telemetry.
+        void _startBackfill();                                                  // Start sending history of the gap.
+        void _sendBackfill();                                                   // Send next history points.
+        bool _sendTelemetry();                                                  // Send telemetry with the selected encoding.
+        bool _sendTelemetryJson();                                              // Send telemetry as JSON.
+        bool _sendTelemetryProtobuf();                                          // Send telemetry as protobuf.
+        bool _publishJson(const char *topic, JsonDocument &doc, uint8_t qos);   // Serialize a document into the MQTT buffer.
+        uint8_t *_beginPublish(const char *topic, size_t &capacity,             // Start a publish, logging a full window.
+                uint8_t qos);
+        int _getProtobufField(const char *key);                                 // Get field number of a telemetry key.
+        void _handleMessage(char *topic, uint8_t *payload, size_t length);      // Handle an incoming message.
+        void _dispatchAttributes(JsonObject attributes);                        // Call handlers of attributes present.
+        void _dispatchRPC(const char *requestId, JsonDocument &request);        // Call RPC handler and respond.
+        void _subscribe();                                                      // Subscribe to topics with handlers.
+        bool _subscribeAttributes();                                            // Subscribe to attribute updates and responses.
+        bool _syncAttributes(JsonDocument &attributes);                         // Send attributes the server doesn't have.
+        bool _requestSharedAttributes(const char *key = nullptr);               // Request shared attributes with handlers.
+        Handler *_addHandler(const char *name, bool rpc);                       // Find or add a handler slot.
+        Handler *_findHandler(const char *name, bool rpc);                      // Find a handler.
+        static uint32_t _hash(const char *name);                                // Hash a name (FNV-1a).
+        static void _onMessage(void *context, char *topic,                      // MQTT message callback.
+                uint8_t *payload, size_t length);
+        static void _onAck(void *context, uint16_t packetId,                    // MQTT PUBACK callback.
+                unsigned long ackTime);
 
     public:
         CFThingsBoardHelper(String appCode, String appVersion);                 // Constructor.
         void loop();                                                            // Loop.
         void ATTRSubscribe(const Attr_Callback callback);                       // Subscribe to attr.
         void RPCSubscribe(const RPC_Callback *callbacks, size_t size);          // Subscribe to RPC.
+        bool onAttribute(const char *key, IntAttributeCallback callback);       // Handle an int attribute.
+        bool onAttribute(const char *key, TextAttributeCallback callback);      // Handle a text attribute.
+        bool onRPC(const char *method, RPCCallback callback);                   // Handle a RPC method.
         void setServerURL(String serverURL);                                    // Define server URL.
+        bool addServer(String serverURL);                                       // Add a standby server.
+        void setPrimaryCheckInterval(unsigned long ttPrimaryCheck);             // Define time between checks for the primary.
         void setToken(String token);                                            // Define token.
         void setLocalIP(String localIP);                                        // Define device name.
         bool isConnected();                                                     // True if ThingsBoard is connected.
+        void sendNow();                                                         // Send on the next loop, out of the send interval.
         void setTelemetryValue(String key, int value);                          // Set telemetry int value.
         void setTelemetryValue(String key, String value);                       // Set telemetry String value.
+        void setTelemetryValue(const char *key, int value);                     // Set telemetry int value without allocating.
+        void setTelemetryValue(const char *key, const char *value);             // Set telemetry text value without allocating.
+        void setTelemetryValue(const char *key, double value);                  // Set telemetry decimal value without allocating.
+        bool setTelemetryAggregate(const char *key, CFAggregator &aggregator);  // Send aggregator statistics as telemetry.
+        bool setTelemetryCapacity(size_t payload, size_t document);             // Size telemetry document and MQTT buffer.
         void setAttributeValue(String key, int value);                          // Set attribute int value.
         void setAttributeValue(String key, String value);                       // Set attribute String value.
+        void setAttributeValue(const char *key, int value);                     // Set attribute int value without allocating.
+        void setAttributeValue(const char *key, const char *value);             // Set attribute text value without allocating.
         void setOnThingsBoardConnectCallback(const VoidCallback);               // Define on ThingsBoard connect callback.
+        void setMetricsInterval(unsigned long ttMetrics);                       // Define time between metrics submissions.
+        void resyncAttributes();                                                // Send every client attribute again.
+        void setEncoding(Encoding encoding);                                    // Define telemetry encoding.
+        void setEncoding(Encoding encoding, const ProtobufField *fields,         // Define telemetry encoding and protobuf fields.
+                size_t size);
+        void setQoS(uint8_t qos);                                               // Define QoS of telemetry and attributes.
+        void setKeepAlive(uint16_t keepAlive, unsigned long ttPingTimeout);     // Define keep alive and ping timeout.
+        void setBackfill(CFTimeSeries &history,                                 // Send history of outages once connected again.
+                CFTimeSeries::Tier tier = CFTimeSeries::MINUTE);
 };
 
-#endif
\ No newline at end of file
+#endif
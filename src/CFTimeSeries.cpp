@@ -0,0 +1,588 @@
+/**
+ * CFTimeSeries.cpp
+ *
+ * History of integer readings kept in flash, with minute and hour averages.
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFTimeSeries.h>                                                       // CF Time Series.
+#include <Logger.h>                                                             // Logger.
+
+#define CF_TS_MAGIC                         0xCF75                              // Segment marker. Change it when layout changes.
+#define CF_TS_PATH_SIZE                     32                                  // SPIFFS max path, terminator included.
+
+static const uint32_t PERIODS[] = {1, 60, 3600};                                // Tier periods (s).
+static const char TIER_NAMES[] = "rmh";                                         // Tier file extensions.
+
+/**
+ * Constructor.
+ *
+ * @param fileSystem File system (SPIFFS or LittleFS).
+ * @param directory Directory of the tier files. Paths are <directory>/<key>.<r|m|h>, so keep
+ *          them within 31 characters on SPIFFS.
+ */
+CFTimeSeries::CFTimeSeries(FS &fileSystem, const char *directory):
+        _fileSystem(fileSystem), _directory(directory), _seriesCount(0), _mounted(false),
+        _ttFlush(300000), _tLastFlush(0) {
+
+}
+
+/**
+ * Add a series, loading what its tier files already have.
+ *
+ * @param key Key. It must outlive the store (e.g. a literal).
+ * @return Series index or -1 if there is no room for another series.
+ */
+int CFTimeSeries::addSeries(const char *key) {
+    int series = getSeries(key);
+    if (series >= 0) {
+        return series;
+    }
+    if (_seriesCount >= CF_TS_MAX_SERIES) {
+        return -1;
+    }
+    if (!_mounted) {
+        _mounted = _fileSystem.begin();
+        if (!_mounted) {
+            Logger::error("Time series file system can't be mounted.");
+        }
+    }
+    series = _seriesCount++;
+    memset(&_series[series], 0, sizeof(Series));
+    _series[series].key = key;
+    for (uint8_t tier = RAW; tier < AUTO; tier++) {
+        _load(series, (Tier) tier);
+    }
+    return series;
+}
+
+/**
+ * Loop. Writes pending samples every flush interval.
+ */
+void CFTimeSeries::loop() {
+    if (millis() - _tLastFlush > _ttFlush) {
+        flush();
+    }
+}
+
+/**
+ * Add a sample now. Dropped while the clock isn't set.
+ *
+ * @param series Series index.
+ * @param value Value.
+ * @return False if it was dropped.
+ */
+bool CFTimeSeries::add(int series, long value) {
+    uint32_t timestamp = now();
+    return timestamp != 0 && add(series, value, timestamp);
+}
+
+/**
+ * Add a sample. Samples older than the last one of the series are dropped.
+ *
+ * @param series Series index.
+ * @param value Value.
+ * @param timestamp Unix time (s).
+ * @return False if it was dropped.
+ */
+bool CFTimeSeries::add(int series, long value, uint32_t timestamp) {
+    if (series < 0 || series >= _seriesCount || timestamp == 0) {
+        return false;
+    }
+    if (!_append(series, RAW, timestamp, value)) {
+        return false;
+    }
+    _fold(series, MINUTE, timestamp, value);
+    _fold(series, HOUR, timestamp, value);
+    return true;
+}
+
+/**
+ * Get points of a time range, oldest first. Segments are found by binary search over their
+ * headers, so only the segments within the range are decoded.
+ *
+ * @param series Series index.
+ * @param from Range start, Unix time (s).
+ * @param to Range end, Unix time (s), included.
+ * @param points Receives points.
+ * @param size Max points.
+ * @param tier Tier, or AUTO for the finest one holding the range start.
+ * @return Points returned. Less than size when the range has no more.
+ */
+size_t CFTimeSeries::query(int series, uint32_t from, uint32_t to, Point *points, size_t size, Tier tier) {
+    if (series < 0 || series >= _seriesCount || size == 0 || from > to) {
+        return 0;
+    }
+    if (tier == AUTO) {
+        tier = getTier(series, from);
+    }
+    Ring &ring = _series[series].rings[tier];
+    File &file = _files[series][tier];
+
+    // Last segment starting at or before the range start.
+    Header header;
+    int start = 0;
+    int low = 0;
+    int high = ring.segments - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        if (_segmentHeader(series, tier, middle, file, header) && header.first <= from) {
+            start = middle;
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    // Decode from there until the range end.
+    size_t count = 0;
+    uint8_t data[sizeof(ring.data)];
+    for (int i = start; i < ring.segments && count < size; i++) {
+        const uint8_t *segment = ring.data;
+        if (i == ring.segments - 1) {
+            header = ring.header;
+        } else {
+            uint8_t slot = (ring.head + CF_TS_SEGMENTS - (ring.segments - 1 - i)) % CF_TS_SEGMENTS;
+            if (!file || !_readSegment(file, slot, header, data)) {
+                continue;
+            }
+            segment = data;
+        }
+        if (header.count > 0 && header.first > to) {
+            break;
+        }
+        count += _decode(header, segment, from, to, points + count, size - count);
+    }
+    return count;
+}
+
+/**
+ * Write pending samples, that is, segments being filled that changed since last written.
+ */
+void CFTimeSeries::flush() {
+    for (int series = 0; series < _seriesCount; series++) {
+        for (uint8_t tier = RAW; tier < AUTO; tier++) {
+            if (_series[series].rings[tier].dirty) {
+                _writeSegment(series, (Tier) tier);
+            }
+        }
+    }
+    _tLastFlush = millis();
+}
+
+/**
+ * Get Unix time.
+ *
+ * @return Unix time (s) or 0 if the clock isn't set.
+ */
+uint32_t CFTimeSeries::now() {
+    time_t timestamp = time(nullptr);
+    return timestamp >= (time_t) CF_TS_VALID_TIME ? (uint32_t) timestamp : 0;
+}
+
+/**
+ * Get tier file path.
+ *
+ * @param buffer Output buffer.
+ * @param size Buffer size.
+ * @param series Series index.
+ * @param tier Tier.
+ */
+void CFTimeSeries::_path(char *buffer, size_t size, int series, Tier tier) {
+    snprintf(buffer, size, "%s/%s.%c", _directory, _series[series].key, TIER_NAMES[tier]);
+}
+
+/**
+ * Open a tier file and find its ring: the newest segment is the one being filled, and the
+ * segments before it with consecutive sequences are the stored ones. A missing file is created
+ * with all its segments, so it never grows afterwards. The file is kept open.
+ *
+ * @param series Series index.
+ * @param tier Tier.
+ */
+void CFTimeSeries::_load(int series, Tier tier) {
+    Ring &ring = _series[series].rings[tier];
+    ring.header.magic = CF_TS_MAGIC;
+    ring.header.sequence = 1;
+    ring.segments = 1;
+    char path[CF_TS_PATH_SIZE];
+    _path(path, sizeof(path), series, tier);
+    File &file = _files[series][tier];
+    if (!_fileSystem.exists(path)) {
+        file = _fileSystem.open(path, "w+");
+        if (!file) {
+            return;
+        }
+        uint8_t zeros[32] = {0};
+        for (size_t i = 0; i < (size_t) CF_TS_SEGMENTS * CF_TS_SEGMENT_SIZE; i += sizeof(zeros)) {
+            file.write(zeros, sizeof(zeros));
+        }
+        file.flush();
+        return;
+    }
+    file = _fileSystem.open(path, "r+");
+    if (!file) {
+        return;
+    }
+
+    // Sequence of each slot, and the newest.
+    uint32_t sequences[CF_TS_SEGMENTS];
+    Header header;
+    int head = -1;
+    for (uint8_t slot = 0; slot < CF_TS_SEGMENTS; slot++) {
+        sequences[slot] = 0;
+        if (file.seek((uint32_t) slot * CF_TS_SEGMENT_SIZE)
+                && file.read((uint8_t *) &header, sizeof(header)) == sizeof(header)
+                && header.magic == CF_TS_MAGIC && header.count > 0) {
+            sequences[slot] = header.sequence;
+            if (head < 0 || header.sequence > sequences[head]) {
+                head = slot;
+            }
+        }
+    }
+    if (head < 0 || !_readSegment(file, head, ring.header, ring.data)) {
+        return;
+    }
+    ring.head = head;
+    for (uint8_t i = 1; i < CF_TS_SEGMENTS; i++) {
+        uint8_t slot = (head + CF_TS_SEGMENTS - i) % CF_TS_SEGMENTS;
+        if (sequences[slot] == 0 || sequences[slot] != ring.header.sequence - i) {
+            break;
+        }
+        ring.segments++;
+    }
+
+    // Encoder state where the segment stops.
+    int32_t value;
+    size_t length = _getVarint(ring.data, sizeof(ring.data), value);
+    uint32_t timestamp = ring.header.first;
+    ring.value = value;
+    ring.delta = 0;
+    for (uint16_t i = 1; i < ring.header.count && length > 0; i++) {
+        int32_t deltaOfDelta;
+        int32_t deltaValue;
+        size_t used = _getVarint(ring.data + length, sizeof(ring.data) - length, deltaOfDelta);
+        used = used ? used + _getVarint(ring.data + length + used, sizeof(ring.data) - length - used, deltaValue) : 0;
+        if (used == 0) {
+            ring.header.count = i;
+            break;
+        }
+        ring.delta += deltaOfDelta;
+        timestamp += ring.delta;
+        ring.value += deltaValue;
+        length += used;
+    }
+    ring.length = length;
+    ring.header.last = timestamp;
+}
+
+/**
+ * Read a segment from a tier file.
+ *
+ * @param file Tier file.
+ * @param slot Slot in the file.
+ * @param header Receives header.
+ * @param data Receives encoded samples.
+ * @return False if it can't be read or isn't a segment.
+ */
+bool CFTimeSeries::_readSegment(File &file, uint8_t slot, Header &header, uint8_t *data) {
+    return file.seek((uint32_t) slot * CF_TS_SEGMENT_SIZE)
+            && file.read((uint8_t *) &header, sizeof(header)) == sizeof(header)
+            && header.magic == CF_TS_MAGIC
+            && file.read(data, CF_TS_SEGMENT_SIZE - sizeof(Header)) == CF_TS_SEGMENT_SIZE - sizeof(Header);
+}
+
+/**
+ * Write the segment being filled into its slot.
+ *
+ * @param series Series index.
+ * @param tier Tier.
+ */
+void CFTimeSeries::_writeSegment(int series, Tier tier) {
+    Ring &ring = _series[series].rings[tier];
+    File &file = _files[series][tier];
+    if (file && file.seek((uint32_t) ring.head * CF_TS_SEGMENT_SIZE)) {
+        file.write((const uint8_t *) &ring.header, sizeof(ring.header));
+        file.write(ring.data, sizeof(ring.data));
+        file.flush();
+        ring.dirty = false;
+    }
+}
+
+/**
+ * Append a sample to a tier. A full segment is written and the next slot starts a new one,
+ * overwriting the oldest segment once the ring has gone around.
+ *
+ * @param series Series index.
+ * @param tier Tier.
+ * @param timestamp Unix time (s).
+ * @param value Value.
+ * @return False if the sample is older than the last one.
+ */
+bool CFTimeSeries::_append(int series, Tier tier, uint32_t timestamp, long value) {
+    Ring &ring = _series[series].rings[tier];
+    if (ring.header.count > 0 && timestamp < ring.header.last) {
+        return false;
+    }
+    uint8_t encoded[10];
+    size_t length = 0;
+    uint32_t delta = timestamp - ring.header.last;
+    if (ring.header.count > 0) {
+        length = _putVarint(encoded, (int32_t) (delta - ring.delta));
+        length += _putVarint(encoded + length, (int32_t) (value - ring.value));
+    }
+    if (ring.header.count > 0 && ring.length + length > sizeof(ring.data)) {
+        _writeSegment(series, tier);
+        ring.head = (ring.head + 1) % CF_TS_SEGMENTS;
+        if (ring.segments < CF_TS_SEGMENTS) {
+            ring.segments++;
+        }
+        ring.header.sequence++;
+        ring.header.count = 0;
+        ring.length = 0;
+        memset(ring.data, 0, sizeof(ring.data));
+    }
+    if (ring.header.count == 0) {
+        length = _putVarint(encoded, value);
+        ring.header.first = timestamp;
+        delta = 0;
+    }
+    memcpy(ring.data + ring.length, encoded, length);
+    ring.length += length;
+    ring.header.count++;
+    ring.header.last = timestamp;
+    ring.delta = delta;
+    ring.value = value;
+    ring.dirty = true;
+    return true;
+}
+
+/**
+ * Fold a sample into the average of a coarser tier. The average is appended to the tier once a
+ * sample of the next period arrives.
+ *
+ * @param series Series index.
+ * @param tier Tier.
+ * @param timestamp Unix time (s).
+ * @param value Value.
+ */
+void CFTimeSeries::_fold(int series, Tier tier, uint32_t timestamp, long value) {
+    Bucket &bucket = _series[series].buckets[tier];
+    uint32_t start = timestamp - timestamp % PERIODS[tier];
+    if (bucket.count > 0 && start != bucket.start) {
+        int64_t half = bucket.count / 2;
+        long average = (bucket.sum >= 0 ? bucket.sum + half : bucket.sum - half) / bucket.count;
+        _append(series, tier, bucket.start, average);
+        bucket.count = 0;
+        bucket.sum = 0;
+    }
+    if (bucket.count == UINT16_MAX) {
+        return;
+    }
+    bucket.start = start;
+    bucket.sum += value;
+    bucket.count++;
+}
+
+/**
+ * Decode points of a segment within a range.
+ *
+ * @param header Segment header.
+ * @param data Encoded samples.
+ * @param from Range start (s).
+ * @param to Range end (s), included.
+ * @param points Receives points.
+ * @param size Max points.
+ * @return Points decoded.
+ */
+size_t CFTimeSeries::_decode(const Header &header, const uint8_t *data, uint32_t from, uint32_t to,
+        Point *points, size_t size) {
+    const size_t dataSize = CF_TS_SEGMENT_SIZE - sizeof(Header);
+    if (header.count == 0 || header.last < from) {
+        return 0;
+    }
+    int32_t value;
+    size_t offset = _getVarint(data, dataSize, value);
+    uint32_t timestamp = header.first;
+    uint32_t delta = 0;
+    size_t count = 0;
+    for (uint16_t i = 0; i < header.count && offset > 0; i++) {
+        if (i > 0) {
+            int32_t deltaOfDelta;
+            int32_t deltaValue;
+            size_t used = _getVarint(data + offset, dataSize - offset, deltaOfDelta);
+            used = used ? used + _getVarint(data + offset + used, dataSize - offset - used, deltaValue) : 0;
+            if (used == 0) {
+                break;
+            }
+            delta += deltaOfDelta;
+            timestamp += delta;
+            value += deltaValue;
+            offset += used;
+        }
+        if (timestamp > to) {
+            break;
+        }
+        if (timestamp >= from) {
+            points[count].timestamp = timestamp;
+            points[count].value = value;
+            if (++count >= size) {
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Get header of a stored segment.
+ *
+ * @param series Series index.
+ * @param tier Tier.
+ * @param index Segment index, oldest first (the one being filled is the last).
+ * @param file Tier file, for the stored ones.
+ * @param header Receives header.
+ * @return False if it can't be read or has no samples.
+ */
+bool CFTimeSeries::_segmentHeader(int series, Tier tier, uint8_t index, File &file, Header &header) {
+    Ring &ring = _series[series].rings[tier];
+    if (index == ring.segments - 1) {
+        header = ring.header;
+    } else {
+        uint8_t slot = (ring.head + CF_TS_SEGMENTS - (ring.segments - 1 - index)) % CF_TS_SEGMENTS;
+        if (!file || !file.seek((uint32_t) slot * CF_TS_SEGMENT_SIZE)
+                || file.read((uint8_t *) &header, sizeof(header)) != sizeof(header)
+                || header.magic != CF_TS_MAGIC) {
+            return false;
+        }
+    }
+    return header.count > 0;
+}
+
+/**
+ * Encode a zig-zag varint, small magnitudes of either sign in few bytes.
+ *
+ * @param buffer Output buffer, room for 5 bytes.
+ * @param value Value.
+ * @return Bytes written.
+ */
+size_t CFTimeSeries::_putVarint(uint8_t *buffer, int32_t value) {
+    uint32_t zigzag = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+    size_t length = 0;
+    while (zigzag >= 0x80) {
+        buffer[length++] = (zigzag & 0x7F) | 0x80;
+        zigzag >>= 7;
+    }
+    buffer[length++] = zigzag;
+    return length;
+}
+
+/**
+ * Decode a zig-zag varint.
+ *
+ * @param buffer Input buffer.
+ * @param size Bytes available.
+ * @param value Receives value.
+ * @return Bytes read or 0 if it's truncated.
+ */
+size_t CFTimeSeries::_getVarint(const uint8_t *buffer, size_t size, int32_t &value) {
+    uint32_t zigzag = 0;
+    for (size_t i = 0; i < size && i < 5; i++) {
+        zigzag |= (uint32_t) (buffer[i] & 0x7F) << (7 * i);
+        if ((buffer[i] & 0x80) == 0) {
+            value = (int32_t) (zigzag >> 1) ^ -(int32_t) (zigzag & 1);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Define time between writes of pending samples. Longer saves flash wear, shorter loses less on
+ * a reboot.
+ *
+ * @param ttFlush Time (ms).
+ */
+void CFTimeSeries::setFlushInterval(unsigned long ttFlush) {
+    _ttFlush = ttFlush;
+}
+
+/**
+ * Get series quantity.
+ *
+ * @return Series.
+ */
+int CFTimeSeries::getSeriesCount() {
+    return _seriesCount;
+}
+
+/**
+ * Get series index.
+ *
+ * @param key Key.
+ * @return Series index or -1 if there is none.
+ */
+int CFTimeSeries::getSeries(const char *key) {
+    for (int i = 0; i < _seriesCount; i++) {
+        if (strcmp(_series[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Get series key.
+ *
+ * @param series Series index.
+ * @return Key or nullptr if there is none.
+ */
+const char *CFTimeSeries::getKey(int series) {
+    return (series >= 0 && series < _seriesCount) ? _series[series].key : nullptr;
+}
+
+/**
+ * Get finest tier holding a time. When none goes back that far, the one going back the most.
+ *
+ * @param series Series index.
+ * @param from Unix time (s).
+ * @return Tier.
+ */
+CFTimeSeries::Tier CFTimeSeries::getTier(int series, uint32_t from) {
+    Tier best = RAW;
+    uint32_t bestOldest = UINT32_MAX;
+    for (uint8_t tier = RAW; tier < AUTO; tier++) {
+        uint32_t oldest = getOldest(series, (Tier) tier);
+        if (oldest != 0 && oldest <= from) {
+            return (Tier) tier;
+        }
+        if (oldest != 0 && oldest < bestOldest) {
+            best = (Tier) tier;
+            bestOldest = oldest;
+        }
+    }
+    return best;
+}
+
+/**
+ * Get oldest timestamp of a tier.
+ *
+ * @param series Series index.
+ * @param tier Tier.
+ * @return Unix time (s) or 0 if it's empty.
+ */
+uint32_t CFTimeSeries::getOldest(int series, Tier tier) {
+    if (series < 0 || series >= _seriesCount || tier >= AUTO) {
+        return 0;
+    }
+    Ring &ring = _series[series].rings[tier];
+    Header header;
+    bool found = false;
+    for (uint8_t i = 0; i < ring.segments && !found; i++) {
+        found = _segmentHeader(series, tier, i, _files[series][tier], header);
+    }
+    return found ? header.first : 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * CFTimeSeries.h
+ *
+ * History of integer readings kept in flash (SPIFFS or LittleFS), so the device still has its
+ * recent past when ThingsBoard or the network is down, or after a reboot.
+ *
+ *      CFTimeSeries _history;                                                  // SPIFFS, under /ts.
+ *      int _soilSeries = _history.addSeries("soi_perct");
+ *
+ *      _history.add(_soilSeries, _soilMoisture.getSersorPercent());            // On every reading.
+ *      _history.loop();                                                        // Writes pending samples now and then.
+ *
+ * Each series keeps three tiers, each in its own file of CF_TS_SEGMENTS fixed-size segments used
+ * as a ring, so the oldest segment is overwritten when a tier is full:
+ *
+ *      RAW     Samples as added (e.g. every second).
+ *      MINUTE  Average per minute.
+ *      HOUR    Average per hour.
+ *
+ * Minute and hour averages are folded from raw samples as they're added. A segment holds its
+ * first timestamp in the header, then delta-of-delta timestamps and delta values as zig-zag
+ * varints, so steady sampling takes about 2 bytes per sample. With the defaults (32 segments of
+ * 128 bytes per tier) a series takes 12 KB of flash and keeps ~30 minutes of 1 s samples, a day
+ * of minutes and two months of hours. The segment being filled stays in RAM and is written when
+ * it's full, on flush() and every flush interval; a reboot loses what wasn't written yet, plus
+ * the minute and hour being averaged.
+ *
+ * query() returns points of a time range from the finest tier that still holds its start. Pages
+ * follow with the timestamp after the last point returned:
+ *
+ *      CFTimeSeries::Point points[8];
+ *      size_t count = _history.query(_soilSeries, from, to, points, 8);
+ *      from = points[count - 1].timestamp + 1;
+ *
+ * Tier files are opened once, when the series is added, and stay open: opening a file allocates
+ * (the FS file object), so writes and queries don't, and history works after CFHeap::seal(true).
+ * That's 3 open files per series. SPIFFS allows 5 open files at once unless the core is built
+ * with a larger SPIFFS_MAX_OPEN_FILES, so keep to one series there (LittleFS has no such limit).
+ *
+ * Timestamps are Unix time in seconds, so the clock must be set, e.g. configTime(0, 0,
+ * "pool.ntp.org") in setup(). add() without a timestamp drops samples until it is. See also
+ * CFThingsBoardHelper::setBackfill() and CFLocalEndpoint::setTimeSeries().
+ *
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFTimeSeries_h
+#define CFTimeSeries_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <FS.h>                                                                 // SPIFFS or LittleFS.
+#include <time.h>                                                               // Time.
+
+#ifndef CF_TS_MAX_SERIES
+    #define CF_TS_MAX_SERIES                4                                   // Max series.
+#endif
+
+#ifndef CF_TS_SEGMENT_SIZE
+    #define CF_TS_SEGMENT_SIZE              128                                 // Segment size in flash and in RAM, header included.
+#endif
+
+#ifndef CF_TS_SEGMENTS
+    #define CF_TS_SEGMENTS                  32                                  // Segments per tier file, up to 255.
+#endif
+
+#define CF_TS_VALID_TIME                    1577836800UL                        // Clock is set after 2020-01-01.
+
+class CFTimeSeries {
+    public:
+        // Tiers, finest first.
+        enum Tier : uint8_t {
+            RAW,                                                                // Samples as added.
+            MINUTE,                                                             // Average per minute.
+            HOUR,                                                               // Average per hour.
+            AUTO                                                                // Finest tier holding the range start.
+        };
+
+        // Point.
+        struct Point {
+            uint32_t timestamp;                                                 // Unix time (s).
+            long value;                                                         // Value.
+        };
+
+    private:
+        // Segment header, in flash and in RAM.
+        struct Header {
+            uint16_t magic;                                                     // Segment marker.
+            uint16_t count;                                                     // Samples.
+            uint32_t sequence;                                                  // Segment sequence in the tier (0 if empty).
+            uint32_t first;                                                     // First timestamp.
+            uint32_t last;                                                      // Last timestamp.
+        };
+
+        // Segment being filled, and where the ring is.
+        struct Ring {
+            Header header;                                                      // Header.
+            uint8_t data[CF_TS_SEGMENT_SIZE - sizeof(Header)];                  // Encoded samples.
+            uint16_t length;                                                    // Encoded bytes.
+            uint8_t head;                                                       // Slot of this segment in the file.
+            uint8_t segments;                                                   // Segments stored, this one included.
+            bool dirty;                                                         // Flag that indicates it differs from flash.
+            uint32_t delta;                                                     // Last timestamp delta.
+            long value;                                                         // Last value.
+        };
+
+        // Average being folded into a coarser tier.
+        struct Bucket {
+            uint32_t start;                                                     // Bucket start time.
+            int64_t sum;                                                        // Sum of samples.
+            uint16_t count;                                                     // Samples.
+        };
+
+        // Series.
+        struct Series {
+            const char *key;                                                    // Key.
+            Ring rings[AUTO];                                                   // Segment being filled per tier.
+            Bucket buckets[AUTO];                                               // Averages per coarser tier (RAW unused).
+        };
+
+        // Attributes.
+        FS &_fileSystem;                                                        // File system.
+        const char *_directory;                                                 // Directory of the tier files.
+        Series _series[CF_TS_MAX_SERIES];                                       // Series.
+        File _files[CF_TS_MAX_SERIES][AUTO];                                    // Tier files, open while the store lives.
+        uint8_t _seriesCount;                                                   // Registered series.
+        bool _mounted;                                                          // Flag that indicates file system is mounted.
+        unsigned long _ttFlush;                                                 // Time between writes of pending samples.
+        unsigned long _tLastFlush;                                              // Last time pending samples were written.
+
+        // Methods.
+        void _path(char *buffer, size_t size, int series, Tier tier);           // Get tier file path.
+        void _load(int series, Tier tier);                                      // Find the ring in a tier file.
+        bool _readSegment(File &file, uint8_t slot, Header &header,             // Read a segment.
+                uint8_t *data);
+        void _writeSegment(int series, Tier tier);                              // Write segment being filled.
+        bool _append(int series, Tier tier, uint32_t timestamp, long value);    // Append a sample to a tier.
+        void _fold(int series, Tier tier, uint32_t timestamp, long value);      // Fold a sample into an average.
+        size_t _decode(const Header &header, const uint8_t *data,               // Decode points of a segment within a range.
+                uint32_t from, uint32_t to, Point *points, size_t size);
+        bool _segmentHeader(int series, Tier tier, uint8_t index,               // Get header of a segment, oldest first.
+                File &file, Header &header);
+        static size_t _putVarint(uint8_t *buffer, int32_t value);               // Encode a zig-zag varint.
+        static size_t _getVarint(const uint8_t *buffer, size_t size,            // Decode a zig-zag varint.
+                int32_t &value);
+
+    public:
+        // Methods.
+        CFTimeSeries(FS &fileSystem = SPIFFS, const char *directory = "/ts");   // Constructor.
+        int addSeries(const char *key);                                         // Add a series.
+        void loop();                                                            // Loop.
+        bool add(int series, long value);                                       // Add a sample now.
+        bool add(int series, long value, uint32_t timestamp);                   // Add a sample.
+        size_t query(int series, uint32_t from, uint32_t to, Point *points,     // Get points of a time range.
+                size_t size, Tier tier = AUTO);
+        void flush();                                                           // Write pending samples.
+        static uint32_t now();                                                  // Get Unix time (0 if clock isn't set).
+
+        // Accessors.
+        void setFlushInterval(unsigned long ttFlush);                           // Define time between writes of pending samples.
+        int getSeriesCount();                                                   // Get series quantity.
+        int getSeries(const char *key);                                         // Get series index.
+        const char *getKey(int series);                                         // Get series key.
+        Tier getTier(int series, uint32_t from);                                // Get finest tier holding a time.
+        uint32_t getOldest(int series, Tier tier);                              // Get oldest timestamp of a tier (0 if empty).
+};
+
+#endif
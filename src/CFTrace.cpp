@@ -0,0 +1,71 @@
+/**
+ * CFTrace.cpp
+ * 
+ * Hot-path tracing and compile-time log filtering for the CF helpers.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFTrace.h>                                                            // CF Trace.
+
+const uint16_t CFTrace::PHASE_BEGIN;
+const uint16_t CFTrace::PHASE_END;
+const uint32_t CFTrace::CAPACITY;
+CFTrace::Record CFTrace::_records[CFTrace::CAPACITY];
+uint32_t CFTrace::_written;
+
+/**
+ * Append a record.
+ * Oldest records are overwritten once the buffer is full.
+ *
+ * @param id Event id and phase.
+ * @param a First arg.
+ * @param b Second arg.
+ */
+void CFTrace::record(uint16_t id, int16_t a, int32_t b) {
+    Record &record = _records[_written & (CAPACITY - 1)];
+    record.time = micros();
+    record.id = id;
+    record.a = a;
+    record.b = b;
+    _written++;
+}
+
+/**
+ * Print records as hex lines.
+ *
+ * Format:
+ *      CFTRACE BEGIN <records>
+ *      <24 hex digits per record: time, id, a, b as little endian bytes>
+ *      CFTRACE END
+ *
+ * @param out Output (e.g. Serial).
+ */
+void CFTrace::dump(Print &out) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    uint32_t count = min(_written, CAPACITY);
+    out.print("CFTRACE BEGIN ");
+    out.println((unsigned long) count);
+
+    for (uint32_t i = _written - count; i != _written; i++) {
+        const uint8_t *bytes = (const uint8_t *) &_records[i & (CAPACITY - 1)];
+        char line[sizeof(Record) * 2 + 1];
+        for (size_t j = 0; j < sizeof(Record); j++) {
+            line[j * 2] = HEX_DIGITS[bytes[j] >> 4];
+            line[j * 2 + 1] = HEX_DIGITS[bytes[j] & 0x0F];
+        }
+        line[sizeof(Record) * 2] = '\0';
+        out.println(line);
+    }
+
+    out.println("CFTRACE END");
+}
+
+/**
+ * Discard records.
+ */
+void CFTrace::clear() {
+    _written = 0;
+}
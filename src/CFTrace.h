@@ -0,0 +1,114 @@
+/**
+ * CFTrace.h
+ * 
+ * Hot-path tracing and compile-time log filtering for the CF helpers.
+ *
+ * Logging:
+ *      CF_LOG_VERBOSE/NOTICE/WARNING(message) are removed at compile time when the level is
+ *      below CF_LOG_LEVEL. When they're compiled in, the message (and its String concatenation)
+ *      is only built if Logger's runtime level lets it through.
+ *
+ * Tracing:
+ *      CF_TRACE_BEGIN/END(id) and CF_TRACE_EVENT(id, a, b) append fixed 12 byte records
+ *      (timestamp in us, event id and phase, two args) into a static ring buffer. Nothing is
+ *      formatted on device. CFTrace::dump() prints the buffer as hex lines that
+ *      extras/tools/cftrace2chrome.py turns into Chrome trace JSON (chrome://tracing, Perfetto).
+ *      Tracing is compiled out unless CF_TRACE_BUFFER_SIZE is defined (records, power of two).
+ *
+ * Both are set with build flags, e.g. in platformio.ini:
+ *      build_flags = -DCF_LOG_LEVEL=CF_LOG_LEVEL_NOTICE -DCF_TRACE_BUFFER_SIZE=128
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFTrace_h
+#define CFTrace_h
+
+#include <Arduino.h>                                                            // Arduino library.
+#include <Logger.h>                                                             // Logger.
+
+// Log levels (same order as Logger::Level).
+#define CF_LOG_LEVEL_VERBOSE            0
+#define CF_LOG_LEVEL_NOTICE             1
+#define CF_LOG_LEVEL_WARNING            2
+#define CF_LOG_LEVEL_SILENT             5
+
+#ifndef CF_LOG_LEVEL
+    #define CF_LOG_LEVEL                CF_LOG_LEVEL_VERBOSE                    // Lowest level compiled in.
+#endif
+
+#if CF_LOG_LEVEL <= CF_LOG_LEVEL_VERBOSE
+    #define CF_LOG_VERBOSE(message)     do { if (Logger::getLogLevel() <= Logger::VERBOSE) Logger::verbose(message); } while (0)
+#else
+    #define CF_LOG_VERBOSE(message)     do { } while (0)
+#endif
+
+#if CF_LOG_LEVEL <= CF_LOG_LEVEL_NOTICE
+    #define CF_LOG_NOTICE(message)      do { if (Logger::getLogLevel() <= Logger::NOTICE) Logger::notice(message); } while (0)
+#else
+    #define CF_LOG_NOTICE(message)      do { } while (0)
+#endif
+
+#if CF_LOG_LEVEL <= CF_LOG_LEVEL_WARNING
+    #define CF_LOG_WARNING(message)     do { if (Logger::getLogLevel() <= Logger::WARNING) Logger::warning(message); } while (0)
+#else
+    #define CF_LOG_WARNING(message)     do { } while (0)
+#endif
+
+#ifndef CF_TRACE_BUFFER_SIZE
+    #define CF_TRACE_BUFFER_SIZE        0                                       // Trace records. 0 compiles tracing out.
+#endif
+
+static_assert(CF_TRACE_BUFFER_SIZE >= 0 && (CF_TRACE_BUFFER_SIZE & (CF_TRACE_BUFFER_SIZE - 1)) == 0,
+        "CF_TRACE_BUFFER_SIZE must be 0 or a power of 2, the ring is indexed with a mask.");
+
+#if CF_TRACE_BUFFER_SIZE > 0
+    #define CF_TRACE_BEGIN(id)          CFTrace::record((id) | CFTrace::PHASE_BEGIN, 0, 0)
+    #define CF_TRACE_END(id)            CFTrace::record((id) | CFTrace::PHASE_END, 0, 0)
+    #define CF_TRACE_EVENT(id, a, b)    CFTrace::record((id), (a), (b))
+#else
+    #define CF_TRACE_BEGIN(id)          do { } while (0)
+    #define CF_TRACE_END(id)            do { } while (0)
+    #define CF_TRACE_EVENT(id, a, b)    do { } while (0)
+#endif
+
+class CFTrace {
+    public:
+        // Event ids. Keep in sync with extras/tools/cftrace2chrome.py, it reads them from here.
+        enum Event {
+            SOIL_READ = 1,                                                      // Soil moisture reading (raw, percent).
+            DHT_READ = 2,                                                       // DHT reading.
+            TB_CONNECT = 3,                                                     // ThingsBoard connection.
+            TB_SEND = 4,                                                        // ThingsBoard submission.
+            WIFI_LOOP = 5,                                                      // WiFiManager processing.
+            NOTIFY_SEND = 6,                                                    // Notification request (queued, attempts).
+            INTERCOM_RING = 7,                                                  // Intercom ring (count, duration).
+            USER = 64                                                           // First id free for sketches.
+        };
+
+        // Phases, stored in the top bits of the id.
+        static const uint16_t PHASE_BEGIN = 0x8000;                             // Span begins.
+        static const uint16_t PHASE_END = 0x4000;                               // Span ends.
+
+    private:
+        // Trace record.
+        struct Record {
+            uint32_t time;                                                      // Timestamp (us).
+            uint16_t id;                                                        // Event id and phase.
+            int16_t a;                                                          // First arg.
+            int32_t b;                                                          // Second arg.
+        };
+
+        static const uint32_t CAPACITY = CF_TRACE_BUFFER_SIZE > 0 ? CF_TRACE_BUFFER_SIZE : 1; // Ring buffer capacity.
+        static Record _records[CAPACITY];                                       // Ring buffer.
+        static uint32_t _written;                                               // Records written since start.
+
+    public:
+        static void record(uint16_t id, int16_t a, int32_t b);                  // Append a record.
+        static void dump(Print &out);                                           // Print records as hex lines.
+        static void clear();                                                    // Discard records.
+};
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * CFTrend.cpp
+ * 
+ * Online trend estimation and threshold crossing prediction.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFTrend.h>                                                            // CF Trend.
+
+/**
+ * Constructor.
+ *
+ * @param halfLife Time for a reading's weight to halve (ms), about the window followed.
+ */
+CFTrend::CFTrend(unsigned long halfLife):
+        _halfLife(max(halfLife, 1UL) / 60000.0f),
+        _threshold(0), _horizon(0), _falling(true), _tLastAdd(0) {
+    reset();
+}
+
+/**
+ * Add a reading.
+ *
+ * @param value Reading.
+ * @return True if the threshold crossing has just become imminent.
+ */
+bool CFTrend::add(long value) {
+    unsigned long now = millis();
+    if (_sw > 0) {
+        // Move the time origin to now, then age the sums.
+        float dt = (now - _tLastAdd) / 60000.0f;
+        _stt -= 2 * dt * _st - dt * dt * _sw;
+        _stx -= dt * _sx;
+        _st -= dt * _sw;
+        float decay = exp2f(-dt / _halfLife);
+        _sw *= decay;
+        _st *= decay;
+        _sx *= decay;
+        _stt *= decay;
+        _stx *= decay;
+    }
+    _tLastAdd = now;
+
+    // New reading at time 0.
+    _sw += 1;
+    _sx += value;
+
+    // Weighted least squares, evaluated now.
+    float det = _sw * _stt - _st * _st;
+    if (det > 1e-6f * _sw * _sw) {
+        _slope = (_sw * _stx - _st * _sx) / det;
+        _level = (_sx - _slope * _st) / _sw;
+        _fitted = _sw >= CF_TREND_MIN_READINGS;
+    } else {
+        _slope = 0;
+        _level = _sx / _sw;
+    }
+
+    // Imminent crossing, with hysteresis.
+    if (!_fitted || _horizon <= 0) {
+        return false;
+    }
+    float minutes = _getMinutesToThreshold();
+    if (!_imminent && minutes >= 0 && minutes <= _horizon) {
+        _imminent = true;
+        return true;
+    }
+    if (_imminent && (minutes < 0 || minutes > _horizon * 1.25f)) {
+        _imminent = false;
+    }
+    return false;
+}
+
+/**
+ * Forget readings.
+ */
+void CFTrend::reset() {
+    _sw = _st = _sx = _stt = _stx = 0;
+    _level = _slope = 0;
+    _fitted = false;
+    _imminent = false;
+}
+
+/**
+ * Minutes until the fitted line crosses the threshold.
+ *
+ * @return Minutes, 0 if already past it, -1 if not heading there.
+ */
+float CFTrend::_getMinutesToThreshold() {
+    float distance = _falling ? _level - _threshold : _threshold - _level;
+    float speed = _falling ? -_slope : _slope;
+    if (distance <= 0) {
+        return 0;
+    }
+    return (speed > 0) ? distance / speed : -1;
+}
+
+/**
+ * Define threshold and how soon a crossing is imminent.
+ *
+ * @param threshold Value (e.g. 30 % moisture, the pot is dry below).
+ * @param horizon Crossing is imminent within (ms), 0 never triggers.
+ * @param falling True if crossed going down (default), false going up.
+ */
+void CFTrend::setThreshold(long threshold, unsigned long horizon, bool falling) {
+    _threshold = threshold;
+    _falling = falling;
+    _horizon = horizon / 60000.0f;
+    _imminent = false;
+}
+
+/**
+ * True once there are enough readings for a prediction.
+ *
+ * @return True if fitted.
+ */
+bool CFTrend::isFitted() {
+    return _fitted;
+}
+
+/**
+ * Get smoothed current value.
+ *
+ * @return Level.
+ */
+float CFTrend::getLevel() {
+    return _level;
+}
+
+/**
+ * Get change per hour.
+ *
+ * @return Rate (negative while falling).
+ */
+float CFTrend::getRate() {
+    return _slope * 60;
+}
+
+/**
+ * Get minutes until the threshold is crossed.
+ *
+ * @return Minutes, 0 if already past it, -1 if not heading there or not fitted yet.
+ */
+long CFTrend::getTimeToThreshold() {
+    if (!_fitted) {
+        return -1;
+    }
+    float minutes = _getMinutesToThreshold();
+    return (minutes < 0) ? -1 : lroundf(min(minutes, 1e6f));
+}
+
+/**
+ * True while the threshold crossing is imminent.
+ *
+ * @return True if within the horizon.
+ */
+bool CFTrend::isImminent() {
+    return _imminent;
+}
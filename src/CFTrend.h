@@ -0,0 +1,70 @@
+/**
+ * CFTrend.h
+ * 
+ * Online trend estimation and threshold crossing prediction.
+ *
+ * Readings are fitted with a linear regression weighted by age: a reading's weight halves
+ * every half-life, so the fit follows the recent window with five running sums instead of the
+ * readings themselves. Readings may come at irregular intervals (e.g. from CFAdaptiveSampler).
+ * From the fit:
+ *      - Level: smoothed current value.
+ *      - Rate: change per hour (e.g. drying rate of a pot in % per hour).
+ *      - Time to threshold: minutes until the fitted line falls below the threshold (or rises
+ *        above it), 0 once past it, -1 while heading away.
+ *
+ * add() returns true once when the predicted crossing gets within the horizon, so the sketch
+ * can send right away instead of waiting for the next send. It triggers again only after the
+ * prediction moved away (beyond 1.25 times the horizon, or heading away).
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFTrend_h
+#define CFTrend_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+#define CF_TREND_MIN_READINGS               3                                   // Readings (by weight) before predicting.
+
+class CFTrend {
+    private:
+        // Attributes.
+        float _halfLife;                                                        // Half-life of a reading's weight (minutes).
+        float _sw;                                                              // Sum of weights.
+        float _st;                                                              // Sum of weighted times (minutes, 0 is last reading).
+        float _sx;                                                              // Sum of weighted values.
+        float _stt;                                                             // Sum of weighted squared times.
+        float _stx;                                                             // Sum of weighted time * value.
+        float _level;                                                           // Fitted value now.
+        float _slope;                                                           // Fitted change per minute.
+        bool _fitted;                                                           // Enough readings for a prediction.
+        long _threshold;                                                        // Value to predict the crossing of.
+        float _horizon;                                                         // Crossing is imminent within (minutes).
+        bool _falling;                                                          // Threshold is crossed going down.
+        bool _imminent;                                                         // Crossing is imminent.
+
+        // Loop control.
+        unsigned long _tLastAdd;                                                // Last time a reading was added.
+
+        // Methods.
+        float _getMinutesToThreshold();                                         // Minutes to threshold (-1 if not heading there).
+
+    public:
+        // Methods.
+        CFTrend(unsigned long halfLife);                                        // Constructor.
+        bool add(long value);                                                   // Add a reading. True when the crossing becomes imminent.
+        void reset();                                                           // Forget readings.
+
+        // Accessors.
+        void setThreshold(long threshold, unsigned long horizon,                // Define threshold and how soon is imminent.
+                bool falling = true);
+        bool isFitted();                                                        // True once there are enough readings.
+        float getLevel();                                                       // Get smoothed current value.
+        float getRate();                                                        // Get change per hour.
+        long getTimeToThreshold();                                              // Get minutes until threshold (-1 if not heading there).
+        bool isImminent();                                                      // True while the crossing is imminent.
+};
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * CFUrlWriter.cpp
+ * 
+ * Writes URLs (and small requests) into a caller owned buffer without String concatenation.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFUrlWriter.h>                                                        // CF URL Writer.
+
+/**
+ * Constructor.
+ *
+ * @param buffer Output buffer.
+ * @param size Buffer size.
+ */
+CFUrlWriter::CFUrlWriter(char *buffer, size_t size):
+        _buffer(buffer), _size(size) {
+    reset();
+}
+
+/**
+ * Append a char.
+ *
+ * @param c Char.
+ * @return Writer.
+ */
+CFUrlWriter &CFUrlWriter::append(char c) {
+    if (_length + 1 < _size) {
+        _buffer[_length++] = c;
+        _buffer[_length] = '\0';
+    } else {
+        _overflow = true;
+    }
+    return *this;
+}
+
+/**
+ * Append a text as is.
+ *
+ * @param text Text.
+ * @return Writer.
+ */
+CFUrlWriter &CFUrlWriter::append(const char *text) {
+    while (*text) {
+        append(*text++);
+    }
+    return *this;
+}
+
+/**
+ * Append a number.
+ *
+ * @param value Value.
+ * @return Writer.
+ */
+CFUrlWriter &CFUrlWriter::append(unsigned long value) {
+    char digits[11];
+    int i = 0;
+    do {
+        digits[i++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (i > 0) {
+        append(digits[--i]);
+    }
+    return *this;
+}
+
+/**
+ * Append a percent-encoded text.
+ * Unreserved chars (RFC 3986) are kept, everything else is written as %XX.
+ *
+ * @param text Text.
+ * @return Writer.
+ */
+CFUrlWriter &CFUrlWriter::appendEncoded(const char *text) {
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+    while (*text) {
+        unsigned char c = *text++;
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            append((char) c);
+        } else {
+            append('%');
+            append(HEX_DIGITS[(c >> 4) & 0x0F]);
+            append(HEX_DIGITS[c & 0x0F]);
+        }
+    }
+    return *this;
+}
+
+/**
+ * Discard written data.
+ */
+void CFUrlWriter::reset() {
+    _length = 0;
+    _overflow = false;
+    if (_size > 0) {
+        _buffer[0] = '\0';
+    }
+}
+
+/**
+ * Get written text.
+ *
+ * @return Text.
+ */
+const char *CFUrlWriter::c_str() {
+    return _buffer;
+}
+
+/**
+ * Get written length.
+ *
+ * @return Length.
+ */
+size_t CFUrlWriter::length() {
+    return _length;
+}
+
+/**
+ * True if everything fit into the buffer.
+ *
+ * @return False if some write was dropped.
+ */
+bool CFUrlWriter::isValid() {
+    return !_overflow;
+}
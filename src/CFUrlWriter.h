@@ -0,0 +1,41 @@
+/**
+ * CFUrlWriter.h
+ * 
+ * Writes URLs (and small requests) into a caller owned buffer without String concatenation.
+ * Writes past the end are dropped and flag the writer as overflowed, the buffer is always
+ * null terminated.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFUrlWriter_h
+#define CFUrlWriter_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+class CFUrlWriter {
+    private:
+        // Attributes.
+        char *_buffer;                                                          // Output buffer.
+        size_t _size;                                                           // Buffer size.
+        size_t _length;                                                         // Written length.
+        bool _overflow;                                                         // Flag that indicates the buffer was too small.
+
+    public:
+        // Methods.
+        CFUrlWriter(char *buffer, size_t size);                                 // Constructor.
+        CFUrlWriter &append(char c);                                            // Append a char.
+        CFUrlWriter &append(const char *text);                                  // Append a text as is.
+        CFUrlWriter &append(unsigned long value);                               // Append a number.
+        CFUrlWriter &appendEncoded(const char *text);                           // Append a percent-encoded text.
+        void reset();                                                           // Discard written data.
+
+        // Accessors.
+        const char *c_str();                                                    // Get written text.
+        size_t length();                                                        // Get written length.
+        bool isValid();                                                         // True if everything fit into the buffer.
+};
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * CFWebAssets.cpp
+ * 
+ * Pre-gzipped static assets served by the config portal straight from flash.
+ *
+ * Assets are gzip level 9 with a zeroed mtime so the arrays are reproducible.
+ * They are sent as-is with "Content-Encoding: gzip", so the device never
+ * inflates nor copies them into RAM.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#include <CFWebAssets.h>                                                        // CF Web Assets.
+
+/**
+ * Style sheet.
+ *
+ * body{background:#060606;color:#fff;font-family:verdana,sans-serif}
+ * .wrap{max-width:360px;margin:0 auto}
+ * h1,h3{color:#1fa3ec}
+ * input,select{border-radius:.3rem;width:100%;padding:5px}
+ * button{border:0;border-radius:.3rem;background:#1fa3ec;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%}
+ * a{color:#1fa3ec}
+ */
+const uint8_t CFWebAssets::STYLE_CSS_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6d, 0x8f, 0xc1, 0x6e, 0xc3, 0x20,
+    0x10, 0x44, 0xef, 0x7c, 0x45, 0xa5, 0xa8, 0x37, 0x63, 0xe1, 0xb8, 0xcd, 0x01, 0xbe, 0x66, 0x6d,
+    0x16, 0xb3, 0xaa, 0x0d, 0xd6, 0x02, 0x8d, 0x13, 0x8b, 0x7f, 0x8f, 0xd2, 0xe4, 0x90, 0x56, 0xd5,
+    0x9c, 0xdf, 0xcc, 0xbc, 0x21, 0xda, 0xcb, 0x3e, 0xc0, 0xf8, 0x35, 0x71, 0x2c, 0xc1, 0xea, 0x83,
+    0x3a, 0xdd, 0x63, 0xc6, 0x38, 0x47, 0xd6, 0x07, 0xe7, 0x9c, 0x71, 0x31, 0x64, 0xe9, 0x60, 0xa1,
+    0xf9, 0xa2, 0xbf, 0x91, 0x2d, 0x04, 0x68, 0x12, 0x84, 0x24, 0x13, 0x32, 0xb9, 0x2a, 0xda, 0x33,
+    0xc3, 0xba, 0x2f, 0xb0, 0xc9, 0x33, 0xd9, 0xec, 0x75, 0x7f, 0x52, 0xeb, 0x66, 0x16, 0xe0, 0x89,
+    0x82, 0x56, 0x6f, 0x50, 0x72, 0xac, 0xc2, 0x77, 0x8d, 0xef, 0xf7, 0x67, 0x6b, 0xe7, 0xa0, 0xc7,
+    0xb1, 0x0a, 0x0a, 0x6b, 0xc9, 0x4d, 0xc2, 0x19, 0xc7, 0xbc, 0x0f, 0x91, 0x2d, 0xb2, 0x64, 0xb0,
+    0x54, 0x92, 0x6e, 0x7b, 0xc6, 0xc5, 0x3c, 0x0a, 0x3b, 0xa5, 0xde, 0xcd, 0x0a, 0xd6, 0x52, 0x98,
+    0xf4, 0xe7, 0xba, 0x55, 0x31, 0x94, 0x9c, 0x63, 0x78, 0x22, 0x5a, 0x99, 0xff, 0xd8, 0x57, 0xa9,
+    0xc7, 0xe0, 0xab, 0xd4, 0x4c, 0x01, 0xa5, 0x47, 0x9a, 0x7c, 0xd6, 0xc7, 0xf6, 0xe3, 0x0e, 0xfc,
+    0x78, 0x26, 0xba, 0xa2, 0xee, 0xda, 0xe3, 0xef, 0xf5, 0x2a, 0xe0, 0xef, 0xf7, 0x1b, 0x83, 0xbc,
+    0x5a, 0xb0, 0x39, 0x01, 0x00, 0x00
+};
+const size_t CFWebAssets::STYLE_CSS_GZ_LEN = sizeof(CFWebAssets::STYLE_CSS_GZ);
+
+/**
+ * Favicon. A 16x16 rounded square with the "CF" initials.
+ */
+const uint8_t CFWebAssets::FAVICON_SVG_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x3d, 0x8e, 0xc1, 0x0a, 0xc3, 0x20,
+    0x10, 0x44, 0xef, 0xfd, 0x8a, 0x65, 0x7b, 0x4e, 0x34, 0x09, 0x94, 0xb6, 0xa8, 0x87, 0x16, 0xfa,
+    0x1f, 0x12, 0x35, 0x0a, 0x46, 0x8b, 0x91, 0x98, 0xf6, 0xeb, 0x6b, 0x68, 0x29, 0xcc, 0x61, 0x99,
+    0x79, 0xb3, 0x0c, 0x5b, 0xd6, 0x09, 0xb6, 0xd9, 0x87, 0x85, 0xa3, 0xcd, 0xf9, 0x79, 0x25, 0xa4,
+    0x94, 0xd2, 0x96, 0xa1, 0x8d, 0x69, 0x22, 0x3d, 0xa5, 0x94, 0x54, 0x02, 0x61, 0x75, 0xba, 0xdc,
+    0xe2, 0xc6, 0x91, 0x02, 0x85, 0xee, 0x54, 0x85, 0x82, 0x25, 0x3d, 0x66, 0x28, 0x4e, 0x65, 0xcb,
+    0xb1, 0x1a, 0x60, 0xb5, 0x9b, 0x6c, 0xfe, 0xde, 0xa9, 0xb2, 0x03, 0x82, 0x71, 0xde, 0x73, 0x3c,
+    0x76, 0x46, 0x0e, 0x7a, 0x44, 0x22, 0x58, 0xd6, 0x5b, 0x86, 0x9a, 0x9d, 0x11, 0x5e, 0x95, 0xec,
+    0x2b, 0x12, 0x43, 0x6e, 0x16, 0xf7, 0xd6, 0x1c, 0x2f, 0x08, 0x7b, 0xde, 0xc8, 0x30, 0xda, 0x98,
+    0x38, 0xce, 0x4e, 0x29, 0xaf, 0xff, 0x5f, 0x8c, 0x31, 0x3f, 0xdc, 0xc8, 0xd9, 0xf9, 0xda, 0x5f,
+    0x75, 0x52, 0x32, 0x48, 0x14, 0xf7, 0x07, 0x23, 0x7b, 0x55, 0xb0, 0x7d, 0xaf, 0x38, 0x7c, 0x00,
+    0xdc, 0xcf, 0xa1, 0xeb, 0xd8, 0x00, 0x00, 0x00
+};
+const size_t CFWebAssets::FAVICON_SVG_GZ_LEN = sizeof(CFWebAssets::FAVICON_SVG_GZ);
@@ -0,0 +1,27 @@
+/**
+ * CFWebAssets.h
+ * 
+ * Pre-gzipped static assets served by the config portal straight from flash.
+ * 
+ * @author  Caio Frota <caiofrota@gmail.com>
+ * @version 1.0
+ * @since   Sep, 2021
+ */
+
+#ifndef CFWebAssets_h
+#define CFWebAssets_h
+
+#include <Arduino.h>                                                            // Arduino library.
+
+class CFWebAssets {
+    public:
+        // Style sheet (text/css).
+        static const uint8_t STYLE_CSS_GZ[];
+        static const size_t STYLE_CSS_GZ_LEN;
+
+        // Favicon (image/svg+xml).
+        static const uint8_t FAVICON_SVG_GZ[];
+        static const size_t FAVICON_SVG_GZ_LEN;
+};
+
+#endif
@@ -14,10 +14,14 @@
  * Constructor.
  */
 CFWiFiManagerHelper::CFWiFiManagerHelper():
-        _wifiManager(), _wifiServer(80),
+        _wifiManager(), _wifiServer(CF_WM_SERVER_PORT), _localEndpoint(nullptr), _wifiConnected(false),
         _fileSystemPath("/cfwmconfig.json"),
         _defaultWifiPassword("12345678") {
     _defaultWifiSSID = _wifiManager.getDefaultAPName();
+    _wifiSSID.reserve(32);                                                      // Updated on connection without allocating.
+    _wifiIP.reserve(15);
+    _mConnect = CFMetrics::counter("wifi_connect");
+    _mConfigMode = CFMetrics::counter("wifi_portal");
 }
 
 /**
@@ -26,10 +30,14 @@ CFWiFiManagerHelper::CFWiFiManagerHelper():
  * @param defaultWifiPassword Default password that should be used when WiFi on AP mode.
  */
 CFWiFiManagerHelper::CFWiFiManagerHelper(String defaultWifiPassword):
-         _wifiManager(), _wifiServer(80),
+         _wifiManager(), _wifiServer(CF_WM_SERVER_PORT), _localEndpoint(nullptr), _wifiConnected(false),
         _fileSystemPath("/cfwmconfig.json"),
         _defaultWifiPassword(defaultWifiPassword) {
     _defaultWifiSSID = _wifiManager.getDefaultAPName();
+    _wifiSSID.reserve(32);                                                      // Updated on connection without allocating.
+    _wifiIP.reserve(15);
+    _mConnect = CFMetrics::counter("wifi_connect");
+    _mConfigMode = CFMetrics::counter("wifi_portal");
 }
 
 /**
@@ -56,17 +64,18 @@ void CFWiFiManagerHelper::begin() {
     _wifiManager.setMenu(menu);
     _wifiManager.setConfigPortalTimeout(30);                                    // Auto close config portal timeout.
     _wifiManager.setClass("invert");                                            // Dark theme.
+    _wifiManager.setWebServerCallback(                                          // Register static assets before portal routes.
+            std::bind(&CFWiFiManagerHelper::_webServerCallback, this));
+    _wifiManager.setCustomHeadElement(                                          // Cached style sheet and favicon.
+            "<link rel='stylesheet' href='/cf.css'><link rel='icon' href='/favicon.ico'>");
+    _wifiManager.setConfigPortalBlocking(false);                                // Portal runs from loop(), sensing keeps going.
 
     // Start Wi-Fi Manager.
+    // When it can't connect the config portal is started and begin() returns right away, the
+    // connection is then picked up by loop().
     WiFi.mode(WIFI_STA);
-    bool res = _wifiManager.autoConnect(_defaultWifiSSID.c_str(), _defaultWifiPassword.c_str());
-    if (res) {
-        // Connected.
-        _wifiSSID = WiFi.SSID();
-        _wifiIP = WiFi.localIP().toString();
-        _wifiManager.startWebPortal();
-        _wifiServer.begin();
-        _wifiConnected = true;
+    if (_wifiManager.autoConnect(_defaultWifiSSID.c_str(), _defaultWifiPassword.c_str())) {
+        _onConnected();
     }
 }
 
@@ -74,7 +83,60 @@ void CFWiFiManagerHelper::begin() {
  * Loop.
  */
 void CFWiFiManagerHelper::loop() {
+    CF_TRACE_BEGIN(CFTrace::WIFI_LOOP);
+    CFHeap::allow();                                                            // The portal works on Strings.
     _wifiManager.process();
+    CFHeap::disallow();
+    CF_TRACE_END(CFTrace::WIFI_LOOP);
+
+    // Connected through the config portal or by the station auto reconnect. A dropped station
+    // is connected again by the SDK, picked up here as well.
+    bool connected = WiFi.status() == WL_CONNECTED;
+    if (!_wifiConnected && connected) {
+        CFHeap::allow();                                                        // The portal starts again.
+        _onConnected();
+        CFHeap::disallow();
+    } else if (_wifiConnected && !connected) {
+        CF_LOG_NOTICE("Wi-Fi disconnected.");
+        _wifiConnected = false;
+    }
+
+    // Serve local clients, never waits on them.
+    if (_wifiConnected && _localEndpoint) {
+        _localEndpoint->loop(_wifiServer);
+    }
+}
+
+/**
+ * Update connection data once STA is connected. SSID and IP are copied into the reserved
+ * Strings rather than through WiFi.SSID() and IPAddress::toString(), which allocate.
+ */
+void CFWiFiManagerHelper::_onConnected() {
+    struct station_config config;
+    char ssid[sizeof(config.ssid) + 1];
+    wifi_station_get_config(&config);
+    memcpy(ssid, config.ssid, sizeof(config.ssid));
+    ssid[sizeof(config.ssid)] = '\0';
+    _wifiSSID = ssid;
+    _setIP(WiFi.localIP());
+    _wifiManager.startWebPortal();
+    _wifiServer.begin();
+    _wifiConnected = true;
+    CFMetrics::increment(_mConnect);
+    if (_onConnectCallback) {
+        _onConnectCallback();
+    }
+}
+
+/**
+ * Update local IP text.
+ *
+ * @param ip Address.
+ */
+void CFWiFiManagerHelper::_setIP(IPAddress ip) {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    _wifiIP = text;
 }
 
 /**
@@ -156,22 +218,49 @@ void CFWiFiManagerHelper::_saveParameters() {
  * @param wifiManager Wi-Fi Manager.
  */
 void CFWiFiManagerHelper::_APCallback(WiFiManager *wifiManager) {
-    _wifiIP = WiFi.softAPIP().toString();
+    _setIP(WiFi.softAPIP());
+    CFMetrics::increment(_mConfigMode);
     if (_onConfigModeCallback) {
         _onConfigModeCallback();
     }
 }
 
+/**
+ * Web server callback.
+ * It's called before WiFiManager registers its own routes, so these take precedence.
+ */
+void CFWiFiManagerHelper::_webServerCallback() {
+    _wifiManager.server->on("/cf.css", HTTP_GET, [this]() {
+        _sendAsset("text/css", CFWebAssets::STYLE_CSS_GZ, CFWebAssets::STYLE_CSS_GZ_LEN);
+    });
+    _wifiManager.server->on("/favicon.ico", HTTP_GET, [this]() {
+        _sendAsset("image/svg+xml", CFWebAssets::FAVICON_SVG_GZ, CFWebAssets::FAVICON_SVG_GZ_LEN);
+    });
+}
+
+/**
+ * Send a pre-gzipped asset from flash.
+ * Content is streamed from PROGMEM without being inflated or copied into RAM.
+ *
+ * @param contentType Content type.
+ * @param data Gzipped data.
+ * @param len Data length.
+ */
+void CFWiFiManagerHelper::_sendAsset(const char *contentType, const uint8_t *data, size_t len) {
+    _wifiManager.server->sendHeader(F("Content-Encoding"), F("gzip"));
+    _wifiManager.server->sendHeader(F("Cache-Control"), F("max-age=86400"));
+    _wifiManager.server->send_P(200, contentType, (PGM_P) data, len);
+}
+
 /**
  * Get parameter value from key.
  * 
  * @param key Parameter key.
- * @return Parameter value.
+ * @return Parameter value, owned by the parameter ("" if not found).
  */
-String CFWiFiManagerHelper::getParameter(String key) {
+const char *CFWiFiManagerHelper::getParameter(const char *key) {
     for (int i = 0; i < _maxParamsQty; i++) {
-        String foundKey = _wifiManagerParameters[i].getID();
-        if (foundKey == key) {
+        if (strcmp(_wifiManagerParameters[i].getID(), key) == 0) {
             return _wifiManagerParameters[i].getValue();
         }
     }
@@ -182,14 +271,32 @@ String CFWiFiManagerHelper::getParameter(String key) {
  * Define parameter value with a key.
  * 
  * @param key Parameter key.
- * @return Parameter value.
+ * @param value Parameter value.
  */
 void CFWiFiManagerHelper::setParameter(String key, String value) {
+    setParameter(key.c_str(), value.c_str());
+}
+
+/**
+ * Define parameter value with a key.
+ * Parameters are only saved when the value changes, so repeated updates don't wear the flash.
+ * 
+ * @param key Parameter key.
+ * @param value Parameter value.
+ */
+void CFWiFiManagerHelper::setParameter(const char *key, const char *value) {
+    if (!value) {
+        return;
+    }
     for (int i = 0; i < _maxParamsQty; i++) {
-        String foundKey = _wifiManagerParameters[i].getID();
-        if (foundKey == key) {
-            _wifiManagerParameters[i].setValue(value.c_str(), value.length());
-            _saveParameters();
+        if (strcmp(_wifiManagerParameters[i].getID(), key) == 0) {
+            if (strcmp(_wifiManagerParameters[i].getValue(), value) != 0) {
+                _wifiManagerParameters[i].setValue(value, _wifiManagerParameters[i].getValueLength());
+                CFHeap::allow();                                                // Rewriting the file, seldom.
+                _saveParameters();
+                CFHeap::disallow();
+            }
+            return;
         }
     }
 }
@@ -199,7 +306,7 @@ void CFWiFiManagerHelper::setParameter(String key, String value) {
  *
  * @return Default SSID.
  */
-String CFWiFiManagerHelper::getDefaultSSID() {
+const String &CFWiFiManagerHelper::getDefaultSSID() {
     return _defaultWifiSSID;
 }
 
@@ -208,7 +315,7 @@ String CFWiFiManagerHelper::getDefaultSSID() {
  *
  * @return Default password.
  */
-String CFWiFiManagerHelper::getDefaultPassword() {
+const String &CFWiFiManagerHelper::getDefaultPassword() {
     return _defaultWifiPassword;
 }
 
@@ -217,7 +324,7 @@ String CFWiFiManagerHelper::getDefaultPassword() {
  *
  * @return SSID.
  */
-String CFWiFiManagerHelper::getSSID() {
+const String &CFWiFiManagerHelper::getSSID() {
     return _wifiSSID;
 }
 
@@ -226,14 +333,24 @@ String CFWiFiManagerHelper::getSSID() {
  *
  * @return Local IP.
  */
-String CFWiFiManagerHelper::getLocalIP() {
+const String &CFWiFiManagerHelper::getLocalIP() {
     return _wifiIP;
 }
 
+/**
+ * True if WiFi is connected.
+ */
 bool CFWiFiManagerHelper::isConnected() {
     return _wifiConnected;
 }
 
+/**
+ * True if config portal (AP mode) is running.
+ */
+bool CFWiFiManagerHelper::isConfigMode() {
+    return _wifiManager.getConfigPortalActive();
+}
+
 /**
  * Define on config mode callback.
  *
@@ -250,4 +367,23 @@ void CFWiFiManagerHelper::setOnConfigModeCallback(VoidCallback callback) {
  */
 void CFWiFiManagerHelper::setOnSaveParametersCallback(VoidCallback callback) {
     _onSaveParametersCallback = callback;
+}
+
+/**
+ * Define on Wi-Fi connect callback.
+ *
+ * @param callback Callback.
+ */
+void CFWiFiManagerHelper::setOnConnectCallback(VoidCallback callback) {
+    _onConnectCallback = callback;
+}
+
+/**
+ * Serve a local endpoint (readings and metrics for LAN monitoring) on the Wi-Fi Server, port
+ * CF_WM_SERVER_PORT, once Wi-Fi is connected.
+ *
+ * @param localEndpoint Local endpoint.
+ */
+void CFWiFiManagerHelper::setLocalEndpoint(CFLocalEndpoint &localEndpoint) {
+    _localEndpoint = &localEndpoint;
 }
\ No newline at end of file
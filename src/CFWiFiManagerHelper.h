@@ -14,6 +14,16 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
+#include <Logger.h>                                                             // Logger.
+#include <CFWebAssets.h>                                                        // CF Web Assets.
+#include <CFMetrics.h>                                                          // CF Metrics.
+#include <CFHeap.h>                                                             // CF Heap.
+#include <CFTrace.h>                                                           // CF Trace.
+#include <CFLocalEndpoint.h>                                                    // CF Local Endpoint.
+
+#ifndef CF_WM_SERVER_PORT
+    #define CF_WM_SERVER_PORT               8080                                // Local endpoint port (WiFiManager web portal keeps 80).
+#endif
 
 class CFWiFiManagerHelper {
     private:
@@ -26,6 +36,7 @@ class CFWiFiManagerHelper {
         WiFiManagerParameter *_wifiManagerParameters;                           // WIFiManager parameters.
         WiFiManager _wifiManager;                                               // WiFiManager.
         WiFiServer _wifiServer;                                                 // Wi-Fi Server.
+        CFLocalEndpoint *_localEndpoint;                                        // Local endpoint served on Wi-Fi Server (optional).
 
         // Config attributes.
         String _fileSystemPath;                                                 // Path to store configs.
@@ -38,16 +49,26 @@ class CFWiFiManagerHelper {
         String _wifiIP;                                                         // Local IP.
         bool _wifiConnected;                                                    // Flag that indicates WiFi is connected.
 
+        // Metrics.
+        int _mConnect;                                                          // Connections.
+        int _mConfigMode;                                                       // Config portal starts.
+
         // Methods.
         void _loadParameters();                                                 // Load parameters from file into WiFiManager.
         void _saveParameters();                                                 // Save parameters into file from WiFiManager.
+        void _onConnected();                                                    // Update connection data once STA is connected.
+        void _setIP(IPAddress ip);                                              // Update local IP text.
+        void _sendAsset(const char *contentType,                                // Send a pre-gzipped asset from flash.
+                const uint8_t *data, size_t len);
 
         // Inner callbacks.
         void _APCallback(WiFiManager *wifiManager);                             // Callback when AP Mode is connected.
+        void _webServerCallback();                                              // Callback when portal web server is created.
 
         // Available callbacks.
         VoidCallback _onConfigModeCallback;                                     // On save parameters callback.
         VoidCallback _onSaveParametersCallback;                                 // On save parameters callback.
+        VoidCallback _onConnectCallback;                                        // On Wi-Fi connect callback.
 
     public:
         // Methods.
@@ -56,15 +77,19 @@ class CFWiFiManagerHelper {
         void begin();                                                           // Initialize.
         void loop();                                                            // Loop.
         void setCustomParameters(WiFiManagerParameter* params, int paramsQt);   // Define WiFiManager parameters.
-        String getParameter(String key);                                        // Get parameter value from key.
+        const char *getParameter(const char *key);                              // Get parameter value from key.
         void setParameter(String key, String value);                            // Define parameter value with a key.
-        String getDefaultSSID();                                                // Get default SSID.
-        String getDefaultPassword();                                            // Get default password.
-        String getSSID();                                                       // Get SSID.
-        String getLocalIP();                                                    // Get local IP.
+        void setParameter(const char *key, const char *value);                  // Define parameter value with a key.
+        const String &getDefaultSSID();                                         // Get default SSID.
+        const String &getDefaultPassword();                                     // Get default password.
+        const String &getSSID();                                                // Get SSID.
+        const String &getLocalIP();                                             // Get local IP.
         bool isConnected();                                                     // True if WiFi is connected.
+        bool isConfigMode();                                                    // True if config portal (AP mode) is running.
         void setOnConfigModeCallback(const VoidCallback);                       // Define on config mode callback.
         void setOnSaveParametersCallback(const VoidCallback);                   // Define on save parameters callback.
+        void setOnConnectCallback(const VoidCallback);                          // Define on Wi-Fi connect callback.
+        void setLocalEndpoint(CFLocalEndpoint &localEndpoint);                  // Serve a local endpoint on the Wi-Fi Server.
 };
 
 #endif
\ No newline at end of file